@@ -22,6 +22,18 @@
 #include <unordered_map>
 #include "Common/Serialize/SerializeFuncs.h"
 
+template<class M>
+void DoMapEntries(PointerWrap &p, M &x, unsigned int number) {
+	// Not for reading, so the keys won't be modified.
+	typename M::iterator itr = x.begin();
+	while (number > 0) {
+		Do(p, const_cast<typename M::key_type &>(itr->first));
+		Do(p, itr->second);
+		--number;
+		++itr;
+	}
+}
+
 template<class M>
 void DoMap(PointerWrap &p, M &x, typename M::mapped_type &default_val) {
 	unsigned int number = (unsigned int)x.size();
@@ -43,22 +55,89 @@ void DoMap(PointerWrap &p, M &x, typename M::mapped_type &default_val) {
 	case PointerWrap::MODE_WRITE:
 	case PointerWrap::MODE_MEASURE:
 	case PointerWrap::MODE_VERIFY:
+		DoMapEntries(p, x, number);
+		break;
+	case PointerWrap::MODE_NOOP:
+		break;
+	}
+}
+
+// Loads into the existing entries where the keys match, to avoid reallocating every node.
+// Requires sorted keys (std::map or std::multimap.)  Maps of pointers are recreated instead, see below.
+template<class M>
+void DoSortedMapInPlace(PointerWrap &p, M &x, typename M::mapped_type &default_val) {
+	unsigned int number = (unsigned int)x.size();
+	Do(p, number);
+	switch (p.mode) {
+	case PointerWrap::MODE_READ:
 	{
 		typename M::iterator itr = x.begin();
 		while (number > 0) {
-			typename M::key_type first = itr->first;
+			typename M::key_type first = typename M::key_type();
 			Do(p, first);
-			Do(p, itr->second);
+			typename M::mapped_type second = default_val;
+			Do(p, second);
+			while (itr != x.end() && itr->first < first)
+				itr = x.erase(itr);
+			if (itr != x.end() && !(first < itr->first)) {
+				itr->second = std::move(second);
+				++itr;
+			} else {
+				x.emplace_hint(itr, std::move(first), std::move(second));
+			}
 			--number;
-			++itr;
 		}
+		x.erase(itr, x.end());
 		break;
 	}
+	case PointerWrap::MODE_WRITE:
+	case PointerWrap::MODE_MEASURE:
+	case PointerWrap::MODE_VERIFY:
+		DoMapEntries(p, x, number);
+		break;
 	case PointerWrap::MODE_NOOP:
 		break;
 	}
 }
 
+// Unordered maps have no key order to walk, so existing entries are looked up instead.
+// If the map had keys that aren't in the state, it's simplest to start over and recreate them.
+template<class M>
+void DoUnorderedMapInPlace(PointerWrap &p, M &x, typename M::mapped_type &default_val) {
+	if (p.mode != PointerWrap::MODE_READ) {
+		DoMap(p, x, default_val);
+		return;
+	}
+
+	unsigned int number = (unsigned int)x.size();
+	Do(p, number);
+	u8 *entries = *p.ptr;
+	for (unsigned int i = 0; i < number; ++i) {
+		typename M::key_type first = typename M::key_type();
+		Do(p, first);
+		typename M::mapped_type second = default_val;
+		Do(p, second);
+		typename M::iterator itr = x.find(first);
+		if (itr != x.end())
+			itr->second = std::move(second);
+		else
+			x.emplace(std::move(first), std::move(second));
+	}
+
+	if (x.size() != number && p.error != PointerWrap::ERROR_FAILURE) {
+		// The entries were already read once, so the data is available.
+		*p.ptr = entries;
+		x.clear();
+		for (unsigned int i = 0; i < number; ++i) {
+			typename M::key_type first = typename M::key_type();
+			Do(p, first);
+			typename M::mapped_type second = default_val;
+			Do(p, second);
+			x[first] = second;
+		}
+	}
+}
+
 template<class K, class T>
 void Do(PointerWrap &p, std::map<K, T *> &x) {
 	if (p.mode == PointerWrap::MODE_READ) {
@@ -74,7 +153,7 @@ void Do(PointerWrap &p, std::map<K, T *> &x) {
 template<class K, class T>
 void Do(PointerWrap &p, std::map<K, T> &x) {
 	T dv = T();
-	DoMap(p, x, dv);
+	DoSortedMapInPlace(p, x, dv);
 }
 
 template<class K, class T>
@@ -92,7 +171,7 @@ void Do(PointerWrap &p, std::unordered_map<K, T *> &x) {
 template<class K, class T>
 void Do(PointerWrap &p, std::unordered_map<K, T> &x) {
 	T dv = T();
-	DoMap(p, x, dv);
+	DoUnorderedMapInPlace(p, x, dv);
 }
 
 template<class M>
@@ -116,16 +195,8 @@ void DoMultimap(PointerWrap &p, M &x, typename M::mapped_type &default_val) {
 	case PointerWrap::MODE_WRITE:
 	case PointerWrap::MODE_MEASURE:
 	case PointerWrap::MODE_VERIFY:
-	{
-		typename M::iterator itr = x.begin();
-		while (number > 0) {
-			Do(p, itr->first);
-			Do(p, itr->second);
-			--number;
-			++itr;
-		}
+		DoMapEntries(p, x, number);
 		break;
-	}
 	case PointerWrap::MODE_NOOP:
 		break;
 	}
@@ -146,7 +217,7 @@ void Do(PointerWrap &p, std::multimap<K, T *> &x) {
 template<class K, class T>
 void Do(PointerWrap &p, std::multimap<K, T> &x) {
 	T dv = T();
-	DoMultimap(p, x, dv);
+	DoSortedMapInPlace(p, x, dv);
 }
 
 template<class K, class T>
@@ -29,12 +29,19 @@ void DoSet(PointerWrap &p, std::set<T> &x) {
 	switch (p.mode) {
 	case PointerWrap::MODE_READ:
 	{
-		x.clear();
+		// Keep the existing nodes where possible, the saved values are sorted too.
+		typename std::set<T>::iterator itr = x.begin();
 		while (number-- > 0) {
 			T it = T();
 			Do(p, it);
-			x.insert(it);
+			while (itr != x.end() && *itr < it)
+				itr = x.erase(itr);
+			if (itr != x.end() && !(it < *itr))
+				++itr;
+			else
+				x.insert(itr, it);
 		}
+		x.erase(itr, x.end());
 	}
 	break;
 	case PointerWrap::MODE_WRITE:
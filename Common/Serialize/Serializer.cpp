@@ -15,8 +15,13 @@
 // Official SVN repository and contact information can be found at
 // http://code.google.com/p/dolphin-emu/
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <vector>
 #include <snappy-c.h>
 #include <zstd.h>
 
@@ -24,6 +29,9 @@
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/File/FileUtil.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ParallelLoop.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
 
 enum class SerializeCompressType {
 	NONE = 0,
@@ -32,6 +40,275 @@ enum class SerializeCompressType {
 };
 
 static constexpr SerializeCompressType SAVE_TYPE = SerializeCompressType::ZSTD;
+// ZSTD saves are written as independent frames of this size, so they can be compressed and
+// decompressed in parallel.  Concatenated frames are still a valid zstd stream.
+static constexpr size_t ZSTD_FRAME_SIZE = 2 * 1024 * 1024;
+// The frames are preceded by an index of their sizes, in a skippable frame that zstd itself ignores.
+// It lets loading start on the first frames while the rest are still being read.
+static constexpr u32 ZSTD_SKIPPABLE_MAGIC = 0x184D2A53;
+static constexpr u32 STATE_INDEX_MAGIC = 0x58444E49;  // INDX
+static constexpr u32 STATE_INDEX_VERSION = 1;
+
+static size_t ZstdFrameIndexSize(size_t sz) {
+	size_t frames = (sz + ZSTD_FRAME_SIZE - 1) / ZSTD_FRAME_SIZE;
+	// Skippable frame header, index header, and then compressed and uncompressed size per frame.
+	return 8 + 12 + frames * 8;
+}
+
+static size_t ZstdChunkedBound(size_t sz) {
+	size_t bound = ZstdFrameIndexSize(sz);
+	for (size_t pos = 0; pos < sz; pos += ZSTD_FRAME_SIZE)
+		bound += ZSTD_compressBound(std::min(ZSTD_FRAME_SIZE, sz - pos));
+	return bound;
+}
+
+// Returns the compressed size, or 0 on failure.
+static size_t ZstdChunkedCompress(u8 *dest, const u8 *src, size_t sz) {
+	int frames = (int)((sz + ZSTD_FRAME_SIZE - 1) / ZSTD_FRAME_SIZE);
+	const size_t indexSize = ZstdFrameIndexSize(sz);
+	std::vector<size_t> destOffsets(frames + 1);
+	destOffsets[0] = indexSize;
+	for (int i = 0; i < frames; ++i)
+		destOffsets[i + 1] = destOffsets[i] + ZSTD_compressBound(std::min(ZSTD_FRAME_SIZE, sz - i * ZSTD_FRAME_SIZE));
+	std::vector<size_t> written(frames);
+
+	ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+		auto ctx = ZSTD_createCCtx();
+		for (int i = l; i < h; ++i) {
+			size_t srcSize = std::min(ZSTD_FRAME_SIZE, sz - i * ZSTD_FRAME_SIZE);
+			if (!ctx) {
+				written[i] = 0;
+				continue;
+			}
+			// TODO: If free disk space is low, we could max this out to 22?
+			ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+			ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 1);
+			ZSTD_CCtx_setPledgedSrcSize(ctx, srcSize);
+			size_t result = ZSTD_compress2(ctx, dest + destOffsets[i], destOffsets[i + 1] - destOffsets[i], src + i * ZSTD_FRAME_SIZE, srcSize);
+			written[i] = ZSTD_isError(result) ? 0 : result;
+		}
+		ZSTD_freeCCtx(ctx);
+	}, 0, frames, 1);
+
+	// Now pack the frames together after the index.
+	u32 *index = (u32 *)dest;
+	index[0] = ZSTD_SKIPPABLE_MAGIC;
+	index[1] = (u32)(indexSize - 8);
+	index[2] = STATE_INDEX_MAGIC;
+	index[3] = STATE_INDEX_VERSION;
+	index[4] = (u32)frames;
+	size_t pos = indexSize;
+	for (int i = 0; i < frames; ++i) {
+		if (written[i] == 0)
+			return 0;
+		memmove(dest + pos, dest + destOffsets[i], written[i]);
+		pos += written[i];
+		index[5 + i * 2] = (u32)written[i];
+		index[6 + i * 2] = (u32)std::min(ZSTD_FRAME_SIZE, sz - i * ZSTD_FRAME_SIZE);
+	}
+	return pos;
+}
+
+// Handles any zstd stream, but decompresses in parallel when it's made of frames with known sizes.
+static bool ZstdChunkedDecompress(u8 *dest, size_t destSize, const u8 *src, size_t sz) {
+	struct Frame {
+		size_t srcOffset;
+		size_t srcSize;
+		size_t destOffset;
+		size_t destSize;
+	};
+	std::vector<Frame> frames;
+	size_t destPos = 0;
+	for (size_t pos = 0; pos < sz; ) {
+		size_t frameSize = ZSTD_findFrameCompressedSize(src + pos, sz - pos);
+		unsigned long long contentSize = ZSTD_getFrameContentSize(src + pos, sz - pos);
+		if (ZSTD_isError(frameSize) || contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR || destPos + contentSize > destSize) {
+			frames.clear();
+			break;
+		}
+		frames.push_back(Frame{ pos, frameSize, destPos, (size_t)contentSize });
+		pos += frameSize;
+		destPos += (size_t)contentSize;
+	}
+
+	if (frames.size() <= 1 || destPos != destSize) {
+		size_t status = ZSTD_decompress(dest, destSize, src, sz);
+		return !ZSTD_isError(status) && status == destSize;
+	}
+
+	std::atomic<bool> success(true);
+	ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+		auto ctx = ZSTD_createDCtx();
+		for (int i = l; i < h; ++i) {
+			const Frame &frame = frames[i];
+			size_t status = ctx ? ZSTD_decompressDCtx(ctx, dest + frame.destOffset, frame.destSize, src + frame.srcOffset, frame.srcSize) : 0;
+			if (!ctx || ZSTD_isError(status) || status != frame.destSize)
+				success = false;
+		}
+		ZSTD_freeDCtx(ctx);
+	}, 0, (int)frames.size(), 1);
+	return success;
+}
+
+struct StateFrame {
+	size_t srcOffset;
+	size_t srcSize;
+	size_t destOffset;
+	size_t destSize;
+};
+
+// Reads an indexed ZSTD save state on an I/O task, decompressing each frame on the thread pool
+// as soon as it's read.  PointerWrap waits on it only for the bytes it actually needs.
+class StateStreamLoader : public PointerWrapSource {
+public:
+	StateStreamLoader(std::FILE *file, std::vector<StateFrame> &&frames, u8 *dest, size_t destSize)
+		: file_(file), frames_(std::move(frames)), dest_(dest), destSize_(destSize) {
+		done_.resize(frames_.size());
+		const StateFrame &last = frames_.back();
+		src_.resize(last.srcOffset + last.srcSize);
+	}
+	~StateStreamLoader() {
+		fclose(file_);
+	}
+
+	void Start();
+	bool WaitFor(size_t offset) override;
+	bool Finish();
+
+	void ReadFrames();
+	void DecompressFrame(int i);
+
+private:
+	void FrameDone(int i, bool success);
+
+	std::FILE *file_;
+	std::vector<StateFrame> frames_;
+	std::vector<u8> src_;
+	u8 *dest_;
+	size_t destSize_;
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::vector<bool> done_;
+	size_t nextFrame_ = 0;
+	size_t readyBytes_ = 0;
+	int pending_ = 0;
+	bool failed_ = false;
+};
+
+class StateStreamTask : public Task {
+public:
+	// Use a frame of -1 to read the file.
+	StateStreamTask(StateStreamLoader *loader, int frame) : loader_(loader), frame_(frame) {}
+
+	TaskType Type() const override { return frame_ < 0 ? TaskType::IO_BLOCKING : TaskType::CPU_COMPUTE; }
+	TaskPriority Priority() const override { return TaskPriority::HIGH; }
+
+	void Run() override {
+		if (frame_ < 0)
+			loader_->ReadFrames();
+		else
+			loader_->DecompressFrame(frame_);
+	}
+
+private:
+	StateStreamLoader *loader_;
+	int frame_;
+};
+
+void StateStreamLoader::Start() {
+	pending_ = 1;
+	g_threadManager.EnqueueTask(new StateStreamTask(this, -1));
+}
+
+void StateStreamLoader::ReadFrames() {
+	for (size_t i = 0; i < frames_.size(); ++i) {
+		const StateFrame &frame = frames_[i];
+		if (fread(&src_[frame.srcOffset], 1, frame.srcSize, file_) != frame.srcSize) {
+			ERROR_LOG(SAVESTATE, "ChunkReader: Error reading file");
+			std::lock_guard<std::mutex> guard(lock_);
+			failed_ = true;
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			if (failed_)
+				break;
+			pending_++;
+		}
+		g_threadManager.EnqueueTask(new StateStreamTask(this, (int)i));
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
+	pending_--;
+	cond_.notify_all();
+}
+
+void StateStreamLoader::DecompressFrame(int i) {
+	const StateFrame &frame = frames_[i];
+	size_t status = ZSTD_decompress(dest_ + frame.destOffset, frame.destSize, &src_[frame.srcOffset], frame.srcSize);
+	FrameDone(i, !ZSTD_isError(status) && status == frame.destSize);
+}
+
+void StateStreamLoader::FrameDone(int i, bool success) {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!success) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Failed to decompress file");
+		failed_ = true;
+	}
+	done_[i] = true;
+	while (nextFrame_ < frames_.size() && done_[nextFrame_]) {
+		readyBytes_ = frames_[nextFrame_].destOffset + frames_[nextFrame_].destSize;
+		nextFrame_++;
+	}
+	pending_--;
+	cond_.notify_all();
+}
+
+bool StateStreamLoader::WaitFor(size_t offset) {
+	if (offset > destSize_)
+		return false;
+	std::unique_lock<std::mutex> guard(lock_);
+	while (readyBytes_ < offset && !failed_)
+		cond_.wait(guard);
+	return readyBytes_ >= offset;
+}
+
+bool StateStreamLoader::Finish() {
+	std::unique_lock<std::mutex> guard(lock_);
+	while (pending_ != 0)
+		cond_.wait(guard);
+	return !failed_ && readyBytes_ == destSize_;
+}
+
+// Reads the index written by ZstdChunkedCompress, leaving the file at the first frame.
+static bool ReadStateFrameIndex(File::IOFile &pFile, size_t dataSize, size_t uncompressedSize, std::vector<StateFrame> *frames) {
+	u32 header[5];
+	if (dataSize < sizeof(header) || !pFile.ReadArray(header, 5))
+		return false;
+	if (header[0] != ZSTD_SKIPPABLE_MAGIC || header[2] != STATE_INDEX_MAGIC || header[3] != STATE_INDEX_VERSION)
+		return false;
+	// Bound the count by the data first, so a corrupt index can't overflow or allocate a huge table.
+	u32 count = header[4];
+	if (count == 0 || count > (dataSize - sizeof(header)) / 8)
+		return false;
+	if (header[1] != 12 + (size_t)count * 8)
+		return false;
+
+	std::vector<u32> sizes(count * 2);
+	if (!pFile.ReadArray(&sizes[0], sizes.size()))
+		return false;
+
+	size_t srcPos = 0;
+	size_t destPos = 0;
+	for (u32 i = 0; i < count; ++i) {
+		frames->push_back(StateFrame{ srcPos, sizes[i * 2], destPos, sizes[i * 2 + 1] });
+		srcPos += sizes[i * 2];
+		destPos += sizes[i * 2 + 1];
+	}
+	return srcPos == dataSize - header[1] - 8 && destPos == uncompressedSize;
+}
 
 void PointerWrap::RewindForWrite(u8 *writePtr) {
 	_assert_(mode == MODE_MEASURE);
@@ -49,7 +326,7 @@ bool PointerWrap::CheckAfterWrite() {
 		WARN_LOG(SAVESTATE, "CheckAfterWrite: Size mismatch! %d but expected %d", (int)offset, (int)measuredSize_);
 		return false;
 	}
-	if (!checkpoints_.empty() && curCheckpoint_ != checkpoints_.size()) {
+	if (!Checkpoints().empty() && curCheckpoint_ != Checkpoints().size()) {
 		WARN_LOG(SAVESTATE, "Checkpoint count mismatch!");
 		return false;
 	}
@@ -66,19 +343,20 @@ PointerWrapSection PointerWrap::Section(const char *title, int minVer, int ver)
 
 	// Compare the measure and write passes. Sanity check to catch bugs, doesn't do anything for output.
 	size_t offset = Offset();
+	std::vector<SerializeCheckpoint> &checkpoints = Checkpoints();
 	if (mode == MODE_MEASURE) {
-		checkpoints_.emplace_back(marker, offset);
+		checkpoints.emplace_back(marker, offset);
 	} else if (mode == MODE_WRITE) {
-		if (!checkpoints_.empty()) {
-			if (checkpoints_.size() <= curCheckpoint_) {
-				WARN_LOG(SAVESTATE, "Write: Not enough checkpoints from measure pass (%d). cur section: %s", (int)checkpoints_.size(), title);
+		if (!checkpoints.empty()) {
+			if (checkpoints.size() <= curCheckpoint_) {
+				WARN_LOG(SAVESTATE, "Write: Not enough checkpoints from measure pass (%d). cur section: %s", (int)checkpoints.size(), title);
 				SetError(ERROR_FAILURE);
 				return PointerWrapSection(*this, -1, title);
 			}
-			if (!checkpoints_[curCheckpoint_].Matches(marker, offset)) {
-				WARN_LOG(SAVESTATE, "Checkpoint mismatch during write! Section %s but expected %s, offset %d but expected %d", title, marker, (int)offset, (int)checkpoints_[curCheckpoint_].offset);
+			if (!checkpoints[curCheckpoint_].Matches(marker, offset)) {
+				WARN_LOG(SAVESTATE, "Checkpoint mismatch during write! Section %s but expected %s, offset %d but expected %d", title, marker, (int)offset, (int)checkpoints[curCheckpoint_].offset);
 				if (curCheckpoint_ > 1) {
-					WARN_LOG(SAVESTATE, "Previous checkpoint: %s (%d)", checkpoints_[curCheckpoint_ - 1].title, (int)checkpoints_[curCheckpoint_ - 1].offset);
+					WARN_LOG(SAVESTATE, "Previous checkpoint: %s (%d)", checkpoints[curCheckpoint_ - 1].title, (int)checkpoints[curCheckpoint_ - 1].offset);
 				}
 				SetError(ERROR_FAILURE);
 				return PointerWrapSection(*this, -1, title);
@@ -125,9 +403,17 @@ void PointerWrap::SetError(Error error_) {
 	}
 }
 
+bool PointerWrap::WaitForSource(size_t size) {
+	if (source_->WaitFor(Offset() + size))
+		return true;
+	WARN_LOG(SAVESTATE, "Savestate failure: data not available at %d", (int)Offset());
+	SetError(ERROR_FAILURE);
+	return false;
+}
+
 bool PointerWrap::ExpectVoid(void *data, int size) {
 	switch (mode) {
-	case MODE_READ:	if (memcmp(data, *ptr, size) != 0) return false; break;
+	case MODE_READ:	if (!WaitForData(size) || memcmp(data, *ptr, size) != 0) return false; break;
 	case MODE_WRITE: memcpy(*ptr, data, size); break;
 	case MODE_MEASURE: break;  // MODE_MEASURE - don't need to do anything
 	case MODE_VERIFY:
@@ -142,7 +428,7 @@ bool PointerWrap::ExpectVoid(void *data, int size) {
 
 void PointerWrap::DoVoid(void *data, int size) {
 	switch (mode) {
-	case MODE_READ:	memcpy(data, *ptr, size); break;
+	case MODE_READ:	if (WaitForData(size)) memcpy(data, *ptr, size); break;
 	case MODE_WRITE: memcpy(*ptr, data, size); break;
 	case MODE_MEASURE: break;  // MODE_MEASURE - don't need to do anything
 	case MODE_VERIFY:
@@ -168,7 +454,7 @@ void Do(PointerWrap &p, std::string &x) {
 	}
 
 	switch (p.mode) {
-	case PointerWrap::MODE_READ: x = (char*)*p.ptr; break;
+	case PointerWrap::MODE_READ: if (p.WaitForData(stringLen)) x = (char*)*p.ptr; break;
 	case PointerWrap::MODE_WRITE: memcpy(*p.ptr, x.c_str(), stringLen); break;
 	case PointerWrap::MODE_MEASURE: break;
 	case PointerWrap::MODE_NOOP: break;
@@ -196,7 +482,13 @@ void Do(PointerWrap &p, std::wstring &x) {
 	};
 
 	switch (p.mode) {
-	case PointerWrap::MODE_READ: x = read(); break;
+	case PointerWrap::MODE_READ:
+		if (p.WaitForData(stringLen)) {
+			// Into the existing string, to reuse its buffer.
+			x.resize((stringLen / sizeof(wchar_t)) - 1);
+			memcpy(&x[0], *p.ptr, stringLen - sizeof(wchar_t));
+		}
+		break;
 	case PointerWrap::MODE_WRITE: memcpy(*p.ptr, x.c_str(), stringLen); break;
 	case PointerWrap::MODE_MEASURE: break;
 	case PointerWrap::MODE_NOOP: break;
@@ -224,7 +516,13 @@ void Do(PointerWrap &p, std::u16string &x) {
 	};
 
 	switch (p.mode) {
-	case PointerWrap::MODE_READ: x = read(); break;
+	case PointerWrap::MODE_READ:
+		if (p.WaitForData(stringLen)) {
+			// Into the existing string, to reuse its buffer.
+			x.resize((stringLen / sizeof(char16_t)) - 1);
+			memcpy(&x[0], *p.ptr, stringLen - sizeof(char16_t));
+		}
+		break;
 	case PointerWrap::MODE_WRITE: memcpy(*p.ptr, x.c_str(), stringLen); break;
 	case PointerWrap::MODE_MEASURE: break;
 	case PointerWrap::MODE_NOOP: break;
@@ -373,11 +671,7 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const Path &filename, std::st
 			auto status = snappy_uncompress((const char *)buffer, sz, (char *)uncomp_buffer, &uncomp_size);
 			success = status == SNAPPY_OK;
 		} else if (SerializeCompressType(header.Compress) == SerializeCompressType::ZSTD) {
-			size_t status = ZSTD_decompress((char *)uncomp_buffer, uncomp_size, (const char *)buffer, sz);
-			success = !ZSTD_isError(status);
-			if (success) {
-				uncomp_size = status;
-			}
+			success = ZstdChunkedDecompress(uncomp_buffer, uncomp_size, buffer, sz);
 		} else {
 			ERROR_LOG(SAVESTATE, "ChunkReader: Unexpected compression type %d", header.Compress);
 		}
@@ -409,6 +703,43 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const Path &filename, std::st
 	return ERROR_NONE;
 }
 
+CChunkFileReader::Error CChunkFileReader::StartLoadFile(const Path &filename, std::string *gitVersion, u8 *&_buffer, size_t &sz, PointerWrapSource **source, std::string *failureReason) {
+	*source = nullptr;
+	if (File::Exists(filename)) {
+		File::IOFile pFile(filename, "rb");
+		SChunkHeader header;
+		std::vector<StateFrame> frames;
+		if (LoadFileHeader(pFile, header, nullptr) == ERROR_NONE && SerializeCompressType(header.Compress) == SerializeCompressType::ZSTD) {
+			if (ReadStateFrameIndex(pFile, header.ExpectedSize, header.UncompressedSize, &frames)) {
+				sz = header.UncompressedSize;
+				_buffer = new u8[sz];
+				if (header.GitVersion[31]) {
+					*gitVersion = std::string(header.GitVersion, 32);
+				} else {
+					*gitVersion = header.GitVersion;
+				}
+
+				StateStreamLoader *loader = new StateStreamLoader(pFile.ReleaseHandle(), std::move(frames), _buffer, sz);
+				loader->Start();
+				*source = loader;
+				return ERROR_NONE;
+			}
+		}
+	}
+
+	// No index (or an older file), so just load it all up front.
+	return LoadFile(filename, gitVersion, _buffer, sz, failureReason);
+}
+
+CChunkFileReader::Error CChunkFileReader::FinishLoadFile(PointerWrapSource *source) {
+	if (!source)
+		return ERROR_NONE;
+	StateStreamLoader *loader = (StateStreamLoader *)source;
+	bool success = loader->Finish();
+	delete loader;
+	return success ? ERROR_NONE : ERROR_BAD_FILE;
+}
+
 // Takes ownership of buffer.
 CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const std::string &title, const char *gitVersion, u8 *buffer, size_t sz) {
 	INFO_LOG(SAVESTATE, "ChunkReader: Writing %s", filename.c_str());
@@ -421,6 +752,7 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const s
 	}
 
 	// Make sure we can allocate a buffer to compress before compressing.
+	double startTime = time_now_d();
 	size_t write_len;
 	SerializeCompressType usedType = SAVE_TYPE;
 	switch (usedType) {
@@ -431,7 +763,7 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const s
 		write_len = snappy_max_compressed_length(sz);
 		break;
 	case SerializeCompressType::ZSTD:
-		write_len = ZSTD_compressBound(sz);
+		write_len = ZstdChunkedBound(sz);
 		break;
 	}
 	u8 *compressed_buffer = write_len == 0 ? nullptr : (u8 *)malloc(write_len);
@@ -452,20 +784,8 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const s
 			success = snappy_compress((const char *)buffer, sz, (char *)compressed_buffer, &write_len) == SNAPPY_OK;
 			break;
 		case SerializeCompressType::ZSTD:
-			{
-				auto ctx = ZSTD_createCCtx();
-				if (!ctx) {
-					success = false;
-				} else {
-					// TODO: If free disk space is low, we could max this out to 22?
-					ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
-					ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 1);
-					ZSTD_CCtx_setPledgedSrcSize(ctx, sz);
-					write_len = ZSTD_compress2(ctx, compressed_buffer, write_len, buffer, sz);
-					success = !ZSTD_isError(write_len);
-				}
-				ZSTD_freeCCtx(ctx);
-			}
+			write_len = ZstdChunkedCompress(compressed_buffer, buffer, sz);
+			success = write_len != 0;
 			break;
 		}
 
@@ -511,7 +831,7 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const s
 		free(write_buffer);
 		return ERROR_BAD_FILE;
 	} else if (sz != write_len) {
-		INFO_LOG(SAVESTATE, "Savestate: Compressed %i bytes into %i", (int)sz, (int)write_len);
+		INFO_LOG(SAVESTATE, "Savestate: Compressed %i bytes into %i in %0.2f ms", (int)sz, (int)write_len, (time_now_d() - startTime) * 1000.0);
 	}
 	free(write_buffer);
 
@@ -93,6 +93,20 @@ struct SerializeCheckpoint {
 	}
 };
 
+// Storage that can be kept around between saves (like for rewind), so that measuring and
+// writing a state doesn't need to allocate each time.
+struct PointerWrapArena {
+	std::vector<SerializeCheckpoint> checkpoints;
+};
+
+// Data that's still being loaded while a PointerWrap reads from it.
+class PointerWrapSource {
+public:
+	virtual ~PointerWrapSource() {}
+	// Blocks until the first offset bytes are ready.  Returns false if they never will be.
+	virtual bool WaitFor(size_t offset) = 0;
+};
+
 // Wrapper class
 class PointerWrap
 {
@@ -115,9 +129,10 @@ class PointerWrap
 	Mode mode;
 	Error error = ERROR_NONE;
 
-	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), ptrStart_(*ptr), mode(mode_) {
+	PointerWrap(u8 **ptr_, Mode mode_, PointerWrapArena *arena = nullptr) : ptr(ptr_), ptrStart_(*ptr), mode(mode_), arena_(arena) {
 		if (mode == MODE_MEASURE) {
-			checkpoints_.reserve(750);
+			Checkpoints().clear();
+			Checkpoints().reserve(750);
 		}
 	}
 
@@ -133,6 +148,7 @@ class PointerWrap
 	}
 
 	void SetMode(Mode mode_) { mode = mode_; }
+	void SetSource(PointerWrapSource *source) { source_ = source; }
 	Mode GetMode() const { return mode; }
 	u8 **GetPPtr() { return ptr; }
 	void SetError(Error error_);
@@ -147,6 +163,13 @@ class PointerWrap
 
 	void DoMarker(const char *prevName, u32 arbitraryNumber = 0x42);
 
+	// When reading, makes sure the next size bytes are ready before accessing them directly.
+	bool WaitForData(size_t size) {
+		if (!source_ || mode != MODE_READ)
+			return true;
+		return WaitForSource(size);
+	}
+
 	void SkipBytes(size_t bytes) {
 		// Should work in all modes.
 		*ptr += bytes;
@@ -155,9 +178,17 @@ class PointerWrap
 	size_t Offset() const { return *ptr - ptrStart_; }
 
 private:
+	bool WaitForSource(size_t size);
+	// Not a pointer to ownCheckpoints_, so copies don't point into the original.
+	std::vector<SerializeCheckpoint> &Checkpoints() {
+		return arena_ ? arena_->checkpoints : ownCheckpoints_;
+	}
+
 	const char *firstBadSectionTitle_ = nullptr;
 	u8 *ptrStart_;
-	std::vector<SerializeCheckpoint> checkpoints_;
+	PointerWrapSource *source_ = nullptr;
+	PointerWrapArena *arena_;
+	std::vector<SerializeCheckpoint> ownCheckpoints_;
 	size_t curCheckpoint_ = 0;
 	size_t measuredSize_ = 0;
 };
@@ -174,9 +205,10 @@ class CChunkFileReader
 
 	// May fail badly if ptr doesn't point to valid data.
 	template<class T>
-	static Error LoadPtr(u8 *ptr, T &_class, std::string *errorString)
+	static Error LoadPtr(u8 *ptr, T &_class, std::string *errorString, PointerWrapSource *source = nullptr)
 	{
 		PointerWrap p(&ptr, PointerWrap::MODE_READ);
+		p.SetSource(source);
 		_class.DoState(p);
 
 		if (p.error != p.ERROR_FAILURE) {
@@ -235,10 +267,10 @@ class CChunkFileReader
 	// Duplicate of the above but takes and modifies a vector. Less invasive
 	// than modifying the rewind manager to keep things in something else than vectors.
 	template<class T>
-	static Error MeasureAndSavePtr(T &_class, std::vector<u8> *saved)
+	static Error MeasureAndSavePtr(T &_class, std::vector<u8> *saved, PointerWrapArena *arena = nullptr)
 	{
 		u8 *ptr = nullptr;
-		PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+		PointerWrap p(&ptr, PointerWrap::MODE_MEASURE, arena);
 		_class.DoState(p);
 		_assert_(p.error == PointerWrap::ERROR_NONE);
 
@@ -264,10 +296,14 @@ class CChunkFileReader
 
 		u8 *ptr = nullptr;
 		size_t sz;
-		Error error = LoadFile(filename, gitVersion, ptr, sz, failureReason);
+		PointerWrapSource *source = nullptr;
+		Error error = StartLoadFile(filename, gitVersion, ptr, sz, &source, failureReason);
 		if (error == ERROR_NONE) {
 			failureReason->clear();
-			error = LoadPtr(ptr, _class, failureReason);
+			error = LoadPtr(ptr, _class, failureReason, source);
+			Error loadError = FinishLoadFile(source);
+			if (error == ERROR_NONE)
+				error = loadError;
 			delete [] ptr;
 			INFO_LOG(SAVESTATE, "ChunkReader: Done loading '%s'", filename.c_str());
 		} else {
@@ -333,6 +369,10 @@ class CChunkFileReader
 	};
 
 	static Error LoadFile(const Path &filename, std::string *gitVersion, u8 *&buffer, size_t &sz, std::string *failureReason);
+	// Like LoadFile, but when the file has a frame index, returns while the data is still being read and decompressed.
+	// In that case source is set, and must be used to read buffer.  Always call FinishLoadFile before freeing buffer.
+	static Error StartLoadFile(const Path &filename, std::string *gitVersion, u8 *&buffer, size_t &sz, PointerWrapSource **source, std::string *failureReason);
+	static Error FinishLoadFile(PointerWrapSource *source);
 	static Error SaveFile(const Path &filename, const std::string &title, const char *gitVersion, u8 *buffer, size_t sz);
 	static Error LoadFileHeader(File::IOFile &pFile, SChunkHeader &header, std::string *title);
 };
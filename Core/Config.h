@@ -122,6 +122,7 @@ struct Config {
 	int iLockedCPUSpeed;
 	bool bAutoSaveSymbolMap;
 	bool bCacheFullIsoInRam;
+	bool bBootPrefetch;
 	int iRemoteISOPort;
 	std::string sLastRemoteISOServer;
 	int iLastRemoteISOPort;
@@ -133,6 +134,7 @@ struct Config {
 	bool bRemoteDebuggerOnStartup;
 	bool bRemoteTab;
 	bool bMemStickInserted;
+	bool bMemStickHandleCache;
 	int iMemStickSizeGB;
 	bool bLoadPlugins;
 
@@ -163,6 +165,7 @@ struct Config {
 
 	bool bSoftwareRendering;
 	bool bSoftwareRenderingJit;
+	int iSoftwareRenderingThreads;  // 0 = auto
 	bool bHardwareTransform; // only used in the GLES backend
 	bool bSoftwareSkinning;
 	bool bVendorBugChecksEnabled;
@@ -230,6 +233,7 @@ struct Config {
 	int iMaxRecent;
 	int iCurrentStateSlot;
 	int iRewindSnapshotInterval;
+	int iRunAheadFrames;
 	bool bUISound;
 	bool bEnableStateUndo;
 	std::string sStateLoadUndoGame;
@@ -276,6 +280,7 @@ struct Config {
 	int iAltSpeedVolume;
 	int iAchievementSoundVolume;
 	bool bExtraAudioBuffering;  // For bluetooth
+	bool bHighQualityResampler;
 	std::string sAudioDevice;
 	bool bAutoAudioDevice;
 	bool bUseNewAtrac;
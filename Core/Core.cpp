@@ -260,6 +260,9 @@ static inline bool Core_WaitStepping() {
 void Core_ProcessStepping() {
 	Core_StateProcessed();
 
+	// Don't pause on, or save, a frame that was only run ahead.
+	PSP_RunAheadRollback();
+
 	// Check if there's any pending save state actions.
 	SaveState::Process();
 	if (coreState != CORE_STEPPING) {
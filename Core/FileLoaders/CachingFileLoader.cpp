@@ -99,6 +99,33 @@ size_t CachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flag
 	return readSize;
 }
 
+void CachingFileLoader::Prefetch(s64 absolutePos, size_t bytes) {
+	Prepare();
+	if (bytes == 0 || absolutePos >= filesize_) {
+		return;
+	}
+
+	const s64 cacheStartPos = absolutePos >> BLOCK_SHIFT;
+	const s64 cacheEndPos = (std::min(absolutePos + (s64)bytes, filesize_) - 1) >> BLOCK_SHIFT;
+	for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
+		{
+			std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
+			if (blocks_.find(i) != blocks_.end()) {
+				continue;
+			}
+		}
+
+		// Like reading ahead, this won't throw out other blocks to make room.
+		SaveIntoCache(i << BLOCK_SHIFT, (size_t)(cacheEndPos - i + 1) << BLOCK_SHIFT, Flags::NONE, true);
+
+		std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
+		if (blocks_.find(i) == blocks_.end()) {
+			// Out of space.
+			break;
+		}
+	}
+}
+
 void CachingFileLoader::InitCache() {
 	cacheSize_ = 0;
 	oldestGeneration_ = 0;
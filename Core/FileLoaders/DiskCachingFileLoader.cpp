@@ -32,6 +32,7 @@
 #include "Common/CommonWindows.h"
 #include "Core/FileLoaders/DiskCachingFileLoader.h"
 #include "Core/System.h"
+#include "ext/xxhash.h"
 
 #if PPSSPP_PLATFORM(UWP)
 #include <fileapifromapp.h>
@@ -46,11 +47,18 @@ static const char * const CACHEFILE_MAGIC = "ppssppDC";
 static const s64 SAFETY_FREE_DISK_SPACE = 768 * 1024 * 1024; // 768 MB
 // Aim to allow this many files cached at once.
 static const u32 CACHE_SPACE_FLEX = 4;
+// All cache files together, the least recently used are deleted to stay under it.
+static const u64 CACHE_STORE_MAX_BYTES = 2048ULL * 1024 * 1024; // 2 GB
+// Compact when at least this many blocks are cached, and one in this many reads would seek.
+static const size_t COMPACT_MIN_BLOCKS = 64;
+static const size_t COMPACT_SEEK_RATIO = 8;
+// Compacting copies every block during shutdown, so skip it past this much data.
+static const u64 COMPACT_MAX_BYTES = 256 * 1024 * 1024; // 256 MB
 
 Path DiskCachingFileLoaderCache::cacheDir_;
 
 std::map<Path, DiskCachingFileLoaderCache *> DiskCachingFileLoader::caches_;
-std::mutex DiskCachingFileLoader::cachesMutex_;
+std::recursive_mutex DiskCachingFileLoader::cachesMutex_;
 
 // Takes ownership of backend.
 DiskCachingFileLoader::DiskCachingFileLoader(FileLoader *backend)
@@ -123,7 +131,7 @@ size_t DiskCachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data,
 }
 
 std::vector<Path> DiskCachingFileLoader::GetCachedPathsInUse() {
-	std::lock_guard<std::mutex> guard(cachesMutex_);
+	std::lock_guard<std::recursive_mutex> guard(cachesMutex_);
 
 	// This is on the file loader so that it can manage the caches_.
 	std::vector<Path> files;
@@ -137,7 +145,7 @@ std::vector<Path> DiskCachingFileLoader::GetCachedPathsInUse() {
 }
 
 void DiskCachingFileLoader::InitCache() {
-	std::lock_guard<std::mutex> guard(cachesMutex_);
+	std::lock_guard<std::recursive_mutex> guard(cachesMutex_);
 
 	Path path = ProxiedFileLoader::GetPath();
 	auto &entry = caches_[path];
@@ -150,7 +158,7 @@ void DiskCachingFileLoader::InitCache() {
 }
 
 void DiskCachingFileLoader::ShutdownCache() {
-	std::lock_guard<std::mutex> guard(cachesMutex_);
+	std::lock_guard<std::recursive_mutex> guard(cachesMutex_);
 
 	if (cache_->Release()) {
 		// If it ran out of counts, delete it.
@@ -201,7 +209,9 @@ void DiskCachingFileLoaderCache::InitCache(const Path &filename) {
 }
 
 void DiskCachingFileLoaderCache::ShutdownCache() {
-	if (f_) {
+	if (f_ && CompactCacheFile()) {
+		// Already written out with the new layout, and unlocked.
+	} else if (f_) {
 		bool failed = false;
 		if (fseek(f_, sizeof(FileHeader), SEEK_SET) != 0) {
 			failed = true;
@@ -221,6 +231,9 @@ void DiskCachingFileLoaderCache::ShutdownCache() {
 
 	index_.clear();
 	blockIndexLookup_.clear();
+	verified_.clear();
+	readOrder_.clear();
+	inReadOrder_.clear();
 	cacheSize_ = 0;
 }
 
@@ -246,9 +259,17 @@ size_t DiskCachingFileLoaderCache::ReadFromCache(s64 pos, size_t bytes, void *da
 		if (info.hits < std::numeric_limits<u16>::max()) {
 			++info.hits;
 		}
+		RecordReadOrder((u32)i);
 
 		size_t toRead = std::min(bytes - readSize, (size_t)blockSize_ - offset);
-		if (!ReadBlockData(p + readSize, info, offset, toRead)) {
+		if (!verified_[i]) {
+			// First use since loading, so read and check the whole block.
+			blockBuffer_.resize(blockSize_);
+			if (!VerifyBlockData((u32)i, &blockBuffer_[0])) {
+				return readSize;
+			}
+			memcpy(p + readSize, &blockBuffer_[0] + offset, toRead);
+		} else if (!ReadBlockData(p + readSize, info, offset, toRead)) {
 			return readSize;
 		}
 		readSize += toRead;
@@ -300,6 +321,8 @@ size_t DiskCachingFileLoaderCache::SaveIntoCache(FileLoader *backend, s64 pos, s
 			info.block = AllocateBlock((u32)cacheStartPos);
 			WriteBlockData(info, buf);
 			WriteIndexData((u32)cacheStartPos, info);
+			verified_[cacheStartPos] = true;
+			RecordReadOrder((u32)cacheStartPos);
 		}
 
 		size_t toRead = std::min(bytes - readSize, (size_t)blockSize_ - offset);
@@ -319,6 +342,8 @@ size_t DiskCachingFileLoaderCache::SaveIntoCache(FileLoader *backend, s64 pos, s
 				WriteBlockData(info, wholeRead + (i * blockSize_));
 				// TODO: Doing each index together would probably be better.
 				WriteIndexData((u32)cacheStartPos + (u32)i, info);
+				verified_[cacheStartPos + i] = true;
+				RecordReadOrder((u32)cacheStartPos + (u32)i);
 			}
 
 			size_t toRead = std::min(bytes - readSize, (size_t)blockSize_ - offset);
@@ -453,7 +478,7 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 	if (size == 0) {
 		return true;
 	}
-	s64 blockOffset = GetBlockOffset(info.block);
+	s64 blockOffset = GetBlockOffset(info.block) + (s64)offset;
 
 	// Before we read, make sure the buffers are flushed.
 	// We might be trying to read an area we've recently written.
@@ -463,13 +488,13 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 #ifdef __ANDROID__
 	if (lseek64(fd_, blockOffset, SEEK_SET) != blockOffset) {
 		failed = true;
-	} else if (read(fd_, dest + offset, size) != (ssize_t)size) {
+	} else if (read(fd_, dest, size) != (ssize_t)size) {
 		failed = true;
 	}
 #else
 	if (fseeko(f_, blockOffset, SEEK_SET) != 0) {
 		failed = true;
-	} else if (fread(dest + offset, size, 1, f_) != 1) {
+	} else if (fread(dest, size, 1, f_) != 1) {
 		failed = true;
 	}
 #endif
@@ -481,11 +506,28 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 	return !failed;
 }
 
+bool DiskCachingFileLoaderCache::VerifyBlockData(u32 indexPos, u8 *dest) {
+	BlockInfo &info = index_[indexPos];
+	if (!ReadBlockData(dest, info, 0, blockSize_)) {
+		return false;
+	}
+
+	if (XXH32(dest, blockSize_, 0) != info.checksum) {
+		// Damaged or partly written, it'll be read from the backend again.
+		WARN_LOG(LOADER, "Disk cache block %d failed checksum, dropping", (int)indexPos);
+		DropBlock(indexPos);
+		return false;
+	}
+	verified_[indexPos] = true;
+	return true;
+}
+
 void DiskCachingFileLoaderCache::WriteBlockData(BlockInfo &info, const u8 *src) {
 	if (!f_) {
 		return;
 	}
 	s64 blockOffset = GetBlockOffset(info.block);
+	info.checksum = XXH32(src, blockSize_, 0);
 
 	bool failed = false;
 #ifdef __ANDROID__
@@ -528,6 +570,119 @@ void DiskCachingFileLoaderCache::WriteIndexData(u32 indexPos, BlockInfo &info) {
 	}
 }
 
+void DiskCachingFileLoaderCache::DropBlock(u32 indexPos) {
+	BlockInfo &info = index_[indexPos];
+	if (info.block == INVALID_BLOCK) {
+		return;
+	}
+
+	blockIndexLookup_[info.block] = INVALID_INDEX;
+	info.block = INVALID_BLOCK;
+	info.generation = 0;
+	info.hits = 0;
+	info.checksum = 0;
+	--cacheSize_;
+	WriteIndexData(indexPos, info);
+}
+
+void DiskCachingFileLoaderCache::RecordReadOrder(u32 indexPos) {
+	if (!inReadOrder_[indexPos]) {
+		inReadOrder_[indexPos] = true;
+		readOrder_.push_back(indexPos);
+	}
+}
+
+bool DiskCachingFileLoaderCache::CompactCacheFile() {
+	// Blocks read this run first, in that order, then anything else still cached.
+	std::vector<u32> order;
+	order.reserve(cacheSize_);
+	for (u32 indexPos : readOrder_) {
+		if (index_[indexPos].block != INVALID_BLOCK) {
+			order.push_back(indexPos);
+		}
+	}
+	for (size_t i = 0; i < index_.size(); ++i) {
+		if (index_[i].block != INVALID_BLOCK && !inReadOrder_[i]) {
+			order.push_back((u32)i);
+		}
+	}
+
+	size_t seeks = 0;
+	for (size_t i = 1; i < order.size(); ++i) {
+		if (index_[order[i]].block != index_[order[i - 1]].block + 1) {
+			++seeks;
+		}
+	}
+	// Rewriting the whole file isn't worth it for a few seeks.
+	if (order.size() < COMPACT_MIN_BLOCKS || seeks * COMPACT_SEEK_RATIO < order.size()) {
+		return false;
+	}
+
+	const u64 dataBytes = (u64)order.size() * blockSize_;
+	if (dataBytes > COMPACT_MAX_BYTES) {
+		return false;
+	}
+	// Both copies exist until the rename, so leave the same room as when growing the cache.
+	const u64 neededBytes = sizeof(FileHeader) + (u64)indexCount_ * sizeof(BlockInfo) + dataBytes;
+	if (FreeDiskSpace() < neededBytes + SAFETY_FREE_DISK_SPACE) {
+		return false;
+	}
+
+	const Path path = MakeCacheFilePath(origPath_);
+	const Path tempPath = path.WithExtraExtension(".tmp");
+	FILE *out = File::OpenCFile(tempPath, "wb");
+	if (!out) {
+		return false;
+	}
+
+	FileHeader header;
+	memcpy(header.magic, CACHEFILE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.blockSize = blockSize_;
+	header.filesize = filesize_;
+	header.maxBlocks = maxBlocks_;
+	header.flags = flags_ & ~FLAG_LOCKED;
+
+	std::vector<BlockInfo> newIndex(indexCount_);
+	for (size_t i = 0; i < order.size(); ++i) {
+		newIndex[order[i]] = index_[order[i]];
+		newIndex[order[i]].block = (u32)i;
+	}
+
+	bool failed = false;
+	if (fwrite(&header, sizeof(header), 1, out) != 1) {
+		failed = true;
+	} else if (fwrite(&newIndex[0], sizeof(BlockInfo), indexCount_, out) != indexCount_) {
+		failed = true;
+	}
+	blockBuffer_.resize(blockSize_);
+	for (size_t i = 0; i < order.size() && !failed; ++i) {
+		if (!ReadBlockData(&blockBuffer_[0], index_[order[i]], 0, blockSize_)) {
+			failed = true;
+		} else if (fwrite(&blockBuffer_[0], blockSize_, 1, out) != 1) {
+			failed = true;
+		}
+	}
+	if (fclose(out) != 0) {
+		failed = true;
+	}
+	if (failed) {
+		ERROR_LOG(LOADER, "Unable to compact disk cache file for %s", origPath_.c_str());
+		File::Delete(tempPath);
+		return false;
+	}
+
+	// Rename can't replace an existing file everywhere.  If this fails, it's left locked and recreated next time.
+	CloseFileHandle();
+	if (!File::Delete(path) || !File::Rename(tempPath, path)) {
+		ERROR_LOG(LOADER, "Unable to replace disk cache file for %s", origPath_.c_str());
+		return false;
+	}
+
+	INFO_LOG(LOADER, "Compacted disk cache for %s, %d blocks with %d seeks", origPath_.c_str(), (int)order.size(), (int)seeks);
+	return true;
+}
+
 bool DiskCachingFileLoaderCache::LoadCacheFile(const Path &path) {
 	FILE *fp = File::OpenCFile(path, "rb+");
 	if (!fp) {
@@ -581,6 +736,9 @@ void DiskCachingFileLoaderCache::LoadCacheIndex() {
 	index_.resize(indexCount_);
 	blockIndexLookup_.resize(maxBlocks_);
 	memset(&blockIndexLookup_[0], INVALID_INDEX, maxBlocks_ * sizeof(blockIndexLookup_[0]));
+	verified_.assign(indexCount_, false);
+	readOrder_.clear();
+	inReadOrder_.assign(indexCount_, false);
 
 	if (fread(&index_[0], sizeof(BlockInfo), indexCount_, f_) != indexCount_) {
 		CloseFileHandle();
@@ -614,6 +772,15 @@ void DiskCachingFileLoaderCache::LoadCacheIndex() {
 
 void DiskCachingFileLoaderCache::CreateCacheFile(const Path &path) {
 	maxBlocks_ = DetermineMaxBlocks();
+
+	// Make room in the shared budget, dropping the least recently used images first.
+	const u64 wantBytes = (u64)std::max(maxBlocks_, (u32)MAX_BLOCKS_LOWER_BOUND) * DEFAULT_BLOCK_SIZE;
+	const u64 storeBytes = CountCachedBytes();
+	if (storeBytes + wantBytes > CACHE_STORE_MAX_BYTES) {
+		GarbageCollectCacheFiles(storeBytes + wantBytes - CACHE_STORE_MAX_BYTES);
+		maxBlocks_ = DetermineMaxBlocks();
+	}
+
 	if (maxBlocks_ < MAX_BLOCKS_LOWER_BOUND) {
 		GarbageCollectCacheFiles(MAX_BLOCKS_LOWER_BOUND * DEFAULT_BLOCK_SIZE);
 		maxBlocks_ = DetermineMaxBlocks();
@@ -626,6 +793,10 @@ void DiskCachingFileLoaderCache::CreateCacheFile(const Path &path) {
 	}
 	flags_ = 0;
 
+	// Images in use can't be dropped, so this might still go a bit over budget.
+	const u64 storeLeft = CACHE_STORE_MAX_BYTES - std::min(CountCachedBytes(), CACHE_STORE_MAX_BYTES);
+	maxBlocks_ = std::max(std::min(maxBlocks_, (u32)(storeLeft / DEFAULT_BLOCK_SIZE)), (u32)MAX_BLOCKS_LOWER_BOUND);
+
 	f_ = File::OpenCFile(path, "wb+");
 	if (!f_) {
 		ERROR_LOG(LOADER, "Could not create disk cache file");
@@ -656,6 +827,9 @@ void DiskCachingFileLoaderCache::CreateCacheFile(const Path &path) {
 	index_.resize(indexCount_);
 	blockIndexLookup_.resize(maxBlocks_);
 	memset(&blockIndexLookup_[0], INVALID_INDEX, maxBlocks_ * sizeof(blockIndexLookup_[0]));
+	verified_.assign(indexCount_, false);
+	readOrder_.clear();
+	inReadOrder_.assign(indexCount_, false);
 
 	if (fwrite(&index_[0], sizeof(BlockInfo), indexCount_, f_) != indexCount_) {
 		CloseFileHandle();
@@ -803,6 +977,24 @@ u32 DiskCachingFileLoaderCache::CountCachedFiles() {
 	return (u32)GetFilesInDir(dir, &files, "ppdc:");
 }
 
+u64 DiskCachingFileLoaderCache::CountCachedBytes() {
+	Path dir = cacheDir_;
+	if (dir.empty()) {
+		dir = GetSysDirectory(DIRECTORY_CACHE);
+	}
+
+	std::vector<File::FileInfo> files;
+	File::GetFilesInDir(dir, &files, "ppdc:");
+
+	u64 total = 0;
+	for (const File::FileInfo &file : files) {
+		if (!file.isDirectory) {
+			total += file.size;
+		}
+	}
+	return total;
+}
+
 void DiskCachingFileLoaderCache::GarbageCollectCacheFiles(u64 goalBytes) {
 	// We attempt to free up at least enough files from the cache to get goalBytes more space.
 	const std::vector<Path> usedPaths = DiskCachingFileLoader::GetCachedPathsInUse();
@@ -818,9 +1010,12 @@ void DiskCachingFileLoaderCache::GarbageCollectCacheFiles(u64 goalBytes) {
 
 	std::vector<File::FileInfo> files;
 	File::GetFilesInDir(dir, &files, "ppdc:");
+	// The index is written back on every shutdown, so the oldest modified was used least recently.
+	std::sort(files.begin(), files.end(), [](const File::FileInfo &a, const File::FileInfo &b) {
+		return a.mtime < b.mtime;
+	});
 
 	u64 remaining = goalBytes;
-	// TODO: Could order by LRU or etc.
 	for (File::FileInfo &file : files) {
 		if (file.isDirectory) {
 			continue;
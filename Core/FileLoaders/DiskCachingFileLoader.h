@@ -56,7 +56,8 @@ class DiskCachingFileLoader : public ProxiedFileLoader {
 	// We don't support concurrent disk cache access (we use memory cached indexes.)
 	// So we have to ensure there's only one of these per.
 	static std::map<Path, DiskCachingFileLoaderCache *> caches_;
-	static std::mutex cachesMutex_;
+	// Recursive since creating a cache may garbage collect others, which checks which are in use.
+	static std::recursive_mutex cachesMutex_;
 };
 
 class DiskCachingFileLoaderCache {
@@ -95,9 +96,13 @@ class DiskCachingFileLoaderCache {
 
 	struct BlockInfo;
 	bool ReadBlockData(u8 *dest, BlockInfo &info, size_t offset, size_t size);
+	bool VerifyBlockData(u32 indexPos, u8 *dest);
 	void WriteBlockData(BlockInfo &info, const u8 *src);
 	void WriteIndexData(u32 indexPos, BlockInfo &info);
+	void DropBlock(u32 indexPos);
+	void RecordReadOrder(u32 indexPos);
 	s64 GetBlockOffset(u32 block);
+	bool CompactCacheFile();
 
 	Path MakeCacheFilePath(const Path &filename);
 	std::string MakeCacheFilename(const Path &path);
@@ -111,6 +116,7 @@ class DiskCachingFileLoaderCache {
 	u64 FreeDiskSpace();
 	u32 DetermineMaxBlocks();
 	u32 CountCachedFiles();
+	u64 CountCachedBytes();
 	void GarbageCollectCacheFiles(u64 goalBytes);
 
 	// File format:
@@ -120,15 +126,16 @@ class DiskCachingFileLoaderCache {
 	// 64 filesize
 	// 32 maxBlocks
 	// 32 flags
-	// index[filesize / blockSize] <-- ~500 KB for 4GB
+	// index[filesize / blockSize] <-- ~750 KB for 4GB
 	//   32 (fileoffset - headersize) / blockSize -> -1=not present
 	//   16 generation?
 	//   16 hits?
-	// blocks[up to maxBlocks]
+	//   32 checksum (XXH32 of the block)
+	// blocks[up to maxBlocks], in the order they were read when last compacted
 	//   8 * blockSize
 
 	enum {
-		CACHE_VERSION = 3,
+		CACHE_VERSION = 4,
 		DEFAULT_BLOCK_SIZE = 65536,
 		MAX_BLOCKS_PER_READ = 16,
 		MAX_BLOCKS_LOWER_BOUND = 256, // 16 MB
@@ -166,13 +173,20 @@ class DiskCachingFileLoaderCache {
 		u32 block;
 		u16 generation;
 		u16 hits;
+		u32 checksum;
 
-		BlockInfo() : block(-1), generation(0), hits(0) {
+		BlockInfo() : block(-1), generation(0), hits(0), checksum(0) {
 		}
 	};
 
 	std::vector<BlockInfo> index_;
 	std::vector<u32> blockIndexLookup_;
+	// Blocks are checked against their checksum the first time they're used after loading.
+	std::vector<bool> verified_;
+	// Index positions in the order first read this run, which compaction lays the blocks out in.
+	std::vector<u32> readOrder_;
+	std::vector<bool> inReadOrder_;
+	std::vector<u8> blockBuffer_;
 
 	FILE *f_ = nullptr;
 	int fd_ = 0;
@@ -0,0 +1,185 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "Core/FileLoaders/IoUring.h"
+
+#ifdef PPSSPP_HAS_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Common/Log.h"
+#include "Common/TimeUtil.h"
+
+IoUringReader::~IoUringReader() {
+	if (sqes_)
+		munmap(sqes_, sqesSize_);
+	if (cqRing_ && cqRing_ != sqRing_)
+		munmap(cqRing_, cqRingSize_);
+	if (sqRing_)
+		munmap(sqRing_, sqRingSize_);
+	if (fd_ != -1)
+		close(fd_);
+	delete [] iovecs_;
+}
+
+bool IoUringReader::Init(unsigned entries) {
+	io_uring_params params{};
+	fd_ = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (fd_ < 0) {
+		INFO_LOG(FILESYS, "io_uring unavailable (%d), using pread", errno);
+		fd_ = -1;
+		return false;
+	}
+	entries_ = params.sq_entries;
+
+	sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMmap)
+		sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+	sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+	if (sqRing_ == MAP_FAILED) {
+		sqRing_ = nullptr;
+		return false;
+	}
+	if (singleMmap) {
+		cqRing_ = sqRing_;
+	} else {
+		cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+		if (cqRing_ == MAP_FAILED) {
+			cqRing_ = nullptr;
+			return false;
+		}
+	}
+	sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+	void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		return false;
+	sqes_ = (io_uring_sqe *)sqes;
+
+	u8 *sq = (u8 *)sqRing_;
+	sqHead_ = (unsigned *)(sq + params.sq_off.head);
+	sqTail_ = (unsigned *)(sq + params.sq_off.tail);
+	sqMask_ = (unsigned *)(sq + params.sq_off.ring_mask);
+	sqArray_ = (unsigned *)(sq + params.sq_off.array);
+	u8 *cq = (u8 *)cqRing_;
+	cqHead_ = (unsigned *)(cq + params.cq_off.head);
+	cqTail_ = (unsigned *)(cq + params.cq_off.tail);
+	cqMask_ = (unsigned *)(cq + params.cq_off.ring_mask);
+	cqes_ = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// READV rather than READ, which needs a newer kernel.
+	iovecs_ = new iovec[entries_];
+	return true;
+}
+
+int IoUringReader::Enter(unsigned toSubmit, unsigned minComplete) {
+	int result;
+	do {
+		result = (int)syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, minComplete != 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+	} while (result < 0 && errno == EINTR);
+	return result;
+}
+
+// Waits until target requests have completed.  Even if waiting fails, this can't give up:
+// anything in flight still owns its buffer and iovec, so keep polling the ring instead.
+void IoUringReader::Reap(FileLoader::ReadRequest *requests, unsigned &completed, unsigned target) {
+	bool warned = false;
+	while (completed < target) {
+		unsigned head = *cqHead_;
+		if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+			if (Enter(0, target - completed) < 0) {
+				if (!warned)
+					ERROR_LOG(FILESYS, "io_uring wait failed: %d", errno);
+				warned = true;
+				sleep_ms(1);
+			}
+			continue;
+		}
+
+		const io_uring_cqe &cqe = cqes_[head & *cqMask_];
+		requests[cqe.user_data].result = cqe.res < 0 ? 0 : (size_t)cqe.res;
+		__atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+		completed++;
+	}
+}
+
+bool IoUringReader::Read(int fd, FileLoader::ReadRequest *requests, size_t count) {
+	for (size_t first = 0; first < count; first += entries_) {
+		const unsigned batch = (unsigned)std::min(count - first, (size_t)entries_);
+
+		// We're the only producer, so no need for an acquire on our own tail.
+		unsigned tail = *sqTail_;
+		const unsigned mask = *sqMask_;
+		for (unsigned i = 0; i < batch; ++i) {
+			FileLoader::ReadRequest &request = requests[first + i];
+			const unsigned index = tail & mask;
+			iovecs_[i].iov_base = request.data;
+			iovecs_[i].iov_len = request.bytes;
+
+			io_uring_sqe &sqe = sqes_[index];
+			memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = IORING_OP_READV;
+			sqe.fd = fd;
+			sqe.addr = (u64)(uintptr_t)&iovecs_[i];
+			sqe.len = 1;
+			sqe.off = (u64)request.pos;
+			sqe.user_data = first + i;
+			sqArray_[index] = index;
+			tail++;
+		}
+		__atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+		unsigned submitted = 0;
+		unsigned completed = 0;
+		while (submitted < batch) {
+			// Don't ask to wait here: after a partial submit, it might wait for more than is in flight.
+			int result = Enter(batch - submitted, 0);
+			if (result > 0) {
+				submitted += result;
+				continue;
+			}
+			// Out of kernel resources, let some of ours finish and try again.
+			if (result < 0 && (errno == EAGAIN || errno == EBUSY) && completed < submitted) {
+				Reap(requests, completed, completed + 1);
+				continue;
+			}
+
+			ERROR_LOG(FILESYS, "io_uring submit failed: %d (%d)", result, errno);
+			// Take back what the kernel never consumed, so a later call can't submit stale entries.
+			// Without SQPOLL, the kernel only moves the head inside io_uring_enter, so this is safe.
+			__atomic_store_n(sqTail_, __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+			// What did get submitted is still reading into the caller's buffers.
+			Reap(requests, completed, submitted);
+			return false;
+		}
+
+		Reap(requests, completed, batch);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include "ppsspp_config.h"
+
+#include <cstddef>
+
+#include "Core/Loaders.h"
+
+// Android blocks io_uring for apps, so only desktop Linux.
+#if PPSSPP_PLATFORM(LINUX) && !PPSSPP_PLATFORM(ANDROID) && !defined(HAVE_LIBRETRO_VFS) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PPSSPP_HAS_IO_URING 1
+#endif
+#endif
+
+#ifdef PPSSPP_HAS_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct iovec;
+
+// Just enough io_uring to keep a batch of reads from a file in flight at once, without liburing.
+// Not thread safe, each thread needs its own.
+class IoUringReader {
+public:
+	IoUringReader() {}
+	~IoUringReader();
+
+	// Fails if the kernel doesn't support it or it's not allowed.
+	bool Init(unsigned entries);
+	// Fills in result for each request, which may be short like pread.
+	// If this returns false, the ring is broken and the results can't be trusted, but nothing is
+	// left in flight: the buffers are safe to reuse.
+	bool Read(int fd, FileLoader::ReadRequest *requests, size_t count);
+
+private:
+	int Enter(unsigned toSubmit, unsigned minComplete);
+	void Reap(FileLoader::ReadRequest *requests, unsigned &completed, unsigned target);
+
+	int fd_ = -1;
+	unsigned entries_ = 0;
+
+	void *sqRing_ = nullptr;
+	void *cqRing_ = nullptr;
+	size_t sqRingSize_ = 0;
+	size_t cqRingSize_ = 0;
+	io_uring_sqe *sqes_ = nullptr;
+	size_t sqesSize_ = 0;
+
+	unsigned *sqHead_ = nullptr;
+	unsigned *sqTail_ = nullptr;
+	unsigned *sqMask_ = nullptr;
+	unsigned *sqArray_ = nullptr;
+	unsigned *cqHead_ = nullptr;
+	unsigned *cqTail_ = nullptr;
+	unsigned *cqMask_ = nullptr;
+	io_uring_cqe *cqes_ = nullptr;
+
+	iovec *iovecs_ = nullptr;
+};
+
+#endif
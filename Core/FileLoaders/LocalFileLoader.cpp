@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <cstdio>
 
 #include "ppsspp_config.h"
@@ -23,6 +24,7 @@
 #include "Common/Log.h"
 #include "Common/File/FileUtil.h"
 #include "Common/File/DirListing.h"
+#include "Core/FileLoaders/IoUring.h"
 #include "Core/FileLoaders/LocalFileLoader.h"
 
 #if PPSSPP_PLATFORM(ANDROID)
@@ -124,6 +126,11 @@ LocalFileLoader::LocalFileLoader(const Path &filename)
 }
 
 LocalFileLoader::~LocalFileLoader() {
+#ifdef PPSSPP_HAS_IO_URING
+	for (IoUringReader *ring : freeRings_)
+		delete ring;
+#endif
+
 #if defined(HAVE_LIBRETRO_VFS)
     filestream_close(handle_);
 #elif !defined(_WIN32)
@@ -222,3 +229,89 @@ size_t LocalFileLoader::ReadAt(s64 absolutePos, size_t bytes, size_t count, void
 	return result == TRUE ? (size_t)read / bytes : -1;
 #endif
 }
+
+// Enough to keep storage busy, while keeping the number of rings per file small.
+static const int MAX_IO_RINGS = 4;
+static const unsigned IO_RING_ENTRIES = 64;
+
+void LocalFileLoader::ReadAtMultiple(ReadRequest *requests, size_t count, Flags flags) {
+#ifdef PPSSPP_HAS_IO_URING
+	IoUringReader *ring = count > 1 && fd_ != -1 ? AcquireRing() : nullptr;
+	if (ring) {
+		bool success = ring->Read(fd_, requests, count);
+		ReleaseRing(ring, !success);
+		if (success) {
+			// Short reads can happen, same as with pread.  Finish those the simple way.
+			for (size_t i = 0; i < count; ++i) {
+				ReadRequest &request = requests[i];
+				while (request.result < request.bytes && request.pos + (s64)request.result < (s64)filesize_) {
+					u8 *rest = (u8 *)request.data + request.result;
+					size_t readBytes = ReadAt(request.pos + request.result, 1, request.bytes - request.result, rest, flags);
+					// On an error, leave it short so the caller sees the read failed.
+					if (readBytes == 0 || readBytes == (size_t)-1)
+						break;
+					request.result += readBytes;
+				}
+			}
+			return;
+		}
+	}
+#endif
+	FileLoader::ReadAtMultiple(requests, count, flags);
+}
+
+IoUringReader *LocalFileLoader::AcquireRing() {
+#ifdef PPSSPP_HAS_IO_URING
+	std::lock_guard<std::mutex> guard(ringLock_);
+	if (!freeRings_.empty()) {
+		IoUringReader *ring = freeRings_.back();
+		freeRings_.pop_back();
+		return ring;
+	}
+	// If all are busy, the caller just uses pread, which is fine alongside.
+	if (ringsFailed_ || ringCount_ >= MAX_IO_RINGS)
+		return nullptr;
+
+	IoUringReader *ring = new IoUringReader();
+	if (!ring->Init(IO_RING_ENTRIES)) {
+		delete ring;
+		ringsFailed_ = true;
+		return nullptr;
+	}
+	ringCount_++;
+	return ring;
+#else
+	return nullptr;
+#endif
+}
+
+void LocalFileLoader::ReleaseRing(IoUringReader *ring, bool broken) {
+#ifdef PPSSPP_HAS_IO_URING
+	std::lock_guard<std::mutex> guard(ringLock_);
+	if (broken) {
+		// Don't trust any of them after a failure.
+		delete ring;
+		ringCount_--;
+		ringsFailed_ = true;
+	} else {
+		freeRings_.push_back(ring);
+	}
+#endif
+}
+
+void LocalFileLoader::Prefetch(s64 absolutePos, size_t bytes) {
+	if (bytes == 0 || absolutePos >= (s64)filesize_)
+		return;
+
+	// Just ask the OS to start reading, it'll land in its cache.  Helps a lot with slow storage.
+#if defined(HAVE_LIBRETRO_VFS) || PPSSPP_PLATFORM(SWITCH) || defined(_WIN32)
+	// No simple hint available here.
+#elif defined(__APPLE__)
+	struct radvisory advice;
+	advice.ra_offset = absolutePos;
+	advice.ra_count = (int)std::min(bytes, (size_t)0x7FFFFFFF);
+	fcntl(fd_, F_RDADVISE, &advice);
+#else
+	posix_fadvise(fd_, absolutePos, bytes, POSIX_FADV_WILLNEED);
+#endif
+}
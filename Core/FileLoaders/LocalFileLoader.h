@@ -18,6 +18,7 @@
 #pragma once
 
 #include <mutex>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Common/File/Path.h"
@@ -32,6 +33,8 @@ typedef void *HANDLE;
 typedef RFILE* HANDLE;
 #endif
 
+class IoUringReader;
+
 class LocalFileLoader : public FileLoader {
 public:
 	LocalFileLoader(const Path &filename);
@@ -44,8 +47,13 @@ class LocalFileLoader : public FileLoader {
 		return filename_;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override;
+	void ReadAtMultiple(ReadRequest *requests, size_t count, Flags flags = Flags::NONE) override;
+	void Prefetch(s64 absolutePos, size_t bytes) override;
 
 private:
+	IoUringReader *AcquireRing();
+	void ReleaseRing(IoUringReader *ring, bool broken);
+
 #if !defined(_WIN32) && !defined(HAVE_LIBRETRO_VFS)
 	void DetectSizeFd();
 	int fd_ = -1;
@@ -56,4 +64,10 @@ class LocalFileLoader : public FileLoader {
 	Path filename_;
 	std::mutex readLock_;
 	bool isOpenedByFd_ = false;
+
+	// Only used where io_uring is available.  One per concurrent batch.
+	std::vector<IoUringReader *> freeRings_;
+	int ringCount_ = 0;
+	bool ringsFailed_ = false;
+	std::mutex ringLock_;
 };
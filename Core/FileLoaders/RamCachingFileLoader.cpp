@@ -88,6 +88,31 @@ size_t RamCachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, F
 	return readSize;
 }
 
+void RamCachingFileLoader::Prefetch(s64 absolutePos, size_t bytes) {
+	if (cache_ == nullptr || bytes == 0 || absolutePos >= filesize_) {
+		return;
+	}
+
+	const u32 cacheStartPos = (u32)(absolutePos >> BLOCK_SHIFT);
+	const u32 cacheEndPos = (u32)((std::min(absolutePos + (s64)bytes, filesize_) - 1) >> BLOCK_SHIFT);
+	for (u32 i = cacheStartPos; i <= cacheEndPos; ++i) {
+		{
+			std::lock_guard<std::mutex> guard(blocksMutex_);
+			if (blocks_[i] != 0) {
+				continue;
+			}
+		}
+
+		SaveIntoCache((s64)i << BLOCK_SHIFT, (size_t)(cacheEndPos - i + 1) << BLOCK_SHIFT, Flags::NONE);
+
+		std::lock_guard<std::mutex> guard(blocksMutex_);
+		if (blocks_[i] == 0) {
+			// Must've failed to read, don't keep trying.
+			break;
+		}
+	}
+}
+
 void RamCachingFileLoader::InitCache() {
 	std::lock_guard<std::mutex> guard(blocksMutex_);
 	u32 blockCount = (u32)((filesize_ + BLOCK_SIZE - 1) >> BLOCK_SHIFT);
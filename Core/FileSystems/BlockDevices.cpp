@@ -24,12 +24,17 @@
 #include "Common/System/OSD.h"
 #include "Common/Log.h"
 #include "Common/Swap.h"
+#include "Common/Thread/ParallelLoop.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Common/File/FileUtil.h"
 #include "Common/File/DirListing.h"
 #include "Core/Loaders.h"
 #include "Core/FileSystems/BlockDevices.h"
 #include "libchdr/chd.h"
 
+#include <zstd.h>
+#include <zdict.h>
+
 extern "C"
 {
 #include "zlib.h"
@@ -65,6 +70,8 @@ BlockDevice *constructBlockDevice(FileLoader *fileLoader) {
 			return new NPDRMDemoBlockDevice(fileLoader);
 	} else if (!memcmp(buffer, "MComprHD", 8)) {
 		return new CHDFileBlockDevice(fileLoader);
+	} else if (!memcmp(buffer, "ZDIM", 4)) {
+		return new ZstdDiscBlockDevice(fileLoader);
 	}
 
 	// Should be just a regular ISO file. Let's open it as a plain block device and let the other systems take over.
@@ -98,7 +105,34 @@ bool FileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached) {
 	return true;
 }
 
+// Large reads are split into pieces of at least this many blocks, which some loaders can read in parallel.
+static const int FILE_READ_SPLIT_BLOCKS = 64;
+static const int FILE_READ_MAX_PIECES = 16;
+
 bool FileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
+	if (count >= FILE_READ_SPLIT_BLOCKS * 2) {
+		const int pieces = std::min(count / FILE_READ_SPLIT_BLOCKS, FILE_READ_MAX_PIECES);
+		const int blocksPerPiece = (count + pieces - 1) / pieces;
+		FileLoader::ReadRequest requests[FILE_READ_MAX_PIECES];
+		for (int i = 0; i < pieces; ++i) {
+			const int first = i * blocksPerPiece;
+			const int blocks = std::min(blocksPerPiece, count - first);
+			requests[i].pos = (u64)(minBlock + first) * (u64)GetBlockSize();
+			requests[i].bytes = (size_t)blocks * GetBlockSize();
+			requests[i].data = outPtr + (size_t)first * GetBlockSize();
+			requests[i].result = 0;
+		}
+
+		fileLoader_->ReadAtMultiple(requests, pieces);
+		for (int i = 0; i < pieces; ++i) {
+			if (requests[i].result != requests[i].bytes) {
+				ERROR_LOG(FILESYS, "Could not read %d blocks, at block offset %d. Only got %d bytes", (int)(requests[i].bytes / GetBlockSize()), (int)(requests[i].pos / GetBlockSize()), (int)requests[i].result);
+				return false;
+			}
+		}
+		return true;
+	}
+
 	size_t retval = fileLoader_->ReadAt((u64)minBlock * (u64)GetBlockSize(), 2048, count, outPtr);
 	if (retval != (size_t)count) {
 		ERROR_LOG(FILESYS, "Could not read %d blocks, at block offset %d. Only got %d blocks", count, minBlock, (int)retval);
@@ -107,6 +141,320 @@ bool FileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	return true;
 }
 
+void FileBlockDevice::Prefetch(u32 minBlock, u32 count) {
+	fileLoader_->Prefetch((u64)minBlock * (u64)GetBlockSize(), (size_t)count * GetBlockSize());
+}
+
+// Frames
+
+static const u32 FRAME_READ_BUFFER_SIZE = 1024 * 1024;
+// Decompressed frames to keep around, in bytes.  Lookups are a linear scan, so the count is limited too.
+static const u32 FRAME_CACHE_SIZE = 1024 * 1024;
+static const u32 FRAME_CACHE_MIN_SLOTS = 8;
+static const u32 FRAME_CACHE_MAX_SLOTS = 64;
+// Below this much decompressed data, it's not worth waking other threads.
+static const u32 FRAME_PARALLEL_MIN_SIZE = 64 * 1024;
+
+FramedBlockDevice::~FramedBlockDevice() {
+	_dbg_assert_msg_(freeContexts_.empty(), "Subclass must call ShutdownFrames()");
+	for (ReadScratch *scratch : freeScratch_) {
+		delete [] scratch->readBuffer;
+		delete [] scratch->frameBuffer;
+		delete scratch;
+	}
+	delete [] frameCache_;
+}
+
+void FramedBlockDevice::InitFrames(u32 maxFrameRead) {
+	readBufferSize = std::max(FRAME_READ_BUFFER_SIZE, maxFrameRead);
+
+	const u32 cacheSlots = std::clamp(FRAME_CACHE_SIZE / std::max(frameSize, 1U), FRAME_CACHE_MIN_SLOTS, FRAME_CACHE_MAX_SLOTS);
+	frameCache_ = new u8[(size_t)cacheSlots * frameSize];
+	cacheFrames_.resize(cacheSlots, numFrames);
+	cacheLastUse_.resize(cacheSlots, 0);
+
+	// Most reads come from one thread at a time, so start with one of each.
+	ReleaseScratch(AcquireScratch());
+	ReleaseContext(AcquireContext());
+}
+
+void FramedBlockDevice::ShutdownFrames() {
+	for (void *ctx : freeContexts_)
+		DestroyContext(ctx);
+	freeContexts_.clear();
+}
+
+void *FramedBlockDevice::AcquireContext() {
+	std::lock_guard<std::mutex> guard(contextLock_);
+	if (!freeContexts_.empty()) {
+		void *ctx = freeContexts_.back();
+		freeContexts_.pop_back();
+		return ctx;
+	}
+	return CreateContext();
+}
+
+void FramedBlockDevice::ReleaseContext(void *ctx) {
+	if (!ctx)
+		return;
+	std::lock_guard<std::mutex> guard(contextLock_);
+	freeContexts_.push_back(ctx);
+}
+
+FramedBlockDevice::ReadScratch *FramedBlockDevice::AcquireScratch() {
+	{
+		std::lock_guard<std::mutex> guard(contextLock_);
+		if (!freeScratch_.empty()) {
+			ReadScratch *scratch = freeScratch_.back();
+			freeScratch_.pop_back();
+			return scratch;
+		}
+	}
+
+	ReadScratch *scratch = new ReadScratch();
+	scratch->readBuffer = new u8[readBufferSize];
+	scratch->frameBuffer = new u8[(size_t)frameSize * 2];
+	return scratch;
+}
+
+void FramedBlockDevice::ReleaseScratch(ReadScratch *scratch) {
+	std::lock_guard<std::mutex> guard(contextLock_);
+	freeScratch_.push_back(scratch);
+}
+
+const u8 *FramedBlockDevice::FindCachedFrame(u32 frame) {
+	for (size_t i = 0; i < cacheFrames_.size(); ++i) {
+		if (cacheFrames_[i] == frame) {
+			cacheLastUse_[i] = ++cacheUseCounter_;
+			return frameCache_ + i * frameSize;
+		}
+	}
+	return nullptr;
+}
+
+void FramedBlockDevice::StoreCachedFrame(u32 frame, const u8 *data) {
+	// Another thread may have read the same frame meanwhile.
+	if (FindCachedFrame(frame))
+		return;
+
+	size_t slot = 0;
+	for (size_t i = 1; i < cacheFrames_.size(); ++i) {
+		if (cacheLastUse_[i] < cacheLastUse_[slot])
+			slot = i;
+	}
+	cacheFrames_[slot] = frame;
+	cacheLastUse_[slot] = ++cacheUseCounter_;
+	memcpy(frameCache_ + slot * frameSize, data, frameSize);
+}
+
+bool FramedBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached) {
+	FileLoader::Flags flags = uncached ? FileLoader::Flags::HINT_UNCACHED : FileLoader::Flags::NONE;
+	if ((u32)blockNumber >= numBlocks) {
+		memset(outPtr, 0, GetBlockSize());
+		return false;
+	}
+
+	const u32 frameNumber = blockNumber >> blockShift;
+	const FrameInfo info = GetFrameInfo(frameNumber);
+	const u32 frameOffset = (blockNumber & ((1 << blockShift) - 1)) * GetBlockSize();
+
+	if (info.plain) {
+		int readSize = (u32)fileLoader_->ReadAt(info.pos + frameOffset, 1, GetBlockSize(), outPtr, flags);
+		if (readSize < GetBlockSize())
+			memset(outPtr + readSize, 0, GetBlockSize() - readSize);
+		return true;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		const u8 *cached = FindCachedFrame(frameNumber);
+		if (cached) {
+			// We already have it.  Just apply the offset and copy.
+			memcpy(outPtr, cached + frameOffset, GetBlockSize());
+			return true;
+		}
+	}
+
+	ReadScratch *scratch = AcquireScratch();
+	const u32 readSize = (u32)fileLoader_->ReadAt(info.pos, 1, std::min(info.size, readBufferSize), scratch->readBuffer, flags);
+
+	u8 *dest = frameSize == (u32)GetBlockSize() ? outPtr : scratch->frameBuffer;
+	void *ctx = AcquireContext();
+	const bool success = DecompressFrame(ctx, scratch->readBuffer, readSize, dest, frameNumber);
+	ReleaseContext(ctx);
+
+	if (success) {
+		if (dest != outPtr)
+			memcpy(outPtr, dest + frameOffset, GetBlockSize());
+		// Uncached reads (like hashing the whole disc) shouldn't push out frames that are in use.
+		if (!uncached) {
+			std::lock_guard<std::mutex> guard(lock_);
+			StoreCachedFrame(frameNumber, dest);
+		}
+	} else {
+		memset(outPtr, 0, GetBlockSize());
+		std::lock_guard<std::mutex> guard(lock_);
+		NotifyReadError();
+	}
+
+	ReleaseScratch(scratch);
+	return success;
+}
+
+void FramedBlockDevice::RunFrameJob(void *ctx, const u8 *readBuffer, FrameJob &job) {
+	const u8 *src = readBuffer + job.readOffset;
+	if (job.plain) {
+		// A bad index can make a plain frame shorter than the blocks wanted from it.
+		if ((job.blockOffset + job.blocks) * GetBlockSize() > job.readSize) {
+			job.failed = true;
+			memset(job.out, 0, job.blocks * GetBlockSize());
+		} else {
+			memcpy(job.out, src + job.blockOffset * GetBlockSize(), job.blocks * GetBlockSize());
+		}
+		return;
+	}
+
+	if (!DecompressFrame(ctx, src, job.readSize, job.dest, job.frame)) {
+		job.failed = true;
+		memset(job.out, 0, job.blocks * GetBlockSize());
+	} else if (job.dest != job.out) {
+		memcpy(job.out, job.dest + job.blockOffset * GetBlockSize(), job.blocks * GetBlockSize());
+	}
+}
+
+void FramedBlockDevice::Prefetch(u32 minBlock, u32 count) {
+	if (minBlock >= numBlocks || count == 0 || numFrames == 0)
+		return;
+	const u32 lastBlock = std::min(minBlock + count, numBlocks) - 1;
+	const u32 firstFrame = minBlock >> blockShift;
+	const u32 lastFrame = std::min(lastBlock >> blockShift, numFrames - 1);
+
+	// Only the compressed data, the frame cache is too small to decompress ahead into.
+	const FrameInfo first = GetFrameInfo(firstFrame);
+	const FrameInfo last = GetFrameInfo(lastFrame);
+	if (last.pos + last.size > first.pos)
+		fileLoader_->Prefetch(first.pos, (size_t)(last.pos + last.size - first.pos));
+}
+
+bool FramedBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
+	if (count == 1) {
+		return ReadBlock(minBlock, outPtr);
+	}
+	if (minBlock >= numBlocks) {
+		memset(outPtr, 0, GetBlockSize() * count);
+		return false;
+	}
+
+	const u32 lastBlock = std::min(minBlock + count, numBlocks) - 1;
+	const u32 missingBlocks = count - (lastBlock + 1 - minBlock);
+	if (missingBlocks != 0) {
+		memset(outPtr + GetBlockSize() * (count - missingBlocks), 0, GetBlockSize() * missingBlocks);
+	}
+
+	const u32 minFrameNumber = minBlock >> blockShift;
+	const u32 lastFrameNumber = lastBlock >> blockShift;
+	const u32 blocksPerFrame = 1 << blockShift;
+
+	ReadScratch *scratch = AcquireScratch();
+	std::vector<FrameJob> &jobs = scratch->jobs;
+	bool success = true;
+	u32 block = minBlock;
+	u32 frame = minFrameNumber;
+	while (frame <= lastFrameNumber) {
+		// Gather a batch of frames that are all in one read, skipping any already decompressed.
+		jobs.clear();
+		u64 batchStart = 0;
+		u64 batchEnd = 0;
+		u32 decompressSize = 0;
+		u32 partialFrames = 0;
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			for (; frame <= lastFrameNumber; ++frame) {
+				const FrameInfo info = GetFrameInfo(frame);
+				const u32 frameBlockOffset = block & ((1 << blockShift) - 1);
+				const u32 frameBlocks = std::min(lastBlock - block + 1, blocksPerFrame - frameBlockOffset);
+
+				const u8 *cached = FindCachedFrame(frame);
+				if (cached) {
+					memcpy(outPtr, cached + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
+				} else {
+					// A bad index could claim anything, so never read more than fits.
+					const u32 frameReadSize = std::min(info.size, readBufferSize);
+					// Frames are normally in order, but don't assume it.
+					if (jobs.empty())
+						batchStart = info.pos;
+					else if (info.pos < batchEnd || info.pos + frameReadSize - batchStart > readBufferSize)
+						break;
+					batchEnd = info.pos + frameReadSize;
+
+					FrameJob job;
+					job.frame = frame;
+					job.readOffset = (u32)(info.pos - batchStart);
+					job.readSize = frameReadSize;
+					job.plain = info.plain;
+					job.failed = false;
+					job.out = outPtr;
+					job.blockOffset = frameBlockOffset;
+					job.blocks = frameBlocks;
+					// Only the first and last frames can be partial.  They're likely to be read again
+					// by the next sequential read, so they go into the cache afterward.
+					if (job.plain || frameBlocks == blocksPerFrame) {
+						job.dest = outPtr;
+					} else {
+						_dbg_assert_(partialFrames < 2);
+						job.dest = scratch->frameBuffer + (size_t)frameSize * partialFrames++;
+					}
+					if (!job.plain)
+						decompressSize += frameSize;
+					jobs.push_back(job);
+				}
+
+				block += frameBlocks;
+				outPtr += frameBlocks * GetBlockSize();
+			}
+		}
+
+		if (jobs.empty())
+			continue;
+
+		// The read and decompression don't touch the cache, so other reads can use it meanwhile.
+		const size_t chunkSize = (size_t)(batchEnd - batchStart);
+		const u32 readSize = (u32)fileLoader_->ReadAt(batchStart, 1, chunkSize, scratch->readBuffer);
+		if (readSize < chunkSize) {
+			memset(scratch->readBuffer + readSize, 0, chunkSize - readSize);
+		}
+
+		if (jobs.size() > 1 && decompressSize >= FRAME_PARALLEL_MIN_SIZE) {
+			// Frames are independent, so each worker can decompress its own share with its own context.
+			const int minJobs = std::max(1U, FRAME_PARALLEL_MIN_SIZE / 2 / frameSize);
+			ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+				void *ctx = AcquireContext();
+				for (int i = l; i < h; ++i)
+					RunFrameJob(ctx, scratch->readBuffer, jobs[i]);
+				ReleaseContext(ctx);
+			}, 0, (int)jobs.size(), minJobs);
+		} else {
+			void *ctx = AcquireContext();
+			for (FrameJob &job : jobs)
+				RunFrameJob(ctx, scratch->readBuffer, job);
+			ReleaseContext(ctx);
+		}
+
+		std::lock_guard<std::mutex> guard(lock_);
+		for (const FrameJob &job : jobs) {
+			if (job.failed) {
+				NotifyReadError();
+				success = false;
+			} else if (job.dest != job.out) {
+				StoreCachedFrame(job.frame, job.dest);
+			}
+		}
+	}
+
+	ReleaseScratch(scratch);
+	return success;
+}
+
 // .CSO format
 
 // compressed ISO(9660) header format
@@ -135,10 +483,8 @@ typedef struct ciso_header
 
 // TODO: Need much better error handling.
 
-static const u32 CSO_READ_BUFFER_SIZE = 256 * 1024;
-
 CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
-	: BlockDevice(fileLoader)
+	: FramedBlockDevice(fileLoader)
 {
 	// CISO format is fairly simple, but most tools do not write the header_size.
 
@@ -147,7 +493,7 @@ CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 	if (readSize != 1 || memcmp(hdr.magic, "CISO", 4) != 0) {
 		WARN_LOG(LOADER, "Invalid CSO!");
 	}
-	if (hdr.ver > 1) {
+	if (hdr.ver > 2) {
 		WARN_LOG(LOADER, "CSO version too high!");
 	}
 
@@ -168,14 +514,6 @@ CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 	numBlocks = (u32)(totalSize / GetBlockSize());
 	VERBOSE_LOG(LOADER, "CSO numBlocks=%i numFrames=%i align=%i", numBlocks, numFrames, indexShift);
 
-	// We might read a bit of alignment too, so be prepared.
-	if (frameSize + (1 << indexShift) < CSO_READ_BUFFER_SIZE)
-		readBuffer = new u8[CSO_READ_BUFFER_SIZE];
-	else
-		readBuffer = new u8[frameSize + (1 << indexShift)];
-	zlibBuffer = new u8[frameSize + (1 << indexShift)];
-	zlibBufferFrame = numFrames;
-
 	const u32 indexSize = numFrames + 1;
 	const size_t headerEnd = hdr.ver > 1 ? (size_t)hdr.header_size : sizeof(hdr);
 
@@ -211,179 +549,347 @@ CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 			expectedFileSize, fileSize, fileLoader->GetPath().c_str());
 		NotifyReadError();
 	}
+
+	// We might read a bit of alignment too, so be prepared.
+	InitFrames(frameSize + (1 << indexShift));
 }
 
 CISOFileBlockDevice::~CISOFileBlockDevice()
 {
+	ShutdownFrames();
 	delete [] index;
-	delete [] readBuffer;
-	delete [] zlibBuffer;
 }
 
-bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
-{
-	FileLoader::Flags flags = uncached ? FileLoader::Flags::HINT_UNCACHED : FileLoader::Flags::NONE;
-	if ((u32)blockNumber >= numBlocks) {
-		memset(outPtr, 0, GetBlockSize());
-		return false;
-	}
-
-	const u32 frameNumber = blockNumber >> blockShift;
-	const u32 idx = index[frameNumber];
+FramedBlockDevice::FrameInfo CISOFileBlockDevice::GetFrameInfo(u32 frame) const {
+	const u32 idx = index[frame];
 	const u32 indexPos = idx & 0x7FFFFFFF;
-	const u32 nextIndexPos = index[frameNumber + 1] & 0x7FFFFFFF;
-	z_stream z{};
+	const u32 nextIndexPos = index[frame + 1] & 0x7FFFFFFF;
 
-	const u64 compressedReadPos = (u64)indexPos << indexShift;
-	const u64 compressedReadEnd = (u64)nextIndexPos << indexShift;
-	const size_t compressedReadSize = (size_t)(compressedReadEnd - compressedReadPos);
-	const u32 compressedOffset = (blockNumber & ((1 << blockShift) - 1)) * GetBlockSize();
-
-	bool plain = (idx & 0x80000000) != 0;
+	FrameInfo info;
+	info.pos = (u64)indexPos << indexShift;
+	info.size = (u32)(((u64)nextIndexPos << indexShift) - info.pos);
+	info.plain = (idx & 0x80000000) != 0;
 	if (ver_ >= 2) {
 		// CSO v2+ requires blocks be uncompressed if large enough to be.  High bit means other things.
-		plain = compressedReadSize >= frameSize;
+		info.plain = info.size >= frameSize;
 	}
-	if (plain) {
-		int readSize = (u32)fileLoader_->ReadAt(compressedReadPos + compressedOffset, 1, GetBlockSize(), outPtr, flags);
-		if (readSize < GetBlockSize())
-			memset(outPtr + readSize, 0, GetBlockSize() - readSize);
-	} else if (zlibBufferFrame == frameNumber) {
-		// We already have it.  Just apply the offset and copy.
-		memcpy(outPtr, zlibBuffer + compressedOffset, GetBlockSize());
-	} else {
-		const u32 readSize = (u32)fileLoader_->ReadAt(compressedReadPos, 1, compressedReadSize, readBuffer, flags);
+	return info;
+}
 
-		z.zalloc = Z_NULL;
-		z.zfree = Z_NULL;
-		z.opaque = Z_NULL;
-		if (inflateInit2(&z, -15) != Z_OK) {
-			ERROR_LOG(LOADER, "GetBlockSize() ERROR: %s\n", (z.msg) ? z.msg : "?");
-			NotifyReadError();
-			return false;
-		}
-		z.avail_in = readSize;
-		z.next_out = frameSize == (u32)GetBlockSize() ? outPtr : zlibBuffer;
-		z.avail_out = frameSize;
-		z.next_in = readBuffer;
-
-		int status = inflate(&z, Z_FINISH);
-		if (status != Z_STREAM_END) {
-			ERROR_LOG(LOADER, "block %d: inflate : %s[%d]\n", blockNumber, (z.msg) ? z.msg : "error", status);
-			NotifyReadError();
-			inflateEnd(&z);
-			memset(outPtr, 0, GetBlockSize());
-			return false;
-		}
-		if (z.total_out != frameSize) {
-			ERROR_LOG(LOADER, "block %d: block size error %d != %d\n", blockNumber, (u32)z.total_out, frameSize);
-			NotifyReadError();
-			inflateEnd(&z);
-			memset(outPtr, 0, GetBlockSize());
-			return false;
-		}
-		inflateEnd(&z);
+void *CISOFileBlockDevice::CreateContext() {
+	z_stream *z = new z_stream{};
+	if (inflateInit2(z, -15) != Z_OK) {
+		ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z->msg) ? z->msg : "?");
+		delete z;
+		return nullptr;
+	}
+	return z;
+}
 
-		if (frameSize != (u32)GetBlockSize()) {
-			zlibBufferFrame = frameNumber;
-			memcpy(outPtr, zlibBuffer + compressedOffset, GetBlockSize());
-		}
+void CISOFileBlockDevice::DestroyContext(void *ctx) {
+	z_stream *z = (z_stream *)ctx;
+	inflateEnd(z);
+	delete z;
+}
+
+bool CISOFileBlockDevice::DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) {
+	z_stream *z = (z_stream *)ctx;
+	if (!z)
+		return false;
+
+	inflateReset(z);
+	z->avail_in = srcSize;
+	z->next_out = dest;
+	z->avail_out = frameSize;
+	z->next_in = (Bytef *)src;
+
+	int status = inflate(z, Z_FINISH);
+	if (status != Z_STREAM_END) {
+		ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d]\n", frame, (z->msg) ? z->msg : "error", status);
+		return false;
+	}
+	if (z->total_out != frameSize) {
+		ERROR_LOG(LOADER, "Inflate frame %d: block size error %d != %d\n", frame, (u32)z->total_out, frameSize);
+		return false;
 	}
 	return true;
 }
 
-bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
-	if (count == 1) {
-		return ReadBlock(minBlock, outPtr);
+// .ZDI format, a seekable zstd compressed disc image.
+//
+// Frames are independent zstd frames of frame_size uncompressed bytes each, the last one zero padded.
+// Frames may all use one dictionary trained from the image, which helps small frames compress well.
+// Frames that wouldn't get smaller are stored plain, marked by the top bit of their index entry.
+typedef struct zdi_header
+{
+	char magic[4];                  // +00 : 'Z','D','I','M'
+	u32_le header_size;             // +04 : header size (==0x30)
+	u64_le total_bytes;             // +08 : uncompressed size of the image
+	u32_le frame_size;              // +10 : uncompressed size of each frame
+	u32_le num_frames;              // +14 : number of frames
+	u64_le index_offset;            // +18 : offset of num_frames + 1 u64 frame offsets, the last is the end
+	u64_le dict_offset;             // +20 : offset of the zstd dictionary
+	u32_le dict_size;               // +28 : size of the dictionary, or 0 for none
+	u8 ver;                         // +2C : version 01
+	u8 rsv_2d[3];                   // +2D : reserved
+} ZDI_H;
+
+static const u8 ZDI_VERSION = 1;
+static const u64 ZDI_PLAIN_FLAG = 1ULL << 63;
+static const u32 ZDI_MAX_FRAME_SIZE = 1024 * 1024;
+
+ZstdDiscBlockDevice::ZstdDiscBlockDevice(FileLoader *fileLoader)
+	: FramedBlockDevice(fileLoader)
+{
+	ZDI_H hdr{};
+	size_t readSize = fileLoader->ReadAt(0, sizeof(ZDI_H), 1, &hdr);
+	if (readSize != 1 || memcmp(hdr.magic, "ZDIM", 4) != 0) {
+		WARN_LOG(LOADER, "Invalid ZDI!");
 	}
-	if (minBlock >= numBlocks) {
-		memset(outPtr, 0, GetBlockSize() * count);
-		return false;
+	if (hdr.ver > ZDI_VERSION) {
+		WARN_LOG(LOADER, "ZDI version too high!");
 	}
 
-	const u32 lastBlock = std::min(minBlock + count, numBlocks) - 1;
-	const u32 missingBlocks = (lastBlock + 1 - minBlock) - count;
-	if (lastBlock < minBlock + count) {
-		memset(outPtr + GetBlockSize() * (count - missingBlocks), 0, GetBlockSize() * missingBlocks);
+	frameSize = hdr.frame_size;
+	if ((frameSize & (frameSize - 1)) != 0 || frameSize < 0x800 || frameSize > ZDI_MAX_FRAME_SIZE) {
+		ERROR_LOG(LOADER, "ZDI frame size %i unsupported, must be a power of two from one sector to 1MB", frameSize);
+		NotifyReadError();
+		frameSize = 0x800;
+		InitFrames(frameSize);
+		return;
 	}
 
-	const u32 minFrameNumber = minBlock >> blockShift;
-	const u32 lastFrameNumber = lastBlock >> blockShift;
-	const u32 afterLastIndexPos = index[lastFrameNumber + 1] & 0x7FFFFFFF;
-	const u64 totalReadEnd = (u64)afterLastIndexPos << indexShift;
+	blockShift = 0;
+	for (u32 i = frameSize; i > 0x800; i >>= 1)
+		++blockShift;
 
-	z_stream z{};
-	if (inflateInit2(&z, -15) != Z_OK) {
-		ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z.msg) ? z.msg : "?");
-		return false;
+	// Check the header against the file before trusting any sizes from it.
+	const u64 fileSize = fileLoader->FileSize();
+	const u64 totalBytes = hdr.total_bytes;
+	const u64 expectedFrames = (totalBytes + frameSize - 1) / frameSize;
+	const u64 indexBytes = ((u64)hdr.num_frames + 1) * sizeof(u64);
+	const bool sizeValid = totalBytes / GetBlockSize() <= 0xFFFFFFFF && hdr.num_frames == expectedFrames;
+	if (!sizeValid || hdr.index_offset > fileSize || indexBytes > fileSize - hdr.index_offset) {
+		ERROR_LOG(LOADER, "ZDI header is corrupt: %d frames for %lld bytes, index at %lld, file is %lld bytes",
+			(u32)hdr.num_frames, totalBytes, (u64)hdr.index_offset, fileSize);
+		NotifyReadError();
+		InitFrames(frameSize);
+		return;
 	}
 
-	u64 readBufferStart = 0;
-	u64 readBufferEnd = 0;
-	u32 block = minBlock;
-	const u32 blocksPerFrame = 1 << blockShift;
-	for (u32 frame = minFrameNumber; frame <= lastFrameNumber; ++frame) {
-		const u32 idx = index[frame];
-		const u32 indexPos = idx & 0x7FFFFFFF;
-		const u32 nextIndexPos = index[frame + 1] & 0x7FFFFFFF;
-
-		const u64 frameReadPos = (u64)indexPos << indexShift;
-		const u64 frameReadEnd = (u64)nextIndexPos << indexShift;
-		const u32 frameReadSize = (u32)(frameReadEnd - frameReadPos);
-		const u32 frameBlockOffset = block & ((1 << blockShift) - 1);
-		const u32 frameBlocks = std::min(lastBlock - block + 1, blocksPerFrame - frameBlockOffset);
-
-		if (frameReadEnd > readBufferEnd) {
-			const s64 maxNeeded = totalReadEnd - frameReadPos;
-			const size_t chunkSize = (size_t)std::min(maxNeeded, (s64)std::max(frameReadSize, CSO_READ_BUFFER_SIZE));
-
-			const u32 readSize = (u32)fileLoader_->ReadAt(frameReadPos, 1, chunkSize, readBuffer);
-			if (readSize < chunkSize) {
-				memset(readBuffer + readSize, 0, chunkSize - readSize);
-			}
+	numFrames = hdr.num_frames;
+	numBlocks = (u32)(totalBytes / GetBlockSize());
+	VERBOSE_LOG(LOADER, "ZDI numBlocks=%i numFrames=%i dictionary=%i", numBlocks, numFrames, (int)hdr.dict_size);
 
-			readBufferStart = frameReadPos;
-			readBufferEnd = frameReadPos + readSize;
-		}
+	const u32 indexSize = numFrames + 1;
+	std::vector<u64_le> indexTemp(indexSize);
+	index_.resize(indexSize);
+	if (fileLoader->ReadAt(hdr.index_offset, sizeof(u64), indexSize, indexTemp.data()) != indexSize) {
+		NotifyReadError();
+		memset(indexTemp.data(), 0, indexSize * sizeof(u64_le));
+	}
+	for (u32 i = 0; i < indexSize; i++)
+		index_[i] = indexTemp[i];
 
-		u8 *rawBuffer = &readBuffer[frameReadPos - readBufferStart];
-		const int plain = idx & 0x80000000;
-		if (plain) {
-			memcpy(outPtr, rawBuffer + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
+	if (hdr.dict_size != 0 && (hdr.dict_offset > fileSize || hdr.dict_size > fileSize - hdr.dict_offset)) {
+		ERROR_LOG(LOADER, "ZDI dictionary is past the end of the file");
+		NotifyReadError();
+	} else if (hdr.dict_size != 0) {
+		std::vector<u8> dict(hdr.dict_size);
+		if (fileLoader->ReadAt(hdr.dict_offset, 1, dict.size(), dict.data()) != dict.size()) {
+			NotifyReadError();
 		} else {
-			z.avail_in = frameReadSize;
-			z.next_out = frameBlocks == blocksPerFrame ? outPtr : zlibBuffer;
-			z.avail_out = frameSize;
-			z.next_in = rawBuffer;
-
-			int status = inflate(&z, Z_FINISH);
-			if (status != Z_STREAM_END) {
-				ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d]\n", frame, (z.msg) ? z.msg : "error", status);
-				NotifyReadError();
-				memset(outPtr, 0, frameBlocks * GetBlockSize());
-			} else if (z.total_out != frameSize) {
-				ERROR_LOG(LOADER, "Inflate frame %d: block size error %d != %d\n", frame, (u32)z.total_out, frameSize);
-				NotifyReadError();
-				memset(outPtr, 0, frameBlocks * GetBlockSize());
-			} else if (frameBlocks != blocksPerFrame) {
-				memcpy(outPtr, zlibBuffer + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
-				// In case we end up reusing it in a single read later.
-				zlibBufferFrame = frame;
-			}
+			dict_ = ZSTD_createDDict(dict.data(), dict.size());
+		}
+		if (!dict_)
+			ERROR_LOG(LOADER, "Unable to load ZDI dictionary");
+	}
 
-			inflateReset(&z);
+	// Same as for CSO, make sure it's not truncated.
+	u64 expectedFileSize = index_[indexSize - 1] & ~ZDI_PLAIN_FLAG;
+	if (expectedFileSize > fileSize) {
+		ERROR_LOG(LOADER, "Expected ZDI to at least be %lld bytes, but file is %lld bytes. File: '%s'",
+			expectedFileSize, fileSize, fileLoader->GetPath().c_str());
+		NotifyReadError();
+	}
+
+	// Compressed frames are always smaller than plain ones.
+	InitFrames(frameSize);
+}
+
+ZstdDiscBlockDevice::~ZstdDiscBlockDevice() {
+	ShutdownFrames();
+	ZSTD_freeDDict(dict_);
+}
+
+FramedBlockDevice::FrameInfo ZstdDiscBlockDevice::GetFrameInfo(u32 frame) const {
+	const u64 pos = index_[frame] & ~ZDI_PLAIN_FLAG;
+	const u64 nextPos = index_[frame + 1] & ~ZDI_PLAIN_FLAG;
+
+	FrameInfo info;
+	info.pos = pos;
+	info.size = nextPos > pos ? (u32)std::min(nextPos - pos, (u64)ZDI_MAX_FRAME_SIZE) : 0;
+	info.plain = (index_[frame] & ZDI_PLAIN_FLAG) != 0;
+	return info;
+}
+
+void *ZstdDiscBlockDevice::CreateContext() {
+	return ZSTD_createDCtx();
+}
+
+void ZstdDiscBlockDevice::DestroyContext(void *ctx) {
+	ZSTD_freeDCtx((ZSTD_DCtx *)ctx);
+}
+
+bool ZstdDiscBlockDevice::DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) {
+	ZSTD_DCtx *dctx = (ZSTD_DCtx *)ctx;
+	if (!dctx)
+		return false;
+
+	size_t result;
+	if (dict_)
+		result = ZSTD_decompress_usingDDict(dctx, dest, frameSize, src, srcSize, dict_);
+	else
+		result = ZSTD_decompressDCtx(dctx, dest, frameSize, src, srcSize);
+	if (ZSTD_isError(result)) {
+		ERROR_LOG(LOADER, "Zstd frame %d: failed - %s\n", frame, ZSTD_getErrorName(result));
+		return false;
+	}
+	if (result != frameSize) {
+		ERROR_LOG(LOADER, "Zstd frame %d: block size error %d != %d\n", frame, (u32)result, frameSize);
+		return false;
+	}
+	return true;
+}
+
+// How much to read and compress at once while writing.
+static const u32 ZDI_WRITE_BATCH_SIZE = 8 * 1024 * 1024;
+// zstd suggests about 100 times the dictionary size in samples.
+static const u32 ZDI_DICT_SAMPLE_RATIO = 100;
+static const u32 ZDI_DICT_MIN_SAMPLES = 16;
+
+static void ReadSourceFrame(BlockDevice *source, u32 frame, u32 blocksPerFrame, u8 *out) {
+	const u32 firstBlock = frame * blocksPerFrame;
+	const u32 blocks = std::min(blocksPerFrame, source->GetNumBlocks() - firstBlock);
+	if (!source->ReadBlocks(firstBlock, (int)blocks, out))
+		WARN_LOG(LOADER, "Read error in frame %d while compressing", frame);
+	if (blocks < blocksPerFrame)
+		memset(out + blocks * source->GetBlockSize(), 0, (blocksPerFrame - blocks) * source->GetBlockSize());
+}
+
+bool WriteZstdDiscImage(BlockDevice *source, const Path &filename, const ZstdDiscImageOptions &options, std::string *errorString) {
+	const u32 frameSize = options.frameSize;
+	const u32 blockSize = source->GetBlockSize();
+	if (frameSize < blockSize || (frameSize & (frameSize - 1)) != 0 || frameSize > ZDI_MAX_FRAME_SIZE) {
+		*errorString = "Frame size must be a power of two from 2048 to 1048576";
+		return false;
+	}
+
+	const u32 blocksPerFrame = frameSize / blockSize;
+	const u32 numBlocks = source->GetNumBlocks();
+	const u32 numFrames = (numBlocks + blocksPerFrame - 1) / blocksPerFrame;
+
+	// Train a dictionary on frames sampled evenly across the image.
+	std::vector<u8> dict;
+	if (options.dictionarySize != 0 && numFrames >= ZDI_DICT_MIN_SAMPLES) {
+		const u32 sampleCount = std::clamp((u32)((u64)options.dictionarySize * ZDI_DICT_SAMPLE_RATIO / frameSize), ZDI_DICT_MIN_SAMPLES, numFrames);
+		std::vector<u8> samples((size_t)sampleCount * frameSize);
+		std::vector<size_t> sampleSizes(sampleCount, frameSize);
+		for (u32 i = 0; i < sampleCount; ++i)
+			ReadSourceFrame(source, (u32)((u64)i * numFrames / sampleCount), blocksPerFrame, &samples[(size_t)i * frameSize]);
+
+		dict.resize(options.dictionarySize);
+		size_t dictSize = ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data(), sampleSizes.data(), sampleCount);
+		if (ZDICT_isError(dictSize)) {
+			WARN_LOG(LOADER, "Unable to train ZDI dictionary, continuing without: %s", ZDICT_getErrorName(dictSize));
+			dict.clear();
+		} else {
+			dict.resize(dictSize);
 		}
+	}
 
-		block += frameBlocks;
-		outPtr += frameBlocks * GetBlockSize();
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		*errorString = "Unable to open output file";
+		return false;
 	}
 
-	inflateEnd(&z);
+	ZDI_H hdr{};
+	memcpy(hdr.magic, "ZDIM", 4);
+	hdr.header_size = sizeof(ZDI_H);
+	hdr.total_bytes = (u64)numBlocks * blockSize;
+	hdr.frame_size = frameSize;
+	hdr.num_frames = numFrames;
+	hdr.dict_offset = sizeof(ZDI_H);
+	hdr.dict_size = (u32)dict.size();
+	hdr.ver = ZDI_VERSION;
+
+	// The header is written again at the end, once the index offset is known.
+	bool success = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	if (success && !dict.empty())
+		success = fwrite(dict.data(), dict.size(), 1, f) == 1;
+
+	ZSTD_CDict *cdict = dict.empty() ? nullptr : ZSTD_createCDict(dict.data(), dict.size(), options.level);
+	const u32 batchFrames = std::max(1U, ZDI_WRITE_BATCH_SIZE / frameSize);
+	const size_t bound = ZSTD_compressBound(frameSize);
+	std::vector<u8> input((size_t)batchFrames * frameSize);
+	std::vector<u8> output((size_t)batchFrames * bound);
+	std::vector<size_t> outputSizes(batchFrames);
+	std::vector<u64_le> index;
+	index.reserve(numFrames + 1);
+
+	u64 pos = sizeof(ZDI_H) + dict.size();
+	for (u32 first = 0; success && first < numFrames; first += batchFrames) {
+		const u32 count = std::min(batchFrames, numFrames - first);
+		for (u32 i = 0; i < count; ++i)
+			ReadSourceFrame(source, first + i, blocksPerFrame, &input[(size_t)i * frameSize]);
+
+		ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+			ZSTD_CCtx *cctx = ZSTD_createCCtx();
+			for (int i = l; i < h; ++i) {
+				u8 *dst = &output[i * bound];
+				const u8 *src = &input[(size_t)i * frameSize];
+				if (cdict)
+					outputSizes[i] = ZSTD_compress_usingCDict(cctx, dst, bound, src, frameSize, cdict);
+				else
+					outputSizes[i] = ZSTD_compressCCtx(cctx, dst, bound, src, frameSize, options.level);
+			}
+			ZSTD_freeCCtx(cctx);
+		}, 0, (int)count, 1);
+
+		for (u32 i = 0; success && i < count; ++i) {
+			if (ZSTD_isError(outputSizes[i]) || outputSizes[i] >= frameSize) {
+				index.push_back(pos | ZDI_PLAIN_FLAG);
+				success = fwrite(&input[(size_t)i * frameSize], frameSize, 1, f) == 1;
+				pos += frameSize;
+			} else {
+				index.push_back(pos);
+				success = fwrite(&output[i * bound], outputSizes[i], 1, f) == 1;
+				pos += outputSizes[i];
+			}
+		}
+	}
+	ZSTD_freeCDict(cdict);
+
+	index.push_back(pos);
+	hdr.index_offset = pos;
+	if (success)
+		success = fwrite(index.data(), sizeof(u64_le), index.size(), f) == index.size();
+	if (success)
+		success = fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	if (fclose(f) != 0)
+		success = false;
+
+	if (!success) {
+		*errorString = "Unable to write output file";
+		File::Delete(filename);
+		return false;
+	}
 	return true;
 }
 
 NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
-	: BlockDevice(fileLoader)
+	: FramedBlockDevice(fileLoader)
 {
 	std::lock_guard<std::mutex> guard(mutex_);
 	MAC_KEY mkey;
@@ -413,18 +919,22 @@ NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 
 	lbaStart = *(u32*)(np_header+0x54); // LBA start
 	lbaEnd   = *(u32*)(np_header+0x64); // LBA end
-	lbaSize  = (lbaEnd-lbaStart+1);     // LBA size of ISO
-	blockLBAs = *(u32*)(np_header+0x0c); // block size in LBA
-	blockSize = blockLBAs*2048;
-	numBlocks = (lbaSize+blockLBAs-1)/blockLBAs; // total blocks;
+	const u32 blockLBAs = *(u32*)(np_header+0x0c); // block size in LBA
+	if (blockLBAs == 0 || (blockLBAs & (blockLBAs - 1)) != 0 || lbaEnd < lbaStart) {
+		ERROR_LOG(LOADER, "Unsupported NPUMDIMG block size %d", blockLBAs);
+		return;
+	}
 
-	blockBuf = new u8[blockSize];
-	tempBuf  = new u8[blockSize];
+	numBlocks = lbaEnd - lbaStart + 1; // LBA size of ISO
+	frameSize = blockLBAs * 2048;
+	while ((1U << blockShift) < blockLBAs)
+		blockShift++;
+	numFrames = (numBlocks + blockLBAs - 1) / blockLBAs; // total blocks;
 
 	tableOffset = *(u32*)(np_header+0x6c); // table offset
 
-	tableSize = numBlocks*32;
-	table = new table_info[numBlocks];
+	tableSize = numFrames*32;
+	table = new table_info[numFrames];
 
 	readSize = fileLoader_->ReadAt(psarOffset + tableOffset, 1, tableSize, table);
 	if(readSize!=tableSize){
@@ -433,7 +943,7 @@ NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 
 	u32 *p = (u32*)table;
 	u32 i, k0, k1, k2, k3;
-	for(i=0; i<numBlocks; i++){
+	for(i=0; i<numFrames; i++){
 		k0 = p[0]^p[1];
 		k1 = p[1]^p[2];
 		k2 = p[0]^p[3];
@@ -445,79 +955,64 @@ NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 		p += 8;
 	}
 
-	currentBlock = -1;
+	// A frame is never stored larger than it is decompressed.
+	InitFrames(frameSize);
 }
 
 NPDRMDemoBlockDevice::~NPDRMDemoBlockDevice()
 {
-	std::lock_guard<std::mutex> guard(mutex_);
+	ShutdownFrames();
 	delete [] table;
-	delete [] tempBuf;
-	delete [] blockBuf;
 }
 
-int lzrc_decompress(void *out, int out_len, void *in, int in_len);
-
-bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
-{
-	FileLoader::Flags flags = uncached ? FileLoader::Flags::HINT_UNCACHED : FileLoader::Flags::NONE;
-	std::lock_guard<std::mutex> guard(mutex_);
-	CIPHER_KEY ckey;
-	int block, lba, lzsize;
-	size_t readSize;
-	u8 *readBuf;
-
-	lba = blockNumber-currentBlock;
-	if(lba>=0 && lba<blockLBAs){
-		memcpy(outPtr, blockBuf+lba*2048, 2048);
-		return true;
-	}
+FramedBlockDevice::FrameInfo NPDRMDemoBlockDevice::GetFrameInfo(u32 frame) const {
+	FrameInfo info;
+	info.pos = (u64)psarOffset + table[frame].offset;
+	info.size = std::min((u32)table[frame].size, frameSize);
+	// Always encrypted, even when not compressed.
+	info.plain = false;
+	return info;
+}
 
-	block = blockNumber/blockLBAs;
-	lba = blockNumber%blockLBAs;
-	currentBlock = block*blockLBAs;
+void *NPDRMDemoBlockDevice::CreateContext() {
+	// Decryption happens in place, and the source is shared.  The cipher's work buffer follows.
+	return new u8[frameSize + BB_WORK_BUFFER_SIZE];
+}
 
-	if(table[block].unk_1c!=0){
-		if((u32)block==(numBlocks-1))
-			return true; // demos make by fake_np
-		else
-			return false;
-	}
+void NPDRMDemoBlockDevice::DestroyContext(void *ctx) {
+	delete [] (u8 *)ctx;
+}
 
-	if(table[block].size<blockSize)
-		readBuf = tempBuf;
-	else
-		readBuf = blockBuf;
+int lzrc_decompress(void *out, int out_len, void *in, int in_len);
 
-	readSize = fileLoader_->ReadAt(psarOffset+table[block].offset, 1, table[block].size, readBuf, flags);
-	if(readSize != (size_t)table[block].size){
-		if((u32)block==(numBlocks-1))
-			return true;
-		else
-			return false;
+bool NPDRMDemoBlockDevice::DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) {
+	const table_info &entry = table[frame];
+	const bool lastFrame = frame == numFrames - 1;
+	if (entry.unk_1c != 0 || srcSize < (u32)entry.size) {
+		// Demos made by fake_np, or a short file.  Let these slide on the last block.
+		memset(dest, 0, frameSize);
+		return lastFrame;
 	}
 
-	if((table[block].flag&1)==0){
-		// skip mac check
-	}
+	// Stored frames can be decrypted right where they end up.
+	const bool compressed = srcSize < frameSize;
+	u8 *buf = compressed ? (u8 *)ctx : dest;
+	memcpy(buf, src, srcSize);
 
-	if((table[block].flag&4)==0){
-		sceDrmBBCipherInit(&ckey, 1, 2, hkey, vkey, table[block].offset>>4);
-		sceDrmBBCipherUpdate(&ckey, readBuf, table[block].size);
+	if ((entry.flag & 4) == 0) {
+		CIPHER_KEY ckey;
+		sceDrmBBCipherInit(&ckey, 1, 2, hkey, vkey, entry.offset >> 4);
+		sceDrmBBCipherUpdateWithBuffer(&ckey, buf, srcSize, (u8 *)ctx + frameSize);
 		sceDrmBBCipherFinal(&ckey);
 	}
 
-	if(table[block].size<blockSize){
-		lzsize = lzrc_decompress(blockBuf, 0x00100000, readBuf, table[block].size);
-		if(lzsize!=blockSize){
-			ERROR_LOG(LOADER, "LZRC decompress error! lzsize=%d\n", lzsize);
-			NotifyReadError();
+	if (compressed) {
+		int lzsize = lzrc_decompress(dest, (int)frameSize, buf, srcSize);
+		if (lzsize != (int)frameSize) {
+			ERROR_LOG(LOADER, "LZRC decompress error! lzsize=%d", lzsize);
 			return false;
 		}
 	}
-
-	memcpy(outPtr, blockBuf+lba*2048, 2048);
-
 	return true;
 }
 
@@ -19,16 +19,21 @@
 
 // Abstractions around read-only blockdevices, such as PSP UMD discs.
 // CISOFileBlockDevice implements compressed iso images, CISO format.
+// ZstdDiscBlockDevice implements seekable zstd compressed iso images, ZDI format.
 //
 // The ISOFileSystemReader reads from a BlockDevice, so it automatically works
 // with CISO images.
 
+#include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Core/ELF/PBPReader.h"
 
 class FileLoader;
+class Path;
 
 class BlockDevice {
 public:
@@ -50,6 +55,8 @@ class BlockDevice {
 		return (u64)GetNumBlocks() * (u64)GetBlockSize();
 	}
 	virtual bool IsDisc() const = 0;
+	// Hint that these blocks will likely be read soon.  May block, so call from a background thread.
+	virtual void Prefetch(u32 minBlock, u32 count) {}
 
 	void NotifyReadError();
 
@@ -58,28 +65,125 @@ class BlockDevice {
 	bool reportedError_ = false;
 };
 
-class CISOFileBlockDevice : public BlockDevice {
+// Base for images made of independently compressed frames with a fixed uncompressed size, like CSO or NPDRM.
+// Keeps a small cache of decompressed frames, and decompresses larger reads on several threads.
+class FramedBlockDevice : public BlockDevice {
 public:
-	CISOFileBlockDevice(FileLoader *fileLoader);
-	~CISOFileBlockDevice();
+	FramedBlockDevice(FileLoader *fileLoader) : BlockDevice(fileLoader) {}
+	~FramedBlockDevice();
 	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
 	u32 GetNumBlocks() const override { return numBlocks; }
 	bool IsDisc() const override { return true; }
+	void Prefetch(u32 minBlock, u32 count) override;
+
+protected:
+	struct FrameInfo {
+		u64 pos;
+		u32 size;
+		bool plain;
+	};
+
+	// Call once frameSize, numFrames, and numBlocks are known.  maxFrameRead is the largest size of one frame in the file.
+	void InitFrames(u32 maxFrameRead);
+	// Must be called by the subclass destructor, since it destroys contexts.
+	void ShutdownFrames();
+
+	virtual FrameInfo GetFrameInfo(u32 frame) const = 0;
+	// A context holds decompression state that can be reused between frames, but only by one thread at a time.
+	virtual void *CreateContext() = 0;
+	virtual void DestroyContext(void *ctx) = 0;
+	// Must produce exactly frameSize bytes.
+	virtual bool DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) = 0;
 
-private:
-	u32 *index = nullptr;
-	u8 *readBuffer = nullptr;
-	u8 *zlibBuffer = nullptr;
-	u32 zlibBufferFrame = 0;
-	u8 indexShift = 0;
 	u8 blockShift = 0;
 	u32 frameSize = 0;
 	u32 numBlocks = 0;
 	u32 numFrames = 0;
+
+private:
+	// One frame of a ReadBlocks() batch, possibly decompressed on another thread.
+	struct FrameJob {
+		u32 frame;
+		u32 readOffset;
+		u32 readSize;
+		bool plain;
+		bool failed;
+		// Where to decompress, either out or a cache slot when only part of the frame is wanted.
+		u8 *dest;
+		u8 *out;
+		u32 blockOffset;
+		u32 blocks;
+	};
+
+	// Buffers for one read, so reads on different threads don't wait on each other's file access.
+	struct ReadScratch {
+		u8 *readBuffer;
+		// Room for the partial frames at each end of a read, which then go into the cache.
+		u8 *frameBuffer;
+		std::vector<FrameJob> jobs;
+	};
+
+	void RunFrameJob(void *ctx, const u8 *readBuffer, FrameJob &job);
+	void *AcquireContext();
+	void ReleaseContext(void *ctx);
+	ReadScratch *AcquireScratch();
+	void ReleaseScratch(ReadScratch *scratch);
+
+	// These need lock_ held.
+	const u8 *FindCachedFrame(u32 frame);
+	void StoreCachedFrame(u32 frame, const u8 *data);
+
+	u32 readBufferSize = 0;
+	// Only guards the frame cache, reading and decompressing happen outside it.
+	std::mutex lock_;
+
+	// Least recently used cache of decompressed frames, mainly useful when frames are larger than a block.
+	u8 *frameCache_ = nullptr;
+	std::vector<u32> cacheFrames_;
+	std::vector<u64> cacheLastUse_;
+	u64 cacheUseCounter_ = 0;
+
+	std::vector<void *> freeContexts_;
+	std::vector<ReadScratch *> freeScratch_;
+	std::mutex contextLock_;
+};
+
+class CISOFileBlockDevice : public FramedBlockDevice {
+public:
+	CISOFileBlockDevice(FileLoader *fileLoader);
+	~CISOFileBlockDevice();
+
+protected:
+	FrameInfo GetFrameInfo(u32 frame) const override;
+	void *CreateContext() override;
+	void DestroyContext(void *ctx) override;
+	bool DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) override;
+
+private:
+	u32 *index = nullptr;
+	u8 indexShift = 0;
 	int ver_ = 0;
 };
 
+struct ZSTD_DDict_s;
+
+// Seekable zstd disc image, see WriteZstdDiscImage().
+class ZstdDiscBlockDevice : public FramedBlockDevice {
+public:
+	ZstdDiscBlockDevice(FileLoader *fileLoader);
+	~ZstdDiscBlockDevice();
+
+protected:
+	FrameInfo GetFrameInfo(u32 frame) const override;
+	void *CreateContext() override;
+	void DestroyContext(void *ctx) override;
+	bool DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) override;
+
+private:
+	std::vector<u64> index_;
+	ZSTD_DDict_s *dict_ = nullptr;
+};
 
 class FileBlockDevice : public BlockDevice {
 public:
@@ -89,6 +193,7 @@ class FileBlockDevice : public BlockDevice {
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
 	u32 GetNumBlocks() const override {return (u32)(filesize_ / GetBlockSize());}
 	bool IsDisc() const override { return true; }
+	void Prefetch(u32 minBlock, u32 count) override;
 	u64 GetUncompressedSize() const override {
 		return filesize_;
 	}
@@ -107,31 +212,29 @@ struct table_info {
 	int unk_1c;
 };
 
-class NPDRMDemoBlockDevice : public BlockDevice {
+// Each table entry is an encrypted frame, usually also LZRC compressed.
+class NPDRMDemoBlockDevice : public FramedBlockDevice {
 public:
 	NPDRMDemoBlockDevice(FileLoader *fileLoader);
 	~NPDRMDemoBlockDevice();
 
-	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
-	u32 GetNumBlocks() const override {return (u32)lbaSize;}
 	bool IsDisc() const override { return false; }
 
+protected:
+	FrameInfo GetFrameInfo(u32 frame) const override;
+	void *CreateContext() override;
+	void DestroyContext(void *ctx) override;
+	bool DecompressFrame(void *ctx, const u8 *src, u32 srcSize, u8 *dest, u32 frame) override;
+
 private:
+	// libkirk's header and MAC functions work in global buffers.  Frames use a buffer per context instead.
 	static std::mutex mutex_;
-	u32 lbaSize;
 
-	u32 psarOffset;
-	int blockSize;
-	int blockLBAs;
-	u32 numBlocks;
+	u32 psarOffset = 0;
 
 	u8 vkey[16];
 	u8 hkey[16];
-	struct table_info *table;
-
-	int currentBlock;
-	u8 *blockBuf;
-	u8 *tempBuf;
+	struct table_info *table = nullptr;
 };
 
 struct CHDImpl;
@@ -156,3 +259,14 @@ class CHDFileBlockDevice : public BlockDevice {
 };
 
 BlockDevice *constructBlockDevice(FileLoader *fileLoader);
+
+struct ZstdDiscImageOptions {
+	// Uncompressed bytes per frame, a power of two of at least one block.  Smaller is faster to seek.
+	u32 frameSize = 16 * 1024;
+	int level = 12;
+	// Size of a dictionary trained from the image, or 0 for none.  Helps small frames compress better.
+	u32 dictionarySize = 64 * 1024;
+};
+
+// Compresses any disc image that can be read as a block device into a seekable zstd disc image.
+bool WriteZstdDiscImage(BlockDevice *source, const Path &filename, const ZstdDiscImageOptions &options, std::string *errorString);
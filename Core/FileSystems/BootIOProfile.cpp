@@ -0,0 +1,172 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "Common/File/FileUtil.h"
+#include "Common/Log.h"
+#include "Common/Thread/ThreadUtil.h"
+#include "Common/TimeUtil.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/BootIOProfile.h"
+
+static const char *BOOT_PROFILE_HEADER = "# PPSSPP boot I/O profile v1";
+// How long after boot to record reads.
+static const double BOOT_PROFILE_SECONDS = 20.0;
+static const size_t BOOT_PROFILE_MAX_READS = 8192;
+// In blocks.  Reads closer than this are prefetched as one.
+static const u32 BOOT_PREFETCH_GAP = 32;
+// In blocks, so a change of pace doesn't wait on a large read.
+static const u32 BOOT_PREFETCH_CHUNK = 256;
+// 256 MB, anything beyond that wouldn't stay cached anyway.
+static const u32 BOOT_PREFETCH_MAX_BLOCKS = 128 * 1024;
+
+BootIOProfile::BootIOProfile(BlockDevice *blockDevice) : blockDevice_(blockDevice) {
+}
+
+BootIOProfile::~BootIOProfile() {
+	Shutdown();
+}
+
+void BootIOProfile::Start(const Path &filename) {
+	filename_ = filename;
+
+	std::vector<Read> reads;
+	if (Load(&reads) && !reads.empty()) {
+		INFO_LOG(FILESYS, "Prefetching %d reads from boot profile %s", (int)reads.size(), filename_.c_str());
+		thread_ = std::thread([this, reads] {
+			SetCurrentThreadName("BootPrefetch");
+			AndroidJNIThreadContext jniContext;
+			Prefetch(reads);
+		});
+	}
+
+	reads_.clear();
+	startTime_ = time_now_d();
+	recording_ = true;
+}
+
+void BootIOProfile::OnRead(u32 block, u32 count) {
+	if (!recording_ || count == 0)
+		return;
+
+	const double elapsed = time_now_d() - startTime_;
+	if (elapsed > BOOT_PROFILE_SECONDS || reads_.size() >= BOOT_PROFILE_MAX_READS) {
+		// This is on the emu thread in the middle of a read, so the file is written at shutdown instead.
+		recording_ = false;
+		return;
+	}
+
+	// Games often read files in many small pieces, no need to keep each.
+	if (!reads_.empty() && reads_.back().block + reads_.back().count == block) {
+		reads_.back().count += count;
+		return;
+	}
+	reads_.push_back(Read{ block, count, (u32)(elapsed * 1000.0) });
+}
+
+void BootIOProfile::Shutdown() {
+	Save();
+
+	cancel_ = true;
+	if (thread_.joinable())
+		thread_.join();
+}
+
+bool BootIOProfile::Load(std::vector<Read> *reads) {
+	FILE *f = File::OpenCFile(filename_, "rt");
+	if (!f)
+		return false;
+
+	char line[256];
+	bool valid = fgets(line, sizeof(line), f) && !strncmp(line, BOOT_PROFILE_HEADER, strlen(BOOT_PROFILE_HEADER));
+	u32 numBlocks = 0;
+	if (valid)
+		valid = fgets(line, sizeof(line), f) && sscanf(line, "blocks %u", &numBlocks) == 1;
+	// Probably a different dump or version of the game, ignore it.
+	if (valid && numBlocks != blockDevice_->GetNumBlocks()) {
+		WARN_LOG(FILESYS, "Ignoring boot profile %s, disc size differs", filename_.c_str());
+		valid = false;
+	}
+
+	while (valid && fgets(line, sizeof(line), f)) {
+		Read read;
+		if (sscanf(line, "%u %u %u", &read.block, &read.count, &read.ms) != 3)
+			continue;
+		if (read.block < numBlocks && read.count != 0)
+			reads->push_back(read);
+	}
+	fclose(f);
+	return valid;
+}
+
+void BootIOProfile::Save() {
+	recording_ = false;
+	if (reads_.empty() || filename_.empty())
+		return;
+
+	FILE *f = File::OpenCFile(filename_, "wt");
+	if (!f) {
+		WARN_LOG(FILESYS, "Unable to write boot profile %s", filename_.c_str());
+		reads_.clear();
+		return;
+	}
+
+	fprintf(f, "%s\n", BOOT_PROFILE_HEADER);
+	fprintf(f, "blocks %u\n", blockDevice_->GetNumBlocks());
+	for (const Read &read : reads_)
+		fprintf(f, "%u %u %u\n", read.block, read.count, read.ms);
+	fclose(f);
+
+	INFO_LOG(FILESYS, "Saved %d reads to boot profile %s", (int)reads_.size(), filename_.c_str());
+	reads_.clear();
+}
+
+void BootIOProfile::Prefetch(std::vector<Read> reads) {
+	// In disc order, and merged, so it's a few long reads rather than many seeks.
+	std::sort(reads.begin(), reads.end(), [](const Read &a, const Read &b) {
+		return a.block < b.block;
+	});
+
+	const u32 numBlocks = blockDevice_->GetNumBlocks();
+	std::vector<Read> ranges;
+	for (const Read &read : reads) {
+		const u32 end = std::min(read.block + read.count, numBlocks);
+		if (!ranges.empty() && read.block <= ranges.back().block + ranges.back().count + BOOT_PREFETCH_GAP) {
+			Read &last = ranges.back();
+			last.count = std::max(last.count, end - last.block);
+		} else {
+			ranges.push_back(Read{ read.block, end - read.block, 0 });
+		}
+	}
+
+	u32 total = 0;
+	double start = time_now_d();
+	for (const Read &range : ranges) {
+		for (u32 block = range.block; block < range.block + range.count; block += BOOT_PREFETCH_CHUNK) {
+			if (cancel_ || total >= BOOT_PREFETCH_MAX_BLOCKS)
+				return;
+			const u32 count = std::min(BOOT_PREFETCH_CHUNK, range.block + range.count - block);
+			blockDevice_->Prefetch(block, count);
+			total += count;
+		}
+	}
+
+	INFO_LOG(FILESYS, "Boot prefetch done, %d ranges, %d KB in %0.1f ms", (int)ranges.size(), total * 2, (time_now_d() - start) * 1000.0);
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File/Path.h"
+
+class BlockDevice;
+
+// Records which blocks a game reads in the first seconds after boot, and saves them to a file.
+// On the next boot, those blocks are prefetched up front in disc order, so the scattered reads
+// of EBOOT, modules, and initial assets mostly hit the file loader's cache.
+class BootIOProfile {
+public:
+	BootIOProfile(BlockDevice *blockDevice);
+	~BootIOProfile();
+
+	// Starts prefetching from the profile if it exists, and records this boot into it.
+	void Start(const Path &filename);
+	void OnRead(u32 block, u32 count);
+	// Saves what was recorded, and stops prefetching.  Must be called before the block device is deleted.
+	void Shutdown();
+
+private:
+	struct Read {
+		u32 block;
+		u32 count;
+		// Since the start of the boot.
+		u32 ms;
+	};
+
+	bool Load(std::vector<Read> *reads);
+	void Save();
+	void Prefetch(std::vector<Read> reads);
+
+	BlockDevice *blockDevice_;
+	Path filename_;
+	std::vector<Read> reads_;
+	double startTime_ = 0.0;
+	bool recording_ = false;
+
+	std::thread thread_;
+	std::atomic<bool> cancel_{};
+};
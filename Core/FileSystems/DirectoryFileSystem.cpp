@@ -25,6 +25,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
 #include <limits>
 
@@ -38,6 +39,8 @@
 #include "Common/File/DiskFree.h"
 #include "Common/File/VFS/VFS.h"
 #include "Common/SysError.h"
+#include "Common/TimeUtil.h"
+#include "Core/Config.h"
 #include "Core/FileSystems/DirectoryFileSystem.h"
 #include "Core/FileSystems/ISOFileSystem.h"
 #include "Core/HLE/sceKernel.h"
@@ -70,6 +73,29 @@
 #include <fcntl.h>
 #endif
 
+// Host metadata older than this is read again, in case something outside the game changed it.
+static const double HOST_CACHE_SECONDS = 2.0;
+static const size_t HOST_CACHE_MAX_STATS = 1024;
+static const size_t HOST_CACHE_MAX_LISTINGS = 64;
+static const size_t HOST_CACHE_MAX_HANDLES = 8;
+
+// Bumped on every write through any DirectoryFileSystem, which all caches check against.
+static std::atomic<u32> hostWriteGeneration;
+
+static void NotifyHostWrite() {
+	hostWriteGeneration++;
+	MemoryStick_NotifyWrite();
+}
+
+static bool UseHandleCache() {
+#ifdef _WIN32
+	// An open handle would block deleting or writing the file, even through another mount.
+	return false;
+#else
+	return g_Config.bMemStickHandleCache;
+#endif
+}
+
 DirectoryFileSystem::DirectoryFileSystem(IHandleAllocator *_hAlloc, const Path & _basePath, FileSystemFlags _flags) : basePath(_basePath), flags(_flags) {
 	File::CreateFullPath(basePath);
 	hAlloc = _hAlloc;
@@ -300,7 +326,7 @@ bool DirectoryFileHandle::Open(const Path &basePath, std::string &fileName, File
 		inGameDir_ = true;
 	}
 	if (access & (FILEACCESS_APPEND | FILEACCESS_CREATE | FILEACCESS_WRITE)) {
-		MemoryStick_NotifyWrite();
+		NotifyHostWrite();
 	}
 
 	return success;
@@ -358,7 +384,7 @@ size_t DirectoryFileHandle::Write(const u8* pointer, s64 size)
 		bytesWritten = ReplayApplyDiskWrite(pointer, (uint64_t)bytesWritten, (uint64_t)size, &diskFull, inGameDir_, CoreTiming::GetGlobalTimeUs());
 	}
 
-	MemoryStick_NotifyWrite();
+	NotifyHostWrite();
 
 	if (diskFull) {
 		ERROR_LOG(FILESYS, "Disk full");
@@ -416,6 +442,7 @@ size_t DirectoryFileHandle::Seek(s32 position, FileMove type)
 void DirectoryFileHandle::Close()
 {
 	if (needsTrunc_ != -1) {
+		NotifyHostWrite();
 #ifdef _WIN32
 		Seek((s32)needsTrunc_, FILEMOVE_BEGIN);
 		if (SetEndOfFile(hFile) == 0) {
@@ -443,6 +470,26 @@ void DirectoryFileSystem::CloseAll() {
 		iter->second.hFile.Close();
 	}
 	entries.clear();
+	ClearCache();
+}
+
+void DirectoryFileSystem::ValidateCache() {
+	const u32 generation = hostWriteGeneration;
+	const double now = time_now_d();
+	if (generation != cacheGeneration_ || now - cacheTime_ > HOST_CACHE_SECONDS) {
+		ClearCache();
+		cacheGeneration_ = generation;
+		cacheTime_ = now;
+	}
+}
+
+void DirectoryFileSystem::ClearCache() {
+	statCache_.clear();
+	listingCache_.clear();
+	fixedCase_.clear();
+	for (auto &entry : closedHandles_)
+		entry.hFile.Close();
+	closedHandles_.clear();
 }
 
 bool DirectoryFileSystem::MkDir(const std::string &dirname) {
@@ -459,7 +506,7 @@ bool DirectoryFileSystem::MkDir(const std::string &dirname) {
 #else
 	result = File::CreateFullPath(GetLocalPath(dirname));
 #endif
-	MemoryStick_NotifyWrite();
+	NotifyHostWrite();
 	return ReplayApplyDisk(ReplayAction::MKDIR, result, CoreTiming::GetGlobalTimeUs()) != 0;
 }
 
@@ -469,7 +516,7 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 #if HOST_IS_CASE_SENSITIVE
 	// Maybe we're lucky?
 	if (File::DeleteDirRecursively(fullName)) {
-		MemoryStick_NotifyWrite();
+		NotifyHostWrite();
 		return (bool)ReplayApplyDisk(ReplayAction::RMDIR, true, CoreTiming::GetGlobalTimeUs());
 	}
 
@@ -482,7 +529,7 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 #endif
 
 	bool result = File::DeleteDirRecursively(fullName);
-	MemoryStick_NotifyWrite();
+	NotifyHostWrite();
 	return ReplayApplyDisk(ReplayAction::RMDIR, result, CoreTiming::GetGlobalTimeUs()) != 0;
 }
 
@@ -530,7 +577,7 @@ int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &
 
 	// TODO: Better error codes.
 	int result = retValue ? 0 : (int)SCE_KERNEL_ERROR_ERRNO_FILE_ALREADY_EXISTS;
-	MemoryStick_NotifyWrite();
+	NotifyHostWrite();
 	return ReplayApplyDisk(ReplayAction::FILE_RENAME, result, CoreTiming::GetGlobalTimeUs());
 }
 
@@ -552,15 +599,45 @@ bool DirectoryFileSystem::RemoveFile(const std::string &filename) {
 	}
 #endif
 
-	MemoryStick_NotifyWrite();
+	NotifyHostWrite();
 	return ReplayApplyDisk(ReplayAction::FILE_REMOVE, retValue, CoreTiming::GetGlobalTimeUs()) != 0;
 }
 
 int DirectoryFileSystem::OpenFile(std::string filename, FileAccess access, const char *devicename) {
+	ValidateCache();
+	const FileAccess pspAccess = (FileAccess)(access & FILEACCESS_PSP_FLAGS);
+
+	// Creating doesn't fix the case, so don't use the cached case either.
+	std::string requestedFilename = filename;
+	auto fixed = fixedCase_.find(filename);
+	if (fixed != fixedCase_.end() && !(pspAccess & FILEACCESS_CREATE))
+		filename = fixed->second;
+
 	OpenFileEntry entry;
 	entry.hFile.fileSystemFlags_ = flags;
 	u32 err = 0;
-	bool success = entry.hFile.Open(basePath, filename, (FileAccess)(access & FILEACCESS_PSP_FLAGS), err);
+	bool success = false;
+	auto cached = std::find_if(closedHandles_.begin(), closedHandles_.end(), [&](const OpenFileEntry &closed) {
+		return closed.guestFilename == filename && closed.access == pspAccess;
+	});
+	if (cached != closedHandles_.end()) {
+		entry = *cached;
+		closedHandles_.erase(cached);
+		// The game didn't ask for this seek, so keep it out of replays.
+		entry.hFile.replay_ = false;
+		success = entry.hFile.Seek(0, FILEMOVE_BEGIN) == 0;
+		entry.hFile.replay_ = true;
+		if (!success) {
+			entry.hFile.Close();
+			entry = OpenFileEntry();
+			entry.hFile.fileSystemFlags_ = flags;
+		}
+	}
+	if (!success) {
+		success = entry.hFile.Open(basePath, filename, pspAccess, err);
+		if (success && filename != requestedFilename && fixedCase_.size() < HOST_CACHE_MAX_STATS)
+			fixedCase_[requestedFilename] = filename;
+	}
 	if (err == 0 && !success) {
 		err = SCE_KERNEL_ERROR_ERRNO_FILE_NOT_FOUND;
 	}
@@ -590,7 +667,7 @@ int DirectoryFileSystem::OpenFile(std::string filename, FileAccess access, const
 		u32 newHandle = hAlloc->GetNewHandle();
 
 		entry.guestFilename = filename;
-		entry.access = (FileAccess)(access & FILEACCESS_PSP_FLAGS);
+		entry.access = pspAccess;
 
 		entries[newHandle] = entry;
 
@@ -602,7 +679,16 @@ void DirectoryFileSystem::CloseFile(u32 handle) {
 	EntryMap::iterator iter = entries.find(handle);
 	if (iter != entries.end()) {
 		hAlloc->FreeHandle(handle);
-		iter->second.hFile.Close();
+		ValidateCache();
+		if (UseHandleCache() && iter->second.access == FILEACCESS_READ) {
+			if (closedHandles_.size() >= HOST_CACHE_MAX_HANDLES) {
+				closedHandles_.front().hFile.Close();
+				closedHandles_.erase(closedHandles_.begin());
+			}
+			closedHandles_.push_back(iter->second);
+		} else {
+			iter->second.hFile.Close();
+		}
 		entries.erase(iter);
 	} else {
 		//This shouldn't happen...
@@ -674,6 +760,19 @@ size_t DirectoryFileSystem::SeekFile(u32 handle, s32 position, FileMove type) {
 }
 
 PSPFileInfo DirectoryFileSystem::GetFileInfo(std::string filename) {
+	ValidateCache();
+	auto cached = statCache_.find(filename);
+	if (cached != statCache_.end())
+		return ReplayApplyDiskFileInfo(cached->second, CoreTiming::GetGlobalTimeUs());
+
+	PSPFileInfo x = GetHostFileInfo(filename);
+	if (statCache_.size() >= HOST_CACHE_MAX_STATS)
+		statCache_.clear();
+	statCache_[filename] = x;
+	return ReplayApplyDiskFileInfo(x, CoreTiming::GetGlobalTimeUs());
+}
+
+PSPFileInfo DirectoryFileSystem::GetHostFileInfo(std::string filename) {
 	PSPFileInfo x;
 	x.name = filename;
 
@@ -682,13 +781,13 @@ PSPFileInfo DirectoryFileSystem::GetFileInfo(std::string filename) {
 	if (!File::GetFileInfo(fullName, &info)) {
 #if HOST_IS_CASE_SENSITIVE
 		if (! FixPathCase(basePath, filename, FPC_FILE_MUST_EXIST))
-			return ReplayApplyDiskFileInfo(x, CoreTiming::GetGlobalTimeUs());
+			return x;
 		fullName = GetLocalPath(filename);
 
 		if (!File::GetFileInfo(fullName, &info))
-			return ReplayApplyDiskFileInfo(x, CoreTiming::GetGlobalTimeUs());
+			return x;
 #else
-		return ReplayApplyDiskFileInfo(x, CoreTiming::GetGlobalTimeUs());
+		return x;
 #endif
 	}
 
@@ -707,7 +806,7 @@ PSPFileInfo DirectoryFileSystem::GetFileInfo(std::string filename) {
 		localtime_r((time_t*)&mtime, &x.mtime);
 	}
 
-	return ReplayApplyDiskFileInfo(x, CoreTiming::GetGlobalTimeUs());
+	return x;
 }
 
 #ifdef _WIN32
@@ -798,22 +897,31 @@ bool DirectoryFileSystem::ComputeRecursiveDirSizeIfFast(const std::string &path,
 std::vector<PSPFileInfo> DirectoryFileSystem::GetDirListing(const std::string &path, bool *exists) {
 	std::vector<PSPFileInfo> myVector;
 
-	std::vector<File::FileInfo> files;
-	Path localPath = GetLocalPath(path);
-	const int flags = File::GETFILES_GETHIDDEN | File::GETFILES_GET_NAVIGATION_ENTRIES;
-	bool success = File::GetFilesInDir(localPath, &files, nullptr, flags);
+	ValidateCache();
+	auto cached = listingCache_.find(path);
+	if (cached == listingCache_.end()) {
+		CachedListing listing;
+		Path localPath = GetLocalPath(path);
+		const int flags = File::GETFILES_GETHIDDEN | File::GETFILES_GET_NAVIGATION_ENTRIES;
+		listing.success = File::GetFilesInDir(localPath, &listing.files, nullptr, flags);
 #if HOST_IS_CASE_SENSITIVE
-	if (!success) {
-		// TODO: Case sensitivity should be checked on a file system basis, right?
-		std::string fixedPath = path;
-		if (FixPathCase(basePath, fixedPath, FPC_FILE_MUST_EXIST)) {
-			// May have failed due to case sensitivity, try again
-			localPath = GetLocalPath(fixedPath);
-			success = File::GetFilesInDir(localPath, &files, nullptr, flags);
+		if (!listing.success) {
+			// TODO: Case sensitivity should be checked on a file system basis, right?
+			std::string fixedPath = path;
+			if (FixPathCase(basePath, fixedPath, FPC_FILE_MUST_EXIST)) {
+				// May have failed due to case sensitivity, try again
+				localPath = GetLocalPath(fixedPath);
+				listing.success = File::GetFilesInDir(localPath, &listing.files, nullptr, flags);
+			}
 		}
-	}
 #endif
-	if (!success) {
+		if (listingCache_.size() >= HOST_CACHE_MAX_LISTINGS)
+			listingCache_.clear();
+		cached = listingCache_.emplace(path, std::move(listing)).first;
+	}
+
+	const std::vector<File::FileInfo> &files = cached->second.files;
+	if (!cached->second.success) {
 		if (exists)
 			*exists = false;
 		return ReplayApplyDiskListing(myVector, CoreTiming::GetGlobalTimeUs());
@@ -822,7 +930,7 @@ std::vector<PSPFileInfo> DirectoryFileSystem::GetDirListing(const std::string &p
 	bool hideISOFiles = PSP_CoreParameter().compat.flags().HideISOFiles;
 
 	// Then apply transforms to match PSP idiosynchrasies, as we convert the entries.
-	for (auto &file : files) {
+	for (const auto &file : files) {
 		PSPFileInfo entry;
 		if (Flags() & FileSystemFlags::SIMULATE_FAT32) {
 			entry.name = SimulateVFATBug(file.name);
@@ -830,7 +938,7 @@ std::vector<PSPFileInfo> DirectoryFileSystem::GetDirListing(const std::string &p
 			entry.name = file.name;
 		}
 		if (hideISOFiles) {
-			if (endsWithNoCase(entry.name, ".cso") || endsWithNoCase(entry.name, ".iso") || endsWithNoCase(entry.name, ".chd")) {  // chd not really necessary, but let's hide them too.
+			if (endsWithNoCase(entry.name, ".cso") || endsWithNoCase(entry.name, ".iso") || endsWithNoCase(entry.name, ".chd") || endsWithNoCase(entry.name, ".zdi")) {  // chd not really necessary, but let's hide them too.
 				// Workaround for DJ Max Portable, see compat.ini.
 				continue;
 			} else if (file.isDirectory) {
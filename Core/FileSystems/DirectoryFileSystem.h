@@ -20,7 +20,10 @@
 // TODO: Remove the Windows-specific code, FILE is fine there too.
 
 #include <map>
+#include <unordered_map>
+#include <vector>
 
+#include "Common/File/DirListing.h"
 #include "Common/File/Path.h"
 #include "Core/FileSystems/FileSystem.h"
 
@@ -94,13 +97,33 @@ class DirectoryFileSystem : public IFileSystem {
 		FileAccess access = FILEACCESS_NONE;
 	};
 
+	struct CachedListing {
+		std::vector<File::FileInfo> files;
+		bool success;
+	};
+
 	typedef std::map<u32, OpenFileEntry> EntryMap;
 	EntryMap entries;
 	Path basePath;
 	IHandleAllocator *hAlloc;
 	FileSystemFlags flags;
 
+	// Games hammer savedata with tiny stats, listings, and opens, so host results are kept
+	// until anything writes through any DirectoryFileSystem (mounts can overlap), or they get old.
+	// Replay is still applied on top, as if each one went to disk.
+	std::unordered_map<std::string, PSPFileInfo> statCache_;
+	std::unordered_map<std::string, CachedListing> listingCache_;
+	// Guest path to the host case that opened it.
+	std::unordered_map<std::string, std::string> fixedCase_;
+	// Host files the game closed after reading, to reopen quickly.
+	std::vector<OpenFileEntry> closedHandles_;
+	u32 cacheGeneration_ = 0;
+	double cacheTime_ = 0.0;
+
 	Path GetLocalPath(std::string internalPath) const;
+	PSPFileInfo GetHostFileInfo(std::string filename);
+	void ValidateCache();
+	void ClearCache();
 };
 
 // VFSFileSystem: Ability to map in Android APK paths as well! Does not support all features, only meant for fonts.
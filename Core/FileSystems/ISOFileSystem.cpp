@@ -23,6 +23,7 @@
 #include "Common/CommonTypes.h"
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
+#include "Common/TimeUtil.h"
 #include "Core/FileSystems/ISOFileSystem.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/MemMap.h"
@@ -143,6 +144,7 @@ struct VolDescriptor {
 ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevice) {
 	blockDevice = _blockDevice;
 	hAlloc = _hAlloc;
+	readAhead_.reset(new ReadAheadPredictor(blockDevice));
 
 	VolDescriptor desc;
 	if (!blockDevice->ReadBlock(16, (u8*)&desc))
@@ -173,10 +175,22 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 }
 
 ISOFileSystem::~ISOFileSystem() {
+	if (lookups_ != 0) {
+		INFO_LOG(FILESYS, "ISO path lookups: %d (%d indexed, %d known missing), %0.2f us average", lookups_, lookupsIndexed_, lookupsMissing_, lookupTime_ * 1000000.0 / lookups_);
+	}
+
+	// These have to stop using the block device first.
+	readAhead_.reset();
+	bootProfile_.reset();
 	delete blockDevice;
 	delete treeroot;
 }
 
+void ISOFileSystem::StartBootIOProfile(const Path &filename) {
+	bootProfile_.reset(new BootIOProfile(blockDevice));
+	bootProfile_->Start(filename);
+}
+
 std::string ISOFileSystem::TreeEntry::BuildPath() {
 	if (parent) {
 		return parent->BuildPath() + "/" + name;
@@ -186,6 +200,10 @@ std::string ISOFileSystem::TreeEntry::BuildPath() {
 }
 
 void ISOFileSystem::ReadDirectory(TreeEntry *root) {
+	std::string indexPrefix = root->BuildPath();
+	if (!indexPrefix.empty())
+		indexPrefix = indexPrefix.substr(1) + "/";
+
 	for (u32 secnum = root->startsector, endsector = root->startsector + (root->dirsize + 2047) / 2048; secnum < endsector; ++secnum) {
 		u8 theSector[2048];
 		if (!blockDevice->ReadBlock(secnum, theSector)) {
@@ -195,6 +213,8 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 			return;
 		}
 		lastReadBlock_ = secnum;  // Hm, this could affect timing... but lazy loading is probably more realistic.
+		if (bootProfile_)
+			bootProfile_->OnRead(secnum, 1);
 
 		for (int offset = 0; offset < 2048; ) {
 			DirectoryEntry &dir = *(DirectoryEntry *)&theSector[offset];
@@ -251,6 +271,8 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 				}
 			}
 			root->children.push_back(entry);
+			// Only the first of any duplicates, like the search used to.
+			pathIndex_.emplace(indexPrefix + entry->name, entry);
 		}
 	}
 	root->valid = true;
@@ -277,6 +299,37 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bo
 	if (pathLength <= pathIndex)
 		return treeroot;
 
+	double start = time_now_d();
+	lookups_++;
+
+	std::string key = path.substr(pathIndex);
+	if (key.back() == '/')
+		key.pop_back();
+
+	TreeEntry *entry = nullptr;
+	auto indexed = pathIndex_.find(key);
+	if (indexed != pathIndex_.end()) {
+		lookupsIndexed_++;
+		entry = indexed->second;
+		if (!entry->valid)
+			ReadDirectory(entry);
+	} else if (missingPaths_.count(key)) {
+		lookupsMissing_++;
+		if (catchError)
+			ERROR_LOG(FILESYS, "File '%s' not found", path.c_str());
+	} else {
+		// Reads any directories on the way, which then adds their entries to the index.
+		entry = WalkPath(path, pathIndex, catchError);
+		if (!entry && missingPaths_.size() < 4096)
+			missingPaths_.insert(key);
+	}
+
+	lookupTime_ += time_now_d() - start;
+	return entry;
+}
+
+ISOFileSystem::TreeEntry *ISOFileSystem::WalkPath(const std::string &path, size_t pathIndex, bool catchError) {
+	const size_t pathLength = path.length();
 	TreeEntry *entry = treeroot;
 	while (true) {
 		if (!entry->valid) {
@@ -381,6 +434,7 @@ void ISOFileSystem::CloseFile(u32 handle) {
 		//CloseHandle((*iter).second.hFile);
 		hAlloc->FreeHandle(handle);
 		entries.erase(iter);
+		readAhead_->OnClose(handle);
 	} else {
 		//This shouldn't happen...
 		ERROR_LOG(FILESYS, "Hey, what are you doing? Closing non-open files?");
@@ -486,6 +540,9 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
 		if (e.isBlockSectorMode) {
 			// Whole sectors! Shortcut to this simple code.
 			blockDevice->ReadBlocks(e.seekPos, (int)size, pointer);
+			readAhead_->OnRead(handle, 0, blockDevice->GetNumBlocks(), e.seekPos, (u32)size);
+			if (bootProfile_)
+				bootProfile_->OnRead(e.seekPos, (u32)size);
 			if (abs((int)lastReadBlock_ - (int)e.seekPos) > 100) {
 				// This is an estimate, sometimes it takes 1+ seconds, but it definitely takes time.
 				usec = 100000;
@@ -556,6 +613,13 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
 		}
 
 		size_t totalBytes = pointer - start;
+		if (totalBytes != 0) {
+			const u32 fileStart = (u32)((positionOnIso - e.seekPos) / 2048);
+			const u32 firstSector = (u32)(positionOnIso / 2048);
+			readAhead_->OnRead(handle, fileStart, (u32)((fileSize + 2047) / 2048), firstSector, secNum - firstSector);
+			if (bootProfile_)
+				bootProfile_->OnRead(firstSector, secNum - firstSector);
+		}
 		if (abs((int)lastReadBlock_ - (int)secNum) > 100) {
 			// This is an estimate, sometimes it takes 1+ seconds, but it definitely takes time.
 			usec = 100000;
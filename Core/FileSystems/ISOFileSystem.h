@@ -20,10 +20,14 @@
 #include <map>
 #include <list>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "FileSystem.h"
 
 #include "BlockDevices.h"
+#include "BootIOProfile.h"
+#include "ReadAheadPredictor.h"
 
 bool parseLBN(const std::string &filename, u32 *sectorStart, u32 *readSize);
 
@@ -56,6 +60,9 @@ class ISOFileSystem : public IFileSystem {
 
 	bool ComputeRecursiveDirSizeIfFast(const std::string &path, int64_t *size) override { return false; }
 
+	// Prefetches what was read during the last boot, and records this boot's reads to the same file.
+	void StartBootIOProfile(const Path &filename);
+
 private:
 	struct TreeEntry {
 		~TreeEntry();
@@ -93,10 +100,22 @@ class ISOFileSystem : public IFileSystem {
 	TreeEntry *treeroot;
 	BlockDevice *blockDevice;
 	u32 lastReadBlock_;
+	std::unique_ptr<ReadAheadPredictor> readAhead_;
+	std::unique_ptr<BootIOProfile> bootProfile_;
 
 	TreeEntry entireISO;
 
+	// Entries of every directory read so far, by path without the leading slash.
+	std::unordered_map<std::string, TreeEntry *> pathIndex_;
+	// Paths already known not to exist.  Some games check for the same missing files over and over.
+	std::unordered_set<std::string> missingPaths_;
+	u32 lookups_ = 0;
+	u32 lookupsIndexed_ = 0;
+	u32 lookupsMissing_ = 0;
+	double lookupTime_ = 0.0;
+
 	void ReadDirectory(TreeEntry *root);
+	TreeEntry *WalkPath(const std::string &path, size_t pathIndex, bool catchError);
 	TreeEntry *GetFromPath(const std::string &path, bool catchError = true);
 	std::string EntryFullPath(TreeEntry *e);
 };
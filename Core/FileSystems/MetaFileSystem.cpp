@@ -178,6 +178,40 @@ IFileSystem *MetaFileSystem::GetHandleOwner(u32 handle)
 	return nullptr;
 }
 
+int MetaFileSystem::GetHandleDevice(u32 handle)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	IFileSystem *sys = GetHandleOwner(handle);
+	return sys ? DeviceIndex(sys) : 0;
+}
+
+int MetaFileSystem::DeviceIndex(IFileSystem *sys)
+{
+	FileSystemFlags flags = sys->Flags();
+	if (flags & FileSystemFlags::UMD)
+		return 1;
+	if (flags & FileSystemFlags::CARD)
+		return 2;
+	if (flags & FileSystemFlags::FLASH)
+		return 3;
+	return 0;
+}
+
+std::shared_ptr<IFileSystem> MetaFileSystem::LockHandleOwner(u32 handle, std::unique_lock<std::recursive_mutex> &deviceGuard)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	for (size_t i = 0; i < fileSystems.size(); i++)
+	{
+		if (fileSystems[i].system->OwnsHandle(handle))
+		{
+			deviceGuard = std::unique_lock<std::recursive_mutex>(DeviceLock(fileSystems[i].system.get()));
+			// Keep a reference, in case the UMD is swapped meanwhile.
+			return fileSystems[i].system;
+		}
+	}
+	return nullptr;
+}
+
 int MetaFileSystem::MapFilePath(const std::string &_inpath, std::string &outpath, MountPoint **system)
 {
 	int error = SCE_KERNEL_ERROR_ERRNO_FILE_NOT_FOUND;
@@ -345,10 +379,12 @@ int MetaFileSystem::OpenFile(std::string filename, FileAccess access, const char
 	std::string of;
 	MountPoint *mount;
 	int error = MapFilePath(filename, of, &mount);
-	if (error == 0)
+	if (error == 0) {
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(mount->system.get()));
 		return mount->system->OpenFile(of, access, mount->prefix.c_str());
-	else
+	} else {
 		return error;
+	}
 }
 
 PSPFileInfo MetaFileSystem::GetFileInfo(std::string filename)
@@ -359,6 +395,7 @@ PSPFileInfo MetaFileSystem::GetFileInfo(std::string filename)
 	int error = MapFilePath(filename, of, &system);
 	if (error == 0)
 	{
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		return system->GetFileInfo(of);
 	}
 	else
@@ -374,6 +411,7 @@ std::vector<PSPFileInfo> MetaFileSystem::GetDirListing(const std::string &path,
 	IFileSystem *system;
 	int error = MapFilePath(path, of, &system);
 	if (error == 0) {
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		return system->GetDirListing(of, exists);
 	} else {
 		std::vector<PSPFileInfo> empty;
@@ -433,6 +471,7 @@ bool MetaFileSystem::MkDir(const std::string &dirname)
 	int error = MapFilePath(dirname, of, &system);
 	if (error == 0)
 	{
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		return system->MkDir(of);
 	}
 	else
@@ -449,6 +488,7 @@ bool MetaFileSystem::RmDir(const std::string &dirname)
 	int error = MapFilePath(dirname, of, &system);
 	if (error == 0)
 	{
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		return system->RmDir(of);
 	}
 	else
@@ -483,6 +523,7 @@ int MetaFileSystem::RenameFile(const std::string &from, const std::string &to)
 		if (osystem != rsystem)
 			return SCE_KERNEL_ERROR_XDEV;
 
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(osystem));
 		return osystem->RenameFile(of, rf);
 	}
 	else
@@ -498,6 +539,7 @@ bool MetaFileSystem::RemoveFile(const std::string &filename)
 	IFileSystem *system;
 	int error = MapFilePath(filename, of, &system);
 	if (error == 0) {
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		return system->RemoveFile(of);
 	} else {
 		return false;
@@ -507,7 +549,8 @@ bool MetaFileSystem::RemoveFile(const std::string &filename)
 int MetaFileSystem::Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 outdataPtr, u32 outlen, int &usec)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->Ioctl(handle, cmd, indataPtr, inlen, outdataPtr, outlen, usec);
 	return SCE_KERNEL_ERROR_ERROR;
@@ -516,7 +559,8 @@ int MetaFileSystem::Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 out
 PSPDevType MetaFileSystem::DevType(u32 handle)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->DevType(handle);
 	return PSPDevType::INVALID;
@@ -525,15 +569,16 @@ PSPDevType MetaFileSystem::DevType(u32 handle)
 void MetaFileSystem::CloseFile(u32 handle)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		sys->CloseFile(handle);
 }
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->ReadFile(handle, pointer, size);
 	else
@@ -543,7 +588,8 @@ size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->WriteFile(handle, pointer, size);
 	else
@@ -552,8 +598,8 @@ size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->ReadFile(handle, pointer, size, usec);
 	else
@@ -563,7 +609,8 @@ size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->WriteFile(handle, pointer, size, usec);
 	else
@@ -573,7 +620,8 @@ size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &u
 size_t MetaFileSystem::SeekFile(u32 handle, s32 position, FileMove type)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
+	std::unique_lock<std::recursive_mutex> deviceGuard;
+	std::shared_ptr<IFileSystem> sys = LockHandleOwner(handle, deviceGuard);
 	if (sys)
 		return sys->SeekFile(handle, position, type);
 	else
@@ -609,8 +657,10 @@ u64 MetaFileSystem::FreeSpace(const std::string &path)
 	std::string of;
 	IFileSystem *system;
 	int error = MapFilePath(path, of, &system);
-	if (error == 0)
+	if (error == 0) {
+		std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		return system->FreeSpace(of);
+	}
 	else
 		return 0;
 }
@@ -644,6 +694,7 @@ void MetaFileSystem::DoState(PointerWrap &p)
 
 	for (u32 i = 0; i < n; ++i) {
 		if (!skipPfat0 || fileSystems[i].prefix != "pfat0:") {
+			std::lock_guard<std::recursive_mutex> deviceGuard(DeviceLock(fileSystems[i].system.get()));
 			fileSystems[i].system->DoState(p);
 		}
 	}
@@ -671,11 +722,13 @@ int64_t MetaFileSystem::ComputeRecursiveDirectorySize(const std::string &filenam
 	int error = MapFilePath(filename, of, &system);
 	if (error == 0) {
 		int64_t size;
+		std::unique_lock<std::recursive_mutex> deviceGuard(DeviceLock(system));
 		if (system->ComputeRecursiveDirSizeIfFast(of, &size)) {
 			// Some file systems can optimize this.
 			return size;
 		} else {
 			// Those that can't, we just run a generic implementation.
+			deviceGuard.unlock();
 			return RecursiveSize(filename);
 		}
 	} else {
@@ -44,6 +44,10 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 
 	std::string startingDirectory;
 	std::recursive_mutex lock;  // must be recursive
+	// Calls into a mounted file system also hold the lock of its device, see DeviceIndex().
+	// Reads let go of the main lock, so the UMD and memory stick don't wait on each other.
+	// Everything else keeps it, since for example writes may check the free space.
+	std::recursive_mutex deviceLocks[4];
 
 	void Reset() {
 		// This used to be 6, probably an attempt to replicate PSP handles.
@@ -68,6 +72,8 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 	IFileSystem *GetSystem(const std::string &prefix);
 	IFileSystem *GetSystemFromFilename(const std::string &filename);
 	IFileSystem *GetHandleOwner(u32 handle);
+	// Operations on handles with the same device are serialized, others may run in parallel.
+	int GetHandleDevice(u32 handle);
 	FileSystemFlags FlagsFromFilename(const std::string &filename) {
 		IFileSystem *sys = GetSystemFromFilename(filename);
 		return sys ? sys->Flags() : FileSystemFlags::NONE;
@@ -151,4 +157,11 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 
 private:
 	int64_t RecursiveSize(const std::string &dirPath);
+
+	static int DeviceIndex(IFileSystem *sys);
+	std::recursive_mutex &DeviceLock(IFileSystem *sys) {
+		return deviceLocks[DeviceIndex(sys)];
+	}
+	// Locks the device of the handle's owner and returns it.  Only the device stays locked after.
+	std::shared_ptr<IFileSystem> LockHandleOwner(u32 handle, std::unique_lock<std::recursive_mutex> &deviceGuard);
 };
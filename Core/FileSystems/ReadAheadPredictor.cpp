@@ -0,0 +1,160 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+
+#include "Common/Log.h"
+#include "Common/Thread/ThreadUtil.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/ReadAheadPredictor.h"
+
+// All in blocks.  Sequential reads double the window each time, up to the max.
+static const u32 READAHEAD_INITIAL_WINDOW = 64;
+static const u32 READAHEAD_MAX_WINDOW = 2048;
+// Files up to this size are prefetched entirely once the game starts reading them from the start.
+static const u32 READAHEAD_SMALL_FILE = 1024;
+// How much of the next file to prefetch, once the current one is done.
+static const u32 READAHEAD_SUCCESSOR = 64;
+// Prefetch in pieces, so newer requests and shutdown don't wait on a whole file.
+static const u32 READAHEAD_CHUNK = 256;
+// Older requests are dropped past this, the game has probably moved on.
+static const size_t READAHEAD_MAX_QUEUED = 32;
+
+ReadAheadPredictor::ReadAheadPredictor(BlockDevice *blockDevice) : blockDevice_(blockDevice) {
+}
+
+ReadAheadPredictor::~ReadAheadPredictor() {
+	Shutdown();
+}
+
+void ReadAheadPredictor::OnRead(u32 handle, u32 fileStart, u32 fileBlocks, u32 block, u32 count) {
+	const u32 fileEnd = fileStart + fileBlocks;
+	const u32 readEnd = block + count;
+
+	auto it = files_.find(handle);
+	if (it == files_.end() || it->second.start != fileStart) {
+		// Learn which file tends to be read after which.  Whole disc access (umd0:) doesn't count.
+		if (fileStart != 0) {
+			if (lastFileStart_ != 0xFFFFFFFF && lastFileStart_ != fileStart)
+				successors_[lastFileStart_] = fileStart;
+			lastFileStart_ = fileStart;
+		}
+
+		FileState state{};
+		state.start = fileStart;
+		state.blocks = fileBlocks;
+		state.nextBlock = fileStart;
+		state.prefetchedEnd = fileStart;
+		it = files_.insert_or_assign(handle, state).first;
+	}
+
+	FileState &state = it->second;
+	// Small reads may continue in the same block the last one ended in.
+	if (block <= state.nextBlock && block + 1 >= state.nextBlock) {
+		state.sequentialReads++;
+	} else {
+		state.sequentialReads = 0;
+		state.prefetchedEnd = readEnd;
+	}
+	state.nextBlock = readEnd;
+	state.prefetchedEnd = std::max(state.prefetchedEnd, readEnd);
+
+	if (state.sequentialReads > 0) {
+		u32 target;
+		if (fileBlocks <= READAHEAD_SMALL_FILE) {
+			target = fileEnd;
+		} else {
+			const int shift = std::min(state.sequentialReads - 1, 5);
+			target = readEnd + std::min(READAHEAD_INITIAL_WINDOW << shift, READAHEAD_MAX_WINDOW);
+		}
+		target = std::min(target, fileEnd);
+
+		if (target > state.prefetchedEnd) {
+			Queue(state.prefetchedEnd, target - state.prefetchedEnd);
+			state.prefetchedEnd = target;
+		}
+	}
+
+	if (!state.prefetchedSuccessor && state.prefetchedEnd >= fileEnd) {
+		auto next = successors_.find(fileStart);
+		if (next != successors_.end()) {
+			const u32 numBlocks = blockDevice_->GetNumBlocks();
+			if (next->second < numBlocks)
+				Queue(next->second, std::min(READAHEAD_SUCCESSOR, numBlocks - next->second));
+		}
+		state.prefetchedSuccessor = true;
+	}
+}
+
+void ReadAheadPredictor::OnClose(u32 handle) {
+	files_.erase(handle);
+}
+
+void ReadAheadPredictor::Queue(u32 block, u32 count) {
+	std::lock_guard<std::mutex> guard(queueLock_);
+	if (!running_)
+		return;
+
+	if (queue_.size() >= READAHEAD_MAX_QUEUED)
+		queue_.pop_front();
+	queue_.push_back(Range{ block, count });
+
+	// Only start the thread once there's something to do, most uses of an ISO never need it.
+	if (!thread_.joinable())
+		thread_ = std::thread([this] { Run(); });
+	queueCond_.notify_one();
+}
+
+void ReadAheadPredictor::Run() {
+	SetCurrentThreadName("DiscReadAhead");
+
+	AndroidJNIThreadContext jniContext;
+
+	std::unique_lock<std::mutex> guard(queueLock_);
+	while (running_) {
+		if (queue_.empty()) {
+			queueCond_.wait(guard);
+			continue;
+		}
+
+		Range &front = queue_.front();
+		const u32 block = front.block;
+		const u32 count = std::min(front.count, READAHEAD_CHUNK);
+		if (count == front.count) {
+			queue_.pop_front();
+		} else {
+			front.block += count;
+			front.count -= count;
+		}
+
+		guard.unlock();
+		VERBOSE_LOG(FILESYS, "Prefetching %d blocks at %08x", count, block);
+		blockDevice_->Prefetch(block, count);
+		guard.lock();
+	}
+}
+
+void ReadAheadPredictor::Shutdown() {
+	{
+		std::lock_guard<std::mutex> guard(queueLock_);
+		running_ = false;
+		queue_.clear();
+		queueCond_.notify_one();
+	}
+	if (thread_.joinable())
+		thread_.join();
+}
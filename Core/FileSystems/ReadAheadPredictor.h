@@ -0,0 +1,77 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "Common/CommonTypes.h"
+
+class BlockDevice;
+
+// Watches the reads games make through open files on a disc, and prefetches what they're likely
+// to read next on a background thread: further into a file being streamed, the rest of small files,
+// and the file that was opened after this one last time.
+// The block device only gets hints, the actual reads still go through it as normal.
+class ReadAheadPredictor {
+public:
+	ReadAheadPredictor(BlockDevice *blockDevice);
+	~ReadAheadPredictor();
+
+	// Call after each read of count blocks at block, from a file of fileBlocks at fileStart.
+	void OnRead(u32 handle, u32 fileStart, u32 fileBlocks, u32 block, u32 count);
+	void OnClose(u32 handle);
+	// Stops the thread, must be called before the block device is deleted.
+	void Shutdown();
+
+private:
+	struct FileState {
+		u32 start;
+		u32 blocks;
+		// Where the next read would be if it's sequential.
+		u32 nextBlock;
+		// How far we've already asked to prefetch.
+		u32 prefetchedEnd;
+		int sequentialReads;
+		bool prefetchedSuccessor;
+	};
+
+	struct Range {
+		u32 block;
+		u32 count;
+	};
+
+	void Queue(u32 block, u32 count);
+	void Run();
+
+	BlockDevice *blockDevice_;
+	std::map<u32, FileState> files_;
+	// Start of the file first read after each file, learned as the game runs.
+	std::unordered_map<u32, u32> successors_;
+	u32 lastFileStart_ = 0xFFFFFFFF;
+
+	std::thread thread_;
+	std::mutex queueLock_;
+	std::condition_variable queueCond_;
+	std::deque<Range> queue_;
+	bool running_ = true;
+};
@@ -22,6 +22,7 @@
 #define _POSIX_THREAD_SAFE_FUNCTIONS 200112L
 #endif
 #endif
+#include <cctype>
 #include <ctime>
 
 #include "Common/File/FileUtil.h"
@@ -30,6 +31,7 @@
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/SysError.h"
+#include "Common/TimeUtil.h"
 #include "Core/FileSystems/VirtualDiscFileSystem.h"
 #include "Core/FileSystems/ISOFileSystem.h"
 #include "Core/HLE/sceKernel.h"
@@ -54,6 +56,17 @@
 
 const std::string INDEX_FILENAME = ".ppsspp-index.lst";
 
+// Known missing names older than this are checked on the host again.
+static const double MISSING_FILES_SECONDS = 2.0;
+static const size_t MISSING_FILES_MAX = 4096;
+
+static std::string FoldedFileListKey(const std::string &fileName) {
+	std::string key = fileName;
+	for (char &c : key)
+		c = tolower(c);
+	return key;
+}
+
 VirtualDiscFileSystem::VirtualDiscFileSystem(IHandleAllocator *_hAlloc, const Path &_basePath)
 	: basePath(_basePath), currentBlockIndex(0) {
 	hAlloc = _hAlloc;
@@ -61,6 +74,9 @@ VirtualDiscFileSystem::VirtualDiscFileSystem(IHandleAllocator *_hAlloc, const Pa
 }
 
 VirtualDiscFileSystem::~VirtualDiscFileSystem() {
+	if (lookups_ != 0) {
+		INFO_LOG(FILESYS, "Virtual disc path lookups: %d (%d known missing), %0.2f us average", lookups_, lookupsMissing_, lookupTime_ * 1000000.0 / lookups_);
+	}
 	for (auto iter = entries.begin(), end = entries.end(); iter != end; ++iter) {
 		if (iter->second.type != VFILETYPE_ISO) {
 			iter->second.Close();
@@ -154,7 +170,7 @@ void VirtualDiscFileSystem::LoadFileListIndex() {
 			currentBlockIndex = nextBlock;
 		}
 
-		fileList.push_back(entry);
+		addFileListEntry(entry);
 	}
 
 	fclose(f);
@@ -183,6 +199,16 @@ void VirtualDiscFileSystem::DoState(PointerWrap &p)
 		Do(p, fileList[i].totalSize);
 	}
 
+	if (p.mode == p.MODE_READ) {
+		fileListIndex_.clear();
+		fileListFoldedIndex_.clear();
+		missingFiles_.clear();
+		for (int i = 0; i < fileListSize; i++) {
+			fileListIndex_.emplace(fileList[i].fileName, i);
+			fileListFoldedIndex_.emplace(FoldedFileListKey(fileList[i].fileName), i);
+		}
+	}
+
 	if (p.mode == p.MODE_READ)
 	{
 		entries.clear();
@@ -259,6 +285,12 @@ Path VirtualDiscFileSystem::GetLocalPath(std::string localpath) {
 	return basePath / localpath;
 }
 
+void VirtualDiscFileSystem::addFileListEntry(const FileListEntry &entry) {
+	fileList.push_back(entry);
+	fileListIndex_.emplace(entry.fileName, (int)fileList.size() - 1);
+	fileListFoldedIndex_.emplace(FoldedFileListKey(entry.fileName), (int)fileList.size() - 1);
+}
+
 int VirtualDiscFileSystem::getFileListIndex(std::string &fileName)
 {
 	std::string normalized;
@@ -268,39 +300,58 @@ int VirtualDiscFileSystem::getFileListIndex(std::string &fileName)
 		normalized = fileName;
 	}
 
-	for (size_t i = 0; i < fileList.size(); i++)
-	{
-		if (fileList[i].fileName == normalized)
-			return (int)i;
+	double start = time_now_d();
+	lookups_++;
+	auto indexed = fileListIndex_.find(normalized);
+	if (indexed != fileListIndex_.end()) {
+		lookupTime_ += time_now_d() - start;
+		return indexed->second;
+	}
+#if !HOST_IS_CASE_SENSITIVE
+	// The host would open the same file anyway, so don't give it a second entry.
+	auto folded = fileListFoldedIndex_.find(FoldedFileListKey(normalized));
+	if (folded != fileListFoldedIndex_.end()) {
+		lookupTime_ += time_now_d() - start;
+		return folded->second;
+	}
+#endif
+	if (start - missingFilesTime_ > MISSING_FILES_SECONDS) {
+		missingFiles_.clear();
+		missingFilesTime_ = start;
+	}
+	if (missingFiles_.count(normalized)) {
+		lookupsMissing_++;
+		lookupTime_ += time_now_d() - start;
+		return -1;
 	}
 
 	// unknown file - add it
+	int index = -1;
 	Path fullName = GetLocalPath(fileName);
-	if (! File::Exists(fullName)) {
+	bool exists = File::Exists(fullName);
 #if HOST_IS_CASE_SENSITIVE
-		if (! FixPathCase(basePath, fileName, FPC_FILE_MUST_EXIST))
-			return -1;
+	if (!exists && FixPathCase(basePath, fileName, FPC_FILE_MUST_EXIST)) {
 		fullName = GetLocalPath(fileName);
-
-		if (! File::Exists(fullName))
-			return -1;
-#else
-		return -1;
-#endif
+		exists = File::Exists(fullName);
 	}
+#endif
 
-	if (File::IsDirectory(fullName))
-		return -1;
-
-	FileListEntry entry = {""};
-	entry.fileName = normalized;
-	entry.totalSize = File::GetFileSize(fullName);
-	entry.firstBlock = currentBlockIndex;
-	currentBlockIndex += (entry.totalSize+2047)/2048;
+	if (exists && !File::IsDirectory(fullName)) {
+		FileListEntry entry = {""};
+		entry.fileName = normalized;
+		entry.totalSize = File::GetFileSize(fullName);
+		entry.firstBlock = currentBlockIndex;
+		currentBlockIndex += (entry.totalSize+2047)/2048;
 
-	fileList.push_back(entry);
+		addFileListEntry(entry);
+		index = (int)fileList.size() - 1;
+	} else if (missingFiles_.size() < MISSING_FILES_MAX) {
+		// Directories don't get an index either.
+		missingFiles_.insert(normalized);
+	}
 
-	return (int)fileList.size()-1;
+	lookupTime_ += time_now_d() - start;
+	return index;
 }
 
 int VirtualDiscFileSystem::getFileListIndex(u32 accessBlock, u32 accessSize, bool blockMode)
@@ -20,6 +20,8 @@
 // TODO: Remove the Windows-specific code, FILE is fine there too.
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "Common/File/Path.h"
 #include "Core/FileSystems/FileSystem.h"
@@ -191,7 +193,19 @@ class VirtualDiscFileSystem: public IFileSystem {
 		Handler *handler;
 	};
 
+	void addFileListEntry(const FileListEntry &entry);
+
 	std::vector<FileListEntry> fileList;
+	// Index into fileList by exact name.
+	std::unordered_map<std::string, int> fileListIndex_;
+	// Lowercase name to index, only used where the host ignores case too.
+	std::unordered_map<std::string, int> fileListFoldedIndex_;
+	// Names recently found missing, forgotten when they get old in case files are added on the host.
+	std::unordered_set<std::string> missingFiles_;
+	double missingFilesTime_ = 0.0;
+	u32 lookups_ = 0;
+	u32 lookupsMissing_ = 0;
+	double lookupTime_ = 0.0;
 	u32 currentBlockIndex;
 	u32 lastReadBlock_;
 
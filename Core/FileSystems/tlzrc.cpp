@@ -65,6 +65,7 @@ static u8 rc_getbyte(LZRC_DECODE *rc)
 {
 	if(rc->in_ptr == rc->in_len){
 		_dbg_assert_msg_(false, "LZRC: End of input!");
+		return 0;
 	}
 
 	return rc->input[rc->in_ptr++];
@@ -215,6 +216,8 @@ int lzrc_decompress(void *out, int out_len, void *in, int in_len)
 
 	if(rc.lc&0x80){
 		/* plain text */
+		if(in_len<5 || rc.code>(u32)out_len || rc.code>(u32)(in_len-5))
+			return -1;
 		memcpy(rc.output, rc.input+5, rc.code);
 		return rc.code; 
 	}
@@ -236,6 +239,8 @@ int lzrc_decompress(void *out, int out_len, void *in, int in_len)
 			byte = rc_bittree(&rc, &rc.bm_literal[((last_byte>>rc.lc)&0x07)][0], 0x100);
 			byte -= 0x100;
 
+			if(rc.out_ptr==rc.out_len)
+				return -1;
 			rc_putbyte(&rc, byte);
 		} else {                       
 			/* 1 -> a match */
@@ -284,6 +289,8 @@ int lzrc_decompress(void *out, int out_len, void *in, int in_len)
 				printf("match_dist out of range! %08x\n", match_dist);
 				return -1;
 			}
+			if(match_len+1>rc.out_len-rc.out_ptr)
+				return -1;
 			match_src = rc.output+rc.out_ptr-match_dist;
 			for(i=0; i<match_len+1; i++){
 				rc_putbyte(&rc, *match_src++);
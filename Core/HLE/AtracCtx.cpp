@@ -18,6 +18,7 @@
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/Log.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/Reporting.h"
 #include "Core/MemMapHelpers.h"
 #include "Core/System.h"
@@ -37,11 +38,33 @@ const int DATA_CHUNK_MAGIC = 0x61746164;
 const int SMPL_CHUNK_MAGIC = 0x6C706D73;
 const int FACT_CHUNK_MAGIC = 0x74636166;
 
+// Per context.  About 12 seconds of stereo, so it holds the start of a loop rather than a whole song.
+const size_t ATRAC_FRAME_CACHE_MAX_BYTES = 2 * 1024 * 1024;
+
+class AtracDecodeAheadTask : public Task {
+public:
+	AtracDecodeAheadTask(Atrac *atrac) : atrac_(atrac) {}
+
+	TaskType Type() const override { return TaskType::CPU_COMPUTE; }
+	TaskPriority Priority() const override { return TaskPriority::HIGH; }
+	void Run() override {
+		atrac_->RunDecodeAhead();
+	}
+
+private:
+	Atrac *atrac_;
+};
+
 void Atrac::DoState(PointerWrap &p) {
 	auto s = p.Section("Atrac", 1, 9);
 	if (!s)
 		return;
 
+	if (p.mode == p.MODE_READ) {
+		// The decoder is recreated below, so anything decoded from it is stale.
+		ClearDecodeAhead();
+	}
+
 	Do(p, track_.channels);
 	Do(p, outputChannels_);
 	if (s >= 5) {
@@ -152,6 +175,7 @@ void Atrac::DoState(PointerWrap &p) {
 }
 
 void Atrac::ResetData() {
+	ClearDecodeAhead();
 	delete decoder_;
 	decoder_ = nullptr;
 
@@ -238,6 +262,7 @@ void Track::DebugLog() {
 }
 
 int Atrac::Analyze(u32 addr, u32 size) {
+	ClearDecodeAhead();
 	track_ = {};
 	first_ = {};
 	first_.addr = addr;
@@ -449,6 +474,7 @@ int AnalyzeAtracTrack(u32 addr, u32 size, Track *track) {
 }
 
 int Atrac::AnalyzeAA3(u32 addr, u32 size, u32 fileSize) {
+	ClearDecodeAhead();
 	first_.addr = addr;
 	first_.size = size;
 	first_._filesize_dontuse = fileSize;
@@ -700,6 +726,7 @@ int Atrac::SetData(u32 buffer, u32 readSize, u32 bufferSize, int outputChannels,
 }
 
 u32 Atrac::SetSecondBuffer(u32 secondBuffer, u32 secondBufferSize) {
+	WaitForDecodeAhead();
 	u32 secondFileOffset = track_.FileOffsetBySample(track_.loopEndSample - track_.firstSampleOffset);
 	u32 desiredSize = track_.fileSize - secondFileOffset;
 
@@ -761,6 +788,7 @@ void Atrac::UpdateBufferState() {
 }
 
 int Atrac::AddStreamData(u32 bytesToAdd) {
+	WaitForDecodeAhead();
 	u32 readOffset;
 	CalculateStreamInfo(&readOffset);
 	if (bytesToAdd > first_.writableBytes)
@@ -794,6 +822,7 @@ int Atrac::AddStreamData(u32 bytesToAdd) {
 }
 
 u32 Atrac::AddStreamDataSas(u32 bufPtr, u32 bytesToAdd) {
+	WaitForDecodeAhead();
 	int addbytes = std::min(bytesToAdd, track_.fileSize - first_.fileoffset - track_.FirstOffsetExtra());
 	Memory::Memcpy(dataBuf_ + first_.fileoffset + track_.FirstOffsetExtra(), bufPtr, addbytes, "AtracAddStreamData");
 	first_.size += bytesToAdd;
@@ -830,12 +859,41 @@ u32 Atrac::GetNextSamples() {
 }
 
 void Atrac::ForceSeekToSample(int sample) {
+	WaitForDecodeAhead();
+	aheadValid_ = false;
 	if (decoder_) {
 		decoder_->FlushBuffers();
+		decoderHistory_ = 0;
+		decoderBehind_ = false;
 	}
 	currentSample_ = sample;
 }
 
+u32 Atrac::PrimeStart(u32 off) const {
+	const u32 backfill = track_.bytesPerFrame * 2;
+	return off - track_.dataByteOffset < backfill ? track_.dataByteOffset : off - backfill;
+}
+
+void Atrac::PrimeDecoder(u32 off, const u8 *input, u32 inputStart) {
+	decoder_->FlushBuffers();
+	decoderHistory_ = 0;
+	decoderBehind_ = false;
+
+	for (u32 pos = PrimeStart(off); pos < off; pos += track_.bytesPerFrame) {
+		decoder_->Decode(input + (pos - inputStart), track_.bytesPerFrame, nullptr, 2, nullptr, nullptr);
+		NoteDecoded(pos);
+	}
+}
+
+void Atrac::NoteDecoded(u32 off) {
+	if (decoderHistory_ > 0 && off == lastDecodedOffset_ + track_.bytesPerFrame) {
+		decoderHistory_++;
+	} else {
+		decoderHistory_ = 1;
+	}
+	lastDecodedOffset_ = off;
+}
+
 void Atrac::SeekToSample(int sample) {
 	// It seems like the PSP aligns the sample position to 0x800...?
 	const u32 offsetSamples = track_.FirstSampleOffsetFull();
@@ -843,21 +901,17 @@ void Atrac::SeekToSample(int sample) {
 	int seekFrame = sample + offsetSamples - unalignedSamples;
 
 	if ((sample != currentSample_ || sample == 0) && decoder_ != nullptr) {
-		// Prefill the decode buffer with packets before the first sample offset.
-		decoder_->FlushBuffers();
+		// Whatever was decoded ahead was for the old position.
+		WaitForDecodeAhead();
+		aheadValid_ = false;
 
 		int adjust = 0;
 		if (sample == 0) {
 			int offsetSamples = track_.FirstSampleOffsetFull();
 			adjust = -(int)(offsetSamples % track_.SamplesPerFrame());
 		}
-		const u32 off = track_.FileOffsetBySample(sample + adjust);
-		const u32 backfill = track_.bytesPerFrame * 2;
-		const u32 start = off - track_.dataByteOffset < backfill ? track_.dataByteOffset : off - backfill;
-
-		for (u32 pos = start; pos < off; pos += track_.bytesPerFrame) {
-			decoder_->Decode(BufferStart() + pos, track_.bytesPerFrame, nullptr, 2, nullptr, nullptr);
-		}
+		// Prefill the decode buffer with packets before the first sample offset.
+		PrimeDecoder(track_.FileOffsetBySample(sample + adjust), BufferStart(), 0);
 	}
 
 	currentSample_ = sample;
@@ -914,7 +968,168 @@ void Atrac::ConsumeFrame() {
 	}
 }
 
+bool Atrac::CanDecodeAhead() const {
+	// With the whole track loaded, the next frame is already there.  The game can still write to it,
+	// since the buffer is used directly, so the worker decodes a copy that's checked before use.
+	return decodeAhead_ && bufferState_ == ATRAC_STATUS_ALL_DATA_LOADED && decoder_ != nullptr;
+}
+
+bool Atrac::CanCacheFrames() const {
+	// The ATRAC3+ decoder keeps some state longer, like window shapes of subbands that weren't coded,
+	// so a primed decoder can come out slightly different.  Decoding ahead is fine, it's the same order.
+	return CanDecodeAhead() && track_.codecType == PSP_MODE_AT_3;
+}
+
+u32 Atrac::NextFrameOffset() const {
+	// Same as DecodeData(), which aligns back to the start of the frame.
+	int offsetSamples = track_.FirstSampleOffsetFull();
+	u32 unalignedSamples = (offsetSamples + currentSample_) % track_.SamplesPerFrame();
+	return track_.FileOffsetBySample(currentSample_ - (int)unalignedSamples);
+}
+
+bool Atrac::DecodeFrameNow(u32 off, const u8 *input, u32 inputStart, int channels, int16_t *outbuf, int *outSamples, bool *historyComplete) {
+	if (decoderBehind_)
+		PrimeDecoder(off, input, inputStart);
+	*historyComplete = decoderHistory_ >= 2 && lastDecodedOffset_ + track_.bytesPerFrame == off;
+
+	int bytesConsumed = 0;
+	bool result = decoder_->Decode(input + (off - inputStart), track_.bytesPerFrame, &bytesConsumed, channels, outbuf, outSamples);
+	NoteDecoded(off);
+	return result;
+}
+
+bool Atrac::DecodeFrame(u32 off, int16_t *outbuf, int *outSamples) {
+	const int16_t *decoded = nullptr;
+	bool historyComplete = false;
+	bool result = true;
+
+	const u8 *input = BufferStart();
+	const bool aheadMatches = aheadValid_ && aheadOffset_ == off && aheadChannels_ == outputChannels_;
+	const u32 aheadDecodeBytes = off + track_.bytesPerFrame - aheadDecodeStart_;
+	if (aheadMatches && memcmp(aheadInput_.data() + (aheadDecodeStart_ - aheadInputStart_), input + aheadDecodeStart_, aheadDecodeBytes) == 0) {
+		// The decoder went through exactly the same frames as it would have here.
+		aheadValid_ = false;
+		result = aheadOK_;
+		*outSamples = aheadSamples_;
+		historyComplete = aheadHistoryComplete_;
+		decoded = aheadBuffer_.data();
+		if (outbuf && result)
+			memcpy(outbuf, decoded, aheadSamples_ * aheadChannels_ * sizeof(int16_t));
+	} else {
+		if (aheadMatches) {
+			// The game wrote to the data after it was copied.  Put the decoder back to before the frame, as it was then.
+			aheadValid_ = false;
+			PrimeDecoder(off, aheadInput_.data(), aheadInputStart_);
+			// That was the old data though, so nothing decoded right after it can be cached.
+			decoderHistory_ = 0;
+		} else if (aheadValid_) {
+			// The game moved somewhere else without a seek, so the decoder is a frame further along.
+			aheadValid_ = false;
+			decoderBehind_ = true;
+		}
+
+		// Right after a flush, the decoder is still warming up, and the cached frame would sound different.
+		const bool warm = decoderBehind_ || (decoderHistory_ >= 2 && lastDecodedOffset_ + track_.bytesPerFrame == off);
+		auto cached = frameCache_.find(off);
+		if (cached != frameCache_.end() && memcmp(cached->second.input.data(), input + PrimeStart(off), cached->second.input.size()) != 0) {
+			// The game wrote new data into the buffer, so this is stale.
+			frameCacheBytes_ -= cached->second.data.size() * sizeof(int16_t) + cached->second.input.size();
+			frameCache_.erase(cached);
+			cached = frameCache_.end();
+		}
+		if (warm && cached != frameCache_.end() && cached->second.channels == outputChannels_ && CanCacheFrames()) {
+			*outSamples = cached->second.samples;
+			if (outbuf)
+				memcpy(outbuf, cached->second.data.data(), cached->second.data.size() * sizeof(int16_t));
+			// The decoder skipped this frame, so it has to catch up before the next one.
+			decoderBehind_ = true;
+			return true;
+		}
+
+		result = DecodeFrameNow(off, input, 0, outputChannels_, outbuf, outSamples, &historyComplete);
+		decoded = outbuf;
+	}
+
+	// Only frames that decode the same no matter how we got to them, which takes the two before.
+	if (result && decoded && historyComplete && frameCacheLooped_ && CanCacheFrames()) {
+		const size_t count = *outSamples * outputChannels_;
+		const u32 inputStart = PrimeStart(off);
+		const size_t bytes = count * sizeof(int16_t) + (off + track_.bytesPerFrame - inputStart);
+		if (frameCacheBytes_ + bytes <= ATRAC_FRAME_CACHE_MAX_BYTES && frameCache_.find(off) == frameCache_.end()) {
+			CachedFrame &frame = frameCache_[off];
+			frame.channels = outputChannels_;
+			frame.samples = *outSamples;
+			frame.data.assign(decoded, decoded + count);
+			// The frames before count too, since the decoder carries state from them.
+			frame.input.assign(input + inputStart, input + off + track_.bytesPerFrame);
+			frameCacheBytes_ += bytes;
+		}
+	}
+	return result;
+}
+
+void Atrac::ScheduleDecodeAhead() {
+	if (!CanDecodeAhead() || !g_threadManager.IsInitialized())
+		return;
+	// At sample 0, DecodeData() flushes and primes first, and at the end there's nothing left.
+	if (currentSample_ == 0 || (currentSample_ >= track_.endSample && loopNum_ == 0))
+		return;
+
+	const u32 off = NextFrameOffset();
+	if (off + track_.bytesPerFrame > first_.size)
+		return;
+	auto cached = frameCache_.find(off);
+	if (cached != frameCache_.end() && cached->second.channels == outputChannels_)
+		return;
+
+	aheadOffset_ = off;
+	aheadChannels_ = outputChannels_;
+	aheadBuffer_.resize(ATRAC3PLUS_MAX_SAMPLES * 2);
+	// The CPU or a DMA might still be writing the buffer, so the worker gets its own copy.
+	aheadInputStart_ = PrimeStart(off);
+	aheadDecodeStart_ = decoderBehind_ ? aheadInputStart_ : off;
+	const u8 *input = BufferStart();
+	aheadInput_.assign(input + aheadInputStart_, input + off + track_.bytesPerFrame);
+	{
+		std::lock_guard<std::mutex> guard(aheadLock_);
+		aheadRunning_ = true;
+	}
+	g_threadManager.EnqueueTask(new AtracDecodeAheadTask(this));
+}
+
+void Atrac::RunDecodeAhead() {
+	int outSamples = 0;
+	bool historyComplete = false;
+	bool result = DecodeFrameNow(aheadOffset_, aheadInput_.data(), aheadInputStart_, aheadChannels_, aheadBuffer_.data(), &outSamples, &historyComplete);
+
+	std::lock_guard<std::mutex> guard(aheadLock_);
+	aheadOK_ = result;
+	aheadSamples_ = outSamples;
+	aheadHistoryComplete_ = historyComplete;
+	aheadValid_ = true;
+	aheadRunning_ = false;
+	aheadCond_.notify_all();
+}
+
+void Atrac::WaitForDecodeAhead() {
+	std::unique_lock<std::mutex> guard(aheadLock_);
+	aheadCond_.wait(guard, [this] { return !aheadRunning_; });
+}
+
+void Atrac::ClearDecodeAhead() {
+	WaitForDecodeAhead();
+	aheadValid_ = false;
+	frameCache_.clear();
+	frameCacheBytes_ = 0;
+	frameCacheLooped_ = false;
+	decoderHistory_ = 0;
+	decoderBehind_ = false;
+}
+
 u32 Atrac::DecodeData(u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u32 *finish, int *remains) {
+	// Most likely done already, since the game ran in between.
+	WaitForDecodeAhead();
+
 	int loopNum = loopNum_;
 	if (bufferState_ == ATRAC_STATUS_FOR_SCESAS) {
 		// TODO: Might need more testing.
@@ -957,10 +1172,8 @@ u32 Atrac::DecodeData(u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u32 *finish, i
 	bool gotFrame = false;
 	u32 off = track_.FileOffsetBySample(currentSample_ - skipSamples);
 	if (off < first_.size) {
-		uint8_t *indata = BufferStart() + off;
-		int bytesConsumed = 0;
 		int outSamples = 0;
-		if (!decoder_->Decode(indata, track_.bytesPerFrame, &bytesConsumed, outputChannels_, (int16_t *)outbuf, &outSamples)) {
+		if (!DecodeFrame(off, (int16_t *)outbuf, &outSamples)) {
 			// Decode failed.
 			*SamplesNum = 0;
 			*finish = 1;
@@ -1015,6 +1228,8 @@ u32 Atrac::DecodeData(u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u32 *finish, i
 	int loopEndAdjusted = track_.loopEndSample - track_.FirstSampleOffsetFull();
 	if ((hitEnd || currentSample_ > loopEndAdjusted) && loopNum != 0) {
 		SeekToSample(track_.loopStartSample - track_.FirstSampleOffsetFull());
+		// From here on, the same frames will come around again.
+		frameCacheLooped_ = true;
 		if (bufferState_ != ATRAC_STATUS_FOR_SCESAS) {
 			if (loopNum_ > 0)
 				loopNum_--;
@@ -1040,6 +1255,9 @@ u32 Atrac::DecodeData(u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u32 *finish, i
 	*remains = RemainingFrames();
 	// refresh context_
 	WriteContextToPSPMem();
+
+	// Decode the next frame while the game runs, so the next call just copies it.
+	ScheduleDecodeAhead();
 	return 0;
 }
 
@@ -1057,6 +1275,7 @@ void AtracBase::SetLoopNum(int loopNum) {
 }
 
 u32 Atrac::ResetPlayPosition(int sample, int bytesWrittenFirstBuf, int bytesWrittenSecondBuf) {
+	WaitForDecodeAhead();
 	// Reuse the same calculation as before.
 	AtracResetBufferInfo bufferInfo;
 	GetResetBufferInfo(&bufferInfo, sample);
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/CommonTypes.h"
@@ -316,6 +319,9 @@ class Atrac : public AtracBase {
 	u32 GetNextSamples() override;
 	void InitLowLevel(u32 paramsAddr, bool jointStereo) override;
 
+	// Mostly for tests, the output is the same either way.  Also turns off the loop frame cache.
+	void SetDecodeAhead(bool enabled) { decodeAhead_ = enabled; }
+
 protected:
 	void AnalyzeReset();
 
@@ -333,6 +339,28 @@ class Atrac : public AtracBase {
 	void ConsumeFrame();
 	void CalculateStreamInfo(u32 *readOffset);
 
+	// Flushes and decodes the frames before off, like after a seek.  input holds the data from inputStart on.
+	void PrimeDecoder(u32 off, const u8 *input, u32 inputStart);
+	// Where PrimeDecoder() starts decoding for off.
+	u32 PrimeStart(u32 off) const;
+	void NoteDecoded(u32 off);
+	// Takes the frame from the decode ahead or the cache if possible.
+	bool DecodeFrame(u32 off, int16_t *outbuf, int *outSamples);
+	// Sets historyComplete if the decoder had already decoded the two frames before, so the result can be cached.
+	bool DecodeFrameNow(u32 off, const u8 *input, u32 inputStart, int channels, int16_t *outbuf, int *outSamples, bool *historyComplete);
+	// Only when the whole track is in memory, so the next frame's data is already there.
+	bool CanDecodeAhead() const;
+	// Only for codecs where two frames of priming reproduce the decoder state exactly.
+	bool CanCacheFrames() const;
+	// The frame the next DecodeData() will decode, if it's nothing special.
+	u32 NextFrameOffset() const;
+	void ScheduleDecodeAhead();
+	void WaitForDecodeAhead();
+	// Waits, and forgets any frames decoded ahead or cached.
+	void ClearDecodeAhead();
+	void RunDecodeAhead();
+	friend class AtracDecodeAheadTask;
+
 	InputBuffer first_{};
 	InputBuffer second_{};  // only addr, size, fileoffset are used (incomplete)
 
@@ -348,4 +376,42 @@ class Atrac : public AtracBase {
 	u32 bufferPos_ = 0;
 	u32 bufferValidBytes_ = 0;
 	u32 bufferHeaderSize_ = 0;
+
+	// None of this is saved in states, it's all rebuilt from the data as it's decoded.
+	// Frames in order since the decoder was last flushed, ending at lastDecodedOffset_.
+	int decoderHistory_ = 0;
+	u32 lastDecodedOffset_ = 0;
+	// Frames came from the cache, so the decoder needs priming before it's used again.
+	bool decoderBehind_ = false;
+
+	// Decoded frames by file offset, filled once the track loops so later loops can skip decoding.
+	struct CachedFrame {
+		int channels;
+		int samples;
+		std::vector<int16_t> data;
+		// The game may rewrite the buffer without a SetData(), so this must still match.
+		// Starts at PrimeStart(), since the frames before affect the result too.
+		std::vector<u8> input;
+	};
+	std::unordered_map<u32, CachedFrame> frameCache_;
+	size_t frameCacheBytes_ = 0;
+	bool frameCacheLooped_ = false;
+
+	// The next frame, decoded on a worker between calls to DecodeData().
+	bool decodeAhead_ = true;
+	std::mutex aheadLock_;
+	std::condition_variable aheadCond_;
+	bool aheadRunning_ = false;
+	bool aheadValid_ = false;
+	bool aheadOK_ = false;
+	bool aheadHistoryComplete_ = false;
+	u32 aheadOffset_ = 0;
+	int aheadChannels_ = 0;
+	int aheadSamples_ = 0;
+	std::vector<int16_t> aheadBuffer_;
+	// Copy of the data for the worker, including the frames before to put the decoder back if it's stale.
+	std::vector<u8> aheadInput_;
+	u32 aheadInputStart_ = 0;
+	// Where the worker started decoding, which is before the frame if it had to prime first.
+	u32 aheadDecodeStart_ = 0;
 };
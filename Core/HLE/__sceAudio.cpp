@@ -417,7 +417,8 @@ void __AudioUpdate(bool resetRecording) {
 		memset(mixBuffer, 0, hwBlockSize * 2 * sizeof(s32));
 	}
 
-	if (g_Config.bEnableSound) {
+	// Frames emulated for run-ahead are rolled back, so they must not be heard.
+	if (g_Config.bEnableSound && !PSP_RunAheadMutesAudio()) {
 		System_AudioPushSamples(mixBuffer, hwBlockSize);
 #ifndef MOBILE_DEVICE
 		if (g_Config.bSaveLoadResetsAVdumping && resetRecording) {
@@ -603,7 +603,14 @@ void __DisplayFlip(int cyclesLate) {
 	const bool fbDirty = gpu->FramebufferDirty();
 
 	bool needFlip = fbDirty || noRecentFlip || postEffectRequiresFlip;
+	// Run-ahead won't show this frame.  It skips presenting and timing, but keeps all the other bookkeeping.
+	const bool hideFrame = PSP_RunAheadHidesFrame();
 	if (!needFlip) {
+		if (hideFrame) {
+			// Still end it here, each vblank counts as a frame so static screens don't run ahead faster.
+			Core_NextFrame();
+			return;
+		}
 		// Okay, there's no new frame to draw, game might be sitting in a static loading screen
 		// or similar, and not long enough to trigger noRecentFlip. But audio may be playing, so we need to time still.
 		DoFrameIdleTiming();
@@ -623,7 +630,7 @@ void __DisplayFlip(int cyclesLate) {
 	bool refreshRateNeedsSkip = FrameTimingLimit() != framerate && FrameTimingLimit() > refreshRate;
 	// Alternative to frameskip fast-forward, where we draw everything.
 	// Useful if skipping a frame breaks graphics or for checking drawing speed.
-	if (fastForwardSkipFlip && (!FrameTimingThrottled() || refreshRateNeedsSkip)) {
+	if (fastForwardSkipFlip && !hideFrame && (!FrameTimingThrottled() || refreshRateNeedsSkip)) {
 		static double lastFlip = 0;
 		double now = time_now_d();
 		if ((now - lastFlip) < 1.0f / refreshRate) {
@@ -638,7 +645,9 @@ void __DisplayFlip(int cyclesLate) {
 
 	bool nextFrame = false;
 
-	if (fbReallyDirty || noRecentFlip || postEffectRequiresFlip) {
+	if (hideFrame) {
+		nextFrame = Core_NextFrame();
+	} else if (fbReallyDirty || noRecentFlip || postEffectRequiresFlip) {
 		// Check first though, might've just quit / been paused.
 		if (!forceNoFlip)
 			nextFrame = Core_NextFrame();
@@ -661,8 +670,9 @@ void __DisplayFlip(int cyclesLate) {
 	if (fpsLimit > 0 && fpsLimit != framerate) {
 		scaledTimestep *= (float)framerate / fpsLimit;
 	}
-	bool skipFrame;
-	DoFrameTiming(throttle, &skipFrame, scaledTimestep, nextFrame);
+	bool skipFrame = false;
+	if (!hideFrame)
+		DoFrameTiming(throttle, &skipFrame, scaledTimestep, nextFrame);
 
 	int maxFrameskip = 8;
 	int frameSkipNum = DisplayCalculateFrameSkip();
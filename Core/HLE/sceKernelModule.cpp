@@ -2007,7 +2007,8 @@ void __KernelGPUReplay() {
 		Core_Stop();
 	}
 
-	if (PSP_CoreParameter().headLess && !PSP_CoreParameter().startBreak) {
+	// When benchmarking, keep replaying until enough runs have been timed.
+	if (PSP_CoreParameter().headLess && !PSP_CoreParameter().startBreak && !GPURecord::ShouldRepeatReplay()) {
 		PSPPointer<u8> topaddr;
 		u32 linesize = 512;
 		__DisplayGetFramebuf(&topaddr, &linesize, nullptr, 0);
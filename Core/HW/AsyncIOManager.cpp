@@ -22,12 +22,28 @@
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/Serialize/SerializeMap.h"
 #include "Common/Serialize/SerializeSet.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
 #include "Core/HW/AsyncIOManager.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 
+class AsyncIOTask : public Task {
+public:
+	AsyncIOTask(AsyncIOManager *manager, int device) : manager_(manager), device_(device) {}
+
+	TaskType Type() const override { return TaskType::IO_BLOCKING; }
+	TaskPriority Priority() const override { return TaskPriority::HIGH; }
+	void Run() override {
+		manager_->RunDeviceQueue(device_);
+	}
+
+private:
+	AsyncIOManager *manager_;
+	int device_;
+};
+
 bool AsyncIOManager::HasOperation(u32 handle) {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	if (resultsPending_.find(handle) != resultsPending_.end()) {
@@ -46,15 +62,31 @@ void AsyncIOManager::ScheduleOperation(const AsyncIOEvent &ev) {
 			ERROR_LOG_REPORT(SCEIO, "Scheduling operation for file %d while one is pending (type %d)", ev.handle, ev.type);
 		}
 	}
-	ScheduleEvent(ev);
+	AsyncIOEvent scheduled = ev;
+	scheduled.startTicks = CoreTiming::GetTicks();
+	ScheduleEvent(scheduled);
 }
 
 void AsyncIOManager::Shutdown() {
-	std::lock_guard<std::mutex> guard(resultsLock_);
+	std::unique_lock<std::mutex> guard(resultsLock_);
+	// They write into PSP memory, so can't leave them running.
+	WaitForWorkers(guard);
 	resultsPending_.clear();
 	results_.clear();
 }
 
+void AsyncIOManager::SyncThread(bool force) {
+	IOThreadEventQueue::SyncThread(force);
+	std::unique_lock<std::mutex> guard(resultsLock_);
+	WaitForWorkers(guard);
+}
+
+void AsyncIOManager::WaitForWorkers(std::unique_lock<std::mutex> &guard) {
+	while (workerOps_ != 0) {
+		resultsWait_.wait(guard);
+	}
+}
+
 bool AsyncIOManager::HasResult(u32 handle) {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	return results_.find(handle) != results_.end();
@@ -89,7 +121,7 @@ bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
 bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || workerOps_ != 0) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (PopResult(handle, result)) {
 			return true;
 		}
@@ -103,7 +135,7 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || workerOps_ != 0) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (ReadResult(handle, result)) {
 			return result.finishTicks;
 		}
@@ -117,30 +149,61 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 }
 
 void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
-	switch (ev.type) {
-	case IO_EVENT_READ:
-		Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr);
-		break;
+	if (ev.type != IO_EVENT_READ && ev.type != IO_EVENT_WRITE) {
+		ERROR_LOG_REPORT(SCEIO, "Unsupported IO event type");
+		return;
+	}
 
-	case IO_EVENT_WRITE:
-		Write(ev.handle, ev.buf, ev.bytes);
-		break;
+	if (!ThreadEnabled() || !g_threadManager.IsInitialized()) {
+		RunOperation(ev);
+		return;
+	}
 
-	default:
-		ERROR_LOG_REPORT(SCEIO, "Unsupported IO event type");
+	const int device = pspFileSystem.GetHandleDevice(ev.handle);
+	std::lock_guard<std::mutex> guard(resultsLock_);
+	DeviceQueue &queue = deviceQueues_[device];
+	queue.events.push_back(ev);
+	workerOps_++;
+	if (!queue.running) {
+		queue.running = true;
+		g_threadManager.EnqueueTask(new AsyncIOTask(this, device));
+	}
+}
+
+void AsyncIOManager::RunOperation(const AsyncIOEvent &ev) {
+	if (ev.type == IO_EVENT_READ) {
+		Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr, ev.startTicks);
+	} else {
+		Write(ev.handle, ev.buf, ev.bytes, ev.startTicks);
+	}
+}
+
+void AsyncIOManager::RunDeviceQueue(int device) {
+	std::unique_lock<std::mutex> guard(resultsLock_);
+	DeviceQueue &queue = deviceQueues_[device];
+	while (!queue.events.empty()) {
+		AsyncIOEvent ev = queue.events.front();
+		queue.events.pop_front();
+
+		guard.unlock();
+		RunOperation(ev);
+		guard.lock();
+		workerOps_--;
 	}
+	queue.running = false;
+	resultsWait_.notify_all();
 }
 
-void AsyncIOManager::Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr) {
+void AsyncIOManager::Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr, u64 startTicks) {
 	int usec = 0;
 	s64 result = pspFileSystem.ReadFile(handle, buf, bytes, usec);
-	EventResult(handle, AsyncIOResult(result, usec, invalidateAddr));
+	EventResult(handle, AsyncIOResult(result, startTicks, usec, invalidateAddr));
 }
 
-void AsyncIOManager::Write(u32 handle, const u8 *buf, size_t bytes) {
+void AsyncIOManager::Write(u32 handle, const u8 *buf, size_t bytes, u64 startTicks) {
 	int usec = 0;
 	s64 result = pspFileSystem.WriteFile(handle, buf, bytes, usec);
-	EventResult(handle, AsyncIOResult(result, usec));
+	EventResult(handle, AsyncIOResult(result, startTicks, usec));
 }
 
 void AsyncIOManager::EventResult(u32 handle, const AsyncIOResult &result) {
@@ -149,7 +212,7 @@ void AsyncIOManager::EventResult(u32 handle, const AsyncIOResult &result) {
 		ERROR_LOG_REPORT(SCEIO, "Overwriting previous result for file action on handle %d", handle);
 	}
 	results_[handle] = result;
-	resultsWait_.notify_one();
+	resultsWait_.notify_all();
 }
 
 void AsyncIOManager::DoState(PointerWrap &p) {
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <deque>
 #include <map>
 #include <set>
 #include <mutex>
@@ -41,6 +42,8 @@ struct AsyncIOEvent {
 	u8 *buf;
 	size_t bytes;
 	u32 invalidateAddr;
+	// When the game scheduled it, so the emulated finish time doesn't depend on the host.
+	u64 startTicks;
 
 	operator AsyncIOEventType() const {
 		return type;
@@ -54,8 +57,8 @@ struct AsyncIOResult {
 	explicit AsyncIOResult(s64 r) : result(r), finishTicks(0), invalidateAddr(0) {
 	}
 
-	AsyncIOResult(s64 r, int usec, u32 addr = 0) : result(r), invalidateAddr(addr) {
-		finishTicks = CoreTiming::GetTicks() + usToCycles(usec);
+	AsyncIOResult(s64 r, u64 startTicks, int usec, u32 addr = 0) : result(r), invalidateAddr(addr) {
+		finishTicks = startTicks + usToCycles(usec);
 	}
 
 	void DoState(PointerWrap &p) {
@@ -78,6 +81,7 @@ struct AsyncIOResult {
 };
 
 typedef ThreadEventQueue<NoBase, AsyncIOEvent, AsyncIOEventType, IO_EVENT_INVALID, IO_EVENT_SYNC, IO_EVENT_FINISH> IOThreadEventQueue;
+// Reads and writes are started from the IO thread on workers, one device (UMD, memory stick...) at a time each.
 class AsyncIOManager : public IOThreadEventQueue {
 public:
 	void DoState(PointerWrap &p);
@@ -85,6 +89,8 @@ class AsyncIOManager : public IOThreadEventQueue {
 	bool HasOperation(u32 handle);
 	void ScheduleOperation(const AsyncIOEvent &ev);
 	void Shutdown();
+	// Also waits for the operations running on workers.
+	void SyncThread(bool force = false);
 
 	bool HasResult(u32 handle);
 	bool WaitResult(u32 handle, AsyncIOResult &result);
@@ -97,10 +103,22 @@ class AsyncIOManager : public IOThreadEventQueue {
 	}
 
 private:
+	friend class AsyncIOTask;
+
+	// Operations in the order they were scheduled.  Only one per device runs at a time,
+	// so a file's operations stay in order and the emulated seek timing matches the order.
+	struct DeviceQueue {
+		std::deque<AsyncIOEvent> events;
+		bool running = false;
+	};
+
 	bool PopResult(u32 handle, AsyncIOResult &result);
 	bool ReadResult(u32 handle, AsyncIOResult &result);
-	void Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr);
-	void Write(u32 handle, const u8 *buf, size_t bytes);
+	void RunOperation(const AsyncIOEvent &ev);
+	void RunDeviceQueue(int device);
+	void WaitForWorkers(std::unique_lock<std::mutex> &guard);
+	void Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr, u64 startTicks);
+	void Write(u32 handle, const u8 *buf, size_t bytes, u64 startTicks);
 
 	void EventResult(u32 handle, const AsyncIOResult &result);
 
@@ -108,4 +126,7 @@ class AsyncIOManager : public IOThreadEventQueue {
 	std::condition_variable resultsWait_;
 	std::set<u32> resultsPending_;
 	std::map<u32, AsyncIOResult> results_;
+	// Also under resultsLock_.
+	std::map<int, DeviceQueue> deviceQueues_;
+	int workerOps_ = 0;
 };
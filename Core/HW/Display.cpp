@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <mutex>
 #include <vector>
 #include "Common/CommonTypes.h"
@@ -26,6 +27,7 @@
 #include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/System.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/HW/Display.h"
 #include "GPU/GPU.h"
@@ -198,6 +200,14 @@ void __DisplayGetDebugStats(char *stats, size_t bufsize) {
 		kernelStats.summedSlowestSyscallName ? kernelStats.summedSlowestSyscallName : "(none)",
 		kernelStats.summedSlowestSyscallTime * 1000.0f,
 		statbuf);
+
+	RunAheadStats runAhead = PSP_GetRunAheadStats();
+	if (runAhead.frames > 0) {
+		size_t len = strlen(stats);
+		snprintf(stats + len, bufsize - len,
+			"Run-ahead %d frames: save %0.2f ms, load %0.2f ms, ahead %0.2f ms\n",
+			runAhead.frames, runAhead.saveMs, runAhead.loadMs, runAhead.aheadMs);
+	}
 }
 
 // On like 90hz, 144hz, etc, we return 60.0f as the framerate target. We only target other
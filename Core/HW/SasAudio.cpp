@@ -16,8 +16,12 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <atomic>
 
+#include "Common/Math/CrossSIMD.h"
 #include "Common/Profiler/Profiler.h"
+#include "Common/Thread/ParallelLoop.h"
+#include "Common/Thread/ThreadManager.h"
 
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Core/MemMapHelpers.h"
@@ -26,10 +30,17 @@
 #include "Core/Reporting.h"
 #include "Core/Util/AudioFormat.h"
 #include "Core/Core.h"
+#include "Core/Debugger/MemBlockInfo.h"
 #include "SasAudio.h"
 
 // #define AUDIO_TO_FILE
 
+// Below this many voices per thread, the handoff costs more than the mixing.
+static const int SAS_PARALLEL_MIN_VOICES = 4;
+// In voices times samples, roughly 10us of mixing.
+static const int SAS_PARALLEL_MIN_WORK = 8 * 1024;
+static const int SAS_PARALLEL_MAX_CHUNKS = PSP_SAS_VOICES_MAX / SAS_PARALLEL_MIN_VOICES + 1;
+
 static const u8 f[16][2] = {
 	{   0,   0 },
 	{  60,   0 },
@@ -92,6 +103,10 @@ void VagDecoder::DecodeBlock(const u8 *&read_pointer) {
 		}
 	}
 
+	// The filter below depends on each previous sample, but the nibbles can be unpacked all at once.
+	s16 deltas[32];
+	UnpackVagNibbles(read_pointer, shift_factor, deltas);
+
 	// Keep state in locals to avoid bouncing to memory.
 	int s1 = s_1;
 	int s2 = s_2;
@@ -99,13 +114,9 @@ void VagDecoder::DecodeBlock(const u8 *&read_pointer) {
 	int coef1 = f[predict_nr][0];
 	int coef2 = -f[predict_nr][1];
 
-	// TODO: Unroll once more and interleave the unpacking with the decoding more?
 	for (int i = 0; i < 28; i += 2) {
-		u8 d = *readp++;
-		int sample1 = (short)((d & 0xf) << 12) >> shift_factor;
-		int sample2 = (short)((d & 0xf0) << 8) >> shift_factor;
-		s2 = clamp_s16(sample1 + ((s1 * coef1 + s2 * coef2) >> 6));
-		s1 = clamp_s16(sample2 + ((s2 * coef1 + s1 * coef2) >> 6));
+		s2 = clamp_s16(deltas[i] + ((s1 * coef1 + s2 * coef2) >> 6));
+		s1 = clamp_s16(deltas[i + 1] + ((s2 * coef1 + s1 * coef2) >> 6));
 		samples[i] = s2;
 		samples[i + 1] = s1;
 	}
@@ -115,7 +126,47 @@ void VagDecoder::DecodeBlock(const u8 *&read_pointer) {
 	curSample = 0;
 	curBlock_++;
 
-	read_pointer = readp;
+	read_pointer = readp + 14;
+}
+
+void VagDecoder::UnpackVagNibbles(const u8 *block, int shift, s16 deltas[32]) {
+	// Each of the last 14 bytes of the block holds two samples, low nibble first.
+	// They're the top bits of an s16, shifted down (arithmetic) by the block's shift.
+	// Only the first 28 outputs are meaningful.
+#if PPSSPP_ARCH(SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i highMask = _mm_set1_epi16((short)0xF000);
+	const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+	// Always read the whole block rather than past its end.
+	const __m128i data = _mm_srli_si128(_mm_loadu_si128((const __m128i *)block), 2);
+	const __m128i bytes[2] = { _mm_unpacklo_epi8(data, zero), _mm_unpackhi_epi8(data, zero) };
+	for (int i = 0; i < 2; ++i) {
+		__m128i lo = _mm_slli_epi16(bytes[i], 12);
+		__m128i hi = _mm_and_si128(_mm_slli_epi16(bytes[i], 8), highMask);
+		_mm_storeu_si128((__m128i *)deltas + i * 2, _mm_sra_epi16(_mm_unpacklo_epi16(lo, hi), shiftCount));
+		_mm_storeu_si128((__m128i *)deltas + i * 2 + 1, _mm_sra_epi16(_mm_unpackhi_epi16(lo, hi), shiftCount));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint8x16_t data = vextq_u8(vld1q_u8(block), vdupq_n_u8(0), 2);
+	const uint16x8_t highMask = vdupq_n_u16(0xF000);
+	// Negative counts shift right.
+	const int16x8_t shiftCount = vdupq_n_s16((int16_t)-shift);
+	const uint16x8_t bytes[2] = { vmovl_u8(vget_low_u8(data)), vmovl_u8(vget_high_u8(data)) };
+	for (int i = 0; i < 2; ++i) {
+		int16x8_t lo = vreinterpretq_s16_u16(vshlq_n_u16(bytes[i], 12));
+		int16x8_t hi = vreinterpretq_s16_u16(vandq_u16(vshlq_n_u16(bytes[i], 8), highMask));
+		int16x8x2_t zipped = vzipq_s16(lo, hi);
+		vst1q_s16(deltas + i * 16, vshlq_s16(zipped.val[0], shiftCount));
+		vst1q_s16(deltas + i * 16 + 8, vshlq_s16(zipped.val[1], shiftCount));
+	}
+#else
+	const u8 *readp = block + 2;
+	for (int i = 0; i < 28; i += 2) {
+		u8 d = *readp++;
+		deltas[i] = (s16)((short)((d & 0xf) << 12) >> shift);
+		deltas[i + 1] = (s16)((short)((d & 0xf0) << 8) >> shift);
+	}
+#endif
 }
 
 void VagDecoder::GetSamples(s16 *outSamples, int numSamples) {
@@ -375,7 +426,7 @@ SasInstance::SasInstance() {
 	memset(&waveformEffect, 0, sizeof(waveformEffect));
 	waveformEffect.type = PSP_SAS_EFFECT_TYPE_OFF;
 	waveformEffect.isDryOn = 1;
-	memset(mixTemp_, 0, sizeof(mixTemp_));  // just to avoid a static analysis warning.
+	memset(&scratch_, 0, sizeof(scratch_));  // just to avoid a static analysis warning.
 }
 
 SasInstance::~SasInstance() {
@@ -430,6 +481,8 @@ void SasInstance::ClearGrainSize() {
 	sendBuffer = nullptr;
 	sendBufferDownsampled = nullptr;
 	sendBufferProcessed = nullptr;
+	workerScratch_.clear();
+	workerBuffers_.clear();
 }
 
 void SasInstance::SetGrainSize(int newGrainSize) {
@@ -449,6 +502,8 @@ void SasInstance::SetGrainSize(int newGrainSize) {
 	memset(sendBuffer, 0, sizeof(int) * grainSize * 2);
 	memset(sendBufferDownsampled, 0, sizeof(s16) * grainSize);
 	memset(sendBufferProcessed, 0, sizeof(s16) * grainSize * 2);
+	// Sized by grain, so reallocated on next use.
+	workerBuffers_.clear();
 }
 
 int SasInstance::EstimateMixUs() {
@@ -525,7 +580,45 @@ bool SasVoice::HaveSamplesEnded() const {
 	}
 }
 
+// Adds one voice's samples, scaled by volume, to an interleaved stereo buffer.
+static void AccumulateVoice(int *out, const int *samples, int count, int volLeft, int volRight) {
+	int i = 0;
+#if PPSSPP_ARCH(SSE2)
+	// Samples are within s16 after the envelope, and volumes are at most 0x1000, so madd's
+	// 16-bit multiplies are exact.  The high half of each volume lane is zero, so the sign
+	// extension bits of the samples are multiplied away.
+	const __m128i vol = _mm_set_epi32(volRight & 0xFFFF, volLeft & 0xFFFF, volRight & 0xFFFF, volLeft & 0xFFFF);
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+		__m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi32(s, s), vol), 12);
+		__m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi32(s, s), vol), 12);
+		__m128i *dest = (__m128i *)(out + i * 2);
+		_mm_storeu_si128(dest, _mm_add_epi32(_mm_loadu_si128(dest), lo));
+		_mm_storeu_si128(dest + 1, _mm_add_epi32(_mm_loadu_si128(dest + 1), hi));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const int32_t volValues[4] = { volLeft, volRight, volLeft, volRight };
+	const int32x4_t vol = vld1q_s32(volValues);
+	for (; i + 4 <= count; i += 4) {
+		int32x4_t s = vld1q_s32(samples + i);
+		int32x4x2_t pairs = vzipq_s32(s, s);
+		int32_t *dest = out + i * 2;
+		vst1q_s32(dest, vaddq_s32(vld1q_s32(dest), vshrq_n_s32(vmulq_s32(pairs.val[0], vol), 12)));
+		vst1q_s32(dest + 4, vaddq_s32(vld1q_s32(dest + 4), vshrq_n_s32(vmulq_s32(pairs.val[1], vol), 12)));
+	}
+#endif
+	for (; i < count; ++i) {
+		out[i * 2] += (samples[i] * volLeft) >> 12;
+		out[i * 2 + 1] += (samples[i] * volRight) >> 12;
+	}
+}
+
 void SasInstance::MixVoice(SasVoice &voice) {
+	MixVoice(voice, mixBuffer, sendBuffer, scratch_);
+}
+
+void SasInstance::MixVoice(SasVoice &voice, int *mixOut, int *sendOut, MixScratch &scratch) {
+	int16_t *mixTemp = scratch.resample;
 	switch (voice.type) {
 	case VOICETYPE_VAG:
 		if (voice.type == VOICETYPE_VAG && !voice.vagAddr)
@@ -551,22 +644,22 @@ void SasInstance::MixVoice(SasVoice &voice) {
 		// TODO: Special case no-resample case (and 2x and 0.5x) for speed, it's not uncommon
 
 		// Two passes: First read, then resample.
-		mixTemp_[0] = voice.resampleHist[0];
-		mixTemp_[1] = voice.resampleHist[1];
+		mixTemp[0] = voice.resampleHist[0];
+		mixTemp[1] = voice.resampleHist[1];
 
 		int voicePitch = voice.pitch;
 		u32 sampleFrac = voice.sampleFrac;
 		int samplesToRead = (sampleFrac + voicePitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
-		if (samplesToRead > ARRAY_SIZE(mixTemp_) - 2) {
+		if (samplesToRead > ARRAY_SIZE(scratch.resample) - 2) {
 			ERROR_LOG(SCESAS, "Too many samples to read (%d)! This shouldn't happen.", samplesToRead);
-			samplesToRead = ARRAY_SIZE(mixTemp_) - 2;
+			samplesToRead = ARRAY_SIZE(scratch.resample) - 2;
 		}
 		int readPos = 2;
 		if (voice.envelope.NeedsKeyOn()) {
 			readPos = 0;
 			samplesToRead += 2;
 		}
-		voice.ReadSamples(&mixTemp_[readPos], samplesToRead);
+		voice.ReadSamples(&mixTemp[readPos], samplesToRead);
 		int tempPos = readPos + samplesToRead;
 
 		for (int i = 0; i < delay; ++i) {
@@ -576,8 +669,9 @@ void SasInstance::MixVoice(SasVoice &voice) {
 		}
 
 		const bool needsInterp = voicePitch != PSP_SAS_PITCH_BASE || (sampleFrac & PSP_SAS_PITCH_MASK) != 0;
+		int *voiceSamples = scratch.voice;
 		for (int i = delay; i < grainSize; i++) {
-			const int16_t *s = mixTemp_ + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+			const int16_t *s = mixTemp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
 
 			// Linear interpolation. Good enough. Need to make resampleHist bigger if we want more.
 			int sample = s[0];
@@ -595,19 +689,18 @@ void SasInstance::MixVoice(SasVoice &voice) {
 
 			// We just scale by the envelope before we scale by volumes.
 			// Again, we round up by adding (1 << 14) first (*after* multiplying.)
-			sample = ((sample * envelopeValue) + (1 << 14)) >> 15;
-
-			// We mix into this 32-bit temp buffer and clip in a second loop
-			// Ideally, the shift right should be there too but for now I'm concerned about
-			// not overflowing.
-			mixBuffer[i * 2] += (sample * voice.volumeLeft) >> 12;
-			mixBuffer[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
-			sendBuffer[i * 2] += sample * voice.effectLeft >> 12;
-			sendBuffer[i * 2 + 1] += sample * voice.effectRight >> 12;
+			voiceSamples[i] = ((sample * envelopeValue) + (1 << 14)) >> 15;
 		}
 
-		voice.resampleHist[0] = mixTemp_[tempPos - 2];
-		voice.resampleHist[1] = mixTemp_[tempPos - 1];
+		// The envelope has to be walked sample by sample, but volumes can be applied in bulk.
+		// We mix into this 32-bit temp buffer and clip in a second loop
+		// Ideally, the shift right should be there too but for now I'm concerned about
+		// not overflowing.
+		AccumulateVoice(mixOut + delay * 2, voiceSamples + delay, grainSize - delay, voice.volumeLeft, voice.volumeRight);
+		AccumulateVoice(sendOut + delay * 2, voiceSamples + delay, grainSize - delay, voice.effectLeft, voice.effectRight);
+
+		voice.resampleHist[0] = mixTemp[tempPos - 2];
+		voice.resampleHist[1] = mixTemp[tempPos - 1];
 
 		voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;
 
@@ -621,12 +714,57 @@ void SasInstance::MixVoice(SasVoice &voice) {
 	}
 }
 
+void SasInstance::MixVoicesParallel(const int *voiceIndices, int count) {
+	const size_t bufferSize = grainSize * 4;
+	if (workerScratch_.size() < SAS_PARALLEL_MAX_CHUNKS)
+		workerScratch_.resize(SAS_PARALLEL_MAX_CHUNKS);
+	if (workerBuffers_.size() < bufferSize * SAS_PARALLEL_MAX_CHUNKS)
+		workerBuffers_.resize(bufferSize * SAS_PARALLEL_MAX_CHUNKS);
+
+	std::atomic<int> chunks{};
+	ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+		const int chunk = chunks++;
+		_dbg_assert_(chunk < SAS_PARALLEL_MAX_CHUNKS);
+		int *mixOut = &workerBuffers_[bufferSize * chunk];
+		int *sendOut = mixOut + grainSize * 2;
+		memset(mixOut, 0, bufferSize * sizeof(int));
+		for (int i = l; i < h; ++i)
+			MixVoice(voices[voiceIndices[i]], mixOut, sendOut, workerScratch_[chunk]);
+	}, 0, count, SAS_PARALLEL_MIN_VOICES);
+
+	// Integer sums, so the order voices were added in doesn't matter.
+	for (int chunk = 0; chunk < chunks; ++chunk) {
+		const int *mixIn = &workerBuffers_[bufferSize * chunk];
+		const int *sendIn = mixIn + grainSize * 2;
+		for (int i = 0; i < grainSize * 2; ++i) {
+			mixBuffer[i] += mixIn[i];
+			sendBuffer[i] += sendIn[i];
+		}
+	}
+}
+
 void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
+	// VAG voices only read memory, so they can be mixed on other threads.  PCM voices may
+	// notify memory reads, and ATRAC3 voices go through sceAtrac, so those stay here.
+	// Memory tracking isn't thread safe either, so skip threads when it's detailed.
+	int parallelVoices[PSP_SAS_VOICES_MAX];
+	int parallelCount = 0;
+	const bool allowParallel = parallelMix_ && !MemBlockInfoDetailed() && g_threadManager.GetNumLooperThreads() > 1;
 	for (int v = 0; v < PSP_SAS_VOICES_MAX; v++) {
 		SasVoice &voice = voices[v];
 		if (!voice.playing || voice.paused)
 			continue;
-		MixVoice(voice);
+		if (allowParallel && voice.type == VOICETYPE_VAG)
+			parallelVoices[parallelCount++] = v;
+		else
+			MixVoice(voice);
+	}
+
+	if (parallelCount >= SAS_PARALLEL_MIN_VOICES * 2 && parallelCount * grainSize >= SAS_PARALLEL_MIN_WORK) {
+		MixVoicesParallel(parallelVoices, parallelCount);
+	} else {
+		for (int i = 0; i < parallelCount; ++i)
+			MixVoice(voices[parallelVoices[i]]);
 	}
 
 	// Then mix the send buffer in with the rest.
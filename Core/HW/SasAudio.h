@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Core/HW/BufferQueue.h"
 #include "Core/HW/SasReverb.h"
@@ -117,6 +119,8 @@ class VagDecoder {
 	u32 GetReadPtr() const { return read_; }
 
 private:
+	static void UnpackVagNibbles(const u8 *block, int shift, s16 deltas[32]);
+
 	s16 samples[28];
 	int curSample = 0;
 
@@ -316,6 +320,8 @@ class SasInstance {
 
 	void Mix(u32 outAddr, u32 inAddr = 0, int leftVol = 0, int rightVol = 0);
 	void MixVoice(SasVoice &voice);
+	// Mostly for tests, the result is the same either way.
+	void SetParallelMix(bool enabled) { parallelMix_ = enabled; }
 
 	// Applies reverb to send buffer, according to waveformEffect.
 	void ApplyWaveformEffect();
@@ -330,9 +336,23 @@ class SasInstance {
 	WaveformEffect waveformEffect;
 
 private:
+	struct MixScratch {
+		int16_t resample[PSP_SAS_MAX_GRAIN * 4 + 2 + 16];  // some extra margin for very high pitches.
+		int voice[PSP_SAS_MAX_GRAIN];
+	};
+
+	void MixVoice(SasVoice &voice, int *mixOut, int *sendOut, MixScratch &scratch);
+	void MixVoicesParallel(const int *voiceIndices, int count);
+
 	SasReverb reverb_;
 	int grainSize = 0;
-	int16_t mixTemp_[PSP_SAS_MAX_GRAIN * 4 + 2 + 16];  // some extra margin for very high pitches.
+	MixScratch scratch_;
+
+	// Voices mixed on other threads go into their own buffers, which are summed afterward.
+	// Allocated on first use, one set per chunk of voices.
+	bool parallelMix_ = true;
+	std::vector<MixScratch> workerScratch_;
+	std::vector<int> workerBuffers_;
 };
 
 const char *ADSRCurveModeAsString(SasADSRCurveMode mode);
@@ -15,9 +15,11 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 
+#include "Common/Math/CrossSIMD.h"
 #include "Common/Math/math_util.h"
 #include "Core/Config.h"
 #include "Core/HW/SasReverb.h"
@@ -174,11 +176,65 @@ void SasReverb::SetPreset(int preset) {
 	if (preset_ != -1) {
 		pos_ = BUFSIZE - presets[preset_].size;
 		memset(workspace_, 0, sizeof(int16_t) * BUFSIZE);
+		simdSafe_ = CanUseSIMD(presets[preset_]);
+		simdReflect_ = CanReflectSIMD(presets[preset_]);
 	} else {
 		pos_ = 0;
+		simdSafe_ = false;
+		simdReflect_ = false;
 	}
 }
 
+static bool SameTap(const SasReverbData &d, int a, int b) {
+	return (a - b) % d.size == 0;
+}
+
+// The SIMD path reads each group of taps before writing any of them, while the scalar one
+// writes as it goes.  That only matters if a tap reads a spot written earlier in the same group.
+bool SasReverb::CanUseSIMD(const SasReverbData &d) const {
+#if PPSSPP_ARCH(SSE2) || PPSSPP_ARCH(ARM_NEON)
+	auto same = [&](int a, int b) {
+		return SameTap(d, a, b);
+	};
+
+	// Each all pass filter reads its delayed input both before and after writing.
+	if (same(d.dAPF1, 0) || same(d.dAPF2, 0))
+		return false;
+	if (same(d.mRAPF1 - d.dAPF1, d.mLAPF1) || same(d.mRAPF2 - d.dAPF2, d.mLAPF2))
+		return false;
+
+	// The comb taps are summed in pairs, which can only overflow with this.
+	const int16_t coefs[4] = { d.vCOMB1, d.vCOMB2, d.vCOMB3, d.vCOMB4 };
+	for (int16_t coef : coefs) {
+		if (coef == -32768)
+			return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Some presets (like Room) point both different side reflections at the same spot, so the
+// right one reads what the left one just wrote.  Those do the reflections one at a time.
+bool SasReverb::CanReflectSIMD(const SasReverbData &d) const {
+	// In the order the scalar code processes them.
+	const int reflectWrites[4] = { d.mLSAME, d.mRSAME, d.mLDIFF, d.mRDIFF };
+	const int reflectReads[4][2] = {
+		{ d.dLSAME, d.mLSAME - 1 },
+		{ d.dRSAME, d.mRSAME - 1 },
+		{ d.dRDIFF, d.mLDIFF - 1 },
+		{ d.dLDIFF, d.mRDIFF - 1 },
+	};
+	for (int lane = 1; lane < 4; ++lane) {
+		for (int earlier = 0; earlier < lane; ++earlier) {
+			if (SameTap(d, reflectReads[lane][0], reflectWrites[earlier]) || SameTap(d, reflectReads[lane][1], reflectWrites[earlier]))
+				return false;
+		}
+	}
+	return true;
+}
+
 // Wraps around the upper part of a buffer.
 template<int bufsize>
 class BufferWrapper {
@@ -198,6 +254,13 @@ class BufferWrapper {
 			pos_ -= size_;
 		}
 	}
+	// Count must be less than the used size.
+	void Advance(int count) {
+		pos_ += count;
+		if (pos_ >= end_) {
+			pos_ -= size_;
+		}
+	}
 
 private:
 	int16_t *buf_;
@@ -207,6 +270,16 @@ class BufferWrapper {
 	int size_;
 };
 
+template <typename Taps>
+static inline void Reflect(Taps &b, const SasReverbData &d, int16_t Lin, int16_t Rin) {
+	// ____Same Side Reflection(left - to - left and right - to - right)___________________
+	b[d.mLSAME] = clamp_s16(Lin + (b[d.dLSAME] * d.vWALL >> 15) - (b[d.mLSAME - 1]*d.vIIR >> 15) + b[d.mLSAME - 1]); // L - to - L
+	b[d.mRSAME] = clamp_s16(Rin + (b[d.dRSAME] * d.vWALL >> 15) - (b[d.mRSAME - 1]*d.vIIR >> 15) + b[d.mRSAME - 1]); // R - to - R
+	// ___Different Side Reflection(left - to - right and right - to - left)_______________
+	b[d.mLDIFF] = clamp_s16(Lin + (b[d.dRDIFF] * d.vWALL >> 15) - (b[d.mLDIFF - 1]*d.vIIR >> 15) + b[d.mLDIFF - 1]); // R - to - L
+	b[d.mRDIFF] = clamp_s16(Rin + (b[d.dLDIFF] * d.vWALL >> 15) - (b[d.mRDIFF - 1]*d.vIIR >> 15) + b[d.mRDIFF - 1]); // L - to - R
+}
+
 void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight) {
 	// This means replicate the input signal in the processed buffer.
 	// Can also be used to verify that the error is in here...
@@ -230,6 +303,14 @@ void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inpu
 		return;
 	}
 
+	if (simdSafe_ && allowSIMD_) {
+		ProcessPresetSIMD(output, input, inputSize, volLeft, volRight, finalShift);
+	} else {
+		ProcessPreset(output, input, inputSize, volLeft, volRight, finalShift);
+	}
+}
+
+void SasReverb::ProcessPreset(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight, int finalShift) {
 	const SasReverbData &d = presets[preset_];
 
 	// We put this on the stack instead of in the object to let the compiler optimize better (avoid mem r/w).
@@ -246,12 +327,7 @@ void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inpu
 		int16_t Lin = LeftInput; //  (d.vLIN * LeftInput) >> 15;
 		int16_t Rin = RightInput; // (d.vRIN * RightInput) >> 15;
 
-		// ____Same Side Reflection(left - to - left and right - to - right)___________________
-		b[d.mLSAME] = clamp_s16(Lin + (b[d.dLSAME] * d.vWALL >> 15) - (b[d.mLSAME - 1]*d.vIIR >> 15) + b[d.mLSAME - 1]); // L - to - L
-		b[d.mRSAME] = clamp_s16(Rin + (b[d.dRSAME] * d.vWALL >> 15) - (b[d.mRSAME - 1]*d.vIIR >> 15) + b[d.mRSAME - 1]); // R - to - R
-		// ___Different Side Reflection(left - to - right and right - to - left)_______________
-		b[d.mLDIFF] = clamp_s16(Lin + (b[d.dRDIFF] * d.vWALL >> 15) - (b[d.mLDIFF - 1]*d.vIIR >> 15) + b[d.mLDIFF - 1]); // R - to - L
-		b[d.mRDIFF] = clamp_s16(Rin + (b[d.dLDIFF] * d.vWALL >> 15) - (b[d.mRDIFF - 1]*d.vIIR >> 15) + b[d.mRDIFF - 1]); // L - to - R
+		Reflect(b, d, Lin, Rin);
 		// ___Early Echo(Comb Filter, with input from buffer)__________________________
 		int32_t Lout = ((d.vCOMB1*b[d.mLCOMB1] + d.vCOMB2*b[d.mLCOMB2] + d.vCOMB3*b[d.mLCOMB3] + d.vCOMB4*b[d.mLCOMB4]) >> 15);
 		int32_t Rout = ((d.vCOMB1*b[d.mRCOMB1] + d.vCOMB2*b[d.mRCOMB2] + d.vCOMB3*b[d.mRCOMB3] + d.vCOMB4*b[d.mRCOMB4]) >> 15);
@@ -278,3 +354,203 @@ void SasReverb::ProcessReverb(int16_t *output, const int16_t *input, size_t inpu
 	pos_ = b.GetPosition();
 }
 
+#if PPSSPP_ARCH(SSE2) || PPSSPP_ARCH(ARM_NEON)
+
+// For stretches where no tap reaches past either end of the buffer, so nothing wraps.
+struct DirectTaps {
+	int16_t *p;
+	int16_t &operator [](int index) {
+		return p[index];
+	}
+};
+
+struct ReverbCoefs {
+#if PPSSPP_ARCH(SSE2)
+	__m128i wall;
+	__m128i iir;
+	__m128i apf1;
+	__m128i apf2;
+	__m128i comb;
+#else
+	int32x4_t wall;
+	int32x4_t iir;
+	int16x4_t comb;
+#endif
+};
+
+// Same as the loop body in ProcessPreset(), but the four reflections, the comb taps, and the
+// left and right all pass filters each go through together.  Every step depends on the
+// previous sample, so it's still one sample at a time.
+#if PPSSPP_ARCH(SSE2)
+
+// Lanes 0 and 2 are left and right, matching the comb sums.  Saturates like clamp_s16().
+template <typename Taps>
+static inline __m128i AllPassSIMD(Taps &b, __m128i out, __m128i coef, int dist, int mL, int mR) {
+	const __m128i delayed = _mm_setr_epi32(b[mL - dist], 0, b[mR - dist], 0);
+	__m128i w = _mm_sub_epi32(out, _mm_srai_epi32(_mm_madd_epi16(delayed, coef), 15));
+	w = _mm_packs_epi32(w, w);
+	b[mL] = (int16_t)_mm_extract_epi16(w, 0);
+	b[mR] = (int16_t)_mm_extract_epi16(w, 2);
+	w = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16);
+	return _mm_add_epi32(delayed, _mm_srai_epi32(_mm_madd_epi16(w, coef), 15));
+}
+
+template <typename Taps>
+static inline void ReverbSampleSIMD(Taps &b, const SasReverbData &d, const ReverbCoefs &c, bool simdReflect, int16_t Lin, int16_t Rin, int32_t *Lout, int32_t *Rout) {
+	if (simdReflect) {
+		// Same side (L, R) then different side (L, R) reflections.
+		const __m128i in = _mm_setr_epi32(Lin, Rin, Lin, Rin);
+		const __m128i wallTaps = _mm_setr_epi32(b[d.dLSAME], b[d.dRSAME], b[d.dRDIFF], b[d.dLDIFF]);
+		const __m128i prev = _mm_setr_epi32(b[d.mLSAME - 1], b[d.mRSAME - 1], b[d.mLDIFF - 1], b[d.mRDIFF - 1]);
+		__m128i reflect = _mm_add_epi32(in, _mm_srai_epi32(_mm_madd_epi16(wallTaps, c.wall), 15));
+		reflect = _mm_add_epi32(_mm_sub_epi32(reflect, _mm_srai_epi32(_mm_madd_epi16(prev, c.iir), 15)), prev);
+		reflect = _mm_packs_epi32(reflect, reflect);
+		b[d.mLSAME] = (int16_t)_mm_extract_epi16(reflect, 0);
+		b[d.mRSAME] = (int16_t)_mm_extract_epi16(reflect, 1);
+		b[d.mLDIFF] = (int16_t)_mm_extract_epi16(reflect, 2);
+		b[d.mRDIFF] = (int16_t)_mm_extract_epi16(reflect, 3);
+	} else {
+		Reflect(b, d, Lin, Rin);
+	}
+
+	// Early echo, each side's four taps in one half.  Pairs first, then the halves of each side.
+	const __m128i combTaps = _mm_setr_epi16(b[d.mLCOMB1], b[d.mLCOMB2], b[d.mLCOMB3], b[d.mLCOMB4], b[d.mRCOMB1], b[d.mRCOMB2], b[d.mRCOMB3], b[d.mRCOMB4]);
+	__m128i out = _mm_madd_epi16(combTaps, c.comb);
+	out = _mm_srai_epi32(_mm_add_epi32(out, _mm_srli_epi64(out, 32)), 15);
+
+	out = AllPassSIMD(b, out, c.apf1, d.dAPF1, d.mLAPF1, d.mRAPF1);
+	out = AllPassSIMD(b, out, c.apf2, d.dAPF2, d.mLAPF2, d.mRAPF2);
+
+	*Lout = _mm_cvtsi128_si32(out);
+	*Rout = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+}
+
+#else
+
+// Lanes 0 and 1 are left and right.  vqmovn saturates like clamp_s16().
+template <typename Taps>
+static inline int32x2_t AllPassSIMD(Taps &b, int32x2_t out, int coef, int dist, int mL, int mR) {
+	const int32_t delayedValues[2] = { b[mL - dist], b[mR - dist] };
+	const int32x2_t delayed = vld1_s32(delayedValues);
+	const int32x2_t c = vdup_n_s32(coef);
+	const int32x2_t w = vsub_s32(out, vshr_n_s32(vmul_s32(delayed, c), 15));
+	const int16x4_t clamped = vqmovn_s32(vcombine_s32(w, w));
+	b[mL] = vget_lane_s16(clamped, 0);
+	b[mR] = vget_lane_s16(clamped, 1);
+	return vadd_s32(delayed, vshr_n_s32(vmul_s32(vget_low_s32(vmovl_s16(clamped)), c), 15));
+}
+
+template <typename Taps>
+static inline void ReverbSampleSIMD(Taps &b, const SasReverbData &d, const ReverbCoefs &c, bool simdReflect, int16_t Lin, int16_t Rin, int32_t *Lout, int32_t *Rout) {
+	if (simdReflect) {
+		// Same side (L, R) then different side (L, R) reflections.
+		const int32_t inValues[4] = { Lin, Rin, Lin, Rin };
+		const int32_t wallValues[4] = { b[d.dLSAME], b[d.dRSAME], b[d.dRDIFF], b[d.dLDIFF] };
+		const int32_t prevValues[4] = { b[d.mLSAME - 1], b[d.mRSAME - 1], b[d.mLDIFF - 1], b[d.mRDIFF - 1] };
+		const int32x4_t prev = vld1q_s32(prevValues);
+		int32x4_t reflect = vaddq_s32(vld1q_s32(inValues), vshrq_n_s32(vmulq_s32(vld1q_s32(wallValues), c.wall), 15));
+		reflect = vaddq_s32(vsubq_s32(reflect, vshrq_n_s32(vmulq_s32(prev, c.iir), 15)), prev);
+		const int16x4_t reflected = vqmovn_s32(reflect);
+		b[d.mLSAME] = vget_lane_s16(reflected, 0);
+		b[d.mRSAME] = vget_lane_s16(reflected, 1);
+		b[d.mLDIFF] = vget_lane_s16(reflected, 2);
+		b[d.mRDIFF] = vget_lane_s16(reflected, 3);
+	} else {
+		Reflect(b, d, Lin, Rin);
+	}
+
+	// Early echo, then pairwise sums down to one per side.
+	const int16_t leftTaps[4] = { b[d.mLCOMB1], b[d.mLCOMB2], b[d.mLCOMB3], b[d.mLCOMB4] };
+	const int16_t rightTaps[4] = { b[d.mRCOMB1], b[d.mRCOMB2], b[d.mRCOMB3], b[d.mRCOMB4] };
+	const int32x4_t left = vmull_s16(vld1_s16(leftTaps), c.comb);
+	const int32x4_t right = vmull_s16(vld1_s16(rightTaps), c.comb);
+	const int32x2_t sums = vpadd_s32(vpadd_s32(vget_low_s32(left), vget_high_s32(left)), vpadd_s32(vget_low_s32(right), vget_high_s32(right)));
+	int32x2_t out = vshr_n_s32(sums, 15);
+
+	out = AllPassSIMD(b, out, d.vAPF1, d.dAPF1, d.mLAPF1, d.mRAPF1);
+	out = AllPassSIMD(b, out, d.vAPF2, d.dAPF2, d.mLAPF2, d.mRAPF2);
+
+	*Lout = vget_lane_s32(out, 0);
+	*Rout = vget_lane_s32(out, 1);
+}
+
+#endif
+
+// The range of offsets from the current position that a sample reads or writes.
+static void GetTapRange(const SasReverbData &d, int *minTap, int *maxTap) {
+	const int taps[] = {
+		d.dLSAME, d.dRSAME, d.dLDIFF, d.dRDIFF,
+		d.mLSAME - 1, d.mRSAME - 1, d.mLDIFF - 1, d.mRDIFF - 1,
+		d.mLSAME, d.mRSAME, d.mLDIFF, d.mRDIFF,
+		d.mLCOMB1, d.mLCOMB2, d.mLCOMB3, d.mLCOMB4,
+		d.mRCOMB1, d.mRCOMB2, d.mRCOMB3, d.mRCOMB4,
+		d.mLAPF1 - d.dAPF1, d.mRAPF1 - d.dAPF1, d.mLAPF1, d.mRAPF1,
+		d.mLAPF2 - d.dAPF2, d.mRAPF2 - d.dAPF2, d.mLAPF2, d.mRAPF2,
+	};
+	*minTap = 0;
+	*maxTap = 0;
+	for (int tap : taps) {
+		*minTap = std::min(*minTap, tap);
+		*maxTap = std::max(*maxTap, tap);
+	}
+}
+
+#endif
+
+void SasReverb::ProcessPresetSIMD(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight, int finalShift) {
+#if PPSSPP_ARCH(SSE2) || PPSSPP_ARCH(ARM_NEON)
+	const SasReverbData &d = presets[preset_];
+
+	ReverbCoefs c;
+#if PPSSPP_ARCH(SSE2)
+	// With zero in the top half, madd multiplies just the low (s16) half of each lane, exactly.
+	c.wall = _mm_set1_epi32((uint16_t)d.vWALL);
+	c.iir = _mm_set1_epi32((uint16_t)d.vIIR);
+	c.apf1 = _mm_set1_epi32((uint16_t)d.vAPF1);
+	c.apf2 = _mm_set1_epi32((uint16_t)d.vAPF2);
+	c.comb = _mm_setr_epi16(d.vCOMB1, d.vCOMB2, d.vCOMB3, d.vCOMB4, d.vCOMB1, d.vCOMB2, d.vCOMB3, d.vCOMB4);
+#else
+	const int16_t combValues[4] = { d.vCOMB1, d.vCOMB2, d.vCOMB3, d.vCOMB4 };
+	c.wall = vdupq_n_s32(d.vWALL);
+	c.iir = vdupq_n_s32(d.vIIR);
+	c.comb = vld1_s16(combValues);
+#endif
+
+	int minTap, maxTap;
+	GetTapRange(d, &minTap, &maxTap);
+	const int base = BUFSIZE - d.size;
+
+	BufferWrapper<BUFSIZE> b(workspace_, pos_, d.size);
+	auto finish = [&](size_t i, int32_t Lout, int32_t Rout) {
+		output[i * 4 + 0] = clamp_s16((Lout * volLeft) >> finalShift);
+		output[i * 4 + 1] = clamp_s16((Rout * volRight) >> finalShift);
+		output[i * 4 + 2] = 0;
+		output[i * 4 + 3] = 0;
+	};
+
+	size_t i = 0;
+	while (i < inputSize) {
+		const int pos = b.GetPosition();
+		int32_t Lout, Rout;
+		// Until the furthest tap reaches the end of the buffer, nothing wraps.
+		const int direct = pos + minTap >= base ? BUFSIZE - maxTap - pos : 0;
+		if (direct > 0) {
+			const size_t count = std::min(inputSize - i, (size_t)direct);
+			DirectTaps taps{ workspace_ + pos };
+			for (size_t end = i + count; i < end; ++i, ++taps.p) {
+				ReverbSampleSIMD(taps, d, c, simdReflect_, input[i * 2] >> 1, input[i * 2 + 1] >> 1, &Lout, &Rout);
+				finish(i, Lout, Rout);
+			}
+			b.Advance((int)count);
+		} else {
+			ReverbSampleSIMD(b, d, c, simdReflect_, input[i * 2] >> 1, input[i * 2 + 1] >> 1, &Lout, &Rout);
+			finish(i, Lout, Rout);
+			b.Next();
+			++i;
+		}
+	}
+
+	// Save the state in the object.
+	pos_ = b.GetPosition();
+#endif
+}
@@ -32,13 +32,24 @@ class SasReverb {
 	// Input should be a mixdown of all the channels that have reverb enabled, at 22khz.
 	// Output is written back at 44khz.
 	void ProcessReverb(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight);
+	// Mostly for tests, the output is the same either way.
+	void SetAllowSIMD(bool allow) { allowSIMD_ = allow; }
 
 private:
 	enum {
 		BUFSIZE = 0x20000,
 	};
 
+	void ProcessPreset(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight, int finalShift);
+	void ProcessPresetSIMD(int16_t *output, const int16_t *input, size_t inputSize, uint16_t volLeft, uint16_t volRight, int finalShift);
+	bool CanUseSIMD(const SasReverbData &d) const;
+	bool CanReflectSIMD(const SasReverbData &d) const;
+
 	int16_t *workspace_;
 	int preset_;
 	int pos_;
+	// Whether the current preset's taps can be read all at once, see CanUseSIMD().
+	bool simdSafe_ = false;
+	bool simdReflect_ = false;
+	bool allowSIMD_ = true;
 };
\ No newline at end of file
@@ -32,7 +32,16 @@
 #define CONTROL_FACTOR  0.2f // in freq_shift per fifo size offset
 #define CONTROL_AVG     32.0f
 
+// For the high quality resampler.  Taps are in stereo samples, centered on the read position.
+#define POLYPHASE_TAPS 16
+#define POLYPHASE_PHASE_BITS 8
+#define POLYPHASE_PHASES (1 << POLYPHASE_PHASE_BITS)
+#define POLYPHASE_SHIFT 14
+// Relative to the input's Nyquist frequency.  Hosts mostly output at 44100 or 48000, so there's little to lose.
+#define POLYPHASE_CUTOFF 0.9
+
 #include "ppsspp_config.h"
+#include <cmath>
 #include <cstring>
 #include <atomic>
 
@@ -160,6 +169,45 @@ inline void ClampBufferToS16WithVolume(s16 *out, const s32 *in, size_t size) {
 	}
 }
 
+// A windowed sinc per fractional position, so resampling is just a short dot product.
+// The drift control changes the ratio all the time, but it stays near 1:1, so one cutoff works.
+struct PolyphaseFilter {
+	PolyphaseFilter() {
+		const double pi = 3.14159265358979323846;
+		for (int phase = 0; phase <= POLYPHASE_PHASES; ++phase) {
+			double taps[POLYPHASE_TAPS];
+			double sum = 0.0;
+			for (int i = 0; i < POLYPHASE_TAPS; ++i) {
+				const double x = (double)(i - (POLYPHASE_TAPS / 2 - 1)) - (double)phase / POLYPHASE_PHASES;
+				const double sinc = x == 0.0 ? 1.0 : sin(pi * POLYPHASE_CUTOFF * x) / (pi * POLYPHASE_CUTOFF * x);
+				// Blackman window over the span of the taps.
+				const double w = 2.0 * pi * x / (POLYPHASE_TAPS + 1);
+				taps[i] = sinc * (0.42 + 0.5 * cos(w) + 0.08 * cos(2.0 * w));
+				sum += taps[i];
+			}
+
+			// Each phase must add up to exactly 1.0, or the output gets a ripple as the phase moves.
+			int total = 0;
+			int largest = 0;
+			for (int i = 0; i < POLYPHASE_TAPS; ++i) {
+				coefs[phase][i] = (int16_t)lrint(taps[i] / sum * (1 << POLYPHASE_SHIFT));
+				total += coefs[phase][i];
+				if (abs(coefs[phase][i]) > abs(coefs[phase][largest]))
+					largest = i;
+			}
+			coefs[phase][largest] += (1 << POLYPHASE_SHIFT) - total;
+		}
+	}
+
+	// One extra, so rounding to the nearest phase doesn't need to carry into the position.
+	int16_t coefs[POLYPHASE_PHASES + 1][POLYPHASE_TAPS];
+};
+
+static const PolyphaseFilter &GetPolyphaseFilter() {
+	static const PolyphaseFilter filter;
+	return filter;
+}
+
 void StereoResampler::Clear() {
 	memset(m_buffer, 0, m_maxBufsize * 2 * sizeof(int16_t));
 }
@@ -173,6 +221,8 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 	if (!samples)
 		return 0;
 
+	UpdateCallbackStats(numSamples, sample_rate);
+
 	unsigned int currentSample;
 
 	// Cache access in non-volatile variable
@@ -182,8 +232,9 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 	// so we will just ignore new written data while interpolating (until it wraps...).
 	// Without this cache, the compiler wouldn't be allowed to optimize the
 	// interpolation loop.
-	u32 indexR = m_indexR.load();
-	u32 indexW = m_indexW.load();
+	u32 indexR = m_indexR.load(std::memory_order_relaxed);
+	// Pairs with the release in PushSamples, so the samples before indexW are visible.
+	u32 indexW = m_indexW.load(std::memory_order_acquire);
 
 	const int INDEX_MASK = (m_maxBufsize * 2 - 1);
 
@@ -213,29 +264,17 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 	output_sample_rate_ = (float)(m_input_sample_rate + offset);
 	const u32 ratio = (u32)(65536.0 * output_sample_rate_ / (double)sample_rate);
 	ratio_ = ratio;
-	// TODO: consider a higher-quality resampling algorithm.
 	// TODO: Add a fast path for 1:1.
-	u32 frac = m_frac;
-	for (currentSample = 0; currentSample < numSamples * 2; currentSample += 2) {
-		if (((indexW - indexR) & INDEX_MASK) <= 2) {
-			// Ran out!
-			// int missing = numSamples * 2 - currentSample;
-			// ILOG("Resampler underrun: %d (numSamples: %d, currentSample: %d)", missing, numSamples, currentSample / 2);
-			underrunCount_++;
-			break;
-		}
-		u32 indexR2 = indexR + 2; //next sample
-		s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
-		s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
-		s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
-		s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
-		samples[currentSample] = MixSingleSample(l1, l2, (u16)frac);
-		samples[currentSample + 1] = MixSingleSample(r1, r2, (u16)frac);
-		frac += ratio;
-		indexR += 2 * (frac >> 16);
-		frac &= 0xffff;
+	if (g_Config.bHighQualityResampler) {
+		currentSample = MixPolyphase(samples, numSamples, indexR, indexW, ratio, INDEX_MASK) * 2;
+	} else {
+		currentSample = MixLinear(samples, numSamples, indexR, indexW, ratio, INDEX_MASK) * 2;
+	}
+	if (currentSample < numSamples * 2) {
+		// Ran out!
+		underrunCount_++;
+		underrunSamples_ += numSamples - currentSample / 2;
 	}
-	m_frac = frac;
 
 	// Let's not count the underrun padding here.
 	outputSampleCount_ += currentSample / 2;
@@ -249,13 +288,74 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 		samples[currentSample + 1] = s[1];
 	}
 
-	// Flush cached variable
-	m_indexR.store(indexR);
+	// Flush cached variable.  Pairs with the acquire in PushSamples, so the space isn't reused while we read it.
+	m_indexR.store(indexR, std::memory_order_release);
 
 	// TODO: What should we actually return here?
 	return currentSample / 2;
 }
 
+unsigned int StereoResampler::MixLinear(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio, u32 indexMask) {
+	u32 frac = m_frac;
+	unsigned int currentSample;
+	for (currentSample = 0; currentSample < numSamples * 2; currentSample += 2) {
+		if (((indexW - indexR) & indexMask) <= 2)
+			break;
+		u32 indexR2 = indexR + 2; //next sample
+		s16 l1 = m_buffer[indexR & indexMask]; //current
+		s16 r1 = m_buffer[(indexR + 1) & indexMask]; //current
+		s16 l2 = m_buffer[indexR2 & indexMask]; //next
+		s16 r2 = m_buffer[(indexR2 + 1) & indexMask]; //next
+		samples[currentSample] = MixSingleSample(l1, l2, (u16)frac);
+		samples[currentSample + 1] = MixSingleSample(r1, r2, (u16)frac);
+		frac += ratio;
+		indexR += 2 * (frac >> 16);
+		frac &= 0xffff;
+	}
+	m_frac = frac;
+	return currentSample / 2;
+}
+
+unsigned int StereoResampler::MixPolyphase(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio, u32 indexMask) {
+	const PolyphaseFilter &filter = GetPolyphaseFilter();
+	const int round = 1 << (POLYPHASE_SHIFT - 1);
+
+	u32 frac = m_frac;
+	unsigned int currentSample;
+	for (currentSample = 0; currentSample < numSamples * 2; currentSample += 2) {
+		// Needs the samples after the read position too.  The ones before are kept by PushSamples.
+		if (((indexW - indexR) & indexMask) <= POLYPHASE_TAPS)
+			break;
+		const int16_t *coefs = filter.coefs[(frac + (1 << (15 - POLYPHASE_PHASE_BITS))) >> (16 - POLYPHASE_PHASE_BITS)];
+		const u32 first = indexR - (POLYPHASE_TAPS / 2 - 1) * 2;
+		int left = round;
+		int right = round;
+		for (int i = 0; i < POLYPHASE_TAPS; ++i) {
+			left += m_buffer[(first + i * 2) & indexMask] * coefs[i];
+			right += m_buffer[(first + i * 2 + 1) & indexMask] * coefs[i];
+		}
+		samples[currentSample] = clamp_s16(left >> POLYPHASE_SHIFT);
+		samples[currentSample + 1] = clamp_s16(right >> POLYPHASE_SHIFT);
+		frac += ratio;
+		indexR += 2 * (frac >> 16);
+		frac &= 0xffff;
+	}
+	m_frac = frac;
+	return currentSample / 2;
+}
+
+void StereoResampler::UpdateCallbackStats(unsigned int numSamples, int sampleRate) {
+	const double now = time_now_d();
+	if (lastMixTime_ != 0.0) {
+		const double jitter = fabs((now - lastMixTime_) - lastMixDuration_);
+		jitterSum_ += jitter;
+		jitterMax_ = std::max(jitterMax_, jitter);
+		jitterCount_++;
+	}
+	lastMixTime_ = now;
+	lastMixDuration_ = sampleRate > 0 ? (double)numSamples / sampleRate : 0.0;
+}
+
 // Executes on the emulator thread, pushing sound into the buffer.
 void StereoResampler::PushSamples(const s32 *samples, unsigned int numSamples) {
 	inputSampleCount_ += numSamples;
@@ -265,7 +365,9 @@ void StereoResampler::PushSamples(const s32 *samples, unsigned int numSamples) {
 	// Cache access in non-volatile variable
 	// indexR isn't allowed to cache in the audio throttling loop as it
 	// needs to get updates to not deadlock.
-	u32 indexW = m_indexW.load();
+	u32 indexW = m_indexW.load(std::memory_order_relaxed);
+	// Pairs with the release in Mix, so we don't overwrite samples it's still reading.
+	u32 indexR = m_indexR.load(std::memory_order_acquire);
 
 	u32 cap = m_maxBufsize * 2;
 	// If fast-forwarding, no need to fill up the entire buffer, just screws up timing after releasing the fast-forward button.
@@ -275,7 +377,8 @@ void StereoResampler::PushSamples(const s32 *samples, unsigned int numSamples) {
 
 	// Check if we have enough free space
 	// indexW == m_indexR results in empty buffer, so indexR must always be smaller than indexW
-	if (numSamples * 2 + ((indexW - m_indexR.load()) & INDEX_MASK) >= cap) {
+	// The high quality resampler also reads some samples behind indexR, so keep those too.
+	if (numSamples * 2 + ((indexW - indexR) & INDEX_MASK) + POLYPHASE_TAPS >= cap) {
 		if (!PSP_CoreParameter().fastForward) {
 			overrunCount_++;
 		}
@@ -292,7 +395,7 @@ void StereoResampler::PushSamples(const s32 *samples, unsigned int numSamples) {
 		ClampBufferToS16WithVolume(&m_buffer[indexW & INDEX_MASK], samples, numSamples * 2);
 	}
 
-	m_indexW += numSamples * 2;
+	m_indexW.store(indexW + numSamples * 2, std::memory_order_release);
 	lastPushSize_ = numSamples;
 }
 
@@ -304,8 +407,9 @@ void StereoResampler::GetAudioDebugStats(char *buf, size_t bufSize) {
 	snprintf(buf, bufSize,
 		"Audio buffer: %d/%d (target: %d)\n"
 		"Filtered: %0.2f\n"
-		"Underruns: %d\n"
+		"Underruns: %d (%d samples)\n"
 		"Overruns: %d\n"
+		"Callback jitter: %0.2f ms (max %0.2f ms)\n"
 		"Sample rate: %d (input: %d)\n"
 		"Effective input sample rate: %0.2f\n"
 		"Effective output sample rate: %0.2f\n"
@@ -316,7 +420,10 @@ void StereoResampler::GetAudioDebugStats(char *buf, size_t bufSize) {
 		m_targetBufsize,
 		m_numLeftI,
 		underrunCountTotal_,
+		underrunSamples_,
 		overrunCountTotal_,
+		jitterCount_ > 0 ? jitterSum_ * 1000.0 / jitterCount_ : 0.0,
+		jitterMax_ * 1000.0,
 		(int)output_sample_rate_,
 		m_input_sample_rate,
 		effective_input_sample_rate,
@@ -339,6 +446,10 @@ void StereoResampler::ResetStatCounters() {
 	overrunCount_ = 0;
 	underrunCountTotal_ = 0;
 	overrunCountTotal_ = 0;
+	underrunSamples_ = 0;
+	jitterSum_ = 0.0;
+	jitterMax_ = 0.0;
+	jitterCount_ = 0;
 	inputSampleCount_ = 0;
 	outputSampleCount_ = 0;
 	startTime_ = time_now_d();
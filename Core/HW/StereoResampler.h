@@ -45,31 +45,47 @@ class StereoResampler {
 
 private:
 	void UpdateBufferSize();
+	// Both return the number of stereo samples written, and advance indexR and m_frac.
+	unsigned int MixLinear(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio, u32 indexMask);
+	unsigned int MixPolyphase(short *samples, unsigned int numSamples, u32 &indexR, u32 indexW, u32 ratio, u32 indexMask);
+	void UpdateCallbackStats(unsigned int numSamples, int sampleRate);
 
 	int m_maxBufsize;
 	int m_targetBufsize;
 
 	unsigned int m_input_sample_rate = 44100;
 	int16_t *m_buffer;
-	std::atomic<u32> m_indexW;
-	std::atomic<u32> m_indexR;
-	float m_numLeftI = 0.0f;
 
+	// The ring has one writer (the emulator thread) and one reader (the audio thread), so it needs no lock.
+	// Each index is only written by its own thread, and they're on separate cache lines so that
+	// each push and mix doesn't have to take the line back from the other thread.
+	alignas(64) std::atomic<u32> m_indexW{};
+	// Only used by the emulator thread.
+	int lastPushSize_ = 0;
+	int overrunCount_ = 0;
+	int64_t inputSampleCount_ = 0;
+
+	alignas(64) std::atomic<u32> m_indexR{};
+	// Only used by the audio thread, other than the stats.
+	float m_numLeftI = 0.0f;
 	u32 m_frac = 0;
 	float output_sample_rate_ = 0.0;
 	int lastBufSize_ = 0;
-	int lastPushSize_ = 0;
 	u32 ratio_ = 0;
-
 	int underrunCount_ = 0;
-	int overrunCount_ = 0;
-	int underrunCountTotal_ = 0;
-	int overrunCountTotal_ = 0;
-
+	int underrunSamples_ = 0;
 	int droppedSamples_ = 0;
-
-	int64_t inputSampleCount_ = 0;
 	int64_t outputSampleCount_ = 0;
 
+	// How far apart the host's callbacks are from the time the previous one's samples took to play.
+	double lastMixTime_ = 0.0;
+	double lastMixDuration_ = 0.0;
+	double jitterSum_ = 0.0;
+	double jitterMax_ = 0.0;
+	int jitterCount_ = 0;
+
+	int underrunCountTotal_ = 0;
+	int overrunCountTotal_ = 0;
+
 	double startTime_ = 0.0;
 };
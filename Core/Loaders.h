@@ -65,6 +65,14 @@ class FileLoader {
 		HINT_UNCACHED,
 	};
 
+	struct ReadRequest {
+		s64 pos;
+		size_t bytes;
+		void *data;
+		// Bytes actually read.
+		size_t result;
+	};
+
 	virtual ~FileLoader() {}
 
 	virtual bool IsRemote() {
@@ -82,6 +90,14 @@ class FileLoader {
 	virtual size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) {
 		return ReadAt(absolutePos, 1, bytes, data, flags);
 	}
+	// Independent reads, which some loaders can have in flight at the same time.
+	virtual void ReadAtMultiple(ReadRequest *requests, size_t count, Flags flags = Flags::NONE) {
+		for (size_t i = 0; i < count; ++i)
+			requests[i].result = ReadAt(requests[i].pos, requests[i].bytes, requests[i].data, flags);
+	}
+
+	// Hint that this range will likely be read soon.  May block, so call from a background thread.
+	virtual void Prefetch(s64 absolutePos, size_t bytes) {}
 
 	// Cancel any operations that might block, if possible.
 	virtual void Cancel() {}
@@ -117,6 +133,9 @@ class ProxiedFileLoader : public FileLoader {
 	Path GetPath() const override {
 		return backend_->GetPath();
 	}
+	void Prefetch(s64 absolutePos, size_t bytes) override {
+		backend_->Prefetch(absolutePos, bytes);
+	}
 	void Cancel() override {
 		backend_->Cancel();
 	}
@@ -79,6 +79,9 @@ u32 g_PSPModel;
 
 std::recursive_mutex g_shutdownLock;
 
+static BulkStateCallback bulkStateCallback = nullptr;
+static void *bulkStateUserdata = nullptr;
+
 // We don't declare the IO region in here since its handled by other means.
 static MemoryView views[] =
 {
@@ -324,6 +327,8 @@ void Reinit() {
 	Core_NotifyLifecycle(CoreLifecycle::MEMORY_REINITED);
 }
 
+static const uint32_t DO_MEMORY_PIECE_SIZE = 4 * 1024 * 1024;
+
 static void DoMemoryVoid(PointerWrap &p, uint32_t start, uint32_t size) {
 	uint8_t *d = GetPointerWrite(start);
 	uint8_t *&storage = *p.ptr;
@@ -334,7 +339,13 @@ static void DoMemoryVoid(PointerWrap &p, uint32_t start, uint32_t size) {
 
 	switch (p.mode) {
 	case PointerWrap::MODE_READ:
-		ParallelMemcpy(&g_threadManager, d, storage, size);
+		// The state may still be loading, so copy each piece as soon as it's ready.
+		for (uint32_t pos = 0; pos < size; pos += DO_MEMORY_PIECE_SIZE) {
+			uint32_t pieceSize = std::min(size - pos, DO_MEMORY_PIECE_SIZE);
+			if (!p.WaitForData(pos + pieceSize))
+				break;
+			ParallelMemcpy(&g_threadManager, d + pos, storage + pos, pieceSize);
+		}
 		break;
 	case PointerWrap::MODE_WRITE:
 		ParallelMemcpy(&g_threadManager, storage, d, size);
@@ -386,15 +397,24 @@ void DoState(PointerWrap &p) {
 		}
 	}
 
-	DoMemoryVoid(p, PSP_GetKernelMemoryBase(), g_MemorySize);
-	p.DoMarker("RAM");
+	if (bulkStateCallback) {
+		bulkStateCallback(p, bulkStateUserdata);
+	} else {
+		DoMemoryVoid(p, PSP_GetKernelMemoryBase(), g_MemorySize);
+		p.DoMarker("RAM");
 
-	DoMemoryVoid(p, PSP_GetVidMemBase(), VRAM_SIZE);
-	p.DoMarker("VRAM");
+		DoMemoryVoid(p, PSP_GetVidMemBase(), VRAM_SIZE);
+		p.DoMarker("VRAM");
+	}
 	DoArray(p, m_pPhysicalScratchPad, SCRATCHPAD_SIZE);
 	p.DoMarker("ScratchPad");
 }
 
+void SetBulkStateCallback(BulkStateCallback callback, void *userdata) {
+	bulkStateCallback = callback;
+	bulkStateUserdata = userdata;
+}
+
 void Shutdown() {
 	std::lock_guard<std::recursive_mutex> guard(g_shutdownLock);
 	u32 flags = 0;
@@ -113,6 +113,10 @@ bool Init();
 void Shutdown();
 void DoState(PointerWrap &p);
 void Clear();
+// While set, DoState leaves RAM and VRAM out of the stream and calls this instead.
+// Used by rewind, which keeps track of them per page.
+typedef void (*BulkStateCallback)(PointerWrap &p, void *userdata);
+void SetBulkStateCallback(BulkStateCallback callback, void *userdata);
 // False when shutdown has already been called.
 bool IsActive();
 
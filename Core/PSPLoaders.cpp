@@ -82,6 +82,7 @@ void InitMemoryForGameISO(FileLoader *fileLoader) {
 
 	std::shared_ptr<IFileSystem> fileSystem;
 	std::shared_ptr<IFileSystem> blockSystem;
+	std::shared_ptr<ISOFileSystem> iso;
 
 	if (fileLoader->IsDirectory()) {
 		fileSystem = std::make_shared<VirtualDiscFileSystem>(&pspFileSystem, fileLoader->GetPath());
@@ -92,7 +93,7 @@ void InitMemoryForGameISO(FileLoader *fileLoader) {
 		if (!bd)
 			return;
 
-		auto iso = std::make_shared<ISOFileSystem>(&pspFileSystem, bd);
+		iso = std::make_shared<ISOFileSystem>(&pspFileSystem, bd);
 		fileSystem = iso;
 		blockSystem = std::make_shared<ISOBlockSystem>(iso);
 	}
@@ -124,6 +125,11 @@ void InitMemoryForGameISO(FileLoader *fileLoader) {
 		}
 	}
 
+	// Tests shouldn't leave files behind.
+	if (iso && !gameID.empty() && g_Config.bBootPrefetch && !PSP_CoreParameter().headLess) {
+		iso->StartBootIOProfile(g_Config.getGameConfigFile(gameID).NavigateUp() / (gameID + "_bootio.txt"));
+	}
+
 	for (size_t i = 0; i < g_HDRemastersCount; i++) {
 		const auto &entry = g_HDRemasters[i];
 		if (entry.gameID != gameID) {
@@ -19,8 +19,10 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <zstd.h>
 
 #include "Common/Data/Text/I18n.h"
+#include "Common/Thread/ParallelLoop.h"
 #include "Common/Thread/ThreadUtil.h"
 #include "Common/Data/Text/Parsers.h"
 #include "Common/System/System.h"
@@ -30,6 +32,7 @@
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/StringUtils.h"
 #include "Common/TimeUtil.h"
+#include "Common/Thread/ThreadManager.h"
 
 #include "Core/SaveState.h"
 #include "Core/Config.h"
@@ -90,9 +93,26 @@ namespace SaveState
 		void *cbUserData;
 	};
 
+	// Both RAM and VRAM sizes are multiples of this.
+	static const int MEMORY_PAGE_SIZE = 4096;
+
+	// Pages are numbered through RAM and then VRAM.
+	static u8 *MemoryPagePtr(size_t page) {
+		size_t ramPages = Memory::g_MemorySize / MEMORY_PAGE_SIZE;
+		if (page < ramPages)
+			return Memory::GetPointerWriteUnchecked(PSP_GetKernelMemoryBase()) + page * MEMORY_PAGE_SIZE;
+		return Memory::GetPointerWriteUnchecked(PSP_GetVidMemBase()) + (page - ramPages) * MEMORY_PAGE_SIZE;
+	}
+
+	static size_t MemoryPageCount() {
+		return (Memory::g_MemorySize + Memory::VRAM_SIZE) / MEMORY_PAGE_SIZE;
+	}
+
 	CChunkFileReader::Error SaveToRam(std::vector<u8> &data) {
+		// Only used from the emu thread, and frequently for rewind.
+		static PointerWrapArena arena;
 		SaveStart state;
-		return CChunkFileReader::MeasureAndSavePtr(state, &data);
+		return CChunkFileReader::MeasureAndSavePtr(state, &data, &arena);
 	}
 
 	CChunkFileReader::Error LoadFromRam(std::vector<u8> &data, std::string *errorString) {
@@ -100,16 +120,100 @@ namespace SaveState
 		return CChunkFileReader::LoadPtr(&data[0], state, errorString);
 	}
 
+	CChunkFileReader::Error RollbackState::Save() {
+		Memory::SetBulkStateCallback(&RollbackState::SaveCallback, this);
+		CChunkFileReader::Error err = SaveToRam(state_);
+		Memory::SetBulkStateCallback(nullptr, nullptr);
+		if (err != CChunkFileReader::ERROR_NONE)
+			Clear();
+		return err;
+	}
+
+	CChunkFileReader::Error RollbackState::Load(std::string *errorString) {
+		if (state_.empty())
+			return CChunkFileReader::ERROR_BAD_FILE;
+		Memory::SetBulkStateCallback(&RollbackState::LoadCallback, this);
+		CChunkFileReader::Error err = LoadFromRam(state_, errorString);
+		Memory::SetBulkStateCallback(nullptr, nullptr);
+		return err;
+	}
+
+	void RollbackState::Clear() {
+		state_.clear();
+		memory_.clear();
+		memory_.shrink_to_fit();
+		memorySize_ = 0;
+	}
+
+	// Copies pages that differ between memory and the mirror, in either direction.
+	static void SyncMemoryPages(u8 *mirror, bool toMirror) {
+		ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+			for (int i = l; i < h; i++) {
+				u8 *page = MemoryPagePtr(i);
+				u8 *mirrorPage = mirror + (size_t)i * MEMORY_PAGE_SIZE;
+				if (memcmp(page, mirrorPage, MEMORY_PAGE_SIZE) == 0)
+					continue;
+				if (toMirror)
+					memcpy(mirrorPage, page, MEMORY_PAGE_SIZE);
+				else
+					memcpy(page, mirrorPage, MEMORY_PAGE_SIZE);
+			}
+		}, 0, (int)MemoryPageCount(), 256);
+	}
+
+	void RollbackState::SaveCallback(PointerWrap &p, void *userdata) {
+		if (p.mode != PointerWrap::MODE_WRITE)
+			return;
+		RollbackState *state = (RollbackState *)userdata;
+		const size_t ramSize = Memory::g_MemorySize;
+		if (state->memorySize_ != Memory::g_MemorySize) {
+			state->memory_.resize(ramSize + Memory::VRAM_SIZE);
+			state->memorySize_ = Memory::g_MemorySize;
+			ParallelMemcpy(&g_threadManager, &state->memory_[0], MemoryPagePtr(0), ramSize);
+			ParallelMemcpy(&g_threadManager, &state->memory_[ramSize], MemoryPagePtr(ramSize / MEMORY_PAGE_SIZE), Memory::VRAM_SIZE);
+		} else {
+			SyncMemoryPages(&state->memory_[0], true);
+		}
+	}
+
+	void RollbackState::LoadCallback(PointerWrap &p, void *userdata) {
+		if (p.mode != PointerWrap::MODE_READ)
+			return;
+		RollbackState *state = (RollbackState *)userdata;
+		if (state->memorySize_ != Memory::g_MemorySize) {
+			p.SetError(PointerWrap::ERROR_FAILURE);
+			return;
+		}
+		SyncMemoryPages(&state->memory_[0], false);
+	}
+
 	// This ring buffer of states is for rewind save states, which are kept in RAM.
 	// Save states are compressed against one of two reference saves (bases_), and the reference
 	// is switched to a fresh save every N saves, where N is BASE_USAGE_INTERVAL.
 	// The compression is a simple block based scheme where 0 means to copy a block from the base,
 	// and 1 means that the following bytes are the next block. See Compress/LockedDecompress.
+	// The result, and the memory pages below, are then packed with a fast zstd level.
+	// RAM and VRAM are kept out of the serialized states.  Each base keeps a full copy of them, and
+	// each state only keeps the pages that differ from its base. See SavePages/RestorePages.
 	class StateRingbuffer {
+		struct PageDelta {
+			std::vector<u32> pages;
+			std::vector<u8> data;
+			// Set once data has been packed on the compress thread.
+			bool packed = false;
+
+			void Clear() {
+				pages.clear();
+				data.clear();
+				packed = false;
+			}
+		};
+
 	public:
 		StateRingbuffer() {
 			size_ = REWIND_NUM_STATES;
 			states_.resize(size_);
+			pages_.resize(size_);
 			baseMapping_.resize(size_);
 		}
 
@@ -137,21 +241,34 @@ namespace SaveState
 			std::vector<u8> *compressBuffer = &buffer_;
 			CChunkFileReader::Error err;
 
-			if (base_ == -1 || ++baseUsage_ > BASE_USAGE_INTERVAL)
+			// The memory size only changes on load, but that would make the base useless.
+			bool baseValid = base_ != -1 && baseMemorySize_[base_] == Memory::g_MemorySize;
+			if (!baseValid || ++baseUsage_ > BASE_USAGE_INTERVAL)
 			{
 				base_ = (base_ + 1) % ARRAY_SIZE(bases_);
 				baseUsage_ = 0;
+				pageTarget_ = nullptr;
+				Memory::SetBulkStateCallback(&StateRingbuffer::SavePagesCallback, this);
 				err = SaveToRam(bases_[base_]);
+				Memory::SetBulkStateCallback(nullptr, nullptr);
 				// Let's not bother savestating twice.
 				compressBuffer = &bases_[base_];
+				pages_[n].Clear();
 			}
 			else
+			{
+				pageTarget_ = &pages_[n];
+				Memory::SetBulkStateCallback(&StateRingbuffer::SavePagesCallback, this);
 				err = SaveToRam(buffer_);
+				Memory::SetBulkStateCallback(nullptr, nullptr);
+			}
 
-			if (err == CChunkFileReader::ERROR_NONE)
-				ScheduleCompress(&states_[n], compressBuffer, &bases_[base_]);
-			else
+			if (err == CChunkFileReader::ERROR_NONE) {
+				ScheduleCompress(&states_[n], compressBuffer, &bases_[base_], &pages_[n]);
+			} else {
 				states_[n].clear();
+				pages_[n].Clear();
+			}
 
 			baseMapping_[n] = base_;
 			return err;
@@ -170,13 +287,86 @@ namespace SaveState
 				return CChunkFileReader::ERROR_BAD_FILE;
 
 			static std::vector<u8> buffer;
-			LockedDecompress(buffer, states_[n], bases_[baseMapping_[n]]);
+			if (!LockedDecompress(buffer, states_[n], bases_[baseMapping_[n]]))
+				return CChunkFileReader::ERROR_BAD_FILE;
+			pageTarget_ = &pages_[n];
+			pageBase_ = baseMapping_[n];
+			Memory::SetBulkStateCallback(&StateRingbuffer::RestorePagesCallback, this);
 			CChunkFileReader::Error error = LoadFromRam(buffer, errorString);
+			Memory::SetBulkStateCallback(nullptr, nullptr);
+			pageTarget_ = nullptr;
 			rewindLastTime_ = time_now_d();
 			return error;
 		}
 
-		void ScheduleCompress(std::vector<u8> *result, const std::vector<u8> *state, const std::vector<u8> *base)
+		static void SavePagesCallback(PointerWrap &p, void *userdata) {
+			if (p.mode == PointerWrap::MODE_WRITE)
+				((StateRingbuffer *)userdata)->SavePages();
+		}
+
+		static void RestorePagesCallback(PointerWrap &p, void *userdata) {
+			if (p.mode == PointerWrap::MODE_READ && !((StateRingbuffer *)userdata)->RestorePages())
+				p.SetError(PointerWrap::ERROR_FAILURE);
+		}
+
+		void SavePages() {
+			double start_time = time_now_d();
+			const size_t ramSize = Memory::g_MemorySize;
+			std::vector<u8> &baseMemory = baseMemory_[base_];
+
+			if (!pageTarget_) {
+				// New base, take a full copy.
+				baseMemory.resize(ramSize + Memory::VRAM_SIZE);
+				baseMemorySize_[base_] = Memory::g_MemorySize;
+				ParallelMemcpy(&g_threadManager, &baseMemory[0], MemoryPagePtr(0), ramSize);
+				ParallelMemcpy(&g_threadManager, &baseMemory[ramSize], MemoryPagePtr(ramSize / MEMORY_PAGE_SIZE), Memory::VRAM_SIZE);
+				return;
+			}
+
+			const size_t count = MemoryPageCount();
+			dirty_.resize(count);
+			ParallelRangeLoop(&g_threadManager, [&](int l, int h) {
+				for (int i = l; i < h; i++)
+					dirty_[i] = memcmp(MemoryPagePtr(i), &baseMemory[(size_t)i * MEMORY_PAGE_SIZE], MEMORY_PAGE_SIZE) != 0;
+			}, 0, (int)count, 256);
+
+			PageDelta &delta = *pageTarget_;
+			delta.Clear();
+			for (size_t i = 0; i < count; ++i) {
+				if (dirty_[i])
+					delta.pages.push_back((u32)i);
+			}
+			delta.data.resize(delta.pages.size() * MEMORY_PAGE_SIZE);
+			for (size_t i = 0; i < delta.pages.size(); ++i)
+				memcpy(&delta.data[i * MEMORY_PAGE_SIZE], MemoryPagePtr(delta.pages[i]), MEMORY_PAGE_SIZE);
+
+			double taken_s = time_now_d() - start_time;
+			DEBUG_LOG(SAVESTATE, "Rewind: Saved %d of %d memory pages in %0.2f ms.", (int)delta.pages.size(), (int)count, taken_s * 1000.0);
+		}
+
+		bool RestorePages() {
+			const std::vector<u8> &baseMemory = baseMemory_[pageBase_];
+			const size_t ramSize = Memory::g_MemorySize;
+			// Loading the state can change the memory size, which the base must match.
+			if (baseMemorySize_[pageBase_] != Memory::g_MemorySize || baseMemory.size() != ramSize + Memory::VRAM_SIZE)
+				return false;
+
+			ParallelMemcpy(&g_threadManager, MemoryPagePtr(0), &baseMemory[0], ramSize);
+			ParallelMemcpy(&g_threadManager, MemoryPagePtr(ramSize / MEMORY_PAGE_SIZE), &baseMemory[ramSize], Memory::VRAM_SIZE);
+
+			const PageDelta &delta = *pageTarget_;
+			const std::vector<u8> *data = &delta.data;
+			if (delta.packed) {
+				if (!Unpack(unpacked_, delta.data) || unpacked_.size() != delta.pages.size() * MEMORY_PAGE_SIZE)
+					return false;
+				data = &unpacked_;
+			}
+			for (size_t i = 0; i < delta.pages.size(); ++i)
+				memcpy(MemoryPagePtr(delta.pages[i]), &(*data)[i * MEMORY_PAGE_SIZE], MEMORY_PAGE_SIZE);
+			return true;
+		}
+
+		void ScheduleCompress(std::vector<u8> *result, const std::vector<u8> *state, const std::vector<u8> *base, PageDelta *pages)
 		{
 			if (compressThread_.joinable())
 				compressThread_.join();
@@ -184,11 +374,33 @@ namespace SaveState
 				SetCurrentThreadName("SaveStateCompress");
 
 				// Should do no I/O, so no JNI thread context needed.
-				Compress(*result, *state, *base);
+				Compress(*result, *state, *base, *pages);
 			});
 		}
 
-		void Compress(std::vector<u8> &result, const std::vector<u8> &state, const std::vector<u8> &base)
+		static bool Pack(std::vector<u8> &result, const std::vector<u8> &data)
+		{
+			result.resize(ZSTD_compressBound(data.size()));
+			size_t sz = ZSTD_compress(&result[0], result.size(), data.data(), data.size(), ZSTD_PACK_LEVEL);
+			if (ZSTD_isError(sz)) {
+				result.clear();
+				return false;
+			}
+			result.resize(sz);
+			result.shrink_to_fit();
+			return true;
+		}
+
+		static bool Unpack(std::vector<u8> &result, const std::vector<u8> &packed)
+		{
+			unsigned long long sz = ZSTD_getFrameContentSize(packed.data(), packed.size());
+			if (sz == ZSTD_CONTENTSIZE_UNKNOWN || sz == ZSTD_CONTENTSIZE_ERROR)
+				return false;
+			result.resize((size_t)sz);
+			return !ZSTD_isError(ZSTD_decompress(result.data(), result.size(), packed.data(), packed.size()));
+		}
+
+		void Compress(std::vector<u8> &result, const std::vector<u8> &state, const std::vector<u8> &base, PageDelta &pages)
 		{
 			std::lock_guard<std::mutex> guard(lock_);
 			// Bail if we were cleared before locking.
@@ -196,26 +408,57 @@ namespace SaveState
 				return;
 
 			double start_time = time_now_d();
-			result.clear();
-			result.reserve(512 * 1024);
+			std::vector<u8> &diff = unpacked_;
+			diff.clear();
+			diff.reserve(512 * 1024);
 			for (size_t i = 0; i < state.size(); i += BLOCK_SIZE)
 			{
 				int blockSize = std::min(BLOCK_SIZE, (int)(state.size() - i));
 				if (i + blockSize > base.size() || memcmp(&state[i], &base[i], blockSize) != 0)
 				{
-					result.push_back(1);
-					result.insert(result.end(), state.begin() + i, state.begin() + i + blockSize);
+					diff.push_back(1);
+					diff.insert(diff.end(), state.begin() + i, state.begin() + i + blockSize);
 				}
 				else
-					result.push_back(0);
+					diff.push_back(0);
+			}
+			if (!Pack(result, diff)) {
+				// Pack() left result empty, which Restore() rejects.  Drop the pages too so nothing is half there.
+				ERROR_LOG(SAVESTATE, "Rewind: Failed to compress save state, dropping it.");
+				pages.Clear();
+				return;
+			}
+
+			size_t pageBytes = pages.data.size();
+			if (!pages.packed && !pages.data.empty()) {
+				std::vector<u8> packed;
+				if (Pack(packed, pages.data)) {
+					pages.data.swap(packed);
+					pages.packed = true;
+				}
 			}
 
 			double taken_s = time_now_d() - start_time;
-			DEBUG_LOG(SAVESTATE, "Rewind: Compressed save from %d bytes to %d in %0.2f ms.", (int)state.size(), (int)result.size(), taken_s * 1000.0);
+			DEBUG_LOG(SAVESTATE, "Rewind: Compressed save from %d bytes to %d, pages from %d to %d in %0.2f ms.", (int)state.size(), (int)result.size(), (int)pageBytes, (int)pages.data.size(), taken_s * 1000.0);
+			DEBUG_LOG(SAVESTATE, "Rewind: Using %d KB in total.", (int)(LockedFootprint() / 1024));
 		}
 
-		void LockedDecompress(std::vector<u8> &result, const std::vector<u8> &compressed, const std::vector<u8> &base)
+		size_t LockedFootprint() const
 		{
+			size_t total = 0;
+			for (int i = 0; i < 2; ++i)
+				total += bases_[i].size() + baseMemory_[i].size();
+			for (int i = 0; i < size_; ++i)
+				total += states_[i].size() + pages_[i].data.size() + pages_[i].pages.size() * sizeof(u32);
+			return total;
+		}
+
+		bool LockedDecompress(std::vector<u8> &result, const std::vector<u8> &packed, const std::vector<u8> &base)
+		{
+			if (!Unpack(unpacked_, packed))
+				return false;
+			const std::vector<u8> &compressed = unpacked_;
+
 			result.clear();
 			result.reserve(base.size());
 			auto basePos = base.begin();
@@ -241,6 +484,7 @@ namespace SaveState
 					}
 				}
 			}
+			return true;
 		}
 
 		void Clear()
@@ -255,6 +499,14 @@ namespace SaveState
 			for (auto &b : bases_) {
 				b.clear();
 			}
+			for (auto &m : baseMemory_) {
+				m.clear();
+				m.shrink_to_fit();
+			}
+			for (auto &d : pages_) {
+				d.Clear();
+			}
+			pageTarget_ = nullptr;
 			baseMapping_.clear();
 			baseMapping_.resize(size_);
 			for (auto &s : states_) {
@@ -299,6 +551,7 @@ namespace SaveState
 		const int REWIND_NUM_STATES = 20;
 		// TODO: Instead, based on size of compressed state?
 		const int BASE_USAGE_INTERVAL = 15;
+		static const int ZSTD_PACK_LEVEL = 1;
 
 		typedef std::vector<u8> StateBuffer;
 
@@ -313,6 +566,15 @@ namespace SaveState
 		std::thread compressThread_;
 		std::vector<u8> buffer_;
 
+		std::vector<PageDelta> pages_;
+		StateBuffer baseMemory_[2];
+		u32 baseMemorySize_[2]{};
+		PageDelta *pageTarget_ = nullptr;
+		int pageBase_ = 0;
+		std::vector<u8> dirty_;
+		// Scratch for zstd, only used with lock_ held.
+		std::vector<u8> unpacked_;
+
 		int base_ = -1;
 		int baseUsage_ = 0;
 
@@ -83,6 +83,26 @@ namespace SaveState
 	CChunkFileReader::Error SaveToRam(std::vector<u8> &state);
 	CChunkFileReader::Error LoadFromRam(std::vector<u8> &state, std::string *errorString);
 
+	// A state in RAM for rolling back to quickly and often, like for run-ahead.
+	// RAM and VRAM are kept in a mirror, and only pages that differ are copied on save or load.
+	class RollbackState {
+	public:
+		CChunkFileReader::Error Save();
+		CChunkFileReader::Error Load(std::string *errorString);
+		void Clear();
+		bool Empty() const {
+			return state_.empty();
+		}
+
+	private:
+		static void SaveCallback(PointerWrap &p, void *userdata);
+		static void LoadCallback(PointerWrap &p, void *userdata);
+
+		std::vector<u8> state_;
+		std::vector<u8> memory_;
+		u32 memorySize_ = 0;
+	};
+
 	// For testing / automated tests.  Runs a save state verification pass (async.)
 	// Warning: callback will be called on a different thread.
 	void Verify(Callback callback = Callback(), void *cbUserData = 0);
@@ -65,6 +65,7 @@
 #include "Core/FileSystems/MetaFileSystem.h"
 #include "Core/Loaders.h"
 #include "Core/PSPLoaders.h"
+#include "Core/Replay.h"
 #include "Core/ELF/ParamSFO.h"
 #include "Core/SaveState.h"
 #include "Common/LogManager.h"
@@ -559,6 +560,12 @@ bool PSP_IsQuitting() {
 	return pspIsQuitting;
 }
 
+static SaveState::RollbackState runAheadState;
+static bool runAheadPending = false;
+static bool runAheadHideFrame = false;
+static bool runAheadMuteAudio = false;
+static RunAheadStats runAheadStats;
+
 void PSP_Shutdown() {
 	Achievements::UnloadGame();
 
@@ -582,6 +589,9 @@ void PSP_Shutdown() {
 	CPU_Shutdown();
 	GPU_Shutdown();
 	g_paramSFO.Clear();
+	runAheadState.Clear();
+	runAheadPending = false;
+	runAheadStats = RunAheadStats{};
 	System_SetWindowTitle("");
 	currentMIPS = 0;
 	pspIsInited = false;
@@ -632,11 +642,116 @@ void PSP_RunLoopWhileState() {
 	}
 }
 
+static void RunAheadRollback() {
+	double start = time_now_d();
+	std::string errorString;
+	if (runAheadState.Load(&errorString) != CChunkFileReader::ERROR_NONE) {
+		ERROR_LOG(SAVESTATE, "Run-ahead rollback failed (%s), disabling for now.", errorString.c_str());
+		runAheadState.Clear();
+	}
+	runAheadStats.loadMs = (time_now_d() - start) * 1000.0;
+}
+
+void PSP_RunAheadRollback() {
+	if (!runAheadPending)
+		return;
+	runAheadPending = false;
+	// Keep pauses and the like, only the emulated state goes back.
+	CoreState state = coreState;
+	RunAheadRollback();
+	coreState = state;
+}
+
+void PSP_RunAheadWhileState(int frames) {
+	PSP_RunAheadRollback();
+
+	// Hardcore mode must not see a future that gets thrown away, and replays would record or consume
+	// input and disk events for frames that are rolled back.
+	if (Achievements::HardcoreModeActive() || ReplayIsExecuting() || ReplayIsSaving())
+		frames = 0;
+
+	if (frames <= 0) {
+		runAheadState.Clear();
+		runAheadStats = RunAheadStats{};
+		PSP_RunLoopWhileState();
+		Achievements::FrameUpdate();
+		return;
+	}
+
+	// The real frame. Its audio is kept, but the result won't be shown.
+	runAheadHideFrame = true;
+	PSP_RunLoopWhileState();
+	// Achievements only look at the real frame, before anything is run ahead of it.
+	Achievements::FrameUpdate();
+	if (coreState != CORE_NEXTFRAME) {
+		runAheadHideFrame = false;
+		return;
+	}
+
+	double start = time_now_d();
+	if (runAheadState.Save() != CChunkFileReader::ERROR_NONE) {
+		ERROR_LOG(SAVESTATE, "Run-ahead save failed, showing the real frame.");
+		runAheadHideFrame = false;
+		return;
+	}
+	runAheadStats.saveMs = (time_now_d() - start) * 1000.0;
+
+	start = time_now_d();
+	runAheadMuteAudio = true;
+	bool completed = true;
+	for (int i = 0; i < frames; ++i) {
+		coreState = CORE_RUNNING;
+		// Only the last frame ahead is shown.
+		runAheadHideFrame = i < frames - 1;
+		PSP_RunLoopWhileState();
+		if (coreState != CORE_NEXTFRAME) {
+			completed = false;
+			break;
+		}
+	}
+	runAheadMuteAudio = false;
+	runAheadHideFrame = false;
+	runAheadStats.aheadMs = (time_now_d() - start) * 1000.0;
+	runAheadStats.frames = frames;
+
+	if (completed) {
+		// We roll back at the start of the next frame, so the shown frame is presented first.
+		runAheadPending = true;
+	} else {
+		// Something stopped emulation (like an exception), so go back to where it's real.
+		CoreState state = coreState;
+		RunAheadRollback();
+		coreState = state;
+	}
+}
+
+bool PSP_RunAheadHidesFrame() {
+	return runAheadHideFrame;
+}
+
+bool PSP_RunAheadMutesAudio() {
+	return runAheadMuteAudio;
+}
+
+bool PSP_RunAheadPending() {
+	return runAheadPending;
+}
+
+RunAheadStats PSP_GetRunAheadStats() {
+	return runAheadStats;
+}
+
 void PSP_RunLoopUntil(u64 globalticks) {
-	SaveState::Process();
+	// Don't let queued save states or rewind snapshots capture a speculative frame.
+	if (!runAheadMuteAudio)
+		SaveState::Process();
 	if (coreState == CORE_POWERDOWN || coreState == CORE_BOOT_ERROR || coreState == CORE_RUNTIME_ERROR) {
 		return;
 	} else if (coreState == CORE_STEPPING) {
+		// Stepping in a frame run ahead would debug or save state that's thrown away.
+		// Return instead, PSP_RunAheadWhileState() rolls back and stepping continues from the real frame.
+		if (runAheadMuteAudio)
+			return;
 		Core_ProcessStepping();
 		return;
 	}
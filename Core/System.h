@@ -86,6 +86,23 @@ void PSP_RunLoopWhileState();
 void PSP_RunLoopUntil(u64 globalticks);
 void PSP_RunLoopFor(int cycles);
 
+struct RunAheadStats {
+	int frames;
+	double saveMs;
+	double loadMs;
+	double aheadMs;
+};
+
+// Runs a frame, then emulates frames ahead of it and shows the last one, rolling back before the next frame.
+// Pass 0 to roll back anything pending and run normally.  Also updates achievements, for the real frame only.
+void PSP_RunAheadWhileState(int frames);
+// Goes back to the real frame if frames were run ahead, before anything looks at or saves the state.
+void PSP_RunAheadRollback();
+bool PSP_RunAheadHidesFrame();
+bool PSP_RunAheadMutesAudio();
+bool PSP_RunAheadPending();
+RunAheadStats PSP_GetRunAheadStats();
+
 void PSP_SetLoading(const std::string &reason);
 std::string PSP_GetLoading();
 
@@ -25,6 +25,7 @@
 #include "Common/Profiler/Profiler.h"
 #include "Common/CommonTypes.h"
 #include "Common/Log.h"
+#include "Common/TimeUtil.h"
 #include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
@@ -50,6 +51,8 @@ static uint32_t lastExecVersion;
 static std::vector<Command> lastExecCommands;
 static std::vector<u8> lastExecPushbuf;
 static std::mutex executeLock;
+static ReplayTimingCallback replayTimingCallback;
+static bool repeatReplay = false;
 
 // This class maps pushbuffer (dump data) sections to PSP memory.
 // Dumps can be larger than available PSP memory, because they include generated data too.
@@ -826,7 +829,20 @@ bool RunMountedReplay(const std::string &filename) {
 	}
 
 	DumpExecute executor(lastExecPushbuf, lastExecCommands, version);
-	return executor.Run();
+	double st = time_now_d();
+	bool success = executor.Run();
+	repeatReplay = success && replayTimingCallback && replayTimingCallback(time_now_d() - st);
+	return success;
+}
+
+void SetReplayTimingCallback(const ReplayTimingCallback &callback) {
+	std::lock_guard<std::mutex> guard(executeLock);
+	replayTimingCallback = callback;
+	repeatReplay = false;
+}
+
+bool ShouldRepeatReplay() {
+	return repeatReplay;
 }
 
 };
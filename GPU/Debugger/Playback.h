@@ -17,10 +17,17 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 
 namespace GPURecord {
 
 bool RunMountedReplay(const std::string &filename);
 
+// For benchmarking.  Called after each replay with how long it took to execute, in seconds.
+// Headless keeps replaying the same dump while this returns true.
+typedef std::function<bool(double)> ReplayTimingCallback;
+void SetReplayTimingCallback(const ReplayTimingCallback &callback);
+bool ShouldRepeatReplay();
+
 };
@@ -1429,6 +1429,11 @@ void GPUCommon::DoState(PointerWrap &p) {
 		p.DoVoid(&dls[0], DisplayList_v3_size);
 		dls[0].padding = 0;
 
+		// Make sure the words we peek at below have been loaded.
+		if (!p.WaitForData(sizeof(u32) * 2)) {
+			p.SetError(p.ERROR_FAILURE);
+			return;
+		}
 		const u8 *savedPtr = *p.GetPPtr();
 		const u32 *savedPtr32 = (const u32 *)savedPtr;
 		// Here's the trick: the first member (id) is always the same as the index.
@@ -21,6 +21,7 @@
 #include "Common/Profiler/Profiler.h"
 #include "Common/Thread/ThreadManager.h"
 #include "Common/TimeUtil.h"
+#include "Core/Config.h"
 #include "Core/System.h"
 #include "GPU/Common/TextureDecoder.h"
 #include "GPU/Software/BinManager.h"
@@ -32,6 +33,14 @@ static constexpr bool FORCE_SINGLE_THREAD = false;
 
 using namespace Rasterizer;
 
+static int MaxBinTasks(int limit) {
+	int tasks = std::min(g_threadManager.GetNumLooperThreads(), limit);
+	// Allow limiting threads, i.e. to check threaded output matches.
+	if (g_Config.iSoftwareRenderingThreads > 0)
+		tasks = std::min(tasks, g_Config.iSoftwareRenderingThreads);
+	return tasks;
+}
+
 struct BinWaitable : public Waitable {
 public:
 	BinWaitable() {
@@ -67,10 +76,10 @@ struct BinWaitable : public Waitable {
 	std::condition_variable cond_;
 };
 
-static inline void DrawBinItem(const BinItem &item, const RasterizerState &state) {
+static inline void DrawBinItem(const BinItem &item, const RasterizerState &state, DepthTiles &depthTiles) {
 	switch (item.type) {
 	case BinItemType::TRIANGLE:
-		DrawTriangle(item.v0, item.v1, item.v2, item.range, state);
+		depthTiles.DrawTriangle(item.v0, item.v1, item.v2, item.range, state);
 		break;
 
 	case BinItemType::CLEAR_RECT:
@@ -93,12 +102,14 @@ static inline void DrawBinItem(const BinItem &item, const RasterizerState &state
 		DrawPoint(item.v0, item.range, state);
 		break;
 	}
+
+	depthTiles.Update(item, state);
 }
 
 class DrawBinItemsTask : public Task {
 public:
-	DrawBinItemsTask(BinWaitable *notify, BinManager::BinItemQueue &items, std::atomic<bool> &status, const BinManager::BinStateQueue &states)
-		: notify_(notify), items_(items), status_(status), states_(states) {
+	DrawBinItemsTask(BinWaitable *notify, BinManager::BinItemQueue &items, std::atomic<bool> &status, const BinManager::BinStateQueue &states, DepthTiles &depthTiles, std::atomic<int64_t> &rasterNanos)
+		: notify_(notify), items_(items), status_(status), states_(states), depthTiles_(depthTiles), rasterNanos_(rasterNanos) {
 	}
 
 	TaskType Type() const override {
@@ -111,10 +122,16 @@ class DrawBinItemsTask : public Task {
 	}
 
 	void Run() override {
+		const bool collectStats = coreCollectDebugStats;
+		double st = collectStats ? time_now_d() : 0.0;
+
 		ProcessItems();
 		status_ = false;
 		// In case of any atomic issues, do another pass.
 		ProcessItems();
+
+		if (collectStats)
+			rasterNanos_ += (int64_t)((time_now_d() - st) * 1000000000.0);
 		notify_->Drain();
 	}
 
@@ -126,7 +143,7 @@ class DrawBinItemsTask : public Task {
 	void ProcessItems() {
 		while (!items_.Empty()) {
 			const BinItem &item = items_.PeekNext();
-			DrawBinItem(item, states_[item.stateIndex]);
+			DrawBinItem(item, states_[item.stateIndex], depthTiles_);
 			items_.SkipNext();
 		}
 	}
@@ -135,6 +152,8 @@ class DrawBinItemsTask : public Task {
 	BinManager::BinItemQueue &items_;
 	std::atomic<bool> &status_;
 	const BinManager::BinStateQueue &states_;
+	DepthTiles &depthTiles_;
+	std::atomic<int64_t> &rasterNanos_;
 };
 
 constexpr int BinManager::MAX_POSSIBLE_TASKS;
@@ -148,12 +167,13 @@ BinManager::BinManager() {
 	waitable_ = new BinWaitable();
 	for (auto &s : taskStatus_)
 		s = false;
+	taskRasterNanos_ = 0;
 
 	int maxInitTasks = std::min(g_threadManager.GetNumLooperThreads(), MAX_POSSIBLE_TASKS);
 	for (int i = 0; i < maxInitTasks; ++i) {
 		taskQueues_[i].Setup();
 		for (DrawBinItemsTask *&task : taskLists_[i].tasks)
-			task = new DrawBinItemsTask(waitable_, taskQueues_[i], taskStatus_[i], states_);
+			task = new DrawBinItemsTask(waitable_, taskQueues_[i], taskStatus_[i], states_, depthTiles_, taskRasterNanos_);
 	}
 	states_.Setup();
 	cluts_.Setup();
@@ -171,6 +191,7 @@ BinManager::~BinManager() {
 
 void BinManager::UpdateState() {
 	PROFILE_THIS_SCOPE("bin_state");
+	BinStageScope stageScope(*this, BinStage::STATE);
 	if (HasDirty(SoftDirty::PIXEL_ALL | SoftDirty::SAMPLER_ALL | SoftDirty::RAST_ALL)) {
 		if (states_.Full())
 			Flush("states");
@@ -203,6 +224,9 @@ void BinManager::UpdateState() {
 		scissor_.x2 = screenScissorBR.x + SCREEN_SCALE_FACTOR - 1;
 		scissor_.y2 = screenScissorBR.y + SCREEN_SCALE_FACTOR - 1;
 
+		// This may flush if the depth buffer changed, so do it before marking pending writes.
+		UpdateDepthTiles(state);
+
 		// If we're about to texture from something still pending (i.e. depth), flush.
 		if (HasTextureWrite(state))
 			Flush("tex");
@@ -220,15 +244,23 @@ void BinManager::UpdateState() {
 		}
 	}
 
+	// Until a flush, something queued may still add to the depth tiles.
+	if (state.pixelID.depthWrite)
+		depthTilesQueued_ = true;
+
+	// The thread count setting can change mid-game (or mid-replay), pick it up on the next draw.
+	if (threadsSetting_ != g_Config.iSoftwareRenderingThreads) {
+		threadsSetting_ = g_Config.iSoftwareRenderingThreads;
+		dirty_ |= SoftDirty::BINNER_OVERLAP;
+	}
+
 	if (HasDirty(SoftDirty::BINNER_OVERLAP)) {
 		// This is a good place to record any dependencies for block transfer overlap.
 		MarkPendingReads(state);
 
 		// Disallow threads when rendering to the target, even offset.
 		bool selfRender = HasTextureWrite(state);
-		int newMaxTasks = selfRender || FORCE_SINGLE_THREAD ? 1 : g_threadManager.GetNumLooperThreads();
-		if (newMaxTasks > MAX_POSSIBLE_TASKS)
-			newMaxTasks = MAX_POSSIBLE_TASKS;
+		int newMaxTasks = selfRender || FORCE_SINGLE_THREAD ? 1 : MaxBinTasks(MAX_POSSIBLE_TASKS);
 		// We don't want to overlap wrong, so flush any pending.
 		if (maxTasks_ != newMaxTasks) {
 			maxTasks_ = newMaxTasks;
@@ -338,6 +370,48 @@ void BinManager::MarkPendingWrites(const Rasterizer::RasterizerState &state) {
 		pendingWrites_[1].Expand(gstate.getDepthBufAddress() & mirrorMask, 2, gstate.DepthBufStride(), scissorTL, scissorBR);
 }
 
+void BinManager::UpdateDepthTiles(const Rasterizer::RasterizerState &state) {
+	constexpr uint32_t mirrorMask = 0x041FFFFF;
+	const uint32_t depthAddr = gstate.getDepthBufAddress() & mirrorMask;
+	const uint16_t depthStride = gstate.DepthBufStride();
+	const int rows = std::min(gstate.getScissorY2(), gstate.getRegionY2()) + 1;
+
+	// If we're drawing color into the depth buffer, the tiles can't know what's there.
+	// That includes any rows an earlier, taller draw made them cover, not just this draw's.
+	int depthRows = rows;
+	if (depthTiles_.Matches(depthAddr, depthStride, true))
+		depthRows = std::max(depthRows, depthTiles_.Rows());
+	const uint32_t bpp = state.pixelID.FBFormat() == GE_FORMAT_8888 ? 4 : 2;
+	const uint32_t fbAddr = gstate.getFrameBufAddress() & mirrorMask;
+	const uint32_t fbEnd = fbAddr + gstate.FrameBufStride() * bpp * rows;
+	const uint32_t depthEnd = depthAddr + depthStride * 2 * std::max(depthRows, 1);
+	const bool aliased = fbAddr < depthEnd && depthAddr < fbEnd;
+
+	if (!depthTiles_.Matches(depthAddr, depthStride, !aliased)) {
+		// Anything pending must update the old tiles before we forget them.
+		Flush("depthtiles");
+		depthTiles_.SetTarget(depthAddr, depthStride, !aliased);
+	}
+	depthTiles_.ExpandRows(rows);
+}
+
+void BinManager::InvalidateDepthTiles(uint32_t start, int size) {
+	if (size >= 0) {
+		if (!Memory::IsVRAMAddress(start))
+			return;
+		if (!depthTiles_.Overlaps(start & 0x041FFFFF, (uint32_t)size))
+			return;
+	}
+	// Like every vblank with no depth drawn, there's nothing to forget and no reason to wait on the tasks.
+	if (!depthTiles_.Known() && !depthTilesQueued_)
+		return;
+
+	// Can't reset while tasks might be updating them.
+	Flush("depthinval");
+	depthTiles_.Reset();
+	depthTilesQueued_ = false;
+}
+
 inline void BinDirtyRange::Expand(uint32_t newBase, uint32_t bpp, uint32_t stride, const DrawingCoords &tl, const DrawingCoords &br) {
 	const uint32_t w = br.x - tl.x + 1;
 	const uint32_t h = br.y - tl.y + 1;
@@ -460,6 +534,7 @@ void BinManager::AddPoint(const VertexData &v0) {
 
 void BinManager::Drain(bool flushing) {
 	PROFILE_THIS_SCOPE("bin_drain");
+	BinStageScope stageScope(*this, BinStage::BINNING);
 
 	// If the waitable has fully drained, we can update our binning decisions.
 	if (!tasksSplit_ || waitable_->Empty()) {
@@ -475,7 +550,7 @@ void BinManager::Drain(bool flushing) {
 			const auto &item = queue_.PeekNext();
 			const auto &state = states_[item.stateIndex];
 			if (IsExactSelfRender(state, item))
-				maxTasks_ = std::min(g_threadManager.GetNumLooperThreads(), MAX_POSSIBLE_TASKS);
+				maxTasks_ = MaxBinTasks(MAX_POSSIBLE_TASKS);
 		}
 
 		taskRanges_.clear();
@@ -504,9 +579,10 @@ void BinManager::Drain(bool flushing) {
 
 	if (taskRanges_.size() <= 1) {
 		PROFILE_THIS_SCOPE("bin_drain_single");
+		BinStageScope rasterScope(*this, BinStage::RASTER);
 		while (!queue_.Empty()) {
 			const BinItem &item = queue_.PeekNext();
-			DrawBinItem(item, states_[item.stateIndex]);
+			DrawBinItem(item, states_[item.stateIndex], depthTiles_);
 			queue_.SkipNext();
 		}
 	} else {
@@ -564,7 +640,10 @@ void BinManager::Flush(const char *reason) {
 	if (coreCollectDebugStats)
 		st = time_now_d();
 	Drain(true);
-	waitable_->Wait();
+	{
+		BinStageScope stageScope(*this, BinStage::WAIT);
+		waitable_->Wait();
+	}
 	taskRanges_.clear();
 	tasksSplit_ = false;
 
@@ -586,6 +665,7 @@ void BinManager::Flush(const char *reason) {
 		pending.base = 0;
 	pendingOverlap_ = false;
 	pendingReads_.clear();
+	depthTilesQueued_ = false;
 
 	// We'll need to set the pending writes and reads again, since we just flushed it.
 	dirty_ |= SoftDirty::BINNER_RANGE | SoftDirty::BINNER_OVERLAP;
@@ -695,17 +775,20 @@ void BinManager::GetStats(char *buffer, size_t bufsize) {
 		recentTotal += it.second;
 	}
 
+	const DepthTileStats depthStats = depthTiles_.GetStats();
 	snprintf(buffer, bufsize,
 		"Slowest individual flush: %s (%0.4f)\n"
 		"Slowest frame flush: %s (%0.4f)\n"
 		"Slowest recent flush: %s (%0.4f)\n"
 		"Total flush time: %0.4f (%05.2f%%, last 2: %05.2f%%)\n"
-		"Thread enqueues: %d, count %d",
+		"Thread enqueues: %d, count %d\n"
+		"Depth tiles rejected: %d tris, %d tiles, %lld px",
 		slowestFlushReason_, slowestFlushTime_,
 		slowestTotalReason, slowestTotalTime,
 		slowestRecentReason, slowestRecentTime,
 		allTotal, allTotal * (6000.0 / 1.001), recentTotal * (3000.0 / 1.001),
-		enqueues_, mostThreads_);
+		enqueues_, mostThreads_,
+		depthStats.triangles, depthStats.tiles, (long long)depthStats.pixels);
 }
 
 void BinManager::ResetStats() {
@@ -715,6 +798,36 @@ void BinManager::ResetStats() {
 	slowestFlushTime_ = 0.0;
 	enqueues_ = 0;
 	mostThreads_ = 0;
+	depthTiles_.ResetStats();
+}
+
+BinStage BinManager::EnterStage(BinStage stage) {
+	const BinStage prev = stage_;
+	if (!coreCollectDebugStats) {
+		stage_ = BinStage::NONE;
+		return BinStage::NONE;
+	}
+
+	double now = time_now_d();
+	if (stage_ != BinStage::NONE)
+		stageTimes_[(int)stage_] += now - stageStart_;
+	stageStart_ = now;
+	stage_ = stage;
+	return prev;
+}
+
+void BinManager::GetStageTimes(BinStageTimes *times) const {
+	times->transform = stageTimes_[(int)BinStage::TRANSFORM];
+	times->state = stageTimes_[(int)BinStage::STATE];
+	times->binning = stageTimes_[(int)BinStage::BINNING];
+	times->raster = stageTimes_[(int)BinStage::RASTER] + taskRasterNanos_ * (1.0 / 1000000000.0);
+	times->wait = stageTimes_[(int)BinStage::WAIT];
+}
+
+void BinManager::ResetStageTimes() {
+	for (double &t : stageTimes_)
+		t = 0.0;
+	taskRasterNanos_ = 0;
 }
 
 inline BinCoords BinCoords::Intersect(const BinCoords &range) const {
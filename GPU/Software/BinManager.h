@@ -19,6 +19,7 @@
 
 #include <atomic>
 #include <unordered_map>
+#include "GPU/Software/DepthTiles.h"
 #include "GPU/Software/Rasterizer.h"
 
 struct BinWaitable;
@@ -33,6 +34,26 @@ enum class BinItemType : uint8_t {
 	POINT,
 };
 
+enum class BinStage {
+	NONE,
+	TRANSFORM,
+	STATE,
+	BINNING,
+	RASTER,
+	WAIT,
+	COUNT,
+};
+
+// Seconds spent in each stage, only collected while debug stats are enabled.
+// Raster includes time on all threads, and texture sampling happens during raster.
+struct BinStageTimes {
+	double transform;
+	double state;
+	double binning;
+	double raster;
+	double wait;
+};
+
 struct BinCoords {
 	int x1;
 	int y1;
@@ -206,9 +227,19 @@ class BinManager {
 	bool HasPendingWrite(uint32_t start, uint32_t stride, uint32_t w, uint32_t h);
 	// Assumes you've also checked for a write (writes are partial so are automatically reads.)
 	bool HasPendingRead(uint32_t start, uint32_t stride, uint32_t w, uint32_t h);
+	// Call when VRAM is modified outside drawing.  A negative size means everything.
+	void InvalidateDepthTiles(uint32_t start, int size);
 
 	void GetStats(char *buffer, size_t bufsize);
 	void ResetStats();
+	DepthTileStats GetDepthTileStats() const {
+		return depthTiles_.GetStats();
+	}
+
+	// Switches the stage time is counted toward, returning the previous stage.
+	BinStage EnterStage(BinStage stage);
+	void GetStageTimes(BinStageTimes *times) const;
+	void ResetStageTimes();
 
 	void SetDirty(SoftDirty flags) {
 		dirty_ |= flags;
@@ -252,6 +283,8 @@ class BinManager {
 	SoftDirty dirty_ = SoftDirty::NONE;
 
 	int maxTasks_ = 1;
+	// Last seen iSoftwareRenderingThreads, so changes apply even without state changes.
+	int threadsSetting_ = 0;
 	bool tasksSplit_ = false;
 	std::vector<BinCoords> taskRanges_;
 	BinItemQueue taskQueues_[MAX_POSSIBLE_TASKS];
@@ -261,6 +294,8 @@ class BinManager {
 
 	BinDirtyRange pendingWrites_[2]{};
 	std::unordered_map<uint32_t, BinDirtyRange> pendingReads_;
+	DepthTiles depthTiles_;
+	bool depthTilesQueued_ = false;
 
 	bool pendingOverlap_ = false;
 	bool creatingState_ = false;
@@ -274,8 +309,14 @@ class BinManager {
 	int enqueues_ = 0;
 	int mostThreads_ = 0;
 
+	BinStage stage_ = BinStage::NONE;
+	double stageStart_ = 0.0;
+	double stageTimes_[(int)BinStage::COUNT]{};
+	std::atomic<int64_t> taskRasterNanos_;
+
 	void MarkPendingReads(const Rasterizer::RasterizerState &state);
 	void MarkPendingWrites(const Rasterizer::RasterizerState &state);
+	void UpdateDepthTiles(const Rasterizer::RasterizerState &state);
 	bool HasTextureWrite(const Rasterizer::RasterizerState &state);
 	static bool IsExactSelfRender(const Rasterizer::RasterizerState &state, const BinItem &item);
 	void OptimizePendingStates(uint16_t first, uint16_t last);
@@ -287,3 +328,17 @@ class BinManager {
 
 	friend class DrawBinItemsTask;
 };
+
+class BinStageScope {
+public:
+	BinStageScope(BinManager &binner, BinStage stage) : binner_(binner) {
+		prev_ = binner_.EnterStage(stage);
+	}
+	~BinStageScope() {
+		binner_.EnterStage(prev_);
+	}
+
+private:
+	BinManager &binner_;
+	BinStage prev_;
+};
@@ -0,0 +1,326 @@
+// Copyright (c) 2022- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include "Common/Profiler/Profiler.h"
+#include "GPU/Software/BinManager.h"
+#include "GPU/Software/DepthTiles.h"
+
+using namespace Rasterizer;
+
+static inline uint32_t PackBounds(int zmin, int zmax) {
+	return (uint32_t)zmin | ((uint32_t)zmax << 16);
+}
+
+static inline int BoundsMin(uint32_t tile) {
+	return tile & 0xFFFF;
+}
+
+static inline int BoundsMax(uint32_t tile) {
+	return tile >> 16;
+}
+
+// Interpolation can round by one either way, so widen a bit.  Flat Z isn't interpolated.
+static inline void ExpandDepthRange(int &zmin, int &zmax) {
+	if (zmin != zmax) {
+		zmin--;
+		zmax++;
+	}
+	zmin = std::min(std::max(zmin, 0), 0xFFFF);
+	zmax = std::min(std::max(zmax, 0), 0xFFFF);
+}
+
+// Per the rasterizer's edge functions, positive means the pixel center is definitely inside.
+static inline int64_t EdgeAt(const ScreenCoords &a, const ScreenCoords &b, int x, int y) {
+	return (int64_t)(a.y - b.y) * x + (int64_t)(b.x - a.x) * y + ((int64_t)b.y * a.x - (int64_t)b.x * a.y);
+}
+
+static bool TriangleCoversTile(const VertexData &v0, const VertexData &v1, const VertexData &v2, int x1, int y1, int x2, int y2) {
+	// Pixel centers, matching TriangleEdge::Start().
+	static constexpr int centerOff = (SCREEN_SCALE_FACTOR / 2) - 1;
+	const int xs[2] = { x1 + centerOff, x2 - SCREEN_SCALE_FACTOR + 1 + centerOff };
+	const int ys[2] = { y1 + centerOff, y2 - SCREEN_SCALE_FACTOR + 1 + centerOff };
+	for (int y : ys) {
+		for (int x : xs) {
+			if (EdgeAt(v1.screenpos, v2.screenpos, x, y) <= 0)
+				return false;
+			if (EdgeAt(v2.screenpos, v0.screenpos, x, y) <= 0)
+				return false;
+			if (EdgeAt(v0.screenpos, v1.screenpos, x, y) <= 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+DepthTiles::DepthTiles() {
+	Reset();
+	ResetStats();
+}
+
+void DepthTiles::SetTarget(uint32_t addr, uint16_t stride, bool enabled) {
+	addr_ = addr;
+	stride_ = stride;
+	enabled_ = enabled && stride != 0;
+	rows_ = 0;
+	Reset();
+}
+
+void DepthTiles::ExpandRows(int rows) {
+	rows_ = std::max(rows_, std::min(rows, 1024));
+}
+
+bool DepthTiles::Overlaps(uint32_t addr, uint32_t size) const {
+	if (!enabled_ || rows_ == 0)
+		return false;
+	return addr < EndAddress() && addr + size > addr_;
+}
+
+void DepthTiles::Reset() {
+	for (auto &tile : tiles_)
+		tile.store(UNKNOWN, std::memory_order_relaxed);
+	known_.store(false, std::memory_order_relaxed);
+}
+
+bool DepthTiles::Rejects(GEComparison func, uint32_t tile, int zmin, int zmax) {
+	const int tmin = BoundsMin(tile);
+	const int tmax = BoundsMax(tile);
+	switch (func) {
+	case GE_COMP_NEVER: return true;
+	case GE_COMP_ALWAYS: return false;
+	case GE_COMP_EQUAL: return zmax < tmin || zmin > tmax;
+	case GE_COMP_NOTEQUAL: return zmin == zmax && tmin == tmax && zmin == tmin;
+	case GE_COMP_LESS: return zmin >= tmax;
+	case GE_COMP_LEQUAL: return zmin > tmax;
+	case GE_COMP_GREATER: return zmax <= tmin;
+	case GE_COMP_GEQUAL: return zmax < tmin;
+	}
+	return false;
+}
+
+void DepthTiles::DrawTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2, const BinCoords &range, const RasterizerState &state) {
+	const PixelFuncID &pixelID = state.pixelID;
+	// Only safe to skip pixels when the depth test is the only thing that could happen to them.
+	if (!enabled_ || !pixelID.earlyZChecks || pixelID.clearMode) {
+		Rasterizer::DrawTriangle(v0, v1, v2, range, state);
+		return;
+	}
+
+	PROFILE_THIS_SCOPE("depth_tiles");
+	int zmin = std::min(std::min(v0.screenpos.z, v1.screenpos.z), v2.screenpos.z);
+	int zmax = std::max(std::max(v0.screenpos.z, v1.screenpos.z), v2.screenpos.z);
+	ExpandDepthRange(zmin, zmax);
+
+	const int tx1 = range.x1 / TILE_SCREEN_SIZE;
+	const int ty1 = range.y1 / TILE_SCREEN_SIZE;
+	const int tx2 = std::min(range.x2 / TILE_SCREEN_SIZE, TILES_PER_SIDE - 1);
+	const int ty2 = std::min(range.y2 / TILE_SCREEN_SIZE, TILES_PER_SIDE - 1);
+	const GEComparison func = pixelID.DepthTestFunc();
+
+	static_assert(TILES_PER_SIDE <= 64, "Row mask must fit in 64 bits");
+	uint64_t rejectedRows[TILES_PER_SIDE];
+	int rejected = 0;
+	int64_t rejectedPixels = 0;
+	for (int ty = ty1; ty <= ty2; ++ty) {
+		rejectedRows[ty] = 0;
+		for (int tx = tx1; tx <= tx2; ++tx) {
+			uint32_t tile = tiles_[ty * TILES_PER_SIDE + tx].load(std::memory_order_relaxed);
+			if (Rejects(func, tile, zmin, zmax)) {
+				rejectedRows[ty] |= 1ULL << tx;
+				rejected++;
+
+				int w = std::min(range.x2, (tx + 1) * TILE_SCREEN_SIZE - 1) - std::max(range.x1, tx * TILE_SCREEN_SIZE) + 1;
+				int h = std::min(range.y2, (ty + 1) * TILE_SCREEN_SIZE - 1) - std::max(range.y1, ty * TILE_SCREEN_SIZE) + 1;
+				rejectedPixels += (w / SCREEN_SCALE_FACTOR) * (h / SCREEN_SCALE_FACTOR);
+			}
+		}
+	}
+
+	if (rejected == 0) {
+		Rasterizer::DrawTriangle(v0, v1, v2, range, state);
+		return;
+	}
+
+	rejectedTiles_ += rejected;
+	rejectedPixels_ += rejectedPixels;
+	if (rejected == (tx2 - tx1 + 1) * (ty2 - ty1 + 1)) {
+		rejectedTriangles_++;
+		return;
+	}
+
+	// Draw bands of unrejected rows together, and runs of tiles for rows with rejections.
+	int bandStart = -1;
+	auto flushBand = [&](int ty) {
+		if (bandStart < 0)
+			return;
+		BinCoords band{ range.x1, std::max(range.y1, bandStart * TILE_SCREEN_SIZE), range.x2, std::min(range.y2, ty * TILE_SCREEN_SIZE - 1) };
+		Rasterizer::DrawTriangle(v0, v1, v2, band, state);
+		bandStart = -1;
+	};
+
+	for (int ty = ty1; ty <= ty2; ++ty) {
+		if (rejectedRows[ty] == 0) {
+			if (bandStart < 0)
+				bandStart = ty;
+			continue;
+		}
+		flushBand(ty);
+
+		const int y1 = std::max(range.y1, ty * TILE_SCREEN_SIZE);
+		const int y2 = std::min(range.y2, (ty + 1) * TILE_SCREEN_SIZE - 1);
+		int runStart = -1;
+		for (int tx = tx1; tx <= tx2 + 1; ++tx) {
+			bool skip = tx > tx2 || (rejectedRows[ty] & (1ULL << tx)) != 0;
+			if (!skip) {
+				if (runStart < 0)
+					runStart = tx;
+				continue;
+			}
+			if (runStart >= 0) {
+				BinCoords run{ std::max(range.x1, runStart * TILE_SCREEN_SIZE), y1, std::min(range.x2, tx * TILE_SCREEN_SIZE - 1), y2 };
+				Rasterizer::DrawTriangle(v0, v1, v2, run, state);
+				runStart = -1;
+			}
+		}
+	}
+	flushBand(ty2 + 1);
+}
+
+void DepthTiles::Update(const BinItem &item, const RasterizerState &state) {
+	const PixelFuncID &pixelID = state.pixelID;
+	// In clear mode, this is the depth clear flag.
+	if (!enabled_ || !pixelID.depthWrite)
+		return;
+
+	int zmin = std::min(item.v0.screenpos.z, item.v1.screenpos.z);
+	int zmax = std::max(item.v0.screenpos.z, item.v1.screenpos.z);
+	if (item.type == BinItemType::TRIANGLE) {
+		zmin = std::min(zmin, (int)item.v2.screenpos.z);
+		zmax = std::max(zmax, (int)item.v2.screenpos.z);
+	}
+	ExpandDepthRange(zmin, zmax);
+
+	// When every covered pixel is written, fully covered tiles can tighten.
+	UpdateMode fullMode = UpdateMode::UNION;
+	bool allWritten = !pixelID.applyDepthRange;
+	if (!pixelID.clearMode)
+		allWritten = allWritten && pixelID.AlphaTestFunc() == GE_COMP_ALWAYS && !pixelID.colorTest && !pixelID.stencilTest;
+	if (allWritten && pixelID.clearMode) {
+		fullMode = UpdateMode::REPLACE;
+	} else if (allWritten) {
+		switch (pixelID.DepthTestFunc()) {
+		case GE_COMP_ALWAYS:
+			fullMode = UpdateMode::REPLACE;
+			break;
+		case GE_COMP_GREATER:
+		case GE_COMP_GEQUAL:
+			fullMode = UpdateMode::RAISE;
+			break;
+		case GE_COMP_LESS:
+		case GE_COMP_LEQUAL:
+			fullMode = UpdateMode::LOWER;
+			break;
+		case GE_COMP_NEVER:
+		case GE_COMP_EQUAL:
+			// Nothing written, or written with the same value.
+			return;
+		default:
+			break;
+		}
+	}
+
+	switch (item.type) {
+	case BinItemType::TRIANGLE:
+		UpdateTiles(item.range, zmin, zmax, fullMode, &item.v0);
+		break;
+
+	case BinItemType::CLEAR_RECT:
+	{
+		// The range may include a final partial pixel, so shrink to what's definitely written.
+		BinCoords covered = item.range;
+		covered.x1 = std::max(covered.x1, std::min(item.v0.screenpos.x, item.v1.screenpos.x));
+		covered.y1 = std::max(covered.y1, std::min(item.v0.screenpos.y, item.v1.screenpos.y));
+		covered.x2 = std::min(covered.x2, std::max(item.v0.screenpos.x, item.v1.screenpos.x) - 1);
+		covered.y2 = std::min(covered.y2, std::max(item.v0.screenpos.y, item.v1.screenpos.y) - 1);
+		UpdateTiles(item.range, zmin, zmax, UpdateMode::UNION, nullptr);
+		if (!covered.Invalid())
+			UpdateTiles(covered, zmin, zmax, fullMode, nullptr);
+		break;
+	}
+
+	default:
+		UpdateTiles(item.range, zmin, zmax, UpdateMode::UNION, nullptr);
+		break;
+	}
+}
+
+void DepthTiles::UpdateTiles(const BinCoords &range, int zmin, int zmax, UpdateMode fullMode, const VertexData *tri) {
+	const int tx1 = range.x1 / TILE_SCREEN_SIZE;
+	const int ty1 = range.y1 / TILE_SCREEN_SIZE;
+	const int tx2 = std::min(range.x2 / TILE_SCREEN_SIZE, TILES_PER_SIDE - 1);
+	const int ty2 = std::min(range.y2 / TILE_SCREEN_SIZE, TILES_PER_SIDE - 1);
+	if (!known_.load(std::memory_order_relaxed))
+		known_.store(true, std::memory_order_relaxed);
+
+	for (int ty = ty1; ty <= ty2; ++ty) {
+		const int y1 = ty * TILE_SCREEN_SIZE;
+		const int y2 = y1 + TILE_SCREEN_SIZE - 1;
+		for (int tx = tx1; tx <= tx2; ++tx) {
+			const int x1 = tx * TILE_SCREEN_SIZE;
+			const int x2 = x1 + TILE_SCREEN_SIZE - 1;
+
+			// Tiles straddling the range (and so possibly another bin task) only ever widen.
+			UpdateMode mode = UpdateMode::UNION;
+			if (fullMode != UpdateMode::UNION && x1 >= range.x1 && x2 <= range.x2 && y1 >= range.y1 && y2 <= range.y2) {
+				if (!tri || TriangleCoversTile(tri[0], tri[1], tri[2], x1, y1, x2, y2))
+					mode = fullMode;
+			}
+
+			std::atomic<uint32_t> &tile = tiles_[ty * TILES_PER_SIDE + tx];
+			uint32_t cur = tile.load(std::memory_order_relaxed);
+			uint32_t next;
+			do {
+				int tmin = BoundsMin(cur);
+				int tmax = BoundsMax(cur);
+				switch (mode) {
+				case UpdateMode::UNION:
+					next = PackBounds(std::min(tmin, zmin), std::max(tmax, zmax));
+					break;
+				case UpdateMode::REPLACE:
+					next = PackBounds(zmin, zmax);
+					break;
+				case UpdateMode::RAISE:
+					next = PackBounds(std::max(tmin, zmin), std::max(tmax, zmax));
+					break;
+				case UpdateMode::LOWER:
+					next = PackBounds(std::min(tmin, zmin), std::min(tmax, zmax));
+					break;
+				}
+			} while (next != cur && !tile.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+		}
+	}
+}
+
+DepthTileStats DepthTiles::GetStats() const {
+	return DepthTileStats{ rejectedTriangles_, rejectedTiles_, rejectedPixels_ };
+}
+
+void DepthTiles::ResetStats() {
+	rejectedTriangles_ = 0;
+	rejectedTiles_ = 0;
+	rejectedPixels_ = 0;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2022- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "GPU/Software/Rasterizer.h"
+
+struct BinCoords;
+struct BinItem;
+
+struct DepthTileStats {
+	int triangles;
+	int tiles;
+	int64_t pixels;
+};
+
+// Coarse min/max depth per 16x16 pixel tile of the current depth buffer.
+// The bounds are always conservative (every depth value in the tile is within them), which allows
+// skipping whole tiles or triangles that would fail an early depth test.
+// Drawing and updates are safe from bin tasks, everything else must happen while flushed.
+class DepthTiles {
+public:
+	DepthTiles();
+
+	bool Matches(uint32_t addr, uint16_t stride, bool enabled) const {
+		return addr_ == addr && stride_ == stride && enabled_ == enabled;
+	}
+	void SetTarget(uint32_t addr, uint16_t stride, bool enabled);
+	void ExpandRows(int rows);
+	int Rows() const {
+		return rows_;
+	}
+	uint32_t EndAddress() const {
+		return addr_ + stride_ * 2 * rows_;
+	}
+	bool Overlaps(uint32_t addr, uint32_t size) const;
+	void Reset();
+	// False while every tile is still unknown, so there's nothing to forget.
+	bool Known() const {
+		return known_.load(std::memory_order_relaxed);
+	}
+
+	// Draws a triangle, skipping tiles that would entirely fail the depth test.
+	void DrawTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2, const BinCoords &range, const Rasterizer::RasterizerState &state);
+	// Records depth written by an item that was just drawn.
+	void Update(const BinItem &item, const Rasterizer::RasterizerState &state);
+
+	DepthTileStats GetStats() const;
+	void ResetStats();
+
+private:
+	// In pixels, then screen coords.
+	static constexpr int TILE_SIZE = 16;
+	static constexpr int TILE_SCREEN_SIZE = TILE_SIZE * SCREEN_SCALE_FACTOR;
+	static constexpr int TILES_PER_SIDE = 1024 / TILE_SIZE;
+	// Low 16 bits are the min, high 16 the max.  This value means we know nothing.
+	static constexpr uint32_t UNKNOWN = 0xFFFF0000;
+
+	enum class UpdateMode {
+		UNION,
+		REPLACE,
+		RAISE,
+		LOWER,
+	};
+
+	static bool Rejects(GEComparison func, uint32_t tile, int zmin, int zmax);
+	void UpdateTiles(const BinCoords &range, int zmin, int zmax, UpdateMode fullMode, const VertexData *tri);
+
+	std::atomic<uint32_t> tiles_[TILES_PER_SIDE * TILES_PER_SIDE];
+	uint32_t addr_ = 0;
+	uint16_t stride_ = 0;
+	int rows_ = 0;
+	bool enabled_ = false;
+	std::atomic<bool> known_{};
+
+	std::atomic<int> rejectedTriangles_;
+	std::atomic<int> rejectedTiles_;
+	std::atomic<int64_t> rejectedPixels_;
+};
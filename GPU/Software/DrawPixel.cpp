@@ -159,39 +159,6 @@ static inline void SetPixelColor(GEBufferFormat fmt, int fbStride, int x, int y,
 	}
 }
 
-static inline bool AlphaTestPassed(const PixelFuncID &pixelID, int alpha) {
-	const u8 ref = pixelID.alphaTestRef;
-	if (pixelID.hasAlphaTestMask)
-		alpha &= pixelID.cached.alphaTestMask;
-
-	switch (pixelID.AlphaTestFunc()) {
-	case GE_COMP_NEVER:
-		return false;
-
-	case GE_COMP_ALWAYS:
-		return true;
-
-	case GE_COMP_EQUAL:
-		return (alpha == ref);
-
-	case GE_COMP_NOTEQUAL:
-		return (alpha != ref);
-
-	case GE_COMP_LESS:
-		return (alpha < ref);
-
-	case GE_COMP_LEQUAL:
-		return (alpha <= ref);
-
-	case GE_COMP_GREATER:
-		return (alpha > ref);
-
-	case GE_COMP_GEQUAL:
-		return (alpha >= ref);
-	}
-	return true;
-}
-
 static inline bool ColorTestPassed(const PixelFuncID &pixelID, const Vec3<int> &color) {
 	const u32 mask = pixelID.cached.colorTestMask;
 	const u32 c = color.ToRGB() & mask;
@@ -48,6 +48,40 @@ void Shutdown();
 
 bool CheckDepthTestPassed(GEComparison func, int x, int y, int stride, u16 z);
 
+// Shared with the sprite fast path, which has to match the pixel funcs exactly.
+inline bool AlphaTestPassed(const PixelFuncID &pixelID, int alpha) {
+	const u8 ref = pixelID.alphaTestRef;
+	if (pixelID.hasAlphaTestMask)
+		alpha &= pixelID.cached.alphaTestMask;
+
+	switch (pixelID.AlphaTestFunc()) {
+	case GE_COMP_NEVER:
+		return false;
+
+	case GE_COMP_ALWAYS:
+		return true;
+
+	case GE_COMP_EQUAL:
+		return (alpha == ref);
+
+	case GE_COMP_NOTEQUAL:
+		return (alpha != ref);
+
+	case GE_COMP_LESS:
+		return (alpha < ref);
+
+	case GE_COMP_LEQUAL:
+		return (alpha <= ref);
+
+	case GE_COMP_GREATER:
+		return (alpha > ref);
+
+	case GE_COMP_GEQUAL:
+		return (alpha >= ref);
+	}
+	return true;
+}
+
 bool DescribeCodePtr(const u8 *ptr, std::string &name);
 
 struct PixelBlendState {
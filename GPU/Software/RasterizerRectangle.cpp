@@ -3,6 +3,7 @@
 #include "ppsspp_config.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include "Common/Common.h"
 #include "Common/Data/Convert/ColorConv.h"
@@ -151,33 +152,10 @@ static inline void DrawSinglePixel32(u32 *pixel, const u32 color_in) {
 	*pixel = new_color;
 }
 
-// Check if we can safely ignore the alpha test, assuming standard alpha blending.
-static inline bool AlphaTestIsNeedless(const PixelFuncID &pixelID) {
-	switch (pixelID.AlphaTestFunc()) {
-	case GE_COMP_NEVER:
-	case GE_COMP_EQUAL:
-	case GE_COMP_LESS:
-	case GE_COMP_LEQUAL:
-		return false;
-
-	case GE_COMP_ALWAYS:
-		return true;
-
-	case GE_COMP_NOTEQUAL:
-	case GE_COMP_GREATER:
-	case GE_COMP_GEQUAL:
-		if (pixelID.alphaTestRef != 0 || pixelID.hasAlphaTestMask)
-			return false;
-		return true;
-	}
-
-	return false;
-}
-
-static bool UseDrawSinglePixel(const PixelFuncID &pixelID) {
+static bool UseSpriteBlit(const PixelFuncID &pixelID) {
 	if (pixelID.clearMode || pixelID.colorTest || pixelID.stencilTest)
 		return false;
-	if (!AlphaTestIsNeedless(pixelID) || pixelID.DepthTestFunc() != GE_COMP_ALWAYS)
+	if (pixelID.DepthTestFunc() != GE_COMP_ALWAYS)
 		return false;
 	// We skip blending when alpha = FF, so we can't allow other blend modes.
 	if (pixelID.alphaBlend) {
@@ -230,61 +208,278 @@ static inline Vec4IntResult SOFTRAST_CALL ModulateRGBA(Vec4IntArg prim_in, Vec4I
 	return ToVec4IntResult(out);
 }
 
-template <GEBufferFormat fmt, bool isWhite, bool alphaBlend, bool alphaTestZero>
-static void DrawSpriteTex(const DrawingCoords &pos0, const DrawingCoords &pos1, int s_start, int t_start, int ds, int dt, u32 color0, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
+// The sprite blitters below work on spans of up to this many pixels of a row.
+// Texels are first gathered into a span (directly from memory for common formats), then written together.
+static constexpr int SPRITE_SPAN_SIZE = 64;
+
+typedef void (*SpriteFetchSpanFunc)(u32 *span, int s, int t, int n, int ds, const RasterizerState &state, Sampler::FetchFunc fetchFunc);
+
+static void FetchSpanGeneric(u32 *span, int s, int t, int n, int ds, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
 	const u8 *texptr = state.texptr[0];
 	uint16_t texbufw = state.texbufw[0];
+	for (int i = 0; i < n; ++i) {
+		Vec4<int> tex_color = fetchFunc(s, t, texptr, texbufw, 0, state.samplerID);
+		span[i] = tex_color.ToRGBA();
+		s += ds;
+	}
+}
 
-	int t = t_start;
+static void FetchSpan8888(u32 *span, int s, int t, int n, int ds, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
+	const u32 *src = (const u32 *)state.texptr[0] + t * state.texbufw[0] + s;
+	memcpy(span, src, n * sizeof(u32));
+}
+
+template <GEPaletteFormat clutfmt>
+static void FetchSpanCLUT8(u32 *span, int s, int t, int n, int ds, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
+	const u8 *src = state.texptr[0] + t * state.texbufw[0] + s;
+	const SamplerID &samplerID = state.samplerID;
+	for (int i = 0; i < n; ++i) {
+		switch (clutfmt) {
+		case GE_CMODE_16BIT_BGR5650:
+			span[i] = RGB565ToRGBA8888(samplerID.cached.clut16[src[i]]);
+			break;
+		case GE_CMODE_16BIT_ABGR5551:
+			span[i] = RGBA5551ToRGBA8888(samplerID.cached.clut16[src[i]]);
+			break;
+		case GE_CMODE_16BIT_ABGR4444:
+			span[i] = RGBA4444ToRGBA8888(samplerID.cached.clut16[src[i]]);
+			break;
+		case GE_CMODE_32BIT_ABGR8888:
+			span[i] = samplerID.cached.clut32[src[i]];
+			break;
+		}
+	}
+}
+
+static SpriteFetchSpanFunc GetSpriteFetchSpan(const RasterizerState &state, int ds) {
+	const SamplerID &samplerID = state.samplerID;
+	// Only forward, linear texel rows can be read directly.
+	if (ds != 1 || samplerID.swizzle || samplerID.hasInvalidPtr || !state.texptr[0])
+		return &FetchSpanGeneric;
+
+	switch (samplerID.TexFmt()) {
+	case GE_TFMT_8888:
+		return &FetchSpan8888;
+
+	case GE_TFMT_CLUT8:
+		if (samplerID.hasClutMask || samplerID.hasClutShift || samplerID.hasClutOffset)
+			return &FetchSpanGeneric;
+		switch (samplerID.ClutFmt()) {
+		case GE_CMODE_16BIT_BGR5650: return &FetchSpanCLUT8<GE_CMODE_16BIT_BGR5650>;
+		case GE_CMODE_16BIT_ABGR5551: return &FetchSpanCLUT8<GE_CMODE_16BIT_ABGR5551>;
+		case GE_CMODE_16BIT_ABGR4444: return &FetchSpanCLUT8<GE_CMODE_16BIT_ABGR4444>;
+		case GE_CMODE_32BIT_ABGR8888: return &FetchSpanCLUT8<GE_CMODE_32BIT_ABGR8888>;
+		}
+		return &FetchSpanGeneric;
+
+	default:
+		return &FetchSpanGeneric;
+	}
+}
+
+static void ModulateSpan(u32 *span, int n, const Vec4<int> &c0, const SamplerID &samplerID) {
+	for (int i = 0; i < n; ++i) {
+		Vec4<int> tex_color = Vec4<int>::FromRGBA(span[i]);
+		Vec4<int> prim_color = Vec4<int>(ModulateRGBA(ToVec4IntArg(c0), ToVec4IntArg(tex_color), samplerID));
+		span[i] = prim_color.ToRGBA();
+	}
+}
+
+#if defined(_M_SSE)
+// Blends two pixels, already expanded to 16 bits per channel.  Same math as StandardAlphaBlend().
+static inline __m128i StandardAlphaBlend2(__m128i sourcevec, __m128i dstvec) {
+	const __m128i rgbMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	// Broadcast each alpha, but keep the alpha lane of the srcfactor zero.
+	__m128i srcfactor = _mm_shufflelo_epi16(sourcevec, _MM_SHUFFLE(3, 3, 3, 3));
+	srcfactor = _mm_and_si128(_mm_shufflehi_epi16(srcfactor, _MM_SHUFFLE(3, 3, 3, 3)), rgbMask);
+	const __m128i dstfactor = _mm_sub_epi16(_mm_set1_epi16(255), srcfactor);
+
+	const __m128i half = _mm_set1_epi16(1 << 3);
+
+	const __m128i srgb = _mm_add_epi16(_mm_slli_epi16(sourcevec, 4), half);
+	const __m128i sf = _mm_add_epi16(_mm_slli_epi16(srcfactor, 4), half);
+	const __m128i s = _mm_mulhi_epi16(srgb, sf);
+
+	const __m128i drgb = _mm_add_epi16(_mm_slli_epi16(dstvec, 4), half);
+	const __m128i df = _mm_add_epi16(_mm_slli_epi16(dstfactor, 4), half);
+	const __m128i d = _mm_mulhi_epi16(drgb, df);
+
+	return _mm_adds_epi16(s, d);
+}
+
+static inline __m128i StandardAlphaBlend4(__m128i source, __m128i dst) {
+	const __m128i z = _mm_setzero_si128();
+	const __m128i lo = StandardAlphaBlend2(_mm_unpacklo_epi8(source, z), _mm_unpacklo_epi8(dst, z));
+	const __m128i hi = StandardAlphaBlend2(_mm_unpackhi_epi8(source, z), _mm_unpackhi_epi8(dst, z));
+	return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i AlphaTestMask4(__m128i source, const PixelFuncID &pixelID) {
+	__m128i alpha = _mm_srli_epi32(source, 24);
+	if (pixelID.hasAlphaTestMask)
+		alpha = _mm_and_si128(alpha, _mm_set1_epi32(pixelID.cached.alphaTestMask));
+	const __m128i ref = _mm_set1_epi32(pixelID.alphaTestRef);
+	const __m128i all = _mm_set1_epi32(-1);
+
+	switch (pixelID.AlphaTestFunc()) {
+	case GE_COMP_NEVER:
+		return _mm_setzero_si128();
+	case GE_COMP_ALWAYS:
+		return all;
+	case GE_COMP_EQUAL:
+		return _mm_cmpeq_epi32(alpha, ref);
+	case GE_COMP_NOTEQUAL:
+		return _mm_xor_si128(_mm_cmpeq_epi32(alpha, ref), all);
+	case GE_COMP_LESS:
+		return _mm_cmplt_epi32(alpha, ref);
+	case GE_COMP_LEQUAL:
+		return _mm_xor_si128(_mm_cmpgt_epi32(alpha, ref), all);
+	case GE_COMP_GREATER:
+		return _mm_cmpgt_epi32(alpha, ref);
+	case GE_COMP_GEQUAL:
+		return _mm_xor_si128(_mm_cmplt_epi32(alpha, ref), all);
+	}
+	return all;
+}
+#elif PPSSPP_ARCH(ARM64_NEON)
+// Multiplies 8 channels by 8 factors, same math as StandardAlphaBlend().
+static inline uint16x8_t BlendMultiply8(uint8x8_t c, uint8x8_t f) {
+	const uint16x8_t one = vdupq_n_u16(1);
+	uint16x8_t c16 = vaddq_u16(vshlq_n_u16(vmovl_u8(c), 1), one);
+	uint16x8_t f16 = vaddq_u16(vshlq_n_u16(vmovl_u8(f), 1), one);
+	uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(c16), vget_low_u16(f16)), 10);
+	uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(c16), vget_high_u16(f16)), 10);
+	return vcombine_u16(lo, hi);
+}
+
+// Note: the alpha channel of the result is garbage, callers keep dest alpha.
+static inline uint32x4_t StandardAlphaBlend4(uint32x4_t source, uint32x4_t dst) {
+	static const uint8_t alphaIndex[16] = { 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15 };
+	const uint8x16_t src8 = vreinterpretq_u8_u32(source);
+	const uint8x16_t dst8 = vreinterpretq_u8_u32(dst);
+	const uint8x16_t sf = vqtbl1q_u8(src8, vld1q_u8(alphaIndex));
+	const uint8x16_t df = vmvnq_u8(sf);
+
+	uint16x8_t lo = vaddq_u16(BlendMultiply8(vget_low_u8(src8), vget_low_u8(sf)), BlendMultiply8(vget_low_u8(dst8), vget_low_u8(df)));
+	uint16x8_t hi = vaddq_u16(BlendMultiply8(vget_high_u8(src8), vget_high_u8(sf)), BlendMultiply8(vget_high_u8(dst8), vget_high_u8(df)));
+	return vreinterpretq_u32_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+}
+
+static inline uint32x4_t AlphaTestMask4(uint32x4_t source, const PixelFuncID &pixelID) {
+	uint32x4_t alpha = vshrq_n_u32(source, 24);
+	if (pixelID.hasAlphaTestMask)
+		alpha = vandq_u32(alpha, vdupq_n_u32(pixelID.cached.alphaTestMask));
+	const uint32x4_t ref = vdupq_n_u32(pixelID.alphaTestRef);
+
+	switch (pixelID.AlphaTestFunc()) {
+	case GE_COMP_NEVER:
+		return vdupq_n_u32(0);
+	case GE_COMP_ALWAYS:
+		return vdupq_n_u32(0xFFFFFFFF);
+	case GE_COMP_EQUAL:
+		return vceqq_u32(alpha, ref);
+	case GE_COMP_NOTEQUAL:
+		return vmvnq_u32(vceqq_u32(alpha, ref));
+	case GE_COMP_LESS:
+		return vcltq_u32(alpha, ref);
+	case GE_COMP_LEQUAL:
+		return vcleq_u32(alpha, ref);
+	case GE_COMP_GREATER:
+		return vcgtq_u32(alpha, ref);
+	case GE_COMP_GEQUAL:
+		return vcgeq_u32(alpha, ref);
+	}
+	return vdupq_n_u32(0xFFFFFFFF);
+}
+#endif
+
+// Writes a span of colors, 4 pixels at a time for 8888.  Matches DrawSinglePixel32/DrawSinglePixel exactly.
+template <GEBufferFormat fmt, bool alphaBlend, bool alphaTest>
+static void DrawSpriteSpan(int x, int y, const u32 *span, int n, const PixelFuncID &pixelID) {
+	int i = 0;
+	if (fmt == GE_FORMAT_8888) {
+		u32 *pixel = fb.Get32Ptr(x, y, pixelID.cached.framebufStride);
+#if defined(_M_SSE)
+		const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+		for (; i + 4 <= n; i += 4) {
+			const __m128i src = _mm_loadu_si128((const __m128i *)&span[i]);
+			const __m128i dst = _mm_loadu_si128((const __m128i *)&pixel[i]);
+			// Blending at alpha 0 or 255 gives exactly dst or src, so no need to special case.
+			__m128i result = alphaBlend ? StandardAlphaBlend4(src, dst) : src;
+			result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(dst, alphaMask));
+			if (alphaTest) {
+				const __m128i pass = AlphaTestMask4(src, pixelID);
+				result = _mm_or_si128(_mm_and_si128(pass, result), _mm_andnot_si128(pass, dst));
+			}
+			_mm_storeu_si128((__m128i *)&pixel[i], result);
+		}
+#elif PPSSPP_ARCH(ARM64_NEON)
+		const uint32x4_t alphaMask = vdupq_n_u32(0xFF000000);
+		for (; i + 4 <= n; i += 4) {
+			const uint32x4_t src = vld1q_u32(&span[i]);
+			const uint32x4_t dst = vld1q_u32(&pixel[i]);
+			// Blending at alpha 0 or 255 gives exactly dst or src, so no need to special case.
+			uint32x4_t result = alphaBlend ? StandardAlphaBlend4(src, dst) : src;
+			result = vbslq_u32(alphaMask, dst, result);
+			if (alphaTest)
+				result = vbslq_u32(AlphaTestMask4(src, pixelID), result, dst);
+			vst1q_u32(&pixel[i], result);
+		}
+#endif
+		for (; i < n; ++i) {
+			if (alphaTest && !AlphaTestPassed(pixelID, span[i] >> 24))
+				continue;
+			if (alphaBlend && (span[i] >> 24) == 0)
+				continue;
+			DrawSinglePixel32<alphaBlend>(&pixel[i], span[i]);
+		}
+	} else {
+		u16 *pixel = fb.Get16Ptr(x, y, pixelID.cached.framebufStride);
+		for (; i < n; ++i) {
+			if (alphaTest && !AlphaTestPassed(pixelID, span[i] >> 24))
+				continue;
+			if (alphaBlend && (span[i] >> 24) == 0)
+				continue;
+			DrawSinglePixel<fmt, alphaBlend>(&pixel[i], span[i]);
+		}
+	}
+}
+
+template <GEBufferFormat fmt, bool isWhite, bool alphaBlend, bool alphaTest>
+static void DrawSpriteTex(const DrawingCoords &pos0, const DrawingCoords &pos1, int s_start, int t_start, int ds, int dt, u32 color0, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
+	const SpriteFetchSpanFunc fetchSpan = GetSpriteFetchSpan(state, ds);
 	const Vec4<int> c0 = Vec4<int>::FromRGBA(color0);
+	u32 span[SPRITE_SPAN_SIZE];
+
+	int t = t_start;
 	for (int y = pos0.y; y < pos1.y; y++) {
 		int s = s_start;
-		u16 *pixel16 = fb.Get16Ptr(pos0.x, y, state.pixelID.cached.framebufStride);
-		u32 *pixel32 = fb.Get32Ptr(pos0.x, y, state.pixelID.cached.framebufStride);
-		for (int x = pos0.x; x < pos1.x; x++) {
-			Vec4<int> tex_color = fetchFunc(s, t, texptr, texbufw, 0, state.samplerID);
-			if (isWhite) {
-				if (!alphaTestZero || tex_color.a() != 0) {
-					u32 tex_color32 = tex_color.ToRGBA();
-					if (fmt == GE_FORMAT_8888)
-						DrawSinglePixel32<alphaBlend>(pixel32, tex_color32);
-					else
-						DrawSinglePixel<fmt, alphaBlend>(pixel16, tex_color32);
-				}
-			} else {
-				Vec4<int> prim_color = c0;
-				prim_color = Vec4<int>(ModulateRGBA(ToVec4IntArg(prim_color), ToVec4IntArg(tex_color), state.samplerID));
-				if (!alphaTestZero || prim_color.a() > 0) {
-					if (fmt == GE_FORMAT_8888)
-						DrawSinglePixel32<alphaBlend>(pixel32, prim_color.ToRGBA());
-					else
-						DrawSinglePixel<fmt, alphaBlend>(pixel16, prim_color.ToRGBA());
-				}
-			}
-			s += ds;
-			if (fmt == GE_FORMAT_8888)
-				pixel32++;
-			else
-				pixel16++;
+		for (int x = pos0.x; x < pos1.x; x += SPRITE_SPAN_SIZE) {
+			const int n = std::min(SPRITE_SPAN_SIZE, pos1.x - x);
+			fetchSpan(span, s, t, n, ds, state, fetchFunc);
+			if (!isWhite)
+				ModulateSpan(span, n, c0, state.samplerID);
+			DrawSpriteSpan<fmt, alphaBlend, alphaTest>(x, y, span, n, state.pixelID);
+			s += n * ds;
 		}
 		t += dt;
 	}
 }
 
-template <bool isWhite, bool alphaBlend, bool alphaTestZero>
+template <bool isWhite, bool alphaBlend, bool alphaTest>
 static void DrawSpriteTex(const DrawingCoords &pos0, const DrawingCoords &pos1, int s_start, int t_start, int ds, int dt, u32 color0, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
 	switch (state.pixelID.FBFormat()) {
 	case GE_FORMAT_565:
-		DrawSpriteTex<GE_FORMAT_565, isWhite, alphaBlend, alphaTestZero>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
+		DrawSpriteTex<GE_FORMAT_565, isWhite, alphaBlend, alphaTest>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
 		break;
 	case GE_FORMAT_5551:
-		DrawSpriteTex<GE_FORMAT_5551, isWhite, alphaBlend, alphaTestZero>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
+		DrawSpriteTex<GE_FORMAT_5551, isWhite, alphaBlend, alphaTest>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
 		break;
 	case GE_FORMAT_4444:
-		DrawSpriteTex<GE_FORMAT_4444, isWhite, alphaBlend, alphaTestZero>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
+		DrawSpriteTex<GE_FORMAT_4444, isWhite, alphaBlend, alphaTest>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
 		break;
 	case GE_FORMAT_8888:
-		DrawSpriteTex<GE_FORMAT_8888, isWhite, alphaBlend, alphaTestZero>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
+		DrawSpriteTex<GE_FORMAT_8888, isWhite, alphaBlend, alphaTest>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
 		break;
 	default:
 		// Invalid, don't draw anything...
@@ -294,10 +489,12 @@ static void DrawSpriteTex(const DrawingCoords &pos0, const DrawingCoords &pos1,
 
 template <bool isWhite>
 static inline void DrawSpriteTex(const DrawingCoords &pos0, const DrawingCoords &pos1, int s_start, int t_start, int ds, int dt, u32 color0, const RasterizerState &state, Sampler::FetchFunc fetchFunc) {
-	// Standard alpha blending implies skipping alpha zero.
-	if (state.pixelID.alphaBlend)
+	const bool alphaTest = state.pixelID.AlphaTestFunc() != GE_COMP_ALWAYS;
+	if (state.pixelID.alphaBlend && alphaTest)
 		DrawSpriteTex<isWhite, true, true>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
-	else if (state.pixelID.AlphaTestFunc() != GE_COMP_ALWAYS)
+	else if (state.pixelID.alphaBlend)
+		DrawSpriteTex<isWhite, true, false>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
+	else if (alphaTest)
 		DrawSpriteTex<isWhite, false, true>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
 	else
 		DrawSpriteTex<isWhite, false, false>(pos0, pos1, s_start, t_start, ds, dt, color0, state, fetchFunc);
@@ -308,20 +505,17 @@ static void DrawSpriteNoTex(const DrawingCoords &pos0, const DrawingCoords &pos1
 	if constexpr (alphaBlend)
 		if (Vec4<int>::FromRGBA(color0).a() == 0)
 			return;
+	// The color is flat, so the alpha test applies to the whole sprite.
+	if (!AlphaTestPassed(state.pixelID, color0 >> 24))
+		return;
+
+	u32 span[SPRITE_SPAN_SIZE];
+	std::fill(span, span + SPRITE_SPAN_SIZE, color0);
 
 	for (int y = pos0.y; y < pos1.y; y++) {
-		if (fmt == GE_FORMAT_8888) {
-			u32 *pixel = fb.Get32Ptr(pos0.x, y, state.pixelID.cached.framebufStride);
-			for (int x = pos0.x; x < pos1.x; x++) {
-				DrawSinglePixel32<alphaBlend>(pixel, color0);
-				pixel++;
-			}
-		} else {
-			u16 *pixel = fb.Get16Ptr(pos0.x, y, state.pixelID.cached.framebufStride);
-			for (int x = pos0.x; x < pos1.x; x++) {
-				DrawSinglePixel<fmt, alphaBlend>(pixel, color0);
-				pixel++;
-			}
+		for (int x = pos0.x; x < pos1.x; x += SPRITE_SPAN_SIZE) {
+			const int n = std::min(SPRITE_SPAN_SIZE, pos1.x - x);
+			DrawSpriteSpan<fmt, alphaBlend, false>(x, y, span, n, state.pixelID);
 		}
 	}
 }
@@ -402,7 +596,7 @@ void DrawSprite(const VertexData &v0, const VertexData &v1, const BinCoords &ran
 			pos0.y = scissorTL.y;
 		}
 
-		if (UseDrawSinglePixel(pixelID) && (samplerID.TexFunc() == GE_TEXFUNC_MODULATE || samplerID.TexFunc() == GE_TEXFUNC_REPLACE) && samplerID.useTextureAlpha) {
+		if (UseSpriteBlit(pixelID) && (samplerID.TexFunc() == GE_TEXFUNC_MODULATE || samplerID.TexFunc() == GE_TEXFUNC_REPLACE) && samplerID.useTextureAlpha) {
 			if (isWhite || samplerID.TexFunc() == GE_TEXFUNC_REPLACE) {
 				DrawSpriteTex<true>(pos0, pos1, s_start, t_start, ds, dt, v1.color0, state, fetchFunc);
 			} else {
@@ -448,7 +642,7 @@ void DrawSprite(const VertexData &v0, const VertexData &v1, const BinCoords &ran
 		if (pos1.y > scissorBR.y) pos1.y = scissorBR.y + 1;
 		if (pos0.x < scissorTL.x) pos0.x = scissorTL.x;
 		if (pos0.y < scissorTL.y) pos0.y = scissorTL.y;
-		if (UseDrawSinglePixel(pixelID)) {
+		if (UseSpriteBlit(pixelID)) {
 			if (pixelID.alphaBlend)
 				DrawSpriteNoTex<true>(pos0, pos1, v1.color0, state);
 			else
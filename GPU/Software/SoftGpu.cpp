@@ -36,6 +36,7 @@
 #include "Core/MIPS/MIPS.h"
 #include "Core/Util/PPGeDraw.h"
 #include "Common/Profiler/Profiler.h"
+#include "Common/Serialize/Serializer.h"
 #include "Common/GPU/thin3d.h"
 
 #include "GPU/Software/DrawPixel.h"
@@ -835,8 +836,9 @@ void SoftGPU::Execute_BlockTransferStart(u32 op, u32 diff) {
 
 	DoBlockTransfer(gstate_c.skipDrawReason);
 
-	// Could theoretically dirty the framebuffer.
+	// Could theoretically dirty the framebuffer, or the depth buffer.
 	MarkDirty(dst, dstSize, SoftGPUVRAMDirty::DIRTY | SoftGPUVRAMDirty::REALLY_DIRTY);
+	drawEngine_->transformUnit.InvalidateDepthTiles(dst, dstSize);
 }
 
 void SoftGPU::Execute_Prim(u32 op, u32 diff) {
@@ -1276,9 +1278,31 @@ void SoftGPU::GetStats(char *buffer, size_t bufsize) {
 	drawEngine_->transformUnit.GetStats(buffer, bufsize);
 }
 
+void SoftGPU::GetStageTimes(BinStageTimes *times) {
+	drawEngine_->transformUnit.GetStageTimes(times);
+}
+
+void SoftGPU::ResetStageTimes() {
+	drawEngine_->transformUnit.ResetStageTimes();
+}
+
 void SoftGPU::InvalidateCache(u32 addr, int size, GPUInvalidationType type)
 {
-	// Nothing to invalidate.
+	// Only the coarse depth tiles remember anything about VRAM contents.
+	drawEngine_->transformUnit.InvalidateDepthTiles(addr, type == GPU_INVALIDATE_ALL ? -1 : size);
+}
+
+void SoftGPU::PSPFrame() {
+	GPUCommon::PSPFrame();
+	// The CPU can write to depth without telling us, so don't trust the tiles across frames.
+	drawEngine_->transformUnit.InvalidateDepthTiles(0, -1);
+}
+
+void SoftGPU::DoState(PointerWrap &p) {
+	GPUCommon::DoState(p);
+	// VRAM may have been replaced entirely.
+	if (p.mode == PointerWrap::MODE_READ)
+		drawEngine_->transformUnit.InvalidateDepthTiles(0, -1);
 }
 
 void SoftGPU::PerformWriteFormattedFromMemory(u32 addr, int size, int width, GEBufferFormat format)
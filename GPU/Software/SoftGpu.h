@@ -113,6 +113,7 @@ static inline SoftDirty operator ~(const SoftDirty &v) {
 
 class PresentationCommon;
 class SoftwareDrawEngine;
+struct BinStageTimes;
 
 enum class SoftGPUVRAMDirty : uint8_t {
 	CLEAR = 0,
@@ -138,8 +139,13 @@ class SoftGPU : public GPUCommon {
 	void SetDisplayFramebuffer(u32 framebuf, u32 stride, GEBufferFormat format) override;
 	void CopyDisplayToOutput(bool reallyDirty) override;
 	void GetStats(char *buffer, size_t bufsize) override;
+	// Only collected while debug stats are enabled.
+	void GetStageTimes(BinStageTimes *times);
+	void ResetStageTimes();
 	std::vector<const VirtualFramebuffer *> GetFramebufferList() const override { return std::vector<const VirtualFramebuffer *>(); }
 	void InvalidateCache(u32 addr, int size, GPUInvalidationType type) override;
+	void PSPFrame() override;
+	void DoState(PointerWrap &p) override;
 	void PerformWriteFormattedFromMemory(u32 addr, int size, int width, GEBufferFormat format) override;
 	bool PerformMemoryCopy(u32 dest, u32 src, int size, GPUCopyFlag flags = GPUCopyFlag::NONE) override;
 	bool PerformMemorySet(u32 dest, u8 v, int size) override;
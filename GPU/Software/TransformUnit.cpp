@@ -551,6 +551,7 @@ std::vector<ClipVertexData> SoftwareVertexReader::cached_;
 
 void TransformUnit::SubmitPrimitive(const void* vertices, const void* indices, GEPrimitiveType prim_type, int vertex_count, u32 vertex_type, int *bytesRead, SoftwareDrawEngine *drawEngine)
 {
+	BinStageScope stageScope(*binner_, BinStage::TRANSFORM);
 	VertexDecoder &vdecoder = *drawEngine->FindVertexDecoder(vertex_type);
 
 	if (bytesRead)
@@ -906,6 +907,14 @@ void TransformUnit::GetStats(char *buffer, size_t bufsize) {
 	binner_->GetStats(buffer, bufsize);
 }
 
+void TransformUnit::GetStageTimes(BinStageTimes *times) {
+	binner_->GetStageTimes(times);
+}
+
+void TransformUnit::ResetStageTimes() {
+	binner_->ResetStageTimes();
+}
+
 void TransformUnit::FlushIfOverlap(const char *reason, bool modifying, uint32_t addr, uint32_t stride, uint32_t w, uint32_t h) {
 	if (!hasDraws_)
 		return;
@@ -920,6 +929,10 @@ void TransformUnit::NotifyClutUpdate(const void *src) {
 	binner_->UpdateClut(src);
 }
 
+void TransformUnit::InvalidateDepthTiles(uint32_t addr, int size) {
+	binner_->InvalidateDepthTiles(addr, size);
+}
+
 // TODO: This probably is not the best interface.
 // Also, we should try to merge this into the similar function in DrawEngineCommon.
 bool TransformUnit::GetCurrentSimpleVertices(int count, std::vector<GPUDebugVertex> &vertices, std::vector<u16> &indices) {
@@ -35,6 +35,7 @@ typedef Vec3<float> ViewCoords;
 typedef Vec4<float> ClipCoords; // Range: -w <= x/y/z <= w
 
 class BinManager;
+struct BinStageTimes;
 struct TransformState;
 
 enum class CullType {
@@ -144,8 +145,11 @@ class TransformUnit {
 	void Flush(const char *reason);
 	void FlushIfOverlap(const char *reason, bool modifying, uint32_t addr, uint32_t stride, uint32_t w, uint32_t h);
 	void NotifyClutUpdate(const void *src);
+	void InvalidateDepthTiles(uint32_t addr, int size);
 
 	void GetStats(char *buffer, size_t bufsize);
+	void GetStageTimes(BinStageTimes *times);
+	void ResetStageTimes();
 
 	void SetDirty(SoftDirty flags);
 	SoftDirty GetDirty();
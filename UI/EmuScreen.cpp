@@ -1420,7 +1420,13 @@ ScreenRenderFlags EmuScreen::render(ScreenRenderMode mode) {
 	uint32_t clearColor = 0;
 	if (!blockedExecution) {
 		PSP_BeginHostFrame();
-		PSP_RunLoopWhileState();
+		const bool runAhead = g_Config.iRunAheadFrames > 0 || PSP_RunAheadPending();
+		if (runAhead) {
+			// While frozen, the frame is reloaded anyway, so there's nothing to run ahead of.
+			PSP_RunAheadWhileState(PSP_CoreParameter().frozen ? 0 : g_Config.iRunAheadFrames);
+		} else {
+			PSP_RunLoopWhileState();
+		}
 
 		flags |= ScreenRenderFlags::HANDLED_THROTTLING;
 
@@ -1466,7 +1472,9 @@ ScreenRenderFlags EmuScreen::render(ScreenRenderMode mode) {
 		PSP_EndHostFrame();
 
 		// This place rougly matches how libretro handles it (after retro_frame).
-		Achievements::FrameUpdate();
+		// With run-ahead, it was already done after the real frame, so frames ahead aren't checked.
+		if (!runAhead)
+			Achievements::FrameUpdate();
 	}
 
 	if (gpu && gpu->PresentedThisFrame()) {
@@ -26,7 +26,7 @@ static const u8 loc_1CD4[16] = {0xE3, 0x50, 0xED, 0x1D, 0x91, 0x0A, 0x1F, 0xD0,
 static const u8 loc_1CE4[16] = {0x13, 0x5F, 0xA4, 0x7C, 0xAB, 0x39, 0x5B, 0xA4, 0x76, 0xB8, 0xCC, 0xA9, 0x8F, 0x3A, 0x04, 0x45};
 static const u8 loc_1CF4[16] = {0x67, 0x8D, 0x7F, 0xA3, 0x2A, 0x9C, 0xA0, 0xD1, 0x50, 0x8A, 0xD8, 0x38, 0x5E, 0x4B, 0x01, 0x7E};
 
-static u8 kirk_buf[0x0814]; // 1DC0 1DD4
+static u8 kirk_buf[BB_WORK_BUFFER_SIZE]; // 1DC0 1DD4
 
 /*************************************************************/
 
@@ -515,6 +515,11 @@ int sceDrmBBCipherInit(CIPHER_KEY *ckey, int type, int mode, u8 *header_key, u8
 }
 
 int sceDrmBBCipherUpdate(CIPHER_KEY *ckey, u8 *data, int size)
+{
+	return sceDrmBBCipherUpdateWithBuffer(ckey, data, size, kirk_buf);
+}
+
+int sceDrmBBCipherUpdateWithBuffer(CIPHER_KEY *ckey, u8 *data, int size, u8 *work_buf)
 {
 	int p, retv, dsize;
 
@@ -523,7 +528,7 @@ int sceDrmBBCipherUpdate(CIPHER_KEY *ckey, u8 *data, int size)
 
 	while(size>0){
 		dsize = (size>=0x0800)? 0x0800 : size;
-		retv = sub_428(kirk_buf, data+p, dsize, ckey);
+		retv = sub_428(work_buf, data+p, dsize, ckey);
 		if(retv)
 			break;
 		size -= dsize;
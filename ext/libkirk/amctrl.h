@@ -53,6 +53,9 @@ int bbmac_getkey(MAC_KEY *mkey, u8 *bbmac, u8 *vkey);
 //       2 for decrypt
 int sceDrmBBCipherInit(CIPHER_KEY *ckey, int type, int mode, u8 *header_key, u8 *version_key, u32 seed);
 int sceDrmBBCipherUpdate(CIPHER_KEY *ckey, u8 *data, int size);
+// Doesn't touch any global state for type 1 keys, so can run on several threads with separate buffers.
+#define BB_WORK_BUFFER_SIZE 0x0814
+int sceDrmBBCipherUpdateWithBuffer(CIPHER_KEY *ckey, u8 *data, int size, u8 *work_buf);
 int sceDrmBBCipherFinal(CIPHER_KEY *ckey);
 
 // npdrm.prx
@@ -28,6 +28,9 @@
 #include "Common/File/FileUtil.h"
 #include "Common/StringUtils.h"
 #include "Core/Loaders.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "ext/xxhash.h"
 
 #include "GPU/GPUState.h"
 #include "GPU/Common/GPUDebugInterface.h"
@@ -563,3 +566,43 @@ void ScreenshotComparer::PlotVisualComparison(u32 *dst, u32 offset, u32 actual,
 
 	dst[offset + w_ * 2 + 1] = (reference & 0x00FFFFFF) | alpha;
 }
+
+static uint64_t HashDebugBuffer(const GPUDebugBuffer &buffer) {
+	return XXH3_64bits(buffer.GetData(), buffer.PixelSize() * buffer.GetStride() * buffer.GetHeight());
+}
+
+bool GetFrameHashes(FrameHashes *hashes) {
+	if (!gpuDebug)
+		return false;
+
+	GPUDebugBuffer color;
+	GPUDebugBuffer depth;
+	if (!gpuDebug->GetCurrentFramebuffer(color, GPU_DBG_FRAMEBUF_DISPLAY) || !gpuDebug->GetCurrentDepthbuffer(depth))
+		return false;
+
+	hashes->color = HashDebugBuffer(color);
+	hashes->depth = HashDebugBuffer(depth);
+	return true;
+}
+
+bool GetStateHashes(StateHashes *hashes) {
+	if (!Memory::IsActive() || !currentMIPS)
+		return false;
+
+	XXH3_state_t *state = XXH3_createState();
+	XXH3_64bits_reset(state);
+	XXH3_64bits_update(state, currentMIPS->r, sizeof(currentMIPS->r));
+	XXH3_64bits_update(state, currentMIPS->f, sizeof(currentMIPS->f));
+	XXH3_64bits_update(state, currentMIPS->v, sizeof(currentMIPS->v));
+	XXH3_64bits_update(state, currentMIPS->vfpuCtrl, sizeof(currentMIPS->vfpuCtrl));
+	XXH3_64bits_update(state, &currentMIPS->pc, sizeof(currentMIPS->pc));
+	XXH3_64bits_update(state, &currentMIPS->hi, sizeof(currentMIPS->hi));
+	XXH3_64bits_update(state, &currentMIPS->lo, sizeof(currentMIPS->lo));
+	hashes->cpu = XXH3_64bits_digest(state);
+	XXH3_freeState(state);
+
+	hashes->ram = XXH3_64bits(Memory::GetPointerUnchecked(PSP_GetKernelMemoryBase()), Memory::g_MemorySize);
+	hashes->vram = XXH3_64bits(Memory::GetPointerUnchecked(PSP_GetVidMemBase()), Memory::VRAM_SIZE);
+	hashes->gpu = XXH3_64bits(&gstate, sizeof(gstate));
+	return true;
+}
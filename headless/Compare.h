@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#pragma once
+
 #include <string>
 #include <vector>
 
@@ -35,6 +37,32 @@ std::string GetTestName(const Path &bootFilename);
 bool CompareOutput(const Path &bootFilename, const std::string &output, bool verbose);
 std::vector<u32> TranslateDebugBufferToCompare(const GPUDebugBuffer *buffer, u32 stride, u32 h);
 
+struct FrameHashes {
+	uint64_t color = 0;
+	uint64_t depth = 0;
+
+	bool operator ==(const FrameHashes &other) const {
+		return color == other.color && depth == other.depth;
+	}
+};
+
+// Hashes the displayed framebuffer and the current depth buffer.
+bool GetFrameHashes(FrameHashes *hashes);
+
+struct StateHashes {
+	uint64_t cpu = 0;
+	uint64_t ram = 0;
+	uint64_t vram = 0;
+	uint64_t gpu = 0;
+
+	bool operator ==(const StateHashes &other) const {
+		return cpu == other.cpu && ram == other.ram && vram == other.vram && gpu == other.gpu;
+	}
+};
+
+// Hashes CPU registers, RAM, VRAM, and GE registers, to catch nondeterminism.
+bool GetStateHashes(StateHashes *hashes);
+
 class ScreenshotComparer {
 public:
 	ScreenshotComparer(const std::vector<u32> &pixels, u32 stride, u32 w, u32 h)
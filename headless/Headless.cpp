@@ -35,16 +35,20 @@
 #include "Core/ConfigValues.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/Replay.h"
 #include "Core/System.h"
 #include "Core/WebServer.h"
 #include "Core/HLE/sceUtility.h"
 #include "Core/SaveState.h"
+#include "Core/Loaders.h"
+#include "Core/FileSystems/BlockDevices.h"
 #include "GPU/Common/FramebufferManagerCommon.h"
 #include "Log.h"
 #include "LogManager.h"
 
 #include "Compare.h"
 #include "HeadlessHost.h"
+#include "ReplayBench.h"
 #if defined(_WIN32)
 #include "WindowsHeadlessHost.h"
 #elif defined(SDL)
@@ -172,11 +176,95 @@ int printUsage(const char *progname, const char *reason)
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
 	fprintf(stderr, "  --bench               run multiple times and output speed\n");
+	fprintf(stderr, "  --bench-replay=RUNS   replay each .ppdmp RUNS times and output frame timings\n");
+	fprintf(stderr, "                        directories are searched for .ppdmp files\n");
+	fprintf(stderr, "  --bench-json=FILE     also write --bench-replay results to FILE as JSON\n");
+	fprintf(stderr, "  --frame-hashes        print a hash of the framebuffer and depth each frame\n");
+	fprintf(stderr, "  --verify-threads=RUNS run each .ppdmp or test single and multi threaded RUNS times\n");
+	fprintf(stderr, "                        and report any frames that differ\n");
+	fprintf(stderr, "  --replay=FILE         play back an input replay, stopping when it ends\n");
+	fprintf(stderr, "  --frames=NUMBER       stop after NUMBER frames\n");
+	fprintf(stderr, "  --state-hashes=FILE   write a hash of cpu, ram, vram, and gpu state each frame\n");
+	fprintf(stderr, "  --state-baseline=FILE compare state hashes each frame against a --state-hashes file\n");
+	fprintf(stderr, "  --verify-run-ahead=N  run N frames ahead after each frame, then check that rolling\n");
+	fprintf(stderr, "                        back restores exactly the same state\n");
+	fprintf(stderr, "  --compress-zdi=FILE   convert the iso, cso, or chd to a zstd disc image, then verify it\n");
+	fprintf(stderr, "  --zdi-frame-size=N    uncompressed bytes per frame, default 16384\n");
+	fprintf(stderr, "  --zdi-level=N         zstd compression level, default 12\n");
+	fprintf(stderr, "  --zdi-dict-size=N     size of the trained dictionary, 0 for none, default 65536\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
 }
 
+static int CompressZstdDiscImage(const Path &input, const Path &output, const ZstdDiscImageOptions &options) {
+	FileLoader *fileLoader = ConstructFileLoader(input);
+	BlockDevice *source = fileLoader->Exists() ? constructBlockDevice(fileLoader) : nullptr;
+	if (!source) {
+		fprintf(stderr, "Unable to open disc image %s\n", input.c_str());
+		delete fileLoader;
+		return 1;
+	}
+
+	std::string errorString;
+	double start = time_now_d();
+	bool success = WriteZstdDiscImage(source, output, options, &errorString);
+	double compressTime = time_now_d() - start;
+	if (!success) {
+		fprintf(stderr, "Unable to write %s: %s\n", output.c_str(), errorString.c_str());
+		delete source;
+		delete fileLoader;
+		return 1;
+	}
+
+	// Read the whole thing back, both to verify and to show how fast it is.
+	FileLoader *zdiLoader = ConstructFileLoader(output);
+	ZstdDiscBlockDevice zdi(zdiLoader);
+	const u32 numBlocks = source->GetNumBlocks();
+	const u32 blockSize = source->GetBlockSize();
+	const u32 BATCH_BLOCKS = 64;
+	std::vector<u8> expected(BATCH_BLOCKS * blockSize);
+	std::vector<u8> actual(BATCH_BLOCKS * blockSize);
+	double readTime = 0.0;
+	success = zdi.GetNumBlocks() == numBlocks;
+	for (u32 block = 0; success && block < numBlocks; block += BATCH_BLOCKS) {
+		int count = (int)std::min(BATCH_BLOCKS, numBlocks - block);
+		source->ReadBlocks(block, count, &expected[0]);
+		double readStart = time_now_d();
+		success = zdi.ReadBlocks(block, count, &actual[0]);
+		readTime += time_now_d() - readStart;
+		if (success && memcmp(&expected[0], &actual[0], count * blockSize) != 0) {
+			fprintf(stderr, "Mismatch in blocks %d-%d\n", block, block + count - 1);
+			success = false;
+		}
+	}
+
+	// Scattered single sector reads, which is mostly what games do.
+	const int RANDOM_READS = 4096;
+	u32 seed = 1;
+	double randomStart = time_now_d();
+	for (int i = 0; success && i < RANDOM_READS && numBlocks != 0; ++i) {
+		seed = seed * 1103515245 + 12345;
+		zdi.ReadBlock((seed >> 8) % numBlocks, &actual[0]);
+	}
+	double randomTime = time_now_d() - randomStart;
+
+	if (success) {
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		const double inputSize = (double)numBlocks * blockSize;
+		const double outputSize = (double)zdiLoader->FileSize();
+		printf("%s: %0.1f MB -> %0.1f MB (%0.1f%%) in %0.1f s\n", output.c_str(), inputSize * mb, outputSize * mb, inputSize > 0.0 ? outputSize * 100.0 / inputSize : 0.0, compressTime);
+		printf("Verified, sequential %0.1f MB/s, random sector reads %0.1f us each\n", inputSize * mb / readTime, randomTime * 1000000.0 / RANDOM_READS);
+	} else {
+		fprintf(stderr, "Verification of %s failed\n", output.c_str());
+	}
+
+	delete zdiLoader;
+	delete source;
+	delete fileLoader;
+	return success ? 0 : 1;
+}
+
 static HeadlessHost *getHost(GPUCore gpuCore) {
 	switch (gpuCore) {
 	case GPUCORE_SOFTWARE:
@@ -194,17 +282,31 @@ static HeadlessHost *getHost(GPUCore gpuCore) {
 struct AutoTestOptions {
 	double timeout;
 	double maxScreenshotError;
+	int maxFrames;
+	Path replayFilename;
+	StateHashCheck *stateHashCheck;
+	ReplayThreadCheck *threadCheck;
+	RunAheadCheck *runAheadCheck;
 	bool compare : 1;
 	bool verbose : 1;
 	bool bench : 1;
+	bool benchReplay : 1;
+	bool frameHashes : 1;
+	bool verifyThreads : 1;
 };
 
+static void PrintFrameHashes(const char *frame) {
+	FrameHashes hashes;
+	if (GetFrameHashes(&hashes))
+		printf("Frame %s: color %016llx, depth %016llx\n", frame, (unsigned long long)hashes.color, (unsigned long long)hashes.depth);
+}
+
 bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const AutoTestOptions &opt) {
 	// Kinda ugly, trying to guesstimate the test name from filename...
 	currentTestName = GetTestName(coreParameter.fileToStart);
 
 	std::string output;
-	if (opt.compare || opt.bench)
+	if (opt.compare || opt.bench || opt.benchReplay || opt.verifyThreads)
 		coreParameter.collectDebugOutput = &output;
 
 	std::string error_string;
@@ -232,7 +334,17 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 
 	System_Notify(SystemNotification::BOOT_DONE);
 
-	Core_UpdateDebugStats((DebugOverlay)g_Config.iDebugOverlay == DebugOverlay::DEBUG_STATS || g_Config.bLogFrameDrops);
+	if (!opt.replayFilename.empty() && !ReplayExecuteFile(opt.replayFilename)) {
+		fprintf(stderr, "Failed to load replay '%s'\n", opt.replayFilename.c_str());
+		PSP_Shutdown();
+		TeamCityPrint("testFailed name='%s' message='Replay missing'", currentTestName.c_str());
+		TeamCityPrint("testFinished name='%s'", currentTestName.c_str());
+		return false;
+	}
+
+	int frames = 0;
+	// Stage times for replay benchmarks are only collected with debug stats.
+	Core_UpdateDebugStats((DebugOverlay)g_Config.iDebugOverlay == DebugOverlay::DEBUG_STATS || g_Config.bLogFrameDrops || opt.benchReplay);
 
 	PSP_BeginHostFrame();
 	Draw::DrawContext *draw = coreParameter.graphicsContext ? coreParameter.graphicsContext->GetDrawContext() : nullptr;
@@ -250,14 +362,26 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 		// If we were rendering, this might be a nice time to do something about it.
 		if (coreState == CORE_NEXTFRAME) {
 			coreState = CORE_RUNNING;
+			if (opt.frameHashes)
+				PrintFrameHashes(std::to_string(frames).c_str());
+			if (opt.stateHashCheck)
+				opt.stateHashCheck->OnFrame();
+			if (opt.threadCheck)
+				opt.threadCheck->OnFrame();
+			if (opt.runAheadCheck)
+				opt.runAheadCheck->OnFrame();
+			frames++;
 			headlessHost->SwapBuffers();
+
+			if (opt.maxFrames > 0 ? frames >= opt.maxFrames : !opt.replayFilename.empty() && !ReplayHasMoreEvents())
+				Core_Stop();
 		}
 		if (coreState == CORE_STEPPING && !coreParameter.startBreak) {
 			break;
 		}
 		if (time_now_d() > deadline) {
 			// Don't compare, print the output at least up to this point, and bail.
-			if (!opt.bench) {
+			if (!opt.bench && !opt.benchReplay && !opt.verifyThreads) {
 				printf("%s", output.c_str());
 
 				System_SendDebugOutput("TIMEOUT\n");
@@ -271,6 +395,11 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 	}
 	PSP_EndHostFrame();
 
+	if (!opt.replayFilename.empty())
+		ReplayAbort();
+	if (opt.frameHashes)
+		PrintFrameHashes("final");
+
 	if (draw) {
 		draw->BindFramebufferAsRenderTarget(nullptr, { Draw::RPAction::CLEAR, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE }, "Headless");
 		// Vulkan may get angry if we don't do a final present.
@@ -282,7 +411,7 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 
 	PSP_Shutdown();
 
-	if (!opt.bench)
+	if (!opt.bench && !opt.benchReplay && !opt.verifyThreads)
 		headlessHost->FlushDebugOutput();
 
 	if (opt.compare && passed)
@@ -340,6 +469,14 @@ int main(int argc, const char* argv[])
 	CPUCore cpuCore = CPUCore::JIT;
 	int debuggerPort = -1;
 	bool newAtrac = false;
+	int benchReplayRuns = 0;
+	int verifyThreadsRuns = 0;
+	const char *benchJsonFilename = nullptr;
+	const char *stateHashesFilename = nullptr;
+	int runAheadCheckFrames = 0;
+	const char *stateBaselineFilename = nullptr;
+	const char *compressZdiFilename = nullptr;
+	ZstdDiscImageOptions zdiOptions;
 
 	std::vector<std::string> testFilenames;
 	const char *mountIso = nullptr;
@@ -374,6 +511,32 @@ int main(int argc, const char* argv[])
 			testOptions.compare = true;
 		else if (!strcmp(argv[i], "--bench"))
 			testOptions.bench = true;
+		else if (!strncmp(argv[i], "--bench-replay=", strlen("--bench-replay=")) && strlen(argv[i]) > strlen("--bench-replay="))
+			benchReplayRuns = (int)strtoul(argv[i] + strlen("--bench-replay="), nullptr, 10);
+		else if (!strncmp(argv[i], "--bench-json=", strlen("--bench-json=")) && strlen(argv[i]) > strlen("--bench-json="))
+			benchJsonFilename = argv[i] + strlen("--bench-json=");
+		else if (!strcmp(argv[i], "--frame-hashes"))
+			testOptions.frameHashes = true;
+		else if (!strncmp(argv[i], "--verify-threads=", strlen("--verify-threads=")) && strlen(argv[i]) > strlen("--verify-threads="))
+			verifyThreadsRuns = (int)strtoul(argv[i] + strlen("--verify-threads="), nullptr, 10);
+		else if (!strncmp(argv[i], "--replay=", strlen("--replay=")) && strlen(argv[i]) > strlen("--replay="))
+			testOptions.replayFilename = Path(std::string(argv[i] + strlen("--replay=")));
+		else if (!strncmp(argv[i], "--frames=", strlen("--frames=")) && strlen(argv[i]) > strlen("--frames="))
+			testOptions.maxFrames = (int)strtoul(argv[i] + strlen("--frames="), nullptr, 10);
+		else if (!strncmp(argv[i], "--state-hashes=", strlen("--state-hashes=")) && strlen(argv[i]) > strlen("--state-hashes="))
+			stateHashesFilename = argv[i] + strlen("--state-hashes=");
+		else if (!strncmp(argv[i], "--state-baseline=", strlen("--state-baseline=")) && strlen(argv[i]) > strlen("--state-baseline="))
+			stateBaselineFilename = argv[i] + strlen("--state-baseline=");
+		else if (!strncmp(argv[i], "--verify-run-ahead=", strlen("--verify-run-ahead=")) && strlen(argv[i]) > strlen("--verify-run-ahead="))
+			runAheadCheckFrames = (int)strtoul(argv[i] + strlen("--verify-run-ahead="), nullptr, 10);
+		else if (!strncmp(argv[i], "--compress-zdi=", strlen("--compress-zdi=")) && strlen(argv[i]) > strlen("--compress-zdi="))
+			compressZdiFilename = argv[i] + strlen("--compress-zdi=");
+		else if (!strncmp(argv[i], "--zdi-frame-size=", strlen("--zdi-frame-size=")) && strlen(argv[i]) > strlen("--zdi-frame-size="))
+			zdiOptions.frameSize = (u32)strtoul(argv[i] + strlen("--zdi-frame-size="), nullptr, 10);
+		else if (!strncmp(argv[i], "--zdi-level=", strlen("--zdi-level=")) && strlen(argv[i]) > strlen("--zdi-level="))
+			zdiOptions.level = (int)strtol(argv[i] + strlen("--zdi-level="), nullptr, 10);
+		else if (!strncmp(argv[i], "--zdi-dict-size=", strlen("--zdi-dict-size=")) && strlen(argv[i]) > strlen("--zdi-dict-size="))
+			zdiOptions.dictionarySize = (u32)strtoul(argv[i] + strlen("--zdi-dict-size="), nullptr, 10);
 		else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose"))
 			testOptions.verbose = true;
 		else if (!strcmp(argv[i], "--new-atrac"))
@@ -423,6 +586,28 @@ int main(int argc, const char* argv[])
 	if (testFilenames.size() == 1 && testFilenames[0][0] == '@')
 		testFilenames = ReadFromListFile(testFilenames[0].substr(1));
 
+	testOptions.benchReplay = benchReplayRuns > 0;
+	testOptions.verifyThreads = verifyThreadsRuns > 0;
+	if (testOptions.benchReplay && testOptions.verifyThreads)
+		return printUsage(argv[0], "--bench-replay and --verify-threads can't be used together");
+	const bool checkStateHashes = stateHashesFilename || stateBaselineFilename;
+	if (checkStateHashes && testFilenames.size() != 1)
+		return printUsage(argv[0], "--state-hashes and --state-baseline need exactly one executable");
+	if (compressZdiFilename && testFilenames.size() != 1)
+		return printUsage(argv[0], "--compress-zdi needs exactly one disc image");
+	if (testOptions.benchReplay || testOptions.verifyThreads) {
+		std::vector<std::string> dumpFilenames;
+		for (const std::string &filename : testFilenames) {
+			if (File::IsDirectory(Path(filename))) {
+				std::vector<std::string> dirFilenames = ListReplayDirectory(Path(filename));
+				dumpFilenames.insert(dumpFilenames.end(), dirFilenames.begin(), dirFilenames.end());
+			} else {
+				dumpFilenames.push_back(filename);
+			}
+		}
+		testFilenames = dumpFilenames;
+	}
+
 	if (testFilenames.empty())
 		return printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
 
@@ -441,6 +626,12 @@ int main(int argc, const char* argv[])
 	// Needs to be after log so we don't interfere with test output.
 	g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
 
+	if (compressZdiFilename) {
+		int result = CompressZstdDiscImage(Path(testFilenames[0]), Path(std::string(compressZdiFilename)), zdiOptions);
+		g_threadManager.Teardown();
+		return result;
+	}
+
 	HeadlessHost *headlessHost = getHost(gpuCore);
 	g_headlessHost = headlessHost;
 
@@ -533,8 +724,9 @@ int main(int argc, const char* argv[])
 
 	if (screenshotFilename)
 		headlessHost->SetComparisonScreenshot(Path(std::string(screenshotFilename)), testOptions.maxScreenshotError);
-	headlessHost->SetWriteFailureScreenshot(!teamCityMode && !getenv("GITHUB_ACTIONS") && !testOptions.bench);
-	headlessHost->SetWriteDebugOutput(!testOptions.compare && !testOptions.bench);
+	const bool replayMode = testOptions.benchReplay || testOptions.verifyThreads;
+	headlessHost->SetWriteFailureScreenshot(!teamCityMode && !getenv("GITHUB_ACTIONS") && !testOptions.bench && !replayMode);
+	headlessHost->SetWriteDebugOutput(!testOptions.compare && !testOptions.bench && !replayMode);
 
 #if PPSSPP_PLATFORM(ANDROID)
 	// For some reason the debugger installs it with this name?
@@ -564,12 +756,47 @@ int main(int argc, const char* argv[])
 
 	std::vector<std::string> failedTests;
 	std::vector<std::string> passedTests;
+	ReplayBenchmark replayBench(benchReplayRuns);
+	ReplayThreadCheck threadCheck(verifyThreadsRuns);
+	StateHashCheck stateHashCheck;
+	if (checkStateHashes)
+		testOptions.stateHashCheck = &stateHashCheck;
+	if (testOptions.verifyThreads)
+		testOptions.threadCheck = &threadCheck;
+	RunAheadCheck runAheadCheck(runAheadCheckFrames);
+	if (runAheadCheckFrames > 0)
+		testOptions.runAheadCheck = &runAheadCheck;
 	for (size_t i = 0; i < testFilenames.size(); ++i)
 	{
 		coreParameter.fileToStart = Path(testFilenames[i]);
 		if (testOptions.compare)
 			printf("%s:\n", coreParameter.fileToStart.c_str());
+		if (testOptions.benchReplay)
+			replayBench.Begin(coreParameter.fileToStart);
+		if (testOptions.verifyThreads)
+			threadCheck.Begin(coreParameter.fileToStart);
+		if (testOptions.runAheadCheck)
+			runAheadCheck.Begin(coreParameter.fileToStart);
+		if (checkStateHashes) {
+			Path baseline = stateBaselineFilename ? Path(std::string(stateBaselineFilename)) : Path();
+			Path output = stateHashesFilename ? Path(std::string(stateHashesFilename)) : Path();
+			if (!stateHashCheck.Begin(coreParameter.fileToStart, baseline, output)) {
+				failedTests.push_back(GetTestName(coreParameter.fileToStart));
+				continue;
+			}
+		}
 		bool passed = RunAutoTest(headlessHost, coreParameter, testOptions);
+		// Tests that aren't dumps are run again from boot with the other thread setting.
+		while (testOptions.verifyThreads && threadCheck.NextRun())
+			passed = RunAutoTest(headlessHost, coreParameter, testOptions) && passed;
+		if (testOptions.benchReplay)
+			replayBench.End();
+		if (testOptions.verifyThreads && !threadCheck.End())
+			failedTests.push_back(GetTestName(coreParameter.fileToStart));
+		if (checkStateHashes && !stateHashCheck.End())
+			failedTests.push_back(GetTestName(coreParameter.fileToStart));
+		if (testOptions.runAheadCheck && !runAheadCheck.End())
+			failedTests.push_back(GetTestName(coreParameter.fileToStart));
 		if (testOptions.bench) {
 			double st = time_now_d();
 			double deadline = st + testOptions.timeout;
@@ -597,6 +824,12 @@ int main(int argc, const char* argv[])
 		}
 	}
 
+	if (testOptions.benchReplay) {
+		replayBench.Print();
+		if (benchJsonFilename)
+			replayBench.WriteJSON(Path(std::string(benchJsonFilename)));
+	}
+
 	if (testOptions.compare) {
 		printf("%d tests passed, %d tests failed.\n", (int)passedTests.size(), (int)failedTests.size());
 		if (!failedTests.empty())
@@ -0,0 +1,455 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "headless/Compare.h"
+#include "headless/ReplayBench.h"
+#include "Common/Data/Format/JSONWriter.h"
+#include "Common/File/DirListing.h"
+#include "Common/File/FileUtil.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Core/Config.h"
+#include "Core/Core.h"
+#include "Core/SaveState.h"
+#include "Core/System.h"
+#include "GPU/GPU.h"
+#include "GPU/Debugger/Playback.h"
+#include "GPU/Software/BinManager.h"
+#include "GPU/Software/SoftGpu.h"
+
+static SoftGPU *GetSoftGPU() {
+	if (!gpu || PSP_CoreParameter().gpuCore != GPUCORE_SOFTWARE)
+		return nullptr;
+	return static_cast<SoftGPU *>(gpu);
+}
+
+void ReplayBenchmark::Begin(const Path &filename) {
+	Result result;
+	result.name = GetTestName(filename);
+	results_.push_back(result);
+	warmedUp_ = false;
+
+	GPURecord::SetReplayTimingCallback([this](double seconds) {
+		return OnReplay(seconds);
+	});
+}
+
+void ReplayBenchmark::End() {
+	GPURecord::SetReplayTimingCallback(nullptr);
+}
+
+bool ReplayBenchmark::OnReplay(double seconds) {
+	Result &result = results_.back();
+	SoftGPU *softGPU = GetSoftGPU();
+
+	// The first replay loads the dump and compiles everything, so it isn't counted.
+	if (!warmedUp_) {
+		warmedUp_ = true;
+		if (softGPU)
+			softGPU->ResetStageTimes();
+		return runs_ > 0;
+	}
+
+	result.frameTimes.push_back(seconds);
+	if (softGPU) {
+		BinStageTimes times;
+		softGPU->GetStageTimes(&times);
+		softGPU->ResetStageTimes();
+
+		result.hasStages = true;
+		result.transform += times.transform;
+		result.state += times.state;
+		result.binning += times.binning;
+		result.raster += times.raster;
+		result.wait += times.wait;
+	}
+
+	return (int)result.frameTimes.size() < runs_;
+}
+
+double ReplayBenchmark::Percentile(const std::vector<double> &sorted, double p) {
+	if (sorted.empty())
+		return 0.0;
+	// Nearest rank.
+	size_t rank = (size_t)std::ceil(p * sorted.size());
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+void ReplayBenchmark::Print() const {
+	for (const Result &result : results_) {
+		if (result.frameTimes.empty()) {
+			printf("  %s - no frames timed\n", result.name.c_str());
+			continue;
+		}
+
+		std::vector<double> sorted = result.frameTimes;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double t : sorted)
+			total += t;
+		const double perFrame = 1000.0 / sorted.size();
+
+		printf("  %s - %d frames, mean %0.3f ms, p50 %0.3f ms, p90 %0.3f ms, p99 %0.3f ms, max %0.3f ms\n",
+			result.name.c_str(), (int)sorted.size(), total * perFrame,
+			Percentile(sorted, 0.5) * 1000.0, Percentile(sorted, 0.9) * 1000.0, Percentile(sorted, 0.99) * 1000.0, sorted.back() * 1000.0);
+		if (result.hasStages) {
+			printf("    transform %0.3f ms, state %0.3f ms, binning %0.3f ms, raster %0.3f ms (all threads), wait %0.3f ms\n",
+				result.transform * perFrame, result.state * perFrame, result.binning * perFrame, result.raster * perFrame, result.wait * perFrame);
+		}
+	}
+}
+
+bool ReplayBenchmark::WriteJSON(const Path &filename) const {
+	json::JsonWriter writer(json::JsonWriter::PRETTY);
+	writer.begin();
+	writer.writeInt("runs", runs_);
+	writer.writeString("graphics", PSP_CoreParameter().gpuCore == GPUCORE_SOFTWARE ? "software" : "hardware");
+	writer.writeInt("threads", g_threadManager.GetNumLooperThreads());
+	writer.pushArray("dumps");
+	for (const Result &result : results_) {
+		std::vector<double> sorted = result.frameTimes;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double t : sorted)
+			total += t;
+		const double perFrame = sorted.empty() ? 0.0 : 1000.0 / sorted.size();
+
+		writer.pushDict();
+		writer.writeString("name", result.name);
+		writer.writeInt("frames", (int)sorted.size());
+		writer.writeFloat("mean_ms", total * perFrame);
+		writer.writeFloat("min_ms", sorted.empty() ? 0.0 : sorted.front() * 1000.0);
+		writer.writeFloat("p50_ms", Percentile(sorted, 0.5) * 1000.0);
+		writer.writeFloat("p90_ms", Percentile(sorted, 0.9) * 1000.0);
+		writer.writeFloat("p99_ms", Percentile(sorted, 0.99) * 1000.0);
+		writer.writeFloat("max_ms", sorted.empty() ? 0.0 : sorted.back() * 1000.0);
+		if (result.hasStages) {
+			writer.pushDict("stages_ms");
+			writer.writeFloat("transform", result.transform * perFrame);
+			writer.writeFloat("state", result.state * perFrame);
+			writer.writeFloat("binning", result.binning * perFrame);
+			writer.writeFloat("raster", result.raster * perFrame);
+			writer.writeFloat("wait", result.wait * perFrame);
+			writer.pop();
+		}
+		writer.pop();
+	}
+	writer.pop();
+	writer.end();
+
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp) {
+		fprintf(stderr, "Unable to write benchmark results to '%s'\n", filename.c_str());
+		return false;
+	}
+	const std::string str = writer.str();
+	bool success = fwrite(str.data(), 1, str.size(), fp) == str.size();
+	fclose(fp);
+	return success;
+}
+
+void ReplayThreadCheck::Begin(const Path &filename) {
+	name_ = GetTestName(filename);
+	replays_ = 0;
+	compared_ = 0;
+	diverged_ = 0;
+	frame_ = 0;
+	singleFrames_.clear();
+
+	// Start single threaded, OnReplay() or NextRun() switch back and forth.
+	savedThreads_ = g_Config.iSoftwareRenderingThreads;
+	g_Config.iSoftwareRenderingThreads = 1;
+	dump_ = filename.GetFileExtension() == ".ppdmp";
+	if (dump_) {
+		GPURecord::SetReplayTimingCallback([this](double seconds) {
+			return OnReplay(seconds);
+		});
+	}
+}
+
+void ReplayThreadCheck::OnFrame() {
+	if (dump_)
+		return;
+
+	FrameHashes hashes;
+	if (!GetFrameHashes(&hashes))
+		return;
+
+	// This relies on the test running deterministically from boot, which headless does with the same settings.
+	if ((replays_ & 1) == 0)
+		singleFrames_.push_back(hashes);
+	else if (frame_ < singleFrames_.size())
+		Compare(singleFrames_[frame_], hashes);
+	frame_++;
+}
+
+bool ReplayThreadCheck::NextRun() {
+	if (dump_)
+		return false;
+
+	if ((replays_ & 1) != 0 && frame_ != singleFrames_.size()) {
+		diverged_++;
+		printf("  %s - threaded run had %d frames, single threaded %d\n", name_.c_str(), (int)frame_, (int)singleFrames_.size());
+	}
+
+	replays_++;
+	frame_ = 0;
+	if ((replays_ & 1) == 0)
+		singleFrames_.clear();
+	g_Config.iSoftwareRenderingThreads = (replays_ & 1) != 0 ? savedThreads_ : 1;
+	return replays_ < runs_ * 2;
+}
+
+bool ReplayThreadCheck::End() {
+	GPURecord::SetReplayTimingCallback(nullptr);
+	g_Config.iSoftwareRenderingThreads = savedThreads_;
+
+	if (compared_ == 0) {
+		printf("  %s - no frames compared\n", name_.c_str());
+		return false;
+	}
+	if (diverged_ != 0) {
+		printf("  %s - threaded output differed in %d of %d frames\n", name_.c_str(), diverged_, compared_);
+		return false;
+	}
+	printf("  %s - %d frames identical\n", name_.c_str(), compared_);
+	return true;
+}
+
+bool ReplayThreadCheck::OnReplay(double seconds) {
+	FrameHashes hashes;
+	if (!GetFrameHashes(&hashes)) {
+		printf("  %s - unable to read framebuffer\n", name_.c_str());
+		return false;
+	}
+
+	// Even replays are single threaded, odd ones use the configured threads.
+	if ((replays_ & 1) == 0) {
+		single_ = hashes;
+		g_Config.iSoftwareRenderingThreads = savedThreads_;
+	} else {
+		Compare(single_, hashes);
+		g_Config.iSoftwareRenderingThreads = 1;
+	}
+
+	replays_++;
+	return replays_ < runs_ * 2;
+}
+
+void ReplayThreadCheck::Compare(const FrameHashes &single, const FrameHashes &threaded) {
+	compared_++;
+	if (!(threaded == single)) {
+		diverged_++;
+		printf("  %s - frame %d differs: color %016llx / %016llx, depth %016llx / %016llx\n", name_.c_str(), compared_,
+			(unsigned long long)single.color, (unsigned long long)threaded.color, (unsigned long long)single.depth, (unsigned long long)threaded.depth);
+	}
+}
+
+static const char *const STATE_HASHES_HEADER = "# PPSSPP state hashes v1";
+
+StateHashCheck::~StateHashCheck() {
+	if (output_)
+		fclose(output_);
+}
+
+bool StateHashCheck::Begin(const Path &filename, const Path &baselineFilename, const Path &outputFilename) {
+	name_ = GetTestName(filename);
+	frames_ = 0;
+	diverged_ = 0;
+	firstDiverged_ = -1;
+	baseline_.clear();
+	hasBaseline_ = false;
+
+	if (!baselineFilename.empty() && !ReadBaseline(baselineFilename)) {
+		printf("  %s - unable to read state hash baseline %s\n", name_.c_str(), baselineFilename.c_str());
+		return false;
+	}
+
+	if (output_)
+		fclose(output_);
+	output_ = nullptr;
+	if (!outputFilename.empty()) {
+		output_ = File::OpenCFile(outputFilename, "wt");
+		if (!output_) {
+			printf("  %s - unable to write state hashes to %s\n", name_.c_str(), outputFilename.c_str());
+			return false;
+		}
+		fprintf(output_, "%s\n", STATE_HASHES_HEADER);
+	}
+	return true;
+}
+
+bool StateHashCheck::ReadBaseline(const Path &filename) {
+	FILE *fp = File::OpenCFile(filename, "rt");
+	if (!fp)
+		return false;
+
+	char line[256];
+	if (!fgets(line, sizeof(line), fp) || strncmp(line, STATE_HASHES_HEADER, strlen(STATE_HASHES_HEADER)) != 0) {
+		fclose(fp);
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		Frame f;
+		unsigned long long cpu, ram, vram, gpu;
+		if (sscanf(line, "%d %llx %llx %llx %llx", &f.frame, &cpu, &ram, &vram, &gpu) != 5)
+			continue;
+		f.hashes.cpu = cpu;
+		f.hashes.ram = ram;
+		f.hashes.vram = vram;
+		f.hashes.gpu = gpu;
+		baseline_.push_back(f);
+	}
+	fclose(fp);
+	hasBaseline_ = true;
+	return true;
+}
+
+void StateHashCheck::OnFrame() {
+	StateHashes hashes;
+	if (!GetStateHashes(&hashes))
+		return;
+
+	int frame = frames_++;
+	if (output_) {
+		fprintf(output_, "%d %016llx %016llx %016llx %016llx\n", frame,
+			(unsigned long long)hashes.cpu, (unsigned long long)hashes.ram, (unsigned long long)hashes.vram, (unsigned long long)hashes.gpu);
+	}
+
+	if (!hasBaseline_ || frame >= (int)baseline_.size() || baseline_[frame].frame != frame)
+		return;
+	const StateHashes &expected = baseline_[frame].hashes;
+	if (hashes == expected)
+		return;
+
+	diverged_++;
+	// After the first difference everything tends to differ, so only detail that one.
+	if (firstDiverged_ < 0) {
+		firstDiverged_ = frame;
+		printf("  %s - frame %d differs:%s%s%s%s\n", name_.c_str(), frame,
+			hashes.cpu != expected.cpu ? " cpu" : "",
+			hashes.ram != expected.ram ? " ram" : "",
+			hashes.vram != expected.vram ? " vram" : "",
+			hashes.gpu != expected.gpu ? " gpu" : "");
+	}
+}
+
+bool StateHashCheck::End() {
+	if (output_) {
+		fclose(output_);
+		output_ = nullptr;
+	}
+
+	if (!hasBaseline_) {
+		printf("  %s - %d frames hashed\n", name_.c_str(), frames_);
+		return frames_ != 0;
+	}
+	if (frames_ != (int)baseline_.size())
+		printf("  %s - ran %d frames, baseline has %d\n", name_.c_str(), frames_, (int)baseline_.size());
+	if (diverged_ != 0) {
+		printf("  %s - state differed from baseline in %d of %d frames, first at frame %d\n", name_.c_str(), diverged_, frames_, firstDiverged_);
+		return false;
+	}
+	printf("  %s - %d frames match baseline\n", name_.c_str(), std::min(frames_, (int)baseline_.size()));
+	return frames_ == (int)baseline_.size();
+}
+
+void RunAheadCheck::Begin(const Path &filename) {
+	name_ = GetTestName(filename);
+	checked_ = 0;
+	diverged_ = 0;
+	firstDiverged_ = -1;
+	rollback_.Clear();
+}
+
+void RunAheadCheck::OnFrame() {
+	StateHashes before;
+	if (!GetStateHashes(&before) || SaveState::SaveToRam(before_) != CChunkFileReader::ERROR_NONE)
+		return;
+
+	const int frame = checked_++;
+	bool restored = rollback_.Save() == CChunkFileReader::ERROR_NONE;
+	if (restored) {
+		for (int i = 0; i < frames_; ++i) {
+			coreState = CORE_RUNNING;
+			PSP_RunLoopWhileState();
+			if (coreState != CORE_NEXTFRAME)
+				break;
+		}
+
+		std::string errorString;
+		restored = rollback_.Load(&errorString) == CChunkFileReader::ERROR_NONE;
+		if (!restored)
+			printf("  %s - frame %d rollback failed: %s\n", name_.c_str(), frame, errorString.c_str());
+	} else {
+		printf("  %s - frame %d rollback save failed\n", name_.c_str(), frame);
+	}
+	// Even if the test ended while running ahead, it hasn't really.
+	coreState = CORE_RUNNING;
+
+	StateHashes after;
+	bool sameHashes = restored && GetStateHashes(&after) && after == before;
+	bool sameState = restored && SaveState::SaveToRam(after_) == CChunkFileReader::ERROR_NONE && after_ == before_;
+	if (sameHashes && sameState)
+		return;
+
+	diverged_++;
+	// Later frames build on a broken rollback, so only detail the first.
+	if (firstDiverged_ < 0) {
+		firstDiverged_ = frame;
+		if (restored) {
+			printf("  %s - frame %d not restored:%s%s%s%s%s\n", name_.c_str(), frame,
+				after.cpu != before.cpu ? " cpu" : "",
+				after.ram != before.ram ? " ram" : "",
+				after.vram != before.vram ? " vram" : "",
+				after.gpu != before.gpu ? " gpu" : "",
+				!sameState ? " state" : "");
+		}
+	}
+}
+
+bool RunAheadCheck::End() {
+	rollback_.Clear();
+	if (checked_ == 0) {
+		printf("  %s - no frames rolled back\n", name_.c_str());
+		return false;
+	}
+	if (diverged_ != 0) {
+		printf("  %s - rollback differed in %d of %d frames, first at frame %d\n", name_.c_str(), diverged_, checked_, firstDiverged_);
+		return false;
+	}
+	printf("  %s - %d frames rolled back exactly\n", name_.c_str(), checked_);
+	return true;
+}
+
+std::vector<std::string> ListReplayDirectory(const Path &dir) {
+	std::vector<File::FileInfo> files;
+	File::GetFilesInDir(dir, &files, "ppdmp:");
+	std::sort(files.begin(), files.end());
+
+	std::vector<std::string> filenames;
+	for (const File::FileInfo &info : files) {
+		if (!info.isDirectory)
+			filenames.push_back(info.fullName.ToString());
+	}
+	return filenames;
+}
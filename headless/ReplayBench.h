@@ -0,0 +1,142 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Common/File/Path.h"
+#include "Core/SaveState.h"
+#include "headless/Compare.h"
+
+// Times repeated replays of GE frame dumps (.ppdmp), for tracking renderer performance.
+class ReplayBenchmark {
+public:
+	explicit ReplayBenchmark(int runs) : runs_(runs) {}
+
+	// Call around running each dump.
+	void Begin(const Path &filename);
+	void End();
+
+	void Print() const;
+	bool WriteJSON(const Path &filename) const;
+
+private:
+	struct Result {
+		std::string name;
+		std::vector<double> frameTimes;
+		bool hasStages = false;
+		// Totals over all timed frames, in seconds.
+		double transform = 0.0;
+		double state = 0.0;
+		double binning = 0.0;
+		double raster = 0.0;
+		double wait = 0.0;
+	};
+
+	bool OnReplay(double seconds);
+	static double Percentile(const std::vector<double> &sorted, double p);
+
+	int runs_;
+	bool warmedUp_ = false;
+	std::vector<Result> results_;
+};
+
+// Runs each dump or test alternately single and multi threaded, checking the output is identical.
+// Dumps are replayed in place, other tests are run from boot again and compared frame by frame.
+class ReplayThreadCheck {
+public:
+	explicit ReplayThreadCheck(int runs) : runs_(runs) {}
+
+	void Begin(const Path &filename);
+	// Call each frame of a test that isn't a dump.
+	void OnFrame();
+	// Call after running the file, returns true if it should run again.
+	bool NextRun();
+	// Returns false if any frame differed.
+	bool End();
+
+private:
+	bool OnReplay(double seconds);
+	void Compare(const FrameHashes &single, const FrameHashes &threaded);
+
+	int runs_;
+	int replays_ = 0;
+	int compared_ = 0;
+	int diverged_ = 0;
+	int savedThreads_ = 0;
+	bool dump_ = false;
+	size_t frame_ = 0;
+	std::string name_;
+	FrameHashes single_;
+	std::vector<FrameHashes> singleFrames_;
+};
+
+// Hashes emulator state every frame while an input replay runs, and compares against a baseline.
+// This makes it quick to find the first frame where JIT or threading changes broke determinism.
+class StateHashCheck {
+public:
+	~StateHashCheck();
+
+	// Either filename may be empty.  The baseline is read before the output is written, so they can match.
+	bool Begin(const Path &filename, const Path &baselineFilename, const Path &outputFilename);
+	void OnFrame();
+	// Returns false if any frame differed from the baseline.
+	bool End();
+
+private:
+	struct Frame {
+		int frame;
+		StateHashes hashes;
+	};
+
+	bool ReadBaseline(const Path &filename);
+
+	std::string name_;
+	std::vector<Frame> baseline_;
+	bool hasBaseline_ = false;
+	FILE *output_ = nullptr;
+	int frames_ = 0;
+	int diverged_ = 0;
+	int firstDiverged_ = -1;
+};
+
+// Runs frames ahead after each frame and rolls back, like run-ahead does, checking the state comes back exactly.
+class RunAheadCheck {
+public:
+	explicit RunAheadCheck(int frames) : frames_(frames) {}
+
+	void Begin(const Path &filename);
+	void OnFrame();
+	// Returns false if any rollback didn't restore the state.
+	bool End();
+
+private:
+	int frames_;
+	std::string name_;
+	SaveState::RollbackState rollback_;
+	std::vector<u8> before_;
+	std::vector<u8> after_;
+	int checked_ = 0;
+	int diverged_ = 0;
+	int firstDiverged_ = -1;
+};
+
+// Lists the frame dumps in a directory, sorted by name.
+std::vector<std::string> ListReplayDirectory(const Path &dir);
@@ -0,0 +1,87 @@
+// Times saving and loading a state the way rewind does, and counts allocations per call.
+//
+// This is a separate program from PPSSPPUnitTest, since counting replaces the global operator new
+// and delete, and that shouldn't affect every other test.
+//
+// Usage: SerializerBenchmark [iterations]
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Common/TimeUtil.h"
+#include "TestSerializer.h"
+
+static std::atomic<bool> g_countAllocations;
+static std::atomic<int> g_allocations;
+
+void *operator new(size_t size) {
+	if (g_countAllocations)
+		g_allocations++;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+	free(ptr);
+}
+
+template <typename F>
+static void Measure(const char *title, int iterations, F func) {
+	g_allocations = 0;
+	g_countAllocations = true;
+	double start = time_now_d();
+	for (int i = 0; i < iterations; ++i)
+		func();
+	double elapsed = time_now_d() - start;
+	g_countAllocations = false;
+
+	printf("%s: %0.3f ms, %0.1f allocations per call\n", title, elapsed * 1000.0 / iterations, (double)g_allocations / iterations);
+}
+
+int main(int argc, char *argv[]) {
+	const int iterations = argc > 1 ? atoi(argv[1]) : 200;
+	if (iterations <= 0) {
+		fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	SerializeTestState state;
+	state.Fill(2000, 1);
+	std::vector<u8> buffer;
+	PointerWrapArena arena;
+	std::string error;
+
+	// Warm up, so the buffer and arena are already sized.
+	if (CChunkFileReader::MeasureAndSavePtr(state, &buffer, &arena) != CChunkFileReader::ERROR_NONE || CChunkFileReader::LoadPtr(&buffer[0], state, &error) != CChunkFileReader::ERROR_NONE) {
+		fprintf(stderr, "Failed to save or load: %s\n", error.c_str());
+		return 1;
+	}
+	printf("State: %d bytes\n", (int)buffer.size());
+
+	Measure("MeasureAndSavePtr", iterations, [&] {
+		CChunkFileReader::MeasureAndSavePtr(state, &buffer, &arena);
+	});
+	Measure("MeasureAndSavePtr without arena", iterations, [&] {
+		CChunkFileReader::MeasureAndSavePtr(state, &buffer);
+	});
+	Measure("LoadPtr", iterations, [&] {
+		CChunkFileReader::LoadPtr(&buffer[0], state, &error);
+	});
+
+	// For comparison, loading into empty containers has to create every entry.
+	Measure("LoadPtr into an empty state", iterations, [&] {
+		SerializeTestState empty;
+		CChunkFileReader::LoadPtr(&buffer[0], empty, &error);
+	});
+	return 0;
+}
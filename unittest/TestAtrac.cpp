@@ -0,0 +1,378 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Common/CPUDetect.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/HLE/AtracCtx.h"
+#include "Core/HW/Atrac3Standalone.h"
+#include "Core/HW/SimpleAudioDec.h"
+#include "Core/MemMap.h"
+
+#include "UnitTest.h"
+
+static const u32 TRACK_ADDR = 0x08800000;
+static const u32 OUT_ADDR = 0x08C00000;
+static const int TRACK_FRAMES = 96;
+
+struct AtracTestFormat {
+	const char *name;
+	u32 codecType;
+	u16 bytesPerFrame;
+	int jointStereo;
+};
+
+static u32 NextRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// Same as AtracBase::CreateDecoder().
+static AudioDecoder *CreateTestDecoder(const AtracTestFormat &format) {
+	if (format.codecType == PSP_MODE_AT_3) {
+		uint8_t extraData[14]{};
+		extraData[0] = 1;
+		extraData[3] = 2 << 3;
+		extraData[6] = format.jointStereo;
+		extraData[8] = format.jointStereo;
+		extraData[10] = 1;
+		return CreateAtrac3Audio(2, format.bytesPerFrame, extraData, sizeof(extraData));
+	}
+	return CreateAtrac3PlusAudio(2, format.bytesPerFrame);
+}
+
+// MSB first, like the decoder reads.
+struct BitWriter {
+	u8 *data;
+	int pos;
+
+	void Write(u32 value, int bits) {
+		for (int i = bits - 1; i >= 0; --i, ++pos) {
+			const u8 mask = 0x80 >> (pos & 7);
+			data[pos >> 3] = (value >> i) & 1 ? (data[pos >> 3] | mask) : (data[pos >> 3] & ~mask);
+		}
+	}
+};
+
+// A whole ATRAC3 sound unit.  Random bits would fail checks, or make the decoder read past the frame.
+static void WriteAtrac3SoundUnit(BitWriter &bits, bool jointSecond, u32 &seed) {
+	bits.Write(jointSecond ? 3 : 0x28, jointSecond ? 2 : 6);
+	const int bandsCoded = NextRandom(seed) % 4;
+	bits.Write(bandsCoded, 2);
+	for (int band = 0; band <= bandsCoded; ++band) {
+		// Gain control carries into the next frame, so it's worth having.
+		const int points = NextRandom(seed) % 4;
+		bits.Write(points, 3);
+		int loc = NextRandom(seed) % 8;
+		for (int i = 0; i < points; ++i) {
+			bits.Write(NextRandom(seed) % 16, 4);
+			bits.Write(loc, 5);
+			loc += 1 + NextRandom(seed) % 7;
+		}
+	}
+	// No tonal components.
+	bits.Write(0, 5);
+
+	// A few low subbands, with constant length coding so the size is known.
+	static const int clcLength[8] = { 0, 4, 3, 3, 4, 4, 5, 6 };
+	const int subbands = NextRandom(seed) % 8;
+	int selectors[8];
+	bits.Write(subbands, 5);
+	bits.Write(1, 1);
+	for (int i = 0; i <= subbands; ++i) {
+		selectors[i] = 1 + NextRandom(seed) % 7;
+		bits.Write(selectors[i], 3);
+	}
+	for (int i = 0; i <= subbands; ++i)
+		bits.Write(NextRandom(seed) % 64, 6);
+	for (int i = 0; i <= subbands; ++i) {
+		// The first eight subbands have eight coefficients each, and selector 1 packs two per code.
+		const int codes = selectors[i] == 1 ? 4 : 8;
+		for (int j = 0; j < codes; ++j)
+			bits.Write(NextRandom(seed), clcLength[selectors[i]]);
+	}
+}
+
+// The start of an ATRAC3+ stereo unit, with every parameter coded directly.
+// The delta modes depend on leftovers from the last frame, which random bits can't account for.
+static void WriteAtrac3PlusUnitHeader(BitWriter &bits, u32 &seed) {
+	// A start bit, then the stereo unit id.
+	bits.Write(1, 3);
+	const int quantUnits = 6 + NextRandom(seed) % 9;
+	bits.Write(quantUnits - 1, 5);
+	bits.Write(0, 1);
+	// Word lengths, all non-zero so every unit is used and needs no clone flags.
+	for (int ch = 0; ch < 2; ++ch) {
+		bits.Write(0, 2);
+		for (int i = 0; i < quantUnits; ++i)
+			bits.Write(1 + NextRandom(seed) % 3, 3);
+	}
+	// Scale factors.
+	for (int ch = 0; ch < 2; ++ch) {
+		bits.Write(0, 2);
+		for (int i = 0; i < quantUnits; ++i)
+			bits.Write(10 + NextRandom(seed) % 30, 6);
+	}
+	// Code tables, restricted and for all units.
+	bits.Write(0, 1);
+	for (int ch = 0; ch < 2; ++ch) {
+		bits.Write(NextRandom(seed) % 2, 1);
+		bits.Write(0, 2);
+		bits.Write(0, 1);
+		for (int i = 0; i < quantUnits; ++i)
+			bits.Write(NextRandom(seed) % 4, 2);
+	}
+	// The spectrum and everything after it are left random.
+}
+
+// There's no encoder to make real tracks with, so these are random frames the decoder accepts.
+static std::vector<u8> GenerateFrames(const AtracTestFormat &format) {
+	// The decoder can read past the end of a bad frame, like Atrac::SetData() pads for.
+	std::vector<u8> frames(format.bytesPerFrame * TRACK_FRAMES + 0x4000);
+	std::vector<u8> reversed(format.bytesPerFrame);
+	std::vector<int16_t> scratch(ATRAC3PLUS_MAX_SAMPLES * 2);
+	u32 seed = format.bytesPerFrame;
+	for (int i = 0; i < TRACK_FRAMES; ++i) {
+		u8 *frame = &frames[i * format.bytesPerFrame];
+		for (int attempt = 0; ; ++attempt) {
+			for (int j = 0; j < format.bytesPerFrame; ++j)
+				frame[j] = (u8)NextRandom(seed);
+			if (format.codecType == PSP_MODE_AT_3 && format.jointStereo) {
+				BitWriter first{ frame, 0 };
+				WriteAtrac3SoundUnit(first, false, seed);
+				// The second unit is stored backwards from the end, after any 0xF8 sync bytes.
+				for (int j = 0; j < format.bytesPerFrame; ++j)
+					reversed[j] = frame[format.bytesPerFrame - 1 - j];
+				BitWriter second{ &reversed[0], 0 };
+				// Weighting and matrixing, which also carry over between frames.  The top bit keeps it from looking like sync.
+				second.Write(NextRandom(seed) & 0x7FF, 12);
+				WriteAtrac3SoundUnit(second, true, seed);
+				for (int j = 0; j < (second.pos + 7) / 8; ++j)
+					frame[format.bytesPerFrame - 1 - j] = reversed[j];
+			} else if (format.codecType == PSP_MODE_AT_3) {
+				for (int ch = 0; ch < 2; ++ch) {
+					BitWriter bits{ frame + ch * format.bytesPerFrame / 2, 0 };
+					WriteAtrac3SoundUnit(bits, false, seed);
+				}
+			} else {
+				BitWriter bits{ frame, 0 };
+				WriteAtrac3PlusUnitHeader(bits, seed);
+			}
+
+			std::unique_ptr<AudioDecoder> decoder(CreateTestDecoder(format));
+			int outSamples = 0;
+			if (decoder->Decode(frame, format.bytesPerFrame, nullptr, 2, scratch.data(), &outSamples) && outSamples != 0)
+				break;
+			_assert_(attempt < 10000);
+		}
+	}
+	frames.resize(format.bytesPerFrame * TRACK_FRAMES);
+	return frames;
+}
+
+static void Write32(u32 &addr, u32 value) {
+	Memory::Write_U32(value, addr);
+	addr += 4;
+}
+
+static void Write16(u32 &addr, u16 value) {
+	Memory::Write_U16(value, addr);
+	addr += 2;
+}
+
+// A RIFF track with a loop, like games use for music.  Returns the file size.
+static u32 WriteTrack(const AtracTestFormat &format, const std::vector<u8> &frames, int loopStart, int loopEnd) {
+	const u32 samplesPerFrame = format.codecType == PSP_MODE_AT_3_PLUS ? ATRAC3PLUS_MAX_SAMPLES : ATRAC3_MAX_SAMPLES;
+	const u32 fmtSize = format.codecType == PSP_MODE_AT_3_PLUS ? 52 : 32;
+
+	u32 addr = TRACK_ADDR;
+	Write32(addr, 0x46464952);
+	const u32 riffSizeAddr = addr;
+	Write32(addr, 0);
+	Write32(addr, 0x45564157);
+
+	Write32(addr, 0x20746D66);
+	Write32(addr, fmtSize);
+	const u32 fmtAddr = addr;
+	Write16(addr, format.codecType == PSP_MODE_AT_3_PLUS ? AT3_PLUS_MAGIC : AT3_MAGIC);
+	Write16(addr, 2);
+	Write32(addr, 44100);
+	Write32(addr, format.bytesPerFrame * 44100 / samplesPerFrame);
+	Write16(addr, format.bytesPerFrame);
+	while (addr < fmtAddr + fmtSize)
+		Write16(addr, 0);
+	if (format.codecType == PSP_MODE_AT_3)
+		Memory::Write_U32(format.jointStereo, fmtAddr + 24);
+
+	Write32(addr, 0x74636166);
+	Write32(addr, 8);
+	Write32(addr, (TRACK_FRAMES - 4) * samplesPerFrame);
+	Write32(addr, samplesPerFrame);
+
+	Write32(addr, 0x6C706D73);
+	Write32(addr, 36 + 24);
+	for (int i = 0; i < 7; ++i)
+		Write32(addr, 0);
+	Write32(addr, 1);
+	Write32(addr, 0);
+	Write32(addr, 0);
+	Write32(addr, 0);
+	Write32(addr, loopStart);
+	Write32(addr, loopEnd);
+	Write32(addr, 0);
+	Write32(addr, 0);
+
+	Write32(addr, 0x61746164);
+	Write32(addr, (u32)frames.size());
+	memcpy(Memory::GetPointerWriteRange(addr, (u32)frames.size()), frames.data(), frames.size());
+	addr += (u32)frames.size();
+
+	const u32 fileSize = addr - TRACK_ADDR;
+	Memory::Write_U32(fileSize - 8, riffSizeAddr);
+	return fileSize;
+}
+
+struct AtracDecodeResult {
+	std::vector<int16_t> pcm;
+	std::vector<u32> samples;
+	std::vector<u32> finish;
+	std::vector<int> remains;
+	double decodeTime = 0.0;
+};
+
+// Plays through the loop a few times, then jumps back into the middle like a game restarting its music.
+// If given, newFrames replaces the data in memory partway through, without telling the Atrac.
+static bool DecodeTrack(const AtracTestFormat &format, u32 fileSize, bool decodeAhead, const std::vector<u8> &newFrames, AtracDecodeResult &result) {
+	std::unique_ptr<Atrac> atrac(new Atrac());
+	atrac->SetDecodeAhead(decodeAhead);
+	atrac->GetTrackMut().codecType = format.codecType;
+	EXPECT_EQ_INT(atrac->Analyze(TRACK_ADDR, fileSize), 0);
+	EXPECT_EQ_INT(atrac->SetData(TRACK_ADDR, fileSize, fileSize, 2, 0), 0);
+	EXPECT_EQ_INT(atrac->BufferState(), ATRAC_STATUS_ALL_DATA_LOADED);
+
+	u8 *outbuf = Memory::GetPointerWriteRange(OUT_ADDR, ATRAC3PLUS_MAX_SAMPLES * 2 * sizeof(int16_t));
+	for (int pass = 0; pass < 2; ++pass) {
+		if (pass == 1)
+			EXPECT_EQ_INT(atrac->ResetPlayPosition(atrac->GetTrack().loopStartSample + 5000, 0, 0), 0);
+		atrac->SetLoopNum(3);
+
+		for (int call = 0; call < TRACK_FRAMES * 8; ++call) {
+			// After the first loop, so there are cached frames.
+			if (pass == 0 && call == TRACK_FRAMES + 7 && !newFrames.empty()) {
+				const u32 dataAddr = TRACK_ADDR + fileSize - (u32)newFrames.size();
+				memcpy(Memory::GetPointerWriteRange(dataAddr, (u32)newFrames.size()), newFrames.data(), newFrames.size());
+			}
+
+			u32 samples = 0;
+			u32 finish = 0;
+			int remains = 0;
+			memset(outbuf, 0, ATRAC3PLUS_MAX_SAMPLES * 2 * sizeof(int16_t));
+
+			double start = time_now_d();
+			u32 ret = atrac->DecodeData(outbuf, OUT_ADDR, &samples, &finish, &remains);
+			result.decodeTime += time_now_d() - start;
+
+			result.samples.push_back(samples);
+			result.finish.push_back(finish);
+			result.remains.push_back(remains);
+			result.pcm.insert(result.pcm.end(), (const int16_t *)outbuf, (const int16_t *)outbuf + samples * 2);
+			if (ret != 0 || finish)
+				break;
+		}
+	}
+	return true;
+}
+
+static bool CompareDecodes(const AtracTestFormat &format, const AtracDecodeResult &plain, const AtracDecodeResult &ahead, int tolerance) {
+	EXPECT_EQ_INT((int)ahead.samples.size(), (int)plain.samples.size());
+	EXPECT_TRUE(ahead.samples == plain.samples);
+	EXPECT_TRUE(ahead.finish == plain.finish);
+	EXPECT_TRUE(ahead.remains == plain.remains);
+	EXPECT_EQ_INT((int)ahead.pcm.size(), (int)plain.pcm.size());
+	for (size_t i = 0; i < plain.pcm.size(); ++i) {
+		if (abs(ahead.pcm[i] - plain.pcm[i]) > tolerance) {
+			printf("%s: sample %d differs (%d vs %d)\n", format.name, (int)i / 2, ahead.pcm[i], plain.pcm[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestAtracLoopDecode(const AtracTestFormat &format) {
+	const u32 samplesPerFrame = format.codecType == PSP_MODE_AT_3_PLUS ? ATRAC3PLUS_MAX_SAMPLES : ATRAC3_MAX_SAMPLES;
+	const std::vector<u8> frames = GenerateFrames(format);
+	// Neither end lines up with a frame.
+	const u32 fileSize = WriteTrack(format, frames, samplesPerFrame * 12 + 300, samplesPerFrame * 70 + 77);
+
+	AtracDecodeResult plain;
+	AtracDecodeResult ahead;
+	EXPECT_TRUE(DecodeTrack(format, fileSize, false, {}, plain));
+	EXPECT_TRUE(DecodeTrack(format, fileSize, true, {}, ahead));
+
+	// Make sure it actually looped, and played to the end.
+	EXPECT_TRUE(plain.pcm.size() > TRACK_FRAMES * samplesPerFrame * 2 * 2);
+	EXPECT_EQ_INT(plain.finish.back(), 1);
+	EXPECT_TRUE(CompareDecodes(format, plain, ahead, 0));
+
+	printf("%s: %d calls, %0.1f us/call without decode ahead, %0.1f us/call with\n", format.name, (int)plain.samples.size(),
+		plain.decodeTime * 1000000.0 / plain.samples.size(), ahead.decodeTime * 1000000.0 / ahead.samples.size());
+
+	// Now the game loads something else over the data while it plays, like games that load data async.
+	// Frames decoded ahead or cached from the old data must not be used.
+	std::vector<u8> newFrames(frames.size());
+	for (int i = 0; i < TRACK_FRAMES; ++i)
+		memcpy(&newFrames[i * format.bytesPerFrame], &frames[(TRACK_FRAMES - 1 - i) * format.bytesPerFrame], format.bytesPerFrame);
+
+	AtracDecodeResult plainRewrite;
+	AtracDecodeResult aheadRewrite;
+	WriteTrack(format, frames, samplesPerFrame * 12 + 300, samplesPerFrame * 70 + 77);
+	EXPECT_TRUE(DecodeTrack(format, fileSize, false, newFrames, plainRewrite));
+	WriteTrack(format, frames, samplesPerFrame * 12 + 300, samplesPerFrame * 70 + 77);
+	EXPECT_TRUE(DecodeTrack(format, fileSize, true, newFrames, aheadRewrite));
+	EXPECT_TRUE(plainRewrite.pcm != plain.pcm);
+	// The decoder is put back by decoding the frames before again, which ATRAC3+ doesn't reproduce exactly.
+	// Stale frames would be far off though.
+	const int tolerance = format.codecType == PSP_MODE_AT_3_PLUS ? 1 : 0;
+	EXPECT_TRUE(CompareDecodes(format, plainRewrite, aheadRewrite, tolerance));
+	return true;
+}
+
+bool TestAtrac() {
+	if (!g_threadManager.IsInitialized())
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	static const AtracTestFormat formats[] = {
+		{ "ATRAC3", PSP_MODE_AT_3, 0x180, 0 },
+		{ "ATRAC3 joint stereo", PSP_MODE_AT_3, 0xC0, 1 },
+		{ "ATRAC3+", PSP_MODE_AT_3_PLUS, 0x230, 0 },
+	};
+	bool success = true;
+	for (const AtracTestFormat &format : formats)
+		success = success && TestAtracLoopDecode(format);
+
+	Memory::Shutdown();
+	return success;
+}
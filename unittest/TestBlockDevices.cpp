@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ppsspp_config.h"
+#include "Common/CPUDetect.h"
+#include "Common/File/FileUtil.h"
+#include "Common/StringUtils.h"
+#include "Common/Swap.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/FileLoaders/LocalFileLoader.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/Loaders.h"
+#include "zlib.h"
+
+extern "C" {
+#include "ext/libkirk/amctrl.h"
+#include "ext/libkirk/kirk_engine.h"
+}
+
+#include "UnitTest.h"
+
+class MemoryFileLoader : public FileLoader {
+public:
+	MemoryFileLoader(const std::vector<u8> &data) : data_(data) {}
+
+	bool Exists() override {
+		return true;
+	}
+	bool IsDirectory() override {
+		return false;
+	}
+	s64 FileSize() override {
+		return (s64)data_.size();
+	}
+	Path GetPath() const override {
+		return Path("memory.cso");
+	}
+	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override {
+		if (absolutePos >= (s64)data_.size())
+			return 0;
+		size_t available = (data_.size() - (size_t)absolutePos) / bytes;
+		count = std::min(count, available);
+		memcpy(data, &data_[(size_t)absolutePos], bytes * count);
+		return count;
+	}
+
+private:
+	const std::vector<u8> &data_;
+};
+
+// A file in the temp directory, removed on every way out of the test.
+class TempFile {
+public:
+	explicit TempFile(const char *name) {
+#if PPSSPP_PLATFORM(WINDOWS)
+		const char *dir = getenv("TEMP");
+		const char *fallback = ".";
+#else
+		const char *dir = getenv("TMPDIR");
+		const char *fallback = "/tmp";
+#endif
+		if (!dir || !*dir)
+			dir = fallback;
+		// Unique enough that parallel test runs don't collide.
+		const unsigned int unique = (unsigned int)(time_now_d() * 1000000.0);
+		path_ = Path(std::string(dir)) / StringFromFormat("%08x_%s", unique, name);
+	}
+	~TempFile() {
+		if (File::Exists(path_))
+			File::Delete(path_);
+	}
+
+	const Path &path() const {
+		return path_;
+	}
+
+private:
+	Path path_;
+};
+
+// Mostly compressible, with some frames of noise that have to be stored plain.
+static std::vector<u8> GenerateDiscData(u32 size, u32 frameSize) {
+	std::vector<u8> data(size);
+	u32 seed = 1;
+	for (u32 i = 0; i < size; i += 4) {
+		u32 frame = i / frameSize;
+		u32 value;
+		if ((frame % 7) == 3) {
+			seed = seed * 1103515245 + 12345;
+			value = seed;
+		} else {
+			value = (i / 64) * 0x01010101 ^ frame;
+		}
+		memcpy(&data[i], &value, 4);
+	}
+	return data;
+}
+
+// Version 1 marks plain frames with the top index bit, version 2 by their size alone.
+static std::vector<u8> CompressCSO(const std::vector<u8> &data, u32 frameSize, u8 version) {
+	const u32 numFrames = (u32)((data.size() + frameSize - 1) / frameSize);
+	const u32 headerSize = 0x18;
+
+	std::vector<u8> cso(headerSize + (numFrames + 1) * sizeof(u32));
+	memcpy(&cso[0], "CISO", 4);
+	*(u32_le *)&cso[4] = headerSize;
+	*(u64_le *)&cso[8] = (u64)data.size();
+	*(u32_le *)&cso[16] = frameSize;
+	cso[20] = version;
+	cso[21] = 0;
+
+	std::vector<u8> compressed(compressBound(frameSize) + 64);
+	for (u32 frame = 0; frame < numFrames; ++frame) {
+		*(u32_le *)&cso[headerSize + frame * sizeof(u32)] = (u32)cso.size();
+
+		z_stream z{};
+		deflateInit2(&z, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		z.next_in = (Bytef *)&data[frame * frameSize];
+		z.avail_in = frameSize;
+		z.next_out = &compressed[0];
+		z.avail_out = (uInt)compressed.size();
+		deflate(&z, Z_FINISH);
+		size_t compressedSize = z.total_out;
+		deflateEnd(&z);
+
+		if (compressedSize >= frameSize) {
+			if (version < 2)
+				*(u32_le *)&cso[headerSize + frame * sizeof(u32)] |= 0x80000000;
+			cso.insert(cso.end(), &data[frame * frameSize], &data[frame * frameSize] + frameSize);
+		} else {
+			cso.insert(cso.end(), &compressed[0], &compressed[0] + compressedSize);
+		}
+	}
+	*(u32_le *)&cso[headerSize + numFrames * sizeof(u32)] = (u32)cso.size();
+	return cso;
+}
+
+// A PBP with just enough of an NPUMDIMG PSAR to load.  Frames are encrypted but not LZRC compressed,
+// since there's no compressor, and every fifth is stored plain.
+static std::vector<u8> EncryptNPDRM(const std::vector<u8> &data, u32 frameLBAs) {
+	const u32 frameSize = frameLBAs * 2048;
+	const u32 numLBAs = (u32)(data.size() / 2048);
+	const u32 numFrames = (numLBAs + frameLBAs - 1) / frameLBAs;
+	const u32 psarOffset = 0x100;
+	const u32 tableOffset = 0x100;
+	const u32 dataOffset = tableOffset + numFrames * (u32)sizeof(table_info);
+
+	std::vector<u8> image(psarOffset + dataOffset + (size_t)numFrames * frameSize);
+	*(u32_le *)&image[0x24] = psarOffset;
+
+	kirk_init();
+	u8 *npHeader = &image[psarOffset];
+	for (int i = 0; i < 0xc0; ++i)
+		npHeader[i] = (u8)(i * 7 + 1);
+	*(u32_le *)(npHeader + 0x0c) = frameLBAs;
+	*(u32_le *)(npHeader + 0x54) = 0;
+	*(u32_le *)(npHeader + 0x64) = numLBAs - 1;
+	*(u32_le *)(npHeader + 0x6c) = tableOffset;
+
+	// The cipher is a stream xor, so decrypting also encrypts.
+	u8 vkey[16];
+	for (int i = 0; i < 16; ++i)
+		vkey[i] = (u8)(0xA5 ^ (i * 13));
+	u8 *hkey = npHeader + 0xa0;
+	CIPHER_KEY ckey;
+	sceDrmBBCipherInit(&ckey, 1, 2, hkey, vkey, 0);
+	sceDrmBBCipherUpdate(&ckey, npHeader + 0x40, 0x60);
+	sceDrmBBCipherFinal(&ckey);
+
+	// Work back from the MAC of the header to the bbmac that gives our vkey.
+	MAC_KEY mkey;
+	u8 mac[16];
+	sceDrmBBMacInit(&mkey, 3);
+	sceDrmBBMacUpdate(&mkey, npHeader, 0xc0);
+	sceDrmBBMacFinal(&mkey, mac, nullptr);
+	u8 bbmac[16];
+	for (int i = 0; i < 16; ++i)
+		bbmac[i] = vkey[i] ^ mac[i];
+	kirk4(bbmac, bbmac, 16, 0x38);
+	kirk4(npHeader + 0xc0, bbmac, 16, 0x63);
+
+	table_info *table = (table_info *)&image[psarOffset + tableOffset];
+	for (u32 frame = 0; frame < numFrames; ++frame) {
+		const u32 offset = dataOffset + frame * frameSize;
+		memset(&table[frame], 0, sizeof(table_info));
+		table[frame].offset = offset;
+		table[frame].size = frameSize;
+		table[frame].flag = (frame % 5) == 2 ? 4 : 0;
+
+		u8 *dest = &image[psarOffset + offset];
+		const size_t srcSize = std::min((size_t)frameSize, data.size() - (size_t)frame * frameSize);
+		memcpy(dest, &data[(size_t)frame * frameSize], srcSize);
+		if ((table[frame].flag & 4) == 0) {
+			sceDrmBBCipherInit(&ckey, 1, 2, hkey, vkey, offset >> 4);
+			sceDrmBBCipherUpdate(&ckey, dest, frameSize);
+			sceDrmBBCipherFinal(&ckey);
+		}
+	}
+	return image;
+}
+
+static void PrintThroughput(BlockDevice &device, const char *name, u32 frameSize);
+
+// Checks reads against the source data, then prints throughput.
+static bool TestDeviceReads(BlockDevice &device, const std::vector<u8> &data, const char *name, u32 frameSize) {
+	const int BLOCK_SIZE = 2048;
+	const u32 discSize = (u32)data.size();
+	EXPECT_EQ_INT(device.GetNumBlocks(), discSize / BLOCK_SIZE);
+
+	const u32 numBlocks = device.GetNumBlocks();
+	std::vector<u8> buffer(256 * BLOCK_SIZE);
+
+	// Reads of various sizes that start and end in the middle of frames.
+	const int counts[] = { 1, 3, 17, 64, 255 };
+	for (int count : counts) {
+		for (u32 block = 0; block + count <= numBlocks; block += count * 5 + 1) {
+			EXPECT_TRUE(device.ReadBlocks(block, count, &buffer[0]));
+			EXPECT_TRUE(memcmp(&buffer[0], &data[block * BLOCK_SIZE], count * BLOCK_SIZE) == 0);
+		}
+	}
+
+	// Twice, so the second pass hits the cache.
+	for (int pass = 0; pass < 2; ++pass) {
+		for (u32 block = 5; block < numBlocks; block += 97) {
+			EXPECT_TRUE(device.ReadBlock(block, &buffer[0]));
+			EXPECT_TRUE(memcmp(&buffer[0], &data[block * BLOCK_SIZE], BLOCK_SIZE) == 0);
+		}
+	}
+
+	// Past the end should be zero filled.
+	memset(&buffer[0], 0xCC, 8 * BLOCK_SIZE);
+	device.ReadBlocks(numBlocks - 4, 8, &buffer[0]);
+	EXPECT_TRUE(memcmp(&buffer[0], &data[(numBlocks - 4) * BLOCK_SIZE], 4 * BLOCK_SIZE) == 0);
+	for (int i = 4 * BLOCK_SIZE; i < 8 * BLOCK_SIZE; ++i)
+		EXPECT_EQ_INT(buffer[i], 0);
+
+	// Several threads at once, which share the cache but read and decompress separately.
+	std::atomic<int> mismatches{};
+	std::vector<std::thread> threads;
+	for (u32 t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t] {
+			std::vector<u8> threadBuffer(16 * BLOCK_SIZE);
+			u32 seed = t + 1;
+			for (int i = 0; i < 500; ++i) {
+				seed = seed * 1103515245 + 12345;
+				const int count = 1 + (seed >> 28);
+				const u32 block = (seed >> 8) % (numBlocks - count);
+				if (!device.ReadBlocks(block, count, &threadBuffer[0]) || memcmp(&threadBuffer[0], &data[block * BLOCK_SIZE], count * BLOCK_SIZE) != 0)
+					mismatches++;
+			}
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+	EXPECT_EQ_INT((int)mismatches, 0);
+
+	PrintThroughput(device, name, frameSize);
+	return true;
+}
+
+// Throughput, for sequential streaming and scattered small reads.
+static void PrintThroughput(BlockDevice &device, const char *name, u32 frameSize) {
+	const int BLOCK_SIZE = 2048;
+	const u32 numBlocks = device.GetNumBlocks();
+	std::vector<u8> buffer(64 * BLOCK_SIZE);
+
+	const int SEQUENTIAL_COUNT = 64;
+	double start = time_now_d();
+	for (u32 block = 0; block + SEQUENTIAL_COUNT <= numBlocks; block += SEQUENTIAL_COUNT)
+		device.ReadBlocks(block, SEQUENTIAL_COUNT, &buffer[0]);
+	double sequentialTime = time_now_d() - start;
+
+	const int RANDOM_READS = 4000;
+	u32 seed = 7;
+	start = time_now_d();
+	for (int i = 0; i < RANDOM_READS; ++i) {
+		seed = seed * 1103515245 + 12345;
+		device.ReadBlock((seed >> 8) % numBlocks, &buffer[0]);
+	}
+	double randomTime = time_now_d() - start;
+
+	start = time_now_d();
+	for (int i = 0; i < RANDOM_READS / 16; ++i) {
+		seed = seed * 1103515245 + 12345;
+		device.ReadBlocks((seed >> 8) % (numBlocks - 16), 16, &buffer[0]);
+	}
+	double randomRangeTime = time_now_d() - start;
+
+	const double mb = 1.0 / (1024.0 * 1024.0);
+	printf("%s frame size %d: sequential %0.1f MB/s, random blocks %0.1f MB/s, random 16 block reads %0.1f MB/s\n", name, frameSize,
+		(double)numBlocks * BLOCK_SIZE * mb / sequentialTime,
+		RANDOM_READS * BLOCK_SIZE * mb / randomTime,
+		RANDOM_READS * BLOCK_SIZE * mb / randomRangeTime);
+}
+
+static bool TestCISOReads(u32 frameSize, u8 version) {
+	const u32 DISC_SIZE = 16 * 1024 * 1024;
+
+	std::vector<u8> data = GenerateDiscData(DISC_SIZE, frameSize);
+	std::vector<u8> cso = CompressCSO(data, frameSize, version);
+	MemoryFileLoader loader(cso);
+	CISOFileBlockDevice device(&loader);
+	return TestDeviceReads(device, data, version >= 2 ? "CSOv2" : "CSO", frameSize);
+}
+
+static bool TestNPDRMReads(u32 frameLBAs) {
+	// Not a multiple of the frame size, so the last frame is padded.
+	const u32 DISC_SIZE = 8 * 1024 * 1024 - 3 * 2048;
+
+	std::vector<u8> data = GenerateDiscData(DISC_SIZE, frameLBAs * 2048);
+	std::vector<u8> image = EncryptNPDRM(data, frameLBAs);
+	MemoryFileLoader loader(image);
+	NPDRMDemoBlockDevice device(&loader);
+	RET(TestDeviceReads(device, data, "NPDRM", frameLBAs * 2048));
+
+	// For comparison, the same data as a plain ISO.
+	MemoryFileLoader isoLoader(data);
+	FileBlockDevice isoDevice(&isoLoader);
+	PrintThroughput(isoDevice, "ISO", 2048);
+	return true;
+}
+
+static bool TestZstdDiscImage(u32 frameSize, u32 dictionarySize) {
+	// Not a multiple of the frame size, so the last frame is padded.
+	const u32 DISC_SIZE = 16 * 1024 * 1024 - 3 * 2048;
+	TempFile file("unittest_blockdevices.zdi");
+	const Path &filename = file.path();
+
+	std::vector<u8> data = GenerateDiscData(DISC_SIZE, frameSize);
+	MemoryFileLoader isoLoader(data);
+	FileBlockDevice source(&isoLoader);
+
+	ZstdDiscImageOptions options;
+	options.frameSize = frameSize;
+	options.dictionarySize = dictionarySize;
+	std::string errorString;
+	double start = time_now_d();
+	EXPECT_TRUE(WriteZstdDiscImage(&source, filename, options, &errorString));
+	double compressTime = time_now_d() - start;
+
+	std::string zdiData;
+	EXPECT_TRUE(File::ReadBinaryFileToString(filename, &zdiData));
+	printf("ZDI frame size %d, dictionary %d: %d -> %d bytes in %0.2f s\n", frameSize, dictionarySize, DISC_SIZE, (int)zdiData.size(), compressTime);
+
+	std::vector<u8> zdi(zdiData.begin(), zdiData.end());
+	MemoryFileLoader loader(zdi);
+	ZstdDiscBlockDevice device(&loader);
+	RET(TestDeviceReads(device, data, "ZDI", frameSize));
+
+	// A frame count that doesn't match the size, or an index past the end, should leave an empty device.
+	std::vector<u8> corrupt = zdi;
+	*(u32_le *)&corrupt[0x14] = 0x40000000;
+	MemoryFileLoader corruptLoader(corrupt);
+	ZstdDiscBlockDevice corruptDevice(&corruptLoader);
+	EXPECT_EQ_INT(corruptDevice.GetNumBlocks(), 0);
+
+	corrupt = zdi;
+	*(u64_le *)&corrupt[0x18] = (u64)zdi.size() - 8;
+	MemoryFileLoader truncatedLoader(corrupt);
+	ZstdDiscBlockDevice truncatedDevice(&truncatedLoader);
+	EXPECT_EQ_INT(truncatedDevice.GetNumBlocks(), 0);
+	return true;
+}
+
+static bool TestLocalFileReads() {
+	const u32 FILE_SIZE = 8 * 1024 * 1024 - 1000;
+	const int BLOCK_SIZE = 2048;
+	TempFile file("unittest_blockdevices.iso");
+	const Path &filename = file.path();
+
+	std::vector<u8> data = GenerateDiscData(FILE_SIZE & ~3, 2048);
+	EXPECT_TRUE(File::WriteDataToFile(false, data.data(), data.size(), filename));
+
+	{
+		LocalFileLoader loader(filename);
+		EXPECT_EQ_INT(loader.FileSize(), (int)data.size());
+
+		// Odd sizes and alignments, and one past the end that should come back short.
+		std::vector<u8> buffers[6];
+		FileLoader::ReadRequest requests[6] = {
+			{ 0, 100, nullptr, 0 },
+			{ 4097, 300000, nullptr, 0 },
+			{ 1000000, 1, nullptr, 0 },
+			{ 2000000, 2000000, nullptr, 0 },
+			{ (s64)data.size() - 50, 100, nullptr, 0 },
+			{ 123, 65536, nullptr, 0 },
+		};
+		for (int i = 0; i < 6; ++i) {
+			buffers[i].resize(requests[i].bytes);
+			requests[i].data = buffers[i].data();
+		}
+		loader.ReadAtMultiple(requests, 6);
+		for (int i = 0; i < 6; ++i) {
+			size_t expected = std::min(requests[i].bytes, data.size() - (size_t)requests[i].pos);
+			EXPECT_EQ_INT((int)requests[i].result, (int)expected);
+			EXPECT_TRUE(memcmp(buffers[i].data(), &data[(size_t)requests[i].pos], expected) == 0);
+		}
+
+		// Large block reads get split into several requests.
+		FileBlockDevice device(&loader);
+		std::vector<u8> buffer(1500 * BLOCK_SIZE);
+		EXPECT_TRUE(device.ReadBlocks(7, 1500, buffer.data()));
+		EXPECT_TRUE(memcmp(buffer.data(), &data[7 * BLOCK_SIZE], buffer.size()) == 0);
+		EXPECT_TRUE(device.ReadBlocks(1, 200, buffer.data()));
+		EXPECT_TRUE(memcmp(buffer.data(), &data[1 * BLOCK_SIZE], 200 * BLOCK_SIZE) == 0);
+	}
+
+	return true;
+}
+
+bool TestBlockDevices() {
+	if (!g_threadManager.IsInitialized())
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+
+	RET(TestLocalFileReads());
+	RET(TestCISOReads(2048, 1));
+	RET(TestCISOReads(16384, 1));
+	RET(TestCISOReads(16384, 2));
+	RET(TestNPDRMReads(16));
+	RET(TestZstdDiscImage(16384, 0));
+	RET(TestZstdDiscImage(16384, 64 * 1024));
+	RET(TestZstdDiscImage(4096, 16 * 1024));
+	return true;
+}
@@ -0,0 +1,173 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "Common/CPUDetect.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Core/MemMap.h"
+#include "GPU/GPUState.h"
+#include "GPU/Software/BinManager.h"
+#include "GPU/Software/DrawPixel.h"
+#include "GPU/Software/Rasterizer.h"
+#include "GPU/Software/Sampler.h"
+#include "GPU/Software/SoftGpu.h"
+
+#include "UnitTest.h"
+
+static const u32 COLOR_ADDR = 0x04000000;
+// Right after the 8888 color buffer.
+static const u32 DEPTH_ADDR = 0x04088000;
+static const int STRIDE = 512;
+static const int WIDTH = 480;
+static const int HEIGHT = 272;
+// Alpha is stencil, which is kept, so leave it zero.
+static const u32 RED = 0x000000FF;
+static const u32 GREEN = 0x0000FF00;
+
+static void SetTarget(BinManager &binner, u32 colorAddr, GEBufferFormat format, int rows) {
+	gstate.fbptr = (GE_CMD_FRAMEBUFPTR << 24) | (colorAddr & 0x00FFFFF0);
+	gstate.fbwidth = (GE_CMD_FRAMEBUFWIDTH << 24) | STRIDE;
+	gstate.framebufpixformat = (GE_CMD_FRAMEBUFPIXFORMAT << 24) | format;
+	gstate.zbptr = (GE_CMD_ZBUFPTR << 24) | (DEPTH_ADDR & 0x00FFFFF0);
+	gstate.zbwidth = (GE_CMD_ZBUFWIDTH << 24) | STRIDE;
+	gstate.scissor1 = GE_CMD_SCISSOR1 << 24;
+	gstate.scissor2 = (GE_CMD_SCISSOR2 << 24) | ((rows - 1) << 10) | (WIDTH - 1);
+	gstate.region1 = GE_CMD_REGION1 << 24;
+	gstate.region2 = (GE_CMD_REGION2 << 24) | ((HEIGHT - 1) << 10) | (WIDTH - 1);
+	fb.data = Memory::GetPointerWrite(colorAddr);
+	depthbuf.data = Memory::GetPointerWrite(DEPTH_ADDR);
+	binner.SetDirty(SoftDirty::PIXEL_ALL | SoftDirty::SAMPLER_ALL | SoftDirty::RAST_ALL | SoftDirty::BINNER_RANGE | SoftDirty::BINNER_OVERLAP);
+}
+
+// Depth is only written with the test enabled, so this always writes it.
+static void SetDepthTest(BinManager &binner, bool enabled, GEComparison func) {
+	gstate.zTestEnable = (GE_CMD_ZTESTENABLE << 24) | (enabled ? 1 : 0);
+	gstate.ztestfunc = (GE_CMD_ZTEST << 24) | func;
+	gstate.zmsk = GE_CMD_ZWRITEDISABLE << 24;
+	binner.SetDirty(SoftDirty::PIXEL_ALL | SoftDirty::BINNER_RANGE | SoftDirty::BINNER_OVERLAP);
+}
+
+// Two triangles covering the whole screen, at one depth.
+static void DrawScreen(BinManager &binner, u16 z, u32 color) {
+	binner.UpdateState();
+
+	VertexData v[4]{};
+	for (int i = 0; i < 4; ++i) {
+		v[i].screenpos.x = (i & 1) ? WIDTH * SCREEN_SCALE_FACTOR : 0;
+		v[i].screenpos.y = (i & 2) ? HEIGHT * SCREEN_SCALE_FACTOR : 0;
+		v[i].screenpos.z = z;
+		v[i].clipw = 1.0f;
+		v[i].fogdepth = 1.0f;
+		v[i].color0 = color;
+	}
+	binner.AddTriangle(v[0], v[1], v[2]);
+	binner.AddTriangle(v[1], v[3], v[2]);
+	binner.Flush("test");
+}
+
+static void FillDepth(u16 z) {
+	u16 *depth = (u16 *)Memory::GetPointerWrite(DEPTH_ADDR);
+	for (int i = 0; i < STRIDE * HEIGHT; ++i)
+		depth[i] = z;
+}
+
+// Checks the color of each row, which should be expected within [y1, y2) and other outside.
+static bool CheckRows(int y1, int y2, u32 expected, u32 other) {
+	const u32 *color = (const u32 *)Memory::GetPointer(COLOR_ADDR);
+	for (int y = 0; y < HEIGHT; ++y) {
+		const u32 want = y >= y1 && y < y2 ? expected : other;
+		for (int x = 0; x < WIDTH; ++x) {
+			if (color[y * STRIDE + x] != want) {
+				printf("Pixel %d,%d is %08x, expected %08x\n", x, y, color[y * STRIDE + x], want);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool TestDepthTileRejection(BinManager &binner) {
+	SetTarget(binner, COLOR_ADDR, GE_FORMAT_8888, HEIGHT);
+	SetDepthTest(binner, true, GE_COMP_ALWAYS);
+	DrawScreen(binner, 0x8000, RED);
+	EXPECT_TRUE(CheckRows(0, HEIGHT, RED, RED));
+
+	// Everything behind, so it should mostly be rejected by tiles and not drawn at all.
+	SetDepthTest(binner, true, GE_COMP_GEQUAL);
+	const DepthTileStats before = binner.GetDepthTileStats();
+	DrawScreen(binner, 0x4000, GREEN);
+	const DepthTileStats after = binner.GetDepthTileStats();
+	EXPECT_TRUE(after.tiles > before.tiles);
+	EXPECT_TRUE(CheckRows(0, HEIGHT, RED, RED));
+
+	// Now the CPU clears depth behind the tiles' back.  The next frame must not trust them.
+	// Stale tiles would reject this, since it's behind anything that was drawn.
+	FillDepth(0);
+	// Like SoftGPU::PSPFrame() does.
+	binner.InvalidateDepthTiles(0, -1);
+	DrawScreen(binner, 0x2000, GREEN);
+	EXPECT_TRUE(CheckRows(0, HEIGHT, GREEN, GREEN));
+	return true;
+}
+
+static bool TestDepthTileAliasing(BinManager &binner) {
+	SetTarget(binner, COLOR_ADDR, GE_FORMAT_8888, HEIGHT);
+	SetDepthTest(binner, true, GE_COMP_ALWAYS);
+	DrawScreen(binner, 0x8000, RED);
+
+	// Draw black 565 color into depth rows 100-149, with a scissor only 50 rows tall.
+	// Without any depth test, nothing is written to depth, but the color lands right in it.
+	const u32 aliasAddr = DEPTH_ADDR + 100 * STRIDE * 2;
+	SetTarget(binner, aliasAddr, GE_FORMAT_565, 50);
+	SetDepthTest(binner, false, GE_COMP_ALWAYS);
+	DrawScreen(binner, 0x8000, 0);
+
+	// Only the rows with depth now zero should pass.
+	SetTarget(binner, COLOR_ADDR, GE_FORMAT_8888, HEIGHT);
+	SetDepthTest(binner, true, GE_COMP_GEQUAL);
+	DrawScreen(binner, 0x4000, GREEN);
+	EXPECT_TRUE(CheckRows(100, 150, GREEN, RED));
+	return true;
+}
+
+bool TestDepthTiles() {
+	if (!g_threadManager.IsInitialized())
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	Rasterizer::Init();
+	Sampler::Init();
+
+	memset(&gstate, 0, sizeof(gstate));
+	// Through mode, so depth is used as is.
+	gstate.vertType = (GE_CMD_VERTEXTYPE << 24) | GE_VTYPE_THROUGH;
+	FillDepth(0);
+
+	std::unique_ptr<BinManager> binner(new BinManager());
+	bool success = TestDepthTileRejection(*binner);
+	success = success && TestDepthTileAliasing(*binner);
+
+	binner.reset();
+	Sampler::Shutdown();
+	Rasterizer::Shutdown();
+	Memory::Shutdown();
+	return success;
+}
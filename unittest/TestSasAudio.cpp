@@ -0,0 +1,277 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Common/CPUDetect.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/Config.h"
+#include "Core/ConfigValues.h"
+#include "Core/HW/SasAudio.h"
+#include "Core/HW/SasReverb.h"
+#include "Core/MemMap.h"
+#include "Core/Util/AudioFormat.h"
+
+#include "UnitTest.h"
+
+static const u32 VAG_BASE = 0x08800000;
+static const int VAG_SOUNDS = 8;
+static const int VAG_BLOCKS = 256;
+static const u32 SAS_OUT_ADDR = 0x08C00000;
+
+static u32 NextRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// Noise, with the filters and shifts games actually use, and a loop point.
+static void GenerateVagSounds() {
+	u32 seed = 7;
+	for (int sound = 0; sound < VAG_SOUNDS; ++sound) {
+		u8 *data = Memory::GetPointerWriteRange(VAG_BASE + sound * VAG_BLOCKS * 16, VAG_BLOCKS * 16);
+		for (int block = 0; block < VAG_BLOCKS; ++block) {
+			u8 *p = data + block * 16;
+			const int predict = NextRandom(seed) % 5;
+			const int shift = NextRandom(seed) % 13;
+			p[0] = (u8)((predict << 4) | shift);
+			p[1] = block == 8 ? 6 : (block == VAG_BLOCKS - 1 ? 3 : 0);
+			for (int i = 2; i < 16; ++i)
+				p[i] = (u8)NextRandom(seed);
+		}
+	}
+}
+
+// The plain decoder, as the PSP describes it.
+static void DecodeVagReference(const u8 *data, int blocks, std::vector<s16> &out) {
+	static const int filters[5][2] = { { 0, 0 }, { 60, 0 }, { 115, -52 }, { 98, -55 }, { 122, -60 } };
+	int s1 = 0, s2 = 0;
+	for (int block = 0; block < blocks; ++block) {
+		const u8 *p = data + block * 16;
+		const int predict = p[0] >> 4;
+		const int shift = p[0] & 0xF;
+		for (int i = 0; i < 28; ++i) {
+			const int nibble = (p[2 + i / 2] >> ((i & 1) * 4)) & 0xF;
+			const int delta = (s16)(nibble << 12) >> shift;
+			const int sample = clamp_s16(delta + ((s1 * filters[predict][0] + s2 * filters[predict][1]) >> 6));
+			s2 = s1;
+			s1 = sample;
+			out.push_back((s16)sample);
+		}
+	}
+}
+
+static bool TestVagDecode() {
+	for (int sound = 0; sound < VAG_SOUNDS; ++sound) {
+		const u32 addr = VAG_BASE + sound * VAG_BLOCKS * 16;
+		std::vector<s16> expected;
+		// Without looping, the loop flags are ignored.
+		DecodeVagReference(Memory::GetPointer(addr), VAG_BLOCKS, expected);
+
+		VagDecoder decoder;
+		decoder.Start(addr, VAG_BLOCKS * 16, false);
+		std::vector<s16> decoded(expected.size());
+		// Odd sizes, so reads don't line up with blocks.
+		for (size_t pos = 0; pos < decoded.size(); pos += 100)
+			decoder.GetSamples(&decoded[pos], (int)std::min((size_t)100, decoded.size() - pos));
+		EXPECT_TRUE(memcmp(decoded.data(), expected.data(), expected.size() * sizeof(s16)) == 0);
+	}
+	return true;
+}
+
+enum class SasOp {
+	KEY_ON,
+	KEY_OFF,
+	PITCH,
+	VOLUME,
+};
+
+struct SasCommand {
+	int grain;
+	SasOp op;
+	int voice;
+	int arg1;
+	int arg2;
+};
+
+// Shaped like a game's music and effects: a full set of voices, some notes changing every grain,
+// with pitch bends and volume changes in between.
+static std::vector<SasCommand> GenerateCommandStream(int grains, int voices) {
+	std::vector<SasCommand> commands;
+	u32 seed = 3;
+	for (int v = 0; v < voices; ++v)
+		commands.push_back(SasCommand{ 0, SasOp::KEY_ON, v, (int)(NextRandom(seed) % VAG_SOUNDS), (int)(0x400 + NextRandom(seed) % 0x3C00) });
+
+	for (int grain = 1; grain < grains; ++grain) {
+		const int changes = NextRandom(seed) % 4;
+		for (int i = 0; i < changes; ++i) {
+			const int voice = NextRandom(seed) % voices;
+			switch (NextRandom(seed) % 4) {
+			case 0:
+				commands.push_back(SasCommand{ grain, SasOp::KEY_ON, voice, (int)(NextRandom(seed) % VAG_SOUNDS), (int)(0x400 + NextRandom(seed) % 0x3C00) });
+				break;
+			case 1:
+				commands.push_back(SasCommand{ grain, SasOp::KEY_OFF, voice, 0, 0 });
+				break;
+			case 2:
+				commands.push_back(SasCommand{ grain, SasOp::PITCH, voice, (int)(0x400 + NextRandom(seed) % 0x3C00), 0 });
+				break;
+			default:
+				commands.push_back(SasCommand{ grain, SasOp::VOLUME, voice, (int)(NextRandom(seed) % 0x2001) - 0x1000, (int)(NextRandom(seed) % 0x2001) - 0x1000 });
+				break;
+			}
+		}
+	}
+	return commands;
+}
+
+static void ApplyCommand(SasInstance &sas, const SasCommand &command) {
+	SasVoice &voice = sas.voices[command.voice];
+	switch (command.op) {
+	case SasOp::KEY_ON:
+		voice.type = VOICETYPE_VAG;
+		voice.vagAddr = VAG_BASE + command.arg1 * VAG_BLOCKS * 16;
+		voice.vagSize = VAG_BLOCKS * 16;
+		voice.loop = (command.arg1 & 1) != 0;
+		voice.pitch = command.arg2;
+		voice.envelope.SetSimpleEnvelope(0x000F, 0x1FC6);
+		voice.KeyOn();
+		break;
+	case SasOp::KEY_OFF:
+		voice.KeyOff();
+		break;
+	case SasOp::PITCH:
+		voice.pitch = command.arg1;
+		break;
+	case SasOp::VOLUME:
+		voice.volumeLeft = command.arg1;
+		voice.volumeRight = command.arg2;
+		voice.effectLeft = command.arg2 / 2;
+		voice.effectRight = command.arg1 / 2;
+		break;
+	}
+}
+
+// Returns the average time per grain, in microseconds.
+static double ReplayCommandStream(const std::vector<SasCommand> &commands, int grains, int grainSize, bool parallel, std::vector<s16> &output) {
+	std::unique_ptr<SasInstance> sas(new SasInstance());
+	sas->SetGrainSize(grainSize);
+	sas->SetParallelMix(parallel);
+	sas->waveformEffect.isWetOn = 1;
+	sas->SetWaveformEffectType(PSP_SAS_EFFECT_TYPE_HALL);
+	sas->waveformEffect.leftVol = 0x1000;
+	sas->waveformEffect.rightVol = 0x1000;
+
+	output.resize((size_t)grains * grainSize * 2);
+	size_t next = 0;
+	double mixTime = 0.0;
+	for (int grain = 0; grain < grains; ++grain) {
+		for (; next < commands.size() && commands[next].grain == grain; ++next)
+			ApplyCommand(*sas, commands[next]);
+
+		double start = time_now_d();
+		sas->Mix(SAS_OUT_ADDR);
+		mixTime += time_now_d() - start;
+
+		memcpy(&output[(size_t)grain * grainSize * 2], Memory::GetPointer(SAS_OUT_ADDR), grainSize * 2 * sizeof(s16));
+	}
+	return mixTime * 1000000.0 / grains;
+}
+
+static bool TestSasMix(int grainSize, int voices) {
+	const int grains = 2000;
+	const std::vector<SasCommand> commands = GenerateCommandStream(grains, voices);
+
+	std::vector<s16> serialOutput;
+	std::vector<s16> parallelOutput;
+	double serialUs = ReplayCommandStream(commands, grains, grainSize, false, serialOutput);
+	double parallelUs = ReplayCommandStream(commands, grains, grainSize, true, parallelOutput);
+	EXPECT_TRUE(serialOutput == parallelOutput);
+
+	printf("SAS grain %d, %d voices: %0.1f us/grain serial, %0.1f us/grain parallel\n", grainSize, voices, serialUs, parallelUs);
+	return true;
+}
+
+static bool TestSasReverb(int preset) {
+	// Enough to go around even the largest preset's buffer a few times.
+	const int grains = 2000;
+	const int inputSize = 128;
+
+	SasReverb scalar;
+	SasReverb simd;
+	scalar.SetAllowSIMD(false);
+	scalar.SetPreset(preset);
+	simd.SetPreset(preset);
+
+	std::vector<s16> input(inputSize * 2);
+	std::vector<s16> expected(inputSize * 4);
+	std::vector<s16> output(inputSize * 4);
+	double scalarTime = 0.0;
+	double simdTime = 0.0;
+	u32 seed = 11 + preset;
+	for (int grain = 0; grain < grains; ++grain) {
+		// Loud enough to clip in places, with some quiet stretches for the tails.
+		const int amplitude = (grain % 50) < 40 ? 0x10000 : 0x100;
+		for (s16 &sample : input)
+			sample = (s16)((int)(NextRandom(seed) % amplitude) - amplitude / 2);
+		const uint16_t volLeft = 0x8000 - (grain % 7) * 0x1000;
+		const uint16_t volRight = 0x8000 - (grain % 5) * 0x1000;
+
+		double start = time_now_d();
+		scalar.ProcessReverb(expected.data(), input.data(), inputSize, volLeft, volRight);
+		scalarTime += time_now_d() - start;
+		start = time_now_d();
+		simd.ProcessReverb(output.data(), input.data(), inputSize, volLeft, volRight);
+		simdTime += time_now_d() - start;
+
+		if (expected != output) {
+			printf("Reverb preset %d differs at grain %d\n", preset, grain);
+			return false;
+		}
+	}
+
+	printf("Reverb %s: %0.2f us/grain scalar, %0.2f us/grain SIMD\n", SasReverb::GetPresetName(preset), scalarTime * 1000000.0 / grains, simdTime * 1000000.0 / grains);
+	return true;
+}
+
+bool TestSasAudio() {
+	if (!g_threadManager.IsInitialized())
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	GenerateVagSounds();
+
+	const int reverbVolume = g_Config.iReverbVolume;
+	g_Config.iReverbVolume = VOLUME_FULL;
+	bool success = true;
+	for (int preset = PSP_SAS_EFFECT_TYPE_OFF; preset <= PSP_SAS_EFFECT_TYPE_MAX; ++preset)
+		success = success && TestSasReverb(preset);
+
+	success = success && TestVagDecode();
+	success = success && TestSasMix(256, 8);
+	success = success && TestSasMix(256, 32);
+	success = success && TestSasMix(1024, 32);
+
+	g_Config.iReverbVolume = reverbVolume;
+	Memory::Shutdown();
+	return success;
+}
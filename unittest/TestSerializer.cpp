@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "TestSerializer.h"
+#include "UnitTest.h"
+
+static bool TestSerializeInPlace() {
+	SerializeTestState saved;
+	saved.Fill(100, 1);
+	std::vector<u8> buffer;
+	EXPECT_TRUE(CChunkFileReader::MeasureAndSavePtr(saved, &buffer) == CChunkFileReader::ERROR_NONE);
+
+	// Same keys, different values: every node should be reused.
+	SerializeTestState state;
+	state.Fill(100, 2);
+	const SerializeTestObject *firstObject = &state.objects.begin()->second;
+	const u32 *firstLookup = &state.lookup[0];
+	std::string error;
+	EXPECT_TRUE(CChunkFileReader::LoadPtr(&buffer[0], state, &error) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(state == saved);
+	EXPECT_TRUE(firstObject == &state.objects.begin()->second);
+	EXPECT_TRUE(firstLookup == &state.lookup[0]);
+
+	// Extra and missing keys.
+	SerializeTestState other;
+	other.Fill(150, 1);
+	other.objects.erase(other.objects.begin());
+	other.objects.erase(30);
+	other.waits.insert(std::make_pair(3, 0));
+	other.handles.insert(2);
+	other.lookup.erase(11);
+	other.lookup[1] = 0;
+	EXPECT_TRUE(CChunkFileReader::LoadPtr(&buffer[0], other, &error) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(other == saved);
+
+	SerializeTestState empty;
+	EXPECT_TRUE(CChunkFileReader::LoadPtr(&buffer[0], empty, &error) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(empty == saved);
+	return true;
+}
+
+// Timing and allocation counts are in SerializerBenchmark, this only checks that memory is kept.
+static bool TestSerializeReuse() {
+	SerializeTestState state;
+	state.Fill(2000, 1);
+	std::vector<u8> buffer;
+	PointerWrapArena arena;
+	std::string error;
+	// Warm up, so the buffer and arena are already sized.
+	EXPECT_TRUE(CChunkFileReader::MeasureAndSavePtr(state, &buffer, &arena) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(CChunkFileReader::LoadPtr(&buffer[0], state, &error) == CChunkFileReader::ERROR_NONE);
+
+	// Once sized, repeated saves should keep using the same buffer and checkpoints.
+	const u8 *bufferData = buffer.data();
+	const SerializeCheckpoint *checkpointData = arena.checkpoints.data();
+	for (int i = 0; i < 10; ++i)
+		EXPECT_TRUE(CChunkFileReader::MeasureAndSavePtr(state, &buffer, &arena) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(buffer.data() == bufferData);
+	EXPECT_TRUE(arena.checkpoints.data() == checkpointData);
+
+	// And loads over the same keys should update nodes and strings in place.
+	const SerializeTestObject *firstObject = &state.objects.begin()->second;
+	const u32 *firstLookup = &state.lookup[0];
+	const char *nameData = state.name.data();
+	const char16_t *titleData = state.title.data();
+	for (int i = 0; i < 10; ++i)
+		EXPECT_TRUE(CChunkFileReader::LoadPtr(&buffer[0], state, &error) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(firstObject == &state.objects.begin()->second);
+	EXPECT_TRUE(firstLookup == &state.lookup[0]);
+	EXPECT_TRUE(nameData == state.name.data());
+	EXPECT_TRUE(titleData == state.title.data());
+	return true;
+}
+
+bool TestSerializer() {
+	RET(TestSerializeInPlace());
+	RET(TestSerializeReuse());
+	return true;
+}
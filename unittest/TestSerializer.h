@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/Serialize/Serializer.h"
+#include "Common/Serialize/SerializeFuncs.h"
+#include "Common/Serialize/SerializeMap.h"
+#include "Common/Serialize/SerializeSet.h"
+
+// Shared by the Serializer unit test and the SerializerBenchmark program.
+
+struct SerializeTestObject {
+	u32 id;
+	u32 flags;
+	float values[4];
+};
+
+// Roughly shaped like the kernel object and HLE state that's saved for rewind.
+struct SerializeTestState {
+	std::map<u32, SerializeTestObject> objects;
+	std::multimap<u32, u32> waits;
+	std::set<u32> handles;
+	std::unordered_map<u32, u32> lookup;
+	std::vector<u32> data;
+	std::string name;
+	std::u16string title;
+
+	void DoState(PointerWrap &p) {
+		auto s = p.Section("SerializeTest", 1);
+		if (!s)
+			return;
+
+		Do(p, objects);
+		Do(p, waits);
+		Do(p, handles);
+		Do(p, lookup);
+		Do(p, data);
+		Do(p, name);
+		Do(p, title);
+	}
+
+	void Fill(u32 count, u32 seed) {
+		for (u32 i = 0; i < count; ++i) {
+			SerializeTestObject &obj = objects[i * 3];
+			obj.id = i + seed;
+			obj.flags = i ^ seed;
+			for (int j = 0; j < 4; ++j)
+				obj.values[j] = (float)(i * j + seed);
+			waits.insert(std::make_pair(i % 7, i + seed));
+			handles.insert(i * 5 + seed);
+			lookup[i * 11] = i * seed;
+		}
+		data.resize(count * 16);
+		for (u32 i = 0; i < (u32)data.size(); ++i)
+			data[i] = i * seed;
+		name = "serialize test state with a name long enough to not fit in place";
+		title = u"serialize test state with a title long enough to not fit in place";
+	}
+
+	bool operator ==(const SerializeTestState &other) const {
+		if (objects.size() != other.objects.size())
+			return false;
+		for (auto a = objects.begin(), b = other.objects.begin(); a != objects.end(); ++a, ++b) {
+			if (a->first != b->first || memcmp(&a->second, &b->second, sizeof(SerializeTestObject)) != 0)
+				return false;
+		}
+		return waits == other.waits && handles == other.handles && lookup == other.lookup && data == other.data && name == other.name && title == other.title;
+	}
+};
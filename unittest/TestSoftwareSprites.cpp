@@ -0,0 +1,201 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Common/CPUDetect.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Core/MemMap.h"
+#include "GPU/GPUState.h"
+#include "GPU/Software/BinManager.h"
+#include "GPU/Software/DrawPixel.h"
+#include "GPU/Software/Rasterizer.h"
+#include "GPU/Software/Sampler.h"
+#include "GPU/Software/SoftGpu.h"
+
+#include "UnitTest.h"
+
+// Sprites blit 8888 spans 4 pixels at a time with SIMD, with a scalar loop for the rest.
+// Drawing the same sprite as 1 pixel wide columns only uses the scalar loop, so both must match.
+
+static const u32 COLOR_ADDR = 0x04000000;
+static const u32 TEX_ADDR = 0x08800000;
+static const int STRIDE = 512;
+static const int TEX_SIZE = 64;
+static const int SPRITE_X = 3;
+static const int SPRITE_Y = 5;
+// Not a multiple of 4, so the scalar tail is hit too.
+static const int SPRITE_W = 61;
+static const int SPRITE_H = 40;
+static const int ALPHA_REF = 0x80;
+
+static u32 NextRandom(u32 &seed) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static void SetTarget() {
+	gstate.fbptr = (GE_CMD_FRAMEBUFPTR << 24) | (COLOR_ADDR & 0x00FFFFF0);
+	gstate.fbwidth = (GE_CMD_FRAMEBUFWIDTH << 24) | STRIDE;
+	gstate.framebufpixformat = (GE_CMD_FRAMEBUFPIXFORMAT << 24) | GE_FORMAT_8888;
+	gstate.scissor1 = GE_CMD_SCISSOR1 << 24;
+	gstate.scissor2 = (GE_CMD_SCISSOR2 << 24) | ((SPRITE_Y + SPRITE_H - 1) << 10) | (SPRITE_X + SPRITE_W - 1);
+	gstate.region1 = GE_CMD_REGION1 << 24;
+	gstate.region2 = (GE_CMD_REGION2 << 24) | ((SPRITE_Y + SPRITE_H - 1) << 10) | (SPRITE_X + SPRITE_W - 1);
+	fb.data = Memory::GetPointerWrite(COLOR_ADDR);
+
+	// A 1:1 8888 texture, which is what gets blitted as spans.
+	gstate.texaddr[0] = (GE_CMD_TEXADDR0 << 24) | (TEX_ADDR & 0x00FFFFF0);
+	gstate.texbufwidth[0] = (GE_CMD_TEXBUFWIDTH0 << 24) | ((TEX_ADDR >> 8) & 0x000F0000) | TEX_SIZE;
+	gstate.texsize[0] = (GE_CMD_TEXSIZE0 << 24) | (6 << 8) | 6;
+	gstate.texformat = (GE_CMD_TEXFORMAT << 24) | GE_TFMT_8888;
+	gstate.texmode = GE_CMD_TEXMODE << 24;
+	gstate.texfilter = GE_CMD_TEXFILTER << 24;
+	// Texture alpha is required for the sprite blit.
+	gstate.texfunc = (GE_CMD_TEXFUNC << 24) | 0x100 | GE_TEXFUNC_REPLACE;
+	gstate.blend = (GE_CMD_BLENDMODE << 24) | (GE_BLENDMODE_MUL_AND_ADD << 8) | (GE_DSTBLEND_INVSRCALPHA << 4) | GE_SRCBLEND_SRCALPHA;
+}
+
+static void SetMode(BinManager &binner, bool textured, bool alphaBlend, GEComparison alphaTestFunc, int alphaTestMask) {
+	gstate.textureMapEnable = (GE_CMD_TEXTUREMAPENABLE << 24) | (textured ? 1 : 0);
+	gstate.alphaBlendEnable = (GE_CMD_ALPHABLENDENABLE << 24) | (alphaBlend ? 1 : 0);
+	gstate.alphaTestEnable = (GE_CMD_ALPHATESTENABLE << 24) | (alphaTestFunc != GE_COMP_ALWAYS ? 1 : 0);
+	gstate.alphatest = (GE_CMD_ALPHATEST << 24) | (alphaTestMask << 16) | (ALPHA_REF << 8) | alphaTestFunc;
+	binner.SetDirty(SoftDirty::PIXEL_ALL | SoftDirty::SAMPLER_ALL | SoftDirty::RAST_ALL | SoftDirty::BINNER_RANGE | SoftDirty::BINNER_OVERLAP);
+}
+
+static void FillTexture(u32 seed) {
+	// Favor the alpha values the blend and alpha test special case.
+	static const u8 alphas[] = { 0x00, 0xFF, ALPHA_REF - 1, ALPHA_REF, ALPHA_REF + 1 };
+	u32 *tex = (u32 *)Memory::GetPointerWrite(TEX_ADDR);
+	for (int i = 0; i < TEX_SIZE * TEX_SIZE; ++i) {
+		const u32 r = NextRandom(seed);
+		const u32 pick = NextRandom(seed) & 7;
+		const u32 alpha = pick < ARRAY_SIZE(alphas) ? alphas[pick] : r >> 24;
+		tex[i] = (r & 0x00FFFFFF) | (alpha << 24);
+	}
+}
+
+static void FillColor(u32 seed) {
+	u32 *color = (u32 *)Memory::GetPointerWrite(COLOR_ADDR);
+	for (int i = 0; i < STRIDE * (SPRITE_Y + SPRITE_H); ++i)
+		color[i] = NextRandom(seed);
+}
+
+static VertexData SpriteVertex(int x, int y, u32 color) {
+	VertexData v{};
+	v.screenpos.x = x * SCREEN_SCALE_FACTOR;
+	v.screenpos.y = y * SCREEN_SCALE_FACTOR;
+	v.texturecoords.x = (float)(x - SPRITE_X);
+	v.texturecoords.y = (float)(y - SPRITE_Y);
+	v.clipw = 1.0f;
+	v.fogdepth = 1.0f;
+	v.color0 = color;
+	return v;
+}
+
+// Draws the sprite either in one go, or as columns of 1 pixel each.
+static void DrawSprite(BinManager &binner, bool columns, u32 color) {
+	binner.UpdateState();
+	if (columns) {
+		for (int x = SPRITE_X; x < SPRITE_X + SPRITE_W; ++x)
+			binner.AddSprite(SpriteVertex(x, SPRITE_Y, color), SpriteVertex(x + 1, SPRITE_Y + SPRITE_H, color));
+	} else {
+		binner.AddSprite(SpriteVertex(SPRITE_X, SPRITE_Y, color), SpriteVertex(SPRITE_X + SPRITE_W, SPRITE_Y + SPRITE_H, color));
+	}
+	binner.Flush("test");
+}
+
+static bool CompareSpans(BinManager &binner, u32 color, u32 seed) {
+	const u32 *fbPtr = (const u32 *)Memory::GetPointer(COLOR_ADDR);
+	const size_t count = STRIDE * (SPRITE_Y + SPRITE_H);
+
+	FillColor(seed);
+	DrawSprite(binner, false, color);
+	std::vector<u32> wide(fbPtr, fbPtr + count);
+
+	FillColor(seed);
+	DrawSprite(binner, true, color);
+	for (size_t i = 0; i < count; ++i) {
+		if (wide[i] != fbPtr[i]) {
+			printf("Pixel %d,%d is %08x with SIMD, %08x without\n", (int)(i % STRIDE), (int)(i / STRIDE), wide[i], fbPtr[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestSpriteSpans(BinManager &binner) {
+	static const GEComparison funcs[] = {
+		GE_COMP_ALWAYS, GE_COMP_NEVER, GE_COMP_EQUAL, GE_COMP_NOTEQUAL,
+		GE_COMP_LESS, GE_COMP_LEQUAL, GE_COMP_GREATER, GE_COMP_GEQUAL,
+	};
+
+	SetTarget();
+	FillTexture(0x12345678);
+	u32 seed = 0x87654321;
+	for (bool alphaBlend : { false, true }) {
+		for (GEComparison func : funcs) {
+			for (int mask : { 0xFF, 0xF0 }) {
+				SetMode(binner, true, alphaBlend, func, mask);
+				if (!CompareSpans(binner, 0xFFFFFFFF, NextRandom(seed))) {
+					printf("Textured sprite differs: blend=%d func=%d mask=%02x\n", alphaBlend, func, mask);
+					return false;
+				}
+			}
+		}
+
+		// Without a texture, the whole sprite is one color.
+		SetMode(binner, false, alphaBlend, GE_COMP_ALWAYS, 0xFF);
+		for (u32 alpha : { 0x00, 0x01, ALPHA_REF, 0xFE, 0xFF }) {
+			const u32 color = (alpha << 24) | (NextRandom(seed) & 0x00FFFFFF);
+			if (!CompareSpans(binner, color, NextRandom(seed))) {
+				printf("Flat sprite differs: blend=%d color=%08x\n", alphaBlend, color);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool TestSoftwareSprites() {
+	if (!g_threadManager.IsInitialized())
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	Rasterizer::Init();
+	Sampler::Init();
+
+	memset(&gstate, 0, sizeof(gstate));
+	// Through mode, so texture coordinates are in texels.
+	gstate.vertType = (GE_CMD_VERTEXTYPE << 24) | GE_VTYPE_THROUGH;
+
+	std::unique_ptr<BinManager> binner(new BinManager());
+	bool success = TestSpriteSpans(*binner);
+
+	binner.reset();
+	Sampler::Shutdown();
+	Rasterizer::Shutdown();
+	Memory::Shutdown();
+	return success;
+}
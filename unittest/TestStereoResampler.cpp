@@ -0,0 +1,105 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "Core/Config.h"
+#include "Core/ConfigValues.h"
+#include "Core/HW/StereoResampler.h"
+
+#include "UnitTest.h"
+
+static const int INPUT_RATE = 44100;
+static const int OUTPUT_RATE = 48000;
+// 10 ms at a time, like a typical host callback.
+static const int PUSH_SIZE = INPUT_RATE / 100;
+static const int MIX_SIZE = OUTPUT_RATE / 100;
+
+// Pushes a sine at the PSP's rate and mixes it out at the host's, like the emulator and audio threads would.
+// Returns the RMS of the output after it settles, or -1 if it ever underran or values went beyond the amplitude.
+static double ResampleSine(bool highQuality, double frequency, int amplitude) {
+	g_Config.bHighQualityResampler = highQuality;
+	std::unique_ptr<StereoResampler> resampler(new StereoResampler());
+
+	std::vector<s32> input(PUSH_SIZE * 2);
+	std::vector<short> output(MIX_SIZE * 2);
+	int64_t inputPos = 0;
+	auto push = [&]() {
+		for (int i = 0; i < PUSH_SIZE; ++i) {
+			const double phase = 2.0 * 3.14159265358979323846 * frequency * (double)inputPos++ / INPUT_RATE;
+			input[i * 2] = (s32)lrint(amplitude * sin(phase));
+			input[i * 2 + 1] = amplitude;
+		}
+		resampler->PushSamples(input.data(), PUSH_SIZE);
+	};
+
+	// Prefill to around the target buffer size, so it doesn't start with an underrun.
+	for (int i = 0; i < 4; ++i)
+		push();
+
+	double sum = 0.0;
+	int count = 0;
+	for (int step = 0; step < 200; ++step) {
+		push();
+		if (resampler->Mix(output.data(), MIX_SIZE, false, OUTPUT_RATE) != MIX_SIZE)
+			return -1.0;
+		// Skip the start, where it's still reading the zeroed buffer.
+		if (step < 10)
+			continue;
+
+		for (int i = 0; i < MIX_SIZE; ++i) {
+			// The right side is constant, so any gain ripple from the filter would show up here.
+			if (output[i * 2 + 1] != amplitude)
+				return -1.0;
+			sum += (double)output[i * 2] * output[i * 2];
+			count++;
+		}
+	}
+	return sqrt(sum / count);
+}
+
+static bool TestResamplerResponse(double frequency) {
+	const int amplitude = 10000;
+	const double expectedRMS = amplitude / sqrt(2.0);
+	const double linear = ResampleSine(false, frequency, amplitude);
+	const double polyphase = ResampleSine(true, frequency, amplitude);
+	printf("Resampler %0.0f Hz: RMS %0.1f linear, %0.1f polyphase (of %0.1f)\n", frequency, linear, polyphase, expectedRMS);
+
+	EXPECT_TRUE(linear > 0.0 && polyphase > 0.0);
+	// Linear interpolation loses a lot of the highs, the filter shouldn't lose more than a dB or so.
+	EXPECT_TRUE(fabs(polyphase - expectedRMS) < expectedRMS * 0.1);
+	EXPECT_TRUE(fabs(polyphase - expectedRMS) <= fabs(linear - expectedRMS) + 1.0);
+	return true;
+}
+
+bool TestStereoResampler() {
+	const int globalVolume = g_Config.iGlobalVolume;
+	const bool highQuality = g_Config.bHighQualityResampler;
+	g_Config.iGlobalVolume = VOLUME_FULL;
+
+	bool success = true;
+	success = success && TestResamplerResponse(1000.0);
+	success = success && TestResamplerResponse(8000.0);
+	success = success && TestResamplerResponse(15000.0);
+
+	g_Config.iGlobalVolume = globalVolume;
+	g_Config.bHighQualityResampler = highQuality;
+	return success;
+}
@@ -1014,6 +1014,13 @@ bool TestSoftwareGPUJit();
 bool TestIRPassSimplify();
 bool TestThreadManager();
 bool TestVFS();
+bool TestSerializer();
+bool TestBlockDevices();
+bool TestDepthTiles();
+bool TestSoftwareSprites();
+bool TestSasAudio();
+bool TestAtrac();
+bool TestStereoResampler();
 
 TestItem availableTests[] = {
 #if PPSSPP_ARCH(ARM64) || PPSSPP_ARCH(AMD64) || PPSSPP_ARCH(X86)
@@ -1056,6 +1063,13 @@ TestItem availableTests[] = {
 	TEST_ITEM(VFS),
 	TEST_ITEM(Substitutions),
 	TEST_ITEM(IniFile),
+	TEST_ITEM(Serializer),
+	TEST_ITEM(BlockDevices),
+	TEST_ITEM(DepthTiles),
+	TEST_ITEM(SoftwareSprites),
+	TEST_ITEM(SasAudio),
+	TEST_ITEM(Atrac),
+	TEST_ITEM(StereoResampler),
 };
 
 int main(int argc, const char *argv[]) {